@@ -79,7 +79,16 @@ DRESULT disk_read (
 {
   DRESULT res;
 
+#if _FS_REENTRANT == 2
+  if(!ff_req_grant(disk.sobj[pdrv]))
+  {
+    return RES_ERROR;
+  }
+#endif /* _FS_REENTRANT == 2 */
   res = disk.drv[pdrv]->disk_read(disk.lun[pdrv], buff, sector, count);
+#if _FS_REENTRANT == 2
+  ff_rel_grant(disk.sobj[pdrv]);
+#endif /* _FS_REENTRANT == 2 */
   return res;
 }
 
@@ -101,7 +110,16 @@ DRESULT disk_write (
 {
   DRESULT res;
 
+#if _FS_REENTRANT == 2
+  if(!ff_req_grant(disk.sobj[pdrv]))
+  {
+    return RES_ERROR;
+  }
+#endif /* _FS_REENTRANT == 2 */
   res = disk.drv[pdrv]->disk_write(disk.lun[pdrv], buff, sector, count);
+#if _FS_REENTRANT == 2
+  ff_rel_grant(disk.sobj[pdrv]);
+#endif /* _FS_REENTRANT == 2 */
   return res;
 }
 #endif /* _USE_WRITE == 1 */
@@ -122,11 +140,72 @@ DRESULT disk_ioctl (
 {
   DRESULT res;
 
+#if _FS_REENTRANT == 2
+  if(!ff_req_grant(disk.sobj[pdrv]))
+  {
+    return RES_ERROR;
+  }
+#endif /* _FS_REENTRANT == 2 */
   res = disk.drv[pdrv]->disk_ioctl(disk.lun[pdrv], cmd, buff);
+#if _FS_REENTRANT == 2
+  ff_rel_grant(disk.sobj[pdrv]);
+#endif /* _FS_REENTRANT == 2 */
   return res;
 }
 #endif /* _USE_IOCTL == 1 */
 
+/**
+  * @brief  Submits a read of Sector(s)
+  * @param  pdrv: Physical drive number (0..)
+  * @param  *buff: Data buffer to store read data, kept until the completion
+  * @param  sector: Sector address (LBA)
+  * @param  count: Number of sectors to read (1..128)
+  * @param  func: Completion callback, may be called from interrupt context or
+  *         before the function returns (in place when the driver has no
+  *         asynchronous interface)
+  * @param  *arg: Argument passed to the completion callback
+  * @retval DRESULT: RES_OK when the request has been queued, RES_NOTRDY when
+  *         the queue of the driver is full
+  */
+#if _USE_ASYNC == 1
+DRESULT disk_read_async (
+	BYTE pdrv,		/* Physical drive nmuber to identify the drive */
+	BYTE *buff,		/* Data buffer to store read data */
+	DWORD sector,	        /* Sector address in LBA */
+	UINT count,		/* Number of sectors to read */
+	DISKIO_CB func,		/* Completion callback */
+	void *arg		/* Argument of the completion callback */
+)
+{
+  DRESULT res;
+
+#if _FS_REENTRANT == 2
+  if(!ff_req_grant(disk.sobj[pdrv]))
+  {
+    return RES_ERROR;
+  }
+#endif /* _FS_REENTRANT == 2 */
+  if(disk.drv[pdrv]->disk_read_async != 0)
+  {
+    res = disk.drv[pdrv]->disk_read_async(disk.lun[pdrv], buff, sector, count, func, arg);
+  }
+  else
+  {
+    /* The driver has no asynchronous interface, complete the request in place */
+    res = disk.drv[pdrv]->disk_read(disk.lun[pdrv], buff, sector, count);
+  }
+#if _FS_REENTRANT == 2
+  ff_rel_grant(disk.sobj[pdrv]);
+#endif /* _FS_REENTRANT == 2 */
+  if(disk.drv[pdrv]->disk_read_async == 0)
+  {
+    func(res, arg);
+    res = RES_OK;
+  }
+  return res;
+}
+#endif /* _USE_ASYNC == 1 */
+
 /**
   * @brief  Gets Time from RTC
   * @param  None
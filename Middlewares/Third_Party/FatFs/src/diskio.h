@@ -11,6 +11,9 @@ extern "C" {
 
 #define _USE_WRITE	1	/* 1: Enable disk_write function */
 #define _USE_IOCTL	1	/* 1: Enable disk_ioctl function */
+#ifndef _USE_ASYNC
+#define _USE_ASYNC	0	/* 1: Enable disk_read_async function and f_read_async */
+#endif
 
 #include "integer.h"
 
@@ -27,6 +30,9 @@ typedef enum {
 	RES_PARERR		/* 4: Invalid Parameter */
 } DRESULT;
 
+/* Completion callback of asynchronous disk functions */
+typedef void (*DISKIO_CB)(DRESULT res, void* arg);
+
 
 /*---------------------------------------*/
 /* Prototypes for disk control functions */
@@ -37,6 +43,7 @@ DSTATUS disk_status (BYTE pdrv);
 DRESULT disk_read (BYTE pdrv, BYTE* buff, DWORD sector, UINT count);
 DRESULT disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, UINT count);
 DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
+DRESULT disk_read_async (BYTE pdrv, BYTE* buff, DWORD sector, UINT count, DISKIO_CB func, void* arg);
 DWORD get_fattime (void);
 
 /* Disk Status Bits (DSTATUS) */
@@ -54,12 +61,14 @@ DWORD get_fattime (void);
 #define GET_SECTOR_SIZE		2	/* Get sector size (needed at _MAX_SS != _MIN_SS) */
 #define GET_BLOCK_SIZE		3	/* Get erase block size (needed at _USE_MKFS == 1) */
 #define CTRL_TRIM		4	/* Inform device that the data on the block of sectors is no longer used (needed at _USE_TRIM == 1) */
+#define CTRL_ZERO		15	/* Fill the block of sectors with zero, e.g. by an erase (used by f_mkfs with FM_FAST) */
 
 /* Generic command (Not used by FatFs) */
 #define CTRL_POWER			5	/* Get/Set power status */
 #define CTRL_LOCK			6	/* Lock/Unlock media removal */
 #define CTRL_EJECT			7	/* Eject media */
 #define CTRL_FORMAT			8	/* Create physical format on the media */
+#define GET_QUEUE_DEPTH		9	/* Get number of disk_read_async requests the driver can queue (UINT) */
 
 /* MMC/SDC specific ioctl command */
 #define MMC_GET_TYPE		10	/* Get card type */
@@ -0,0 +1,678 @@
+/**
+******************************************************************************
+* @file    sd_diskio_dma_rtos_bounce_template.c
+* @author  MCD Application Team
+* @brief   SD Disk I/O DMA with RTOS driver template using a pool of bounce
+*          buffers for the unaligned transfers. This file needs to be copied
+*          at user project alongside the respective header file.
+******************************************************************************
+* @attention
+*
+* Copyright (c) 2017 STMicroelectronics. All rights reserved.
+*
+* This software component is licensed by ST under BSD 3-Clause license,
+* the "License"; You may not use this file except in compliance with the
+* License. You may obtain a copy of the License at:
+*                       opensource.org/licenses/BSD-3-Clause
+*
+******************************************************************************
+**/
+/* Includes ------------------------------------------------------------------*/
+#include "ff_gen_drv.h"
+#include "sd_diskio_dma_rtos_bounce.h"
+
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define QUEUE_SIZE         (uint32_t) 10
+#define READ_CPLT_MSG      (uint32_t) 1
+#define WRITE_CPLT_MSG     (uint32_t) 2
+
+/*
+* the following Timeout is useful to give the control back to the applications
+* in case of errors in either BSP_SD_ReadCpltCallback() or BSP_SD_WriteCpltCallback()
+* the value by default is as defined in the BSP platform driver otherwise 30 secs
+*
+*/
+
+#define SD_TIMEOUT 30 * 1000
+
+#define SD_DEFAULT_BLOCK_SIZE 512
+
+/*
+* Depending on the usecase, the SD card initialization could be done at the
+* application level, if it is the case define the flag below to disable
+* the BSP_SD_Init() call in the SD_Initialize().
+*/
+
+#define DISABLE_SD_INIT
+
+
+/*
+* when using cachable memory region, it may be needed to maintain the cache
+* validity. Enable the define below to activate a cache maintenance at each
+* read and write operation.
+* Notice: This is applicable only for cortex M7 based platform.
+*/
+
+/* #define ENABLE_SD_DMA_CACHE_MAINTENANCE  1 */
+
+/*
+* The SD erase leaves the blocks filled with either 0 or 1 depending on the
+* card (DATA_STAT_AFTER_ERASE in the SCR). Enable the define below when the
+* card reads erased blocks as 0, the f_mkfs() with FM_FAST then clears the
+* FAT area with an erase instead of writing it.
+*/
+/* #define ENABLE_SD_ERASE_ZERO */
+
+/*
+* The DMA requires a 4-Byte aligned buffer, and with the cache maintenance
+* enabled a read must not invalidate a cache line shared with data outside
+* of the user buffer. Such transfers go through a pool of bounce buffers:
+* - a buffer that is not 4-Byte aligned is transferred in chunks of
+*   SD_BOUNCE_SECTORS sectors, the copy of a chunk being done while the DMA
+*   of the next one is in progress.
+* - a read to a 4-Byte aligned buffer that is not aligned on a cache line
+*   gets its first and last sectors through the pool, the inner sectors are
+*   read straight into the user buffer with a single multi-block DMA.
+*/
+#define SD_BOUNCE_BUFFERS  2
+#define SD_BOUNCE_SECTORS  8
+
+#define SD_CACHE_LINE      32
+
+#if SD_BOUNCE_BUFFERS < 2 || SD_BOUNCE_SECTORS < 1
+#error Wrong bounce pool configuration
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+ALIGN_32BYTES(static uint8_t bounce[SD_BOUNCE_BUFFERS][SD_BOUNCE_SECTORS * BLOCKSIZE]); // 32-Byte aligned for cache maintenance
+#else
+__ALIGN_BEGIN static uint8_t bounce[SD_BOUNCE_BUFFERS][SD_BOUNCE_SECTORS * BLOCKSIZE] __ALIGN_END;
+#endif
+/* Disk status */
+static volatile DSTATUS Stat = STA_NOINIT;
+#if (osCMSIS <= 0x20000U)
+static osMessageQId SDQueueID = NULL;
+#else
+static osMessageQueueId_t SDQueueID = NULL;
+#endif
+/* Private function prototypes -----------------------------------------------*/
+static DSTATUS SD_CheckStatus(BYTE lun);
+DSTATUS SD_initialize (BYTE);
+DSTATUS SD_status (BYTE);
+DRESULT SD_read (BYTE, BYTE*, DWORD, UINT);
+#if _USE_WRITE == 1
+DRESULT SD_write (BYTE, const BYTE*, DWORD, UINT);
+#endif /* _USE_WRITE == 1 */
+#if _USE_IOCTL == 1
+DRESULT SD_ioctl (BYTE, BYTE, void*);
+#endif  /* _USE_IOCTL == 1 */
+
+const Diskio_drvTypeDef  SD_Driver =
+{
+  SD_initialize,
+  SD_status,
+  SD_read,
+#if  _USE_WRITE == 1
+  SD_write,
+#endif /* _USE_WRITE == 1 */
+
+#if  _USE_IOCTL == 1
+  SD_ioctl,
+#endif /* _USE_IOCTL == 1 */
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+static int SD_CheckStatusWithTimeout(uint32_t timeout)
+{
+  uint32_t timer;
+  /* block until SDIO peripherial is ready again or a timeout occur */
+#if (osCMSIS <= 0x20000U)
+  timer = osKernelSysTick();
+  while( osKernelSysTick() - timer < timeout)
+#else
+    timer = osKernelGetTickCount();
+  while( osKernelGetTickCount() - timer < timeout)
+#endif
+  {
+    if (BSP_SD_GetCardState() == SD_TRANSFER_OK)
+    {
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+static DSTATUS SD_CheckStatus(BYTE lun)
+{
+  Stat = STA_NOINIT;
+
+  if(BSP_SD_GetCardState() == SD_TRANSFER_OK)
+  {
+    Stat &= ~STA_NOINIT;
+  }
+
+  return Stat;
+}
+
+/**
+* @brief  Waits for the end of the DMA transfer in progress
+* @param  msg: Completion message expected from the callback
+* @retval 0 when the transfer is done and the card is ready, -1 otherwise
+*/
+static int SD_WaitTransfer(uint16_t msg)
+{
+  uint32_t timer;
+#if (osCMSIS < 0x20000U)
+  osEvent event;
+
+  /* wait for a message from the queue or a timeout */
+  event = osMessageGet(SDQueueID, SD_TIMEOUT);
+
+  if ((event.status != osEventMessage) || (event.value.v != msg))
+  {
+    return -1;
+  }
+
+  timer = osKernelSysTick();
+  /* block until SDIO IP is ready or a timeout occur */
+  while(osKernelSysTick() - timer < SD_TIMEOUT)
+#else
+  uint16_t event;
+
+  /* wait for a message from the queue or a timeout */
+  if ((osMessageQueueGet(SDQueueID, (void *)&event, NULL, SD_TIMEOUT) != osOK) || (event != msg))
+  {
+    return -1;
+  }
+
+  timer = osKernelGetTickCount();
+  /* block until SDIO IP is ready or a timeout occur */
+  while(osKernelGetTickCount() - timer < SD_TIMEOUT)
+#endif
+  {
+    if (BSP_SD_GetCardState() == SD_TRANSFER_OK)
+    {
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+/**
+* @brief  Rounds a memory area out to the D-Cache lines it touches
+* @param  addr: Start of the area
+* @param  len: Length of the area in bytes
+* @param  *start: Receives the address of the first line
+* @retval Size of the lines in bytes
+*/
+static int32_t SD_CacheLines(const void *addr, uint32_t len, uint32_t **start)
+{
+  uint32_t ofs = (uint32_t)addr & (SD_CACHE_LINE - 1);
+
+  *start = (uint32_t*)((const uint8_t*)addr - ofs);
+  return (int32_t)((ofs + len + SD_CACHE_LINE - 1) & ~(SD_CACHE_LINE - 1));
+}
+#endif
+
+/**
+* @brief  Reads Sector(s) through the bounce pool
+* @param  *buff: Data buffer to store read data, any alignment
+* @param  sector: Sector address (LBA)
+* @param  count: Number of sectors to read
+* @retval DRESULT: Operation result
+*/
+static DRESULT SD_ReadBounce(BYTE *buff, DWORD sector, UINT count)
+{
+  uint8_t *prev = NULL;
+  UINT n, nprev = 0, i = 0;
+
+  while (count > 0)
+  {
+    n = (count < SD_BOUNCE_SECTORS) ? count : SD_BOUNCE_SECTORS;
+
+    if (BSP_SD_ReadBlocks_DMA((uint32_t*)bounce[i], (uint32_t)sector, n) != MSD_OK)
+    {
+      return RES_ERROR;
+    }
+
+    /* copy out the previous chunk while the DMA fills this one */
+    if (prev != NULL)
+    {
+      memcpy(buff, prev, nprev * BLOCKSIZE);
+      buff += nprev * BLOCKSIZE;
+    }
+
+    if (SD_WaitTransfer(READ_CPLT_MSG) < 0)
+    {
+      return RES_ERROR;
+    }
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+    /* the pool is line aligned, drop the lines of the sectors just read */
+    SCB_InvalidateDCache_by_Addr((uint32_t*)bounce[i], n * BLOCKSIZE);
+#endif
+
+    prev = bounce[i];
+    nprev = n;
+    sector += n;
+    count -= n;
+    i = (i + 1) % SD_BOUNCE_BUFFERS;
+  }
+
+  if (prev != NULL)
+  {
+    memcpy(buff, prev, nprev * BLOCKSIZE);
+  }
+
+  return RES_OK;
+}
+
+/**
+* @brief  Reads Sector(s) with a single DMA straight into the user buffer
+* @param  *buff: Data buffer to store read data, 4-Byte aligned
+* @param  sector: Sector address (LBA)
+* @param  count: Number of sectors to read
+* @retval DRESULT: Operation result
+* @note   With the cache maintenance, the lines at both ends of the buffer
+*         must only hold data that is overwritten by this read.
+*/
+static DRESULT SD_ReadDirect(BYTE *buff, DWORD sector, UINT count)
+{
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+  uint32_t *lines;
+  int32_t size = SD_CacheLines(buff, count * BLOCKSIZE, &lines);
+
+  /*
+  * write back the lines before the transfer so that no dirty line can be
+  * evicted over the incoming data
+  */
+  SCB_CleanInvalidateDCache_by_Addr(lines, size);
+#endif
+
+  if (BSP_SD_ReadBlocks_DMA((uint32_t*)buff, (uint32_t)sector, count) != MSD_OK)
+  {
+    return RES_ERROR;
+  }
+
+  if (SD_WaitTransfer(READ_CPLT_MSG) < 0)
+  {
+    return RES_ERROR;
+  }
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+  SCB_InvalidateDCache_by_Addr(lines, size);
+#endif
+
+  return RES_OK;
+}
+
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+/**
+* @brief  Reads Sector(s) to a buffer that is not aligned on a cache line
+* @param  *buff: Data buffer to store read data, 4-Byte aligned
+* @param  sector: Sector address (LBA)
+* @param  count: Number of sectors to read (3 at least)
+* @retval DRESULT: Operation result
+*/
+static DRESULT SD_ReadSplit(BYTE *buff, DWORD sector, UINT count)
+{
+  DRESULT res;
+
+  /* first sector into the pool, its lines are shared with the caller data */
+  if (BSP_SD_ReadBlocks_DMA((uint32_t*)bounce[0], (uint32_t)sector, 1) != MSD_OK)
+  {
+    return RES_ERROR;
+  }
+
+  if (SD_WaitTransfer(READ_CPLT_MSG) < 0)
+  {
+    return RES_ERROR;
+  }
+  SCB_InvalidateDCache_by_Addr((uint32_t*)bounce[0], BLOCKSIZE);
+
+  /* inner sectors: both end lines only hold bytes of the user buffer */
+  res = SD_ReadDirect(buff + BLOCKSIZE, sector + 1, count - 2);
+
+  if (res != RES_OK)
+  {
+    return res;
+  }
+
+  /* last sector into the pool, the first one is copied out meanwhile */
+  if (BSP_SD_ReadBlocks_DMA((uint32_t*)bounce[1], (uint32_t)(sector + count - 1), 1) != MSD_OK)
+  {
+    return RES_ERROR;
+  }
+
+  memcpy(buff, bounce[0], BLOCKSIZE);
+
+  if (SD_WaitTransfer(READ_CPLT_MSG) < 0)
+  {
+    return RES_ERROR;
+  }
+  SCB_InvalidateDCache_by_Addr((uint32_t*)bounce[1], BLOCKSIZE);
+
+  memcpy(buff + (count - 1) * BLOCKSIZE, bounce[1], BLOCKSIZE);
+
+  return RES_OK;
+}
+#endif
+
+#if _USE_WRITE == 1
+/**
+* @brief  Writes Sector(s) through the bounce pool
+* @param  *buff: Data to be written, any alignment
+* @param  sector: Sector address (LBA)
+* @param  count: Number of sectors to write
+* @retval DRESULT: Operation result
+*/
+static DRESULT SD_WriteBounce(const BYTE *buff, DWORD sector, UINT count)
+{
+  UINT n, next, i = 0;
+
+  n = (count < SD_BOUNCE_SECTORS) ? count : SD_BOUNCE_SECTORS;
+  memcpy(bounce[0], buff, n * BLOCKSIZE);
+  buff += n * BLOCKSIZE;
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+  SCB_CleanDCache_by_Addr((uint32_t*)bounce[0], n * BLOCKSIZE);
+#endif
+
+  while (count > 0)
+  {
+    if (BSP_SD_WriteBlocks_DMA((uint32_t*)bounce[i], (uint32_t)sector, n) != MSD_OK)
+    {
+      return RES_ERROR;
+    }
+
+    sector += n;
+    count -= n;
+    i = (i + 1) % SD_BOUNCE_BUFFERS;
+
+    /* fill the next chunk while the DMA drains this one */
+    next = (count < SD_BOUNCE_SECTORS) ? count : SD_BOUNCE_SECTORS;
+    if (next > 0)
+    {
+      memcpy(bounce[i], buff, next * BLOCKSIZE);
+      buff += next * BLOCKSIZE;
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+      SCB_CleanDCache_by_Addr((uint32_t*)bounce[i], next * BLOCKSIZE);
+#endif
+    }
+
+    if (SD_WaitTransfer(WRITE_CPLT_MSG) < 0)
+    {
+      return RES_ERROR;
+    }
+    n = next;
+  }
+
+  return RES_OK;
+}
+#endif /* _USE_WRITE == 1 */
+
+/**
+* @brief  Initializes a Drive
+* @param  lun : not used
+* @retval DSTATUS: Operation status
+*/
+DSTATUS SD_initialize(BYTE lun)
+{
+  Stat = STA_NOINIT;
+  /*
+  * check that the kernel has been started before continuing
+  * as the osMessage API will fail otherwise
+  */
+#if (osCMSIS <= 0x20000U)
+  if(osKernelRunning())
+#else
+    if(osKernelGetState() == osKernelRunning)
+#endif
+    {
+#if !defined(DISABLE_SD_INIT)
+
+      if(BSP_SD_Init() == MSD_OK)
+      {
+        Stat = SD_CheckStatus(lun);
+      }
+
+#else
+      Stat = SD_CheckStatus(lun);
+#endif
+
+      /*
+      * if the SD is correctly initialized, create the operation queue
+      * if not already created
+      */
+
+      if (Stat != STA_NOINIT)
+      {
+        if (SDQueueID == NULL)
+        {
+#if (osCMSIS <= 0x20000U)
+          osMessageQDef(SD_Queue, QUEUE_SIZE, uint16_t);
+          SDQueueID = osMessageCreate (osMessageQ(SD_Queue), NULL);
+#else
+          SDQueueID = osMessageQueueNew(QUEUE_SIZE, 2, NULL);
+#endif
+        }
+
+        if (SDQueueID == NULL)
+        {
+          Stat |= STA_NOINIT;
+        }
+      }
+    }
+
+  return Stat;
+}
+
+/**
+* @brief  Gets Disk Status
+* @param  lun : not used
+* @retval DSTATUS: Operation status
+*/
+DSTATUS SD_status(BYTE lun)
+{
+  return SD_CheckStatus(lun);
+}
+
+/**
+* @brief  Reads Sector(s)
+* @param  lun : not used
+* @param  *buff: Data buffer to store read data
+* @param  sector: Sector address (LBA)
+* @param  count: Number of sectors to read (1..128)
+* @retval DRESULT: Operation result
+*/
+DRESULT SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+  /*
+  * ensure the SDCard is ready for a new operation
+  */
+
+  if (SD_CheckStatusWithTimeout(SD_TIMEOUT) < 0)
+  {
+    return RES_ERROR;
+  }
+
+  if ((uint32_t)buff & 0x3)
+  {
+    /* the DMA can't reach the buffer, everything goes through the pool */
+    return SD_ReadBounce(buff, sector, count);
+  }
+
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+  if ((uint32_t)buff & (SD_CACHE_LINE - 1))
+  {
+    /* only the sectors sharing a line with the caller data are bounced */
+    return (count > 2) ? SD_ReadSplit(buff, sector, count) : SD_ReadBounce(buff, sector, count);
+  }
+#endif
+
+  /* Fast path cause destination buffer is correctly aligned */
+  return SD_ReadDirect(buff, sector, count);
+}
+
+/**
+* @brief  Writes Sector(s)
+* @param  lun : not used
+* @param  *buff: Data to be written
+* @param  sector: Sector address (LBA)
+* @param  count: Number of sectors to write (1..128)
+* @retval DRESULT: Operation result
+*/
+#if _USE_WRITE == 1
+DRESULT SD_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+  uint32_t *lines;
+  int32_t size;
+#endif
+
+  /*
+  * ensure the SDCard is ready for a new operation
+  */
+
+  if (SD_CheckStatusWithTimeout(SD_TIMEOUT) < 0)
+  {
+    return RES_ERROR;
+  }
+
+  if ((uint32_t)buff & 0x3)
+  {
+    /* the DMA can't reach the buffer, everything goes through the pool */
+    return SD_WriteBounce(buff, sector, count);
+  }
+
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+  /* cleaning a shared line is harmless, only the touched lines are written back */
+  size = SD_CacheLines(buff, count * BLOCKSIZE, &lines);
+  SCB_CleanDCache_by_Addr(lines, size);
+#endif
+
+  if (BSP_SD_WriteBlocks_DMA((uint32_t*)buff, (uint32_t)sector, count) != MSD_OK)
+  {
+    return RES_ERROR;
+  }
+
+  return (SD_WaitTransfer(WRITE_CPLT_MSG) < 0) ? RES_ERROR : RES_OK;
+}
+#endif /* _USE_WRITE == 1 */
+
+/**
+* @brief  I/O control operation
+* @param  lun : not used
+* @param  cmd: Control code
+* @param  *buff: Buffer to send/receive control data
+* @retval DRESULT: Operation result
+*/
+#if _USE_IOCTL == 1
+DRESULT SD_ioctl(BYTE lun, BYTE cmd, void *buff)
+{
+  DRESULT res = RES_ERROR;
+  BSP_SD_CardInfo CardInfo;
+
+  if (Stat & STA_NOINIT) return RES_NOTRDY;
+
+  switch (cmd)
+  {
+    /* Make sure that no pending write process */
+  case CTRL_SYNC :
+    res = RES_OK;
+    break;
+
+    /* Get number of sectors on the disk (DWORD) */
+  case GET_SECTOR_COUNT :
+    BSP_SD_GetCardInfo(&CardInfo);
+    *(DWORD*)buff = CardInfo.LogBlockNbr;
+    res = RES_OK;
+    break;
+
+    /* Get R/W sector size (WORD) */
+  case GET_SECTOR_SIZE :
+    BSP_SD_GetCardInfo(&CardInfo);
+    *(WORD*)buff = CardInfo.LogBlockSize;
+    res = RES_OK;
+    break;
+
+    /* Get erase block size in unit of sector (DWORD) */
+  case GET_BLOCK_SIZE :
+    BSP_SD_GetCardInfo(&CardInfo);
+    *(DWORD*)buff = CardInfo.LogBlockSize / SD_DEFAULT_BLOCK_SIZE;
+    res = RES_OK;
+    break;
+
+#if defined(ENABLE_SD_ERASE_ZERO)
+    /* Fill a block of sectors with zero (DWORD[2]: start and end sector) */
+  case CTRL_ZERO :
+    if ((BSP_SD_Erase((uint32_t)((DWORD*)buff)[0], (uint32_t)((DWORD*)buff)[1]) == MSD_OK) &&
+        (SD_CheckStatusWithTimeout(SD_TIMEOUT) == 0))
+    {
+      res = RES_OK;
+    }
+    break;
+#endif
+
+  default:
+    res = RES_PARERR;
+  }
+
+  return res;
+}
+#endif /* _USE_IOCTL == 1 */
+
+
+/*********************************************************************
+*  Select the correct callback prototype depending on your platform *
+*  Check the board related stm32xxx_{eval/discovery}_sd.h           *
+*********************************************************************
+*/
+
+/**
+* @brief Tx Transfer completed callbacks
+* @param hsd: SD handle
+* @retval None
+*/
+
+//void    BSP_SD_WriteCpltCallback(uint32_t SdCard);
+void BSP_SD_WriteCpltCallback(void)
+{
+  /*
+  * No need to add an "osKernelRunning()" check here, as the SD_initialize()
+  * is always called before any SD_Read()/SD_Write() call
+  */
+#if (osCMSIS < 0x20000U)
+  osMessagePut(SDQueueID, WRITE_CPLT_MSG, 0);
+#else
+  const uint16_t msg = WRITE_CPLT_MSG;
+  osMessageQueuePut(SDQueueID, (const void *)&msg, NULL, 0);
+#endif
+}
+
+/**
+* @brief Rx Transfer completed callbacks
+* @param hsd: SD handle
+* @retval None
+*/
+//void    BSP_SD_ReadCpltCallback(uint32_t SdCard);
+void BSP_SD_ReadCpltCallback(void)
+{
+  /*
+  * No need to add an "osKernelRunning()" check here, as the SD_initialize()
+  * is always called before any SD_Read()/SD_Write() call
+  */
+#if (osCMSIS < 0x20000U)
+  osMessagePut(SDQueueID, READ_CPLT_MSG, 0);
+#else
+  const uint16_t msg = READ_CPLT_MSG;
+  osMessageQueuePut(SDQueueID, (const void *)&msg, NULL, 0);
+#endif
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -40,6 +40,10 @@ See BSP_SD_ErrorCallback() and BSP_SD_AbortCallback() below
 #define RW_ERROR_MSG       (uint32_t) 3
 #define RW_ABORT_MSG       (uint32_t) 4
 */
+#if _USE_ASYNC == 1
+/* end of an asynchronous read, posted only when a request is waiting for it */
+#define ASYNC_CPLT_MSG     (uint32_t) 5
+#endif
 /*
 * the following Timeout is useful to give the control back to the applications
 * in case of errors in either BSP_SD_ReadCpltCallback() or BSP_SD_WriteCpltCallback()
@@ -91,6 +95,16 @@ static osMessageQId SDQueueID = NULL;
 #else
 static osMessageQueueId_t SDQueueID = NULL;
 #endif
+#if _USE_ASYNC == 1
+/* Asynchronous read in progress (the SD interface runs one transfer at a time) */
+static volatile DISKIO_CB AsyncFunc = NULL;
+static void *AsyncArg;
+static volatile uint8_t AsyncWait = 0;
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+static BYTE *AsyncBuff;
+static UINT AsyncCount;
+#endif
+#endif /* _USE_ASYNC == 1 */
 /* Private function prototypes -----------------------------------------------*/
 static DSTATUS SD_CheckStatus(BYTE lun);
 DSTATUS SD_initialize (BYTE);
@@ -102,6 +116,9 @@ DRESULT SD_write (BYTE, const BYTE*, DWORD, UINT);
 #if _USE_IOCTL == 1
 DRESULT SD_ioctl (BYTE, BYTE, void*);
 #endif  /* _USE_IOCTL == 1 */
+#if _USE_ASYNC == 1
+DRESULT SD_read_async (BYTE, BYTE*, DWORD, UINT, DISKIO_CB, void*);
+#endif  /* _USE_ASYNC == 1 */
 
 const Diskio_drvTypeDef  SD_Driver =
 {
@@ -115,13 +132,123 @@ const Diskio_drvTypeDef  SD_Driver =
 #if  _USE_IOCTL == 1
   SD_ioctl,
 #endif /* _USE_IOCTL == 1 */
+#if  _USE_ASYNC == 1
+  SD_read_async,
+#endif /* _USE_ASYNC == 1 */
 };
 
 /* Private functions ---------------------------------------------------------*/
 
+#if _USE_ASYNC == 1
+/**
+* @brief  Waits for the end of the asynchronous read in flight, if any
+* @param  timeout: Maximum waiting time in ticks
+* @retval 0 when no asynchronous read is in flight, -1 on timeout
+*/
+static int SD_WaitAsync(uint32_t timeout)
+{
+  uint32_t timer;
+  uint32_t elapsed;
+#if (osCMSIS >= 0x20000U)
+  uint16_t event;
+#endif
+
+#if (osCMSIS <= 0x20000U)
+  timer = osKernelSysTick();
+#else
+  timer = osKernelGetTickCount();
+#endif
+  while (AsyncFunc != NULL)
+  {
+#if (osCMSIS <= 0x20000U)
+    elapsed = osKernelSysTick() - timer;
+#else
+    elapsed = osKernelGetTickCount() - timer;
+#endif
+    if (elapsed >= timeout)
+    {
+      return -1;
+    }
+
+    /*
+    * the completion posts ASYNC_CPLT_MSG when AsyncWait is set, test
+    * AsyncFunc again as the transfer may have ended in the meantime
+    */
+    AsyncWait = 1;
+    if (AsyncFunc != NULL)
+    {
+#if (osCMSIS < 0x20000U)
+      osMessageGet(SDQueueID, timeout - elapsed);
+#else
+      osMessageQueueGet(SDQueueID, (void *)&event, NULL, timeout - elapsed);
+#endif
+    }
+    AsyncWait = 0;
+
+    /* drop the message of a completion that ended before the wait */
+#if (osCMSIS < 0x20000U)
+    osMessageGet(SDQueueID, 0);
+#else
+    osMessageQueueGet(SDQueueID, (void *)&event, NULL, 0);
+#endif
+  }
+
+  return 0;
+}
+
+/**
+* @brief  Completes the asynchronous read in flight, if any
+* @param  res: Result of the transfer
+* @retval 1 when an asynchronous read has been completed, 0 otherwise
+*/
+static int SD_CompleteAsync(DRESULT res)
+{
+  DISKIO_CB func = AsyncFunc;
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+  uint32_t alignedAddr;
+#endif
+#if (osCMSIS >= 0x20000U)
+  const uint16_t msg = ASYNC_CPLT_MSG;
+#endif
+
+  if (func == NULL)
+  {
+    return 0;
+  }
+
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+  if (res == RES_OK)
+  {
+    alignedAddr = (uint32_t)AsyncBuff & ~0x1F;
+    SCB_InvalidateDCache_by_Addr((uint32_t*)alignedAddr, AsyncCount*BLOCKSIZE + ((uint32_t)AsyncBuff - alignedAddr));
+  }
+#endif
+  AsyncFunc = NULL;
+  func(res, AsyncArg);
+
+  if (AsyncWait)
+  {
+#if (osCMSIS < 0x20000U)
+    osMessagePut(SDQueueID, ASYNC_CPLT_MSG, 0);
+#else
+    osMessageQueuePut(SDQueueID, (const void *)&msg, NULL, 0);
+#endif
+  }
+
+  return 1;
+}
+#endif /* _USE_ASYNC == 1 */
+
 static int SD_CheckStatusWithTimeout(uint32_t timeout)
 {
   uint32_t timer;
+#if _USE_ASYNC == 1
+  /* wait for the end of the asynchronous read if any */
+  if (SD_WaitAsync(timeout) < 0)
+  {
+    return -1;
+  }
+#endif
   /* block until SDIO peripherial is ready again or a timeout occur */
 #if (osCMSIS <= 0x20000U)
   timer = osKernelSysTick();
@@ -583,6 +710,14 @@ DRESULT SD_ioctl(BYTE lun, BYTE cmd, void *buff)
     res = RES_OK;
     break;
 
+#if _USE_ASYNC == 1
+    /* Get number of asynchronous reads that can be queued (UINT) */
+  case GET_QUEUE_DEPTH :
+    *(UINT*)buff = 1;
+    res = RES_OK;
+    break;
+#endif
+
   default:
     res = RES_PARERR;
   }
@@ -591,6 +726,52 @@ DRESULT SD_ioctl(BYTE lun, BYTE cmd, void *buff)
 }
 #endif /* _USE_IOCTL == 1 */
 
+/**
+* @brief  Submits a read of Sector(s), the completion is notified from
+*         BSP_SD_ReadCpltCallback() in interrupt context, or with RES_ERROR
+*         from BSP_SD_ErrorCallback()/BSP_SD_AbortCallback()
+* @param  lun : not used
+* @param  *buff: Data buffer to store read data
+* @param  sector: Sector address (LBA)
+* @param  count: Number of sectors to read (1..128)
+* @param  func: Completion callback
+* @param  *arg: Argument of the completion callback
+* @retval DRESULT: RES_OK when started, RES_NOTRDY when a transfer is in progress
+*/
+#if _USE_ASYNC == 1
+DRESULT SD_read_async(BYTE lun, BYTE *buff, DWORD sector, UINT count, DISKIO_CB func, void *arg)
+{
+  if (AsyncFunc != NULL || BSP_SD_GetCardState() != SD_TRANSFER_OK)
+  {
+    return RES_NOTRDY;
+  }
+
+#if defined(ENABLE_SCRATCH_BUFFER)
+  if ((uint32_t)buff & 0x3)
+  {
+    /* Unaligned buffer goes through the scratch buffer, complete it in place */
+    func(SD_read(lun, buff, sector, count), arg);
+    return RES_OK;
+  }
+#endif
+
+  AsyncArg = arg;
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+  AsyncBuff = buff;
+  AsyncCount = count;
+#endif
+  AsyncFunc = func;
+
+  if (BSP_SD_ReadBlocks_DMA((uint32_t*)buff, (uint32_t)(sector), count) != MSD_OK)
+  {
+    AsyncFunc = NULL;
+    return RES_ERROR;
+  }
+
+  return RES_OK;
+}
+#endif /* _USE_ASYNC == 1 */
+
 
 /*********************************************************************
 *  Select the correct callback prototype depending on your platform *
@@ -627,6 +808,12 @@ void BSP_SD_WriteCpltCallback(void)
 //void    BSP_SD_ReadCpltCallback(uint32_t SdCard);
 void BSP_SD_ReadCpltCallback(void)
 {
+#if _USE_ASYNC == 1
+  if (SD_CompleteAsync(RES_OK))
+  {
+    return;
+  }
+#endif /* _USE_ASYNC == 1 */
   /*
   * No need to add an "osKernelRunning()" check here, as the SD_initialize()
   * is always called before any SD_Read()/SD_Write() call
@@ -639,7 +826,32 @@ void BSP_SD_ReadCpltCallback(void)
 #endif
 }
 
+#if _USE_ASYNC == 1
+/**
+* @brief SD error callback, fails the asynchronous read in flight. It is not
+*        called by all the BSP drivers, in that case call it from
+*        HAL_SD_ErrorCallback()
+* @retval None
+*/
+//void    BSP_SD_ErrorCallback(uint32_t SdCard);
+void BSP_SD_ErrorCallback(void)
+{
+  SD_CompleteAsync(RES_ERROR);
+}
+
+/**
+* @brief SD abort callback, fails the asynchronous read in flight
+* @retval None
+*/
+//void    BSP_SD_AbortCallback(uint32_t SdCard);
+void BSP_SD_AbortCallback(void)
+{
+  SD_CompleteAsync(RES_ERROR);
+}
+#endif /* _USE_ASYNC == 1 */
+
 /*
+with _USE_ASYNC == 1, post the messages from the callbacks above instead
 
 //void    BSP_SD_AbortCallback(uint32_t SdCard);
 void BSP_SD_AbortCallback(void)
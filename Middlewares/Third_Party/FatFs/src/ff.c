@@ -304,6 +304,7 @@
 
 
 /* Additional file access control and file status flags for internal use */
+#define FA_CONTIG	0x04	/* File is in a contiguous block (contiguous stream mode) */
 #define FA_SEEKEND	0x20	/* Seek to end of the file on file open */
 #define FA_MODIFIED	0x40	/* File has been modified */
 #define FA_DIRTY	0x80	/* FIL.buf[] needs to be written-back */
@@ -437,6 +438,13 @@
 #define	FSI_Free_Count		488		/* FAT32 FSI: Number of free clusters (DWORD) */
 #define	FSI_Nxt_Free		492		/* FAT32 FSI: Last allocated cluster (DWORD) */
 
+#define	JNL_Sig				0		/* Journal: Signature "FJNL" (DWORD) */
+#define	JNL_Gen				4		/* Journal: Generation of the journal (DWORD) */
+#define	JNL_Seq				8		/* Journal: Sequence number of the record (DWORD, 0xFFFFFFFF:superblock) */
+#define	JNL_Cnt				12		/* Journal: Number of sectors in the record (DWORD) */
+#define	JNL_Sum				16		/* Journal: Check sum of the record (DWORD) */
+#define	JNL_Lba				20		/* Journal: Home sector number of each sector in the record (DWORD[]) */
+
 #define MBR_Table			446		/* MBR: Offset of partition table in the MBR */
 #define	SZ_PTE				16		/* MBR: Size of a partition table entry */
 #define PTE_Boot			0		/* MBR PTE: Boot indicator */
@@ -460,6 +468,9 @@
 #if _USE_LFN == 1
 #error Static LFN work area cannot be used at thread-safe configuration
 #endif
+#if _FS_REENTRANT == 2 && (_FS_TINY || !_FS_LOCK)
+#error _FS_REENTRANT == 2 needs _FS_TINY == 0 and _FS_LOCK > 0
+#endif
 #define	ENTER_FF(fs)		{ if (!lock_fs(fs)) return FR_TIMEOUT; }
 #define	LEAVE_FF(fs, res)	{ unlock_fs(fs, res); return res; }
 #else
@@ -489,6 +500,55 @@
 #endif
 
 
+/* Read-ahead pool and write-back cache */
+#if _FS_RDAHEAD && _FS_TINY
+#error _FS_RDAHEAD must be 0 at tiny buffer configuration
+#endif
+#if _USE_STREAM && !_FS_RDAHEAD
+#error _USE_STREAM needs the read-ahead pool (_FS_RDAHEAD)
+#endif
+#if _FS_WBCACHE
+#if _FS_TINY || _FS_READONLY
+#error _FS_WBCACHE must be 0 at tiny buffer or read-only configuration
+#endif
+#if _FS_WBCACHE_WAYS < 1 || _FS_WBCACHE % _FS_WBCACHE_WAYS
+#error _FS_WBCACHE must be a multiple of _FS_WBCACHE_WAYS
+#endif
+#define	WC_SETS		(_FS_WBCACHE / _FS_WBCACHE_WAYS)	/* Number of sets in the cache */
+#endif
+#if _FS_JOURNAL
+#if !_FS_WBCACHE
+#error _FS_JOURNAL needs the write-back cache (_FS_WBCACHE)
+#endif
+#if _FS_JOURNAL < _FS_WBCACHE + 2 || _FS_JOURNAL > 1024 || _FS_WBCACHE > (_MIN_SS - JNL_Lba) / 4
+#error Wrong _FS_JOURNAL setting
+#endif
+#endif
+#if _FS_RDAHEAD || _FS_WBCACHE
+#define	DISCARD_SECT(fs, sect, cnt)	discard_sect(fs, sect, cnt)
+#else
+#define	DISCARD_SECT(fs, sect, cnt)
+#endif
+
+
+/* Free cluster map */
+#if _FS_FREEMAP && _FS_READONLY
+#error _FS_FREEMAP must be 0 at read-only configuration
+#endif
+
+
+/* Contiguous stream mode */
+#if _FS_CONTIG && _FS_READONLY
+#error _FS_CONTIG must be 0 at read-only configuration
+#endif
+
+
+/* Directory snapshot */
+#if _USE_DIRSNAP && _FS_MINIMIZE > 1
+#error _USE_DIRSNAP needs _FS_MINIMIZE <= 1
+#endif
+
+
 /* Timestamp */
 #if _FS_NORTC == 1
 #if _NORTC_YEAR < 1980 || _NORTC_YEAR > 2107 || _NORTC_MON < 1 || _NORTC_MON > 12 || _NORTC_MDAY < 1 || _NORTC_MDAY > 31
@@ -593,6 +653,13 @@ static WCHAR LfnBuf[_MAX_LFN + 1];	/* LFN enabled with static working buffer */
 static const BYTE ExCvt[] = _EXCVT;	/* Upper conversion table for SBCS extended characters */
 #endif
 
+#if _USE_LFN != 0 && _LFN_UPTABLE
+#if _LFN_UPTABLE < 0x80 || _LFN_UPTABLE > 0x10000
+#error Wrong _LFN_UPTABLE setting
+#endif
+static WCHAR UpTbl[_LFN_UPTABLE];	/* Flat up-case table of the characters below _LFN_UPTABLE (built by f_mount) */
+#endif
+
 
 
 
@@ -875,283 +942,834 @@ void clear_lock (	/* Clear lock entries of the volume */
 
 
 
+#if _FS_RDAHEAD
 /*-----------------------------------------------------------------------*/
-/* Move/Flush disk access window in the file system object               */
+/* Read-ahead pool - Discard the pool if it overlaps written sectors     */
 /*-----------------------------------------------------------------------*/
-#if !_FS_READONLY
+
 static
-FRESULT sync_window (	/* Returns FR_OK or FR_DISK_ERROR */
-	FATFS* fs			/* File system object */
+void ra_discard (
+	FATFS* fs,		/* File system object */
+	DWORD sect,		/* Start sector of the written block */
+	UINT cnt		/* Number of sectors written */
 )
 {
-	DWORD wsect;
-	UINT nf;
-	FRESULT res = FR_OK;
-
-
-	if (fs->wflag) {	/* Write back the sector if it is dirty */
-		wsect = fs->winsect;	/* Current sector number */
-		if (disk_write(fs->drv, fs->win, wsect, 1) != RES_OK) {
-			res = FR_DISK_ERR;
-		} else {
-			fs->wflag = 0;
-			if (wsect - fs->fatbase < fs->fsize) {		/* Is it in the FAT area? */
-				for (nf = fs->n_fats; nf >= 2; nf--) {	/* Reflect the change to all FAT copies */
-					wsect += fs->fsize;
-					disk_write(fs->drv, fs->win, wsect, 1);
-				}
-			}
-		}
+	if (fs->ranum && sect < fs->rasect + fs->ranum && sect + cnt > fs->rasect) {
+		fs->ranum = 0;	/* Invalidate the read-ahead data */
 	}
-	return res;
 }
+
 #endif
 
 
+
+#if _FS_WBCACHE
+/*-----------------------------------------------------------------------*/
+/* Write-back cache - Write sectors to the home location                 */
+/*-----------------------------------------------------------------------*/
+
 static
-FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERROR */
-	FATFS* fs,			/* File system object */
-	DWORD sector		/* Sector number to make appearance in the fs->win[] */
+FRESULT wc_home (	/* Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs,		/* File system object */
+	const BYTE* buf,	/* Data to be written */
+	DWORD sect,		/* Home sector number */
+	UINT n			/* Number of sectors (not across the end of the FAT area) */
 )
 {
-	FRESULT res = FR_OK;
+	UINT nf;
 
 
-	if (sector != fs->winsect) {	/* Window offset changed? */
-#if !_FS_READONLY
-		res = sync_window(fs);		/* Write-back changes */
-#endif
-		if (res == FR_OK) {			/* Fill sector window with new data */
-			if (disk_read(fs->drv, fs->win, sector, 1) != RES_OK) {
-				sector = 0xFFFFFFFF;	/* Invalidate window if data is not reliable */
-				res = FR_DISK_ERR;
-			}
-			fs->winsect = sector;
+	if (disk_write(fs->drv, buf, sect, n) != RES_OK) return FR_DISK_ERR;
+	if (sect - fs->fatbase < fs->fsize) {	/* Is it in the FAT area? */
+		for (nf = fs->n_fats; nf >= 2; nf--) {	/* Reflect the change to all FAT copies */
+			sect += fs->fsize;
+			disk_write(fs->drv, buf, sect, n);
 		}
 	}
-	return res;
+	return FR_OK;
 }
 
 
-
-
-#if !_FS_READONLY
 /*-----------------------------------------------------------------------*/
-/* Synchronize file system and strage device                             */
+/* Write-back cache - Flush all dirty lines to the disk                  */
 /*-----------------------------------------------------------------------*/
 
 static
-FRESULT sync_fs (	/* FR_OK:succeeded, !=0:error */
+FRESULT wc_flush (	/* Returns FR_OK or FR_DISK_ERROR */
 	FATFS* fs		/* File system object */
 )
 {
-	FRESULT res;
+	WORD ln[_FS_WBCACHE];
+	UINT i, j, n, nd;
+	DWORD sect, wsect;
+	int fat;
+	FRESULT res = FR_OK;
 
 
-	res = sync_window(fs);
-	if (res == FR_OK) {
-		/* Update FSInfo sector if needed */
-		if (fs->fs_type == FS_FAT32 && fs->fsi_flag == 1) {
-			/* Create FSInfo structure */
-			mem_set(fs->win, 0, SS(fs));
-			st_word(fs->win + BS_55AA, 0xAA55);
-			st_dword(fs->win + FSI_LeadSig, 0x41615252);
-			st_dword(fs->win + FSI_StrucSig, 0x61417272);
-			st_dword(fs->win + FSI_Free_Count, fs->free_clst);
-			st_dword(fs->win + FSI_Nxt_Free, fs->last_clst);
-			/* Write it into the FSInfo sector */
-			fs->winsect = fs->volbase + 1;
-			disk_write(fs->drv, fs->win, fs->winsect, 1);
-			fs->fsi_flag = 0;
+	for (i = nd = 0; i < _FS_WBCACHE; i++) {	/* Sort the dirty lines by sector number */
+#if _FS_JOURNAL
+		if ((fs->wcdirty[i / 8] | fs->wcjnl[i / 8]) & (1 << i % 8)) {	/* (including the journaled lines) */
+#else
+		if (fs->wcdirty[i / 8] & (1 << i % 8)) {
+#endif
+			for (j = nd++; j > 0 && fs->wctag[ln[j - 1]] > fs->wctag[i]; j--) ln[j] = ln[j - 1];
+			ln[j] = (WORD)i;
+		}
+	}
+	for (i = 0; i < nd; i += n) {
+		sect = fs->wctag[ln[i]];
+		fat = (sect - fs->fatbase < fs->fsize);
+		for (n = 1; i + n < nd; n++) {	/* Get a run of contiguous sectors placed contiguously in the buffer */
+			wsect = fs->wctag[ln[i + n]];
+			if (wsect != sect + n || ln[i + n] != ln[i] + n || (wsect - fs->fatbase < fs->fsize) != fat) break;
+		}
+		if (wc_home(fs, (BYTE*)fs->wcbuf + (UINT)ln[i] * SS(fs), sect, n) != FR_OK) {
+			res = FR_DISK_ERR;
+			continue;				/* Leave the lines dirty */
+		}
+		for (j = i; j < i + n; j++) {
+			fs->wcdirty[ln[j] / 8] &= ~(1 << ln[j] % 8);
+#if _FS_JOURNAL
+			fs->wcjnl[ln[j] / 8] &= ~(1 << ln[j] % 8);
+#endif
 		}
-		/* Make sure that no pending write process in the physical drive */
-		if (disk_ioctl(fs->drv, CTRL_SYNC, 0) != RES_OK) res = FR_DISK_ERR;
 	}
-
 	return res;
 }
 
-#endif
-
 
 
+#if _FS_JOURNAL
 /*-----------------------------------------------------------------------*/
-/* Get sector# from cluster#                                             */
+/* Journal - Calculate check sum of a block                              */
 /*-----------------------------------------------------------------------*/
 
 static
-DWORD clust2sect (	/* !=0:Sector number, 0:Failed (invalid cluster#) */
-	FATFS* fs,		/* File system object */
-	DWORD clst		/* Cluster# to be converted */
+DWORD jnl_sum (		/* Returns the updated check sum */
+	DWORD sum,		/* Previous value */
+	const BYTE* p,	/* Pointer to the block */
+	UINT n			/* Size of the block in byte (multiple of 4) */
 )
 {
-	clst -= 2;
-	if (clst >= fs->n_fatent - 2) return 0;		/* Invalid cluster# */
-	return clst * fs->csize + fs->database;
+	for ( ; n >= 4; n -= 4, p += 4) sum = ((sum << 1 | sum >> 31) + ld_dword(p)) & 0xFFFFFFFF;
+	return sum;
 }
 
 
-
-
 /*-----------------------------------------------------------------------*/
-/* FAT access - Read value of a FAT entry                                */
+/* Journal - Start a new generation of the journal                       */
 /*-----------------------------------------------------------------------*/
 
 static
-DWORD get_fat (	/* 0xFFFFFFFF:Disk error, 1:Internal error, 2..0x7FFFFFFF:Cluster status */
-	_FDID* obj,	/* Corresponding object */
-	DWORD clst	/* Cluster number to get the value */
+FRESULT jnl_reset (	/* Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs		/* File system object */
 )
 {
-	UINT wc, bc;
-	DWORD val;
-	FATFS *fs = obj->fs;
+	BYTE *jb = (BYTE*)fs->jbuf;
 
 
-	if (clst < 2 || clst >= fs->n_fatent) {	/* Check if in valid range */
-		val = 1;	/* Internal error */
+	mem_set(jb, 0, SS(fs));			/* Create the superblock */
+	st_dword(jb + JNL_Sig, 0x4C4E4A46);
+	st_dword(jb + JNL_Gen, ++fs->jgen);	/* Records of the old generation are no longer valid */
+	st_dword(jb + JNL_Seq, 0xFFFFFFFF);
+	if (disk_write(fs->drv, jb, fs->jbase, 1) != RES_OK) return FR_DISK_ERR;
+	fs->jseq = 0;
+	fs->jptr = 1;					/* Records follow the superblock */
+	return FR_OK;
+}
 
-	} else {
-		val = 0xFFFFFFFF;	/* Default value falls on disk error */
 
-		switch (fs->fs_type) {
-		case FS_FAT12 :
-			bc = (UINT)clst; bc += bc / 2;
-			if (move_window(fs, fs->fatbase + (bc / SS(fs))) != FR_OK) break;
-			wc = fs->win[bc++ % SS(fs)];
-			if (move_window(fs, fs->fatbase + (bc / SS(fs))) != FR_OK) break;
-			wc |= fs->win[bc % SS(fs)] << 8;
-			val = (clst & 1) ? (wc >> 4) : (wc & 0xFFF);
-			break;
+/*-----------------------------------------------------------------------*/
+/* Journal - Append the dirty lines to the journal as a record           */
+/*-----------------------------------------------------------------------*/
 
-		case FS_FAT16 :
-			if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 2))) != FR_OK) break;
-			val = ld_word(fs->win + clst * 2 % SS(fs));
-			break;
+static
+FRESULT jnl_append (	/* Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs		/* File system object */
+)
+{
+	UINT i, nd;
+	DWORD sum;
+	BYTE *jb = (BYTE*)fs->jbuf;
 
-		case FS_FAT32 :
-			if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 4))) != FR_OK) break;
-			val = ld_dword(fs->win + clst * 4 % SS(fs)) & 0x0FFFFFFF;
-			break;
-#if _FS_EXFAT
-		case FS_EXFAT :
-			if (obj->objsize) {
-				DWORD cofs = clst - obj->sclust;	/* Offset from start cluster */
-				DWORD clen = (DWORD)((obj->objsize - 1) / SS(fs)) / fs->csize;	/* Number of clusters - 1 */
 
-				if (obj->stat == 2) {	/* Is there no valid chain on the FAT? */
-					if (cofs <= clen) {
-						val = (cofs == clen) ? 0x7FFFFFFF : clst + 1;	/* Generate the value */
-						break;
-					}
-				}
-				if (obj->stat == 3 && cofs < obj->n_cont) {	/* Is it in the 1st fragment? */
-					val = clst + 1; 	/* Generate the value */
-					break;
-				}
-				if (obj->stat != 2) {	/* Get value from FAT if FAT chain is valid */
-					if (obj->n_frag != 0) {	/* Is it on the growing edge? */
-						val = 0x7FFFFFFF;	/* Generate EOC */
-					} else {
-						if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 4))) != FR_OK) break;
-						val = ld_dword(fs->win + clst * 4 % SS(fs)) & 0x7FFFFFFF;
-					}
-					break;
-				}
-			}
-			/* go to default */
-#endif
-		default:
-			val = 1;	/* Internal error */
+	for (i = nd = 0; i < _FS_WBCACHE; i++) {	/* Count the dirty lines */
+		if (fs->wcdirty[i / 8] & (1 << i % 8)) nd++;
+	}
+	if (nd == 0) return FR_OK;
+
+	/* Create the record, the header sector followed by the dirty lines */
+	mem_set(jb, 0, SS(fs));
+	for (i = nd = 0; i < _FS_WBCACHE; i++) {
+		if (fs->wcdirty[i / 8] & (1 << i % 8)) {
+			st_dword(jb + JNL_Lba + nd * 4, fs->wctag[i]);	/* Home sector */
+			mem_cpy(jb + ++nd * SS(fs), (BYTE*)fs->wcbuf + i * SS(fs), SS(fs));
 		}
 	}
-
-	return val;
+	st_dword(jb + JNL_Sig, 0x4C4E4A46);
+	st_dword(jb + JNL_Gen, fs->jgen);
+	st_dword(jb + JNL_Seq, fs->jseq);
+	st_dword(jb + JNL_Cnt, nd);
+	sum = jnl_sum(0, jb + SS(fs), nd * SS(fs));
+	sum = jnl_sum(sum, jb, JNL_Sum);
+	st_dword(jb + JNL_Sum, jnl_sum(sum, jb + JNL_Lba, nd * 4));
+
+	/* Write the record to the journal in a single sequential write */
+	if (disk_write(fs->drv, jb, fs->jbase + fs->jptr, 1 + nd) != RES_OK) return FR_DISK_ERR;
+	for (i = 0; i < (_FS_WBCACHE + 7) / 8; i++) {	/* The lines are journaled but not written to the home sectors */
+		fs->wcjnl[i] |= fs->wcdirty[i];
+		fs->wcdirty[i] = 0;
+	}
+	fs->jptr += 1 + nd;
+	fs->jseq++;
+	return FR_OK;
 }
 
 
-
-
-#if !_FS_READONLY
 /*-----------------------------------------------------------------------*/
-/* FAT access - Change value of a FAT entry                              */
+/* Journal - Write back the journaled lines and discard the records      */
 /*-----------------------------------------------------------------------*/
 
 static
-FRESULT put_fat (	/* FR_OK(0):succeeded, !=0:error */
-	FATFS* fs,		/* Corresponding file system object */
-	DWORD clst,		/* FAT index number (cluster number) to be changed */
-	DWORD val		/* New value to be set to the entry */
+FRESULT jnl_checkpoint (	/* Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs		/* File system object */
 )
 {
-	UINT bc;
-	BYTE *p;
-	FRESULT res = FR_INT_ERR;
-
-	if (clst >= 2 && clst < fs->n_fatent) {	/* Check if in valid range */
-		switch (fs->fs_type) {
-		case FS_FAT12 :	/* Bitfield items */
-			bc = (UINT)clst; bc += bc / 2;
-			res = move_window(fs, fs->fatbase + (bc / SS(fs)));
-			if (res != FR_OK) break;
-			p = fs->win + bc++ % SS(fs);
-			*p = (clst & 1) ? ((*p & 0x0F) | ((BYTE)val << 4)) : (BYTE)val;
-			fs->wflag = 1;
-			res = move_window(fs, fs->fatbase + (bc / SS(fs)));
-			if (res != FR_OK) break;
-			p = fs->win + bc % SS(fs);
-			*p = (clst & 1) ? (BYTE)(val >> 4) : ((*p & 0xF0) | ((BYTE)(val >> 8) & 0x0F));
-			fs->wflag = 1;
-			break;
+	FRESULT res;
 
-		case FS_FAT16 :	/* WORD aligned items */
-			res = move_window(fs, fs->fatbase + (clst / (SS(fs) / 2)));
-			if (res != FR_OK) break;
-			st_word(fs->win + clst * 2 % SS(fs), (WORD)val);
-			fs->wflag = 1;
-			break;
 
-		case FS_FAT32 :	/* DWORD aligned items */
-#if _FS_EXFAT
-		case FS_EXFAT :
-#endif
-			res = move_window(fs, fs->fatbase + (clst / (SS(fs) / 4)));
-			if (res != FR_OK) break;
-			if (!_FS_EXFAT || fs->fs_type != FS_EXFAT) {
-				val = (val & 0x0FFFFFFF) | (ld_dword(fs->win + clst * 4 % SS(fs)) & 0xF0000000);
-			}
-			st_dword(fs->win + clst * 4 % SS(fs), val);
-			fs->wflag = 1;
-			break;
+	res = wc_flush(fs);		/* Write all dirty and journaled lines to the home sectors */
+	if (res == FR_OK && fs->jseq) {	/* Discard the records if any */
+		if (disk_ioctl(fs->drv, CTRL_SYNC, 0) != RES_OK) {	/* The home sectors must be updated prior to the superblock */
+			res = FR_DISK_ERR;
+		} else {
+			res = jnl_reset(fs);
 		}
 	}
 	return res;
 }
 
-#endif /* !_FS_READONLY */
-
 
-
-
-#if _FS_EXFAT && !_FS_READONLY
 /*-----------------------------------------------------------------------*/
-/* exFAT: Accessing FAT and Allocation Bitmap                            */
+/* Journal - Replay the committed records at mount time                  */
 /*-----------------------------------------------------------------------*/
 
-/*--------------------------------------*/
-/* Find a contiguous free cluster block */
-/*--------------------------------------*/
-
 static
-DWORD find_bitmap (	/* 0:Not found, 2..:Cluster block found, 0xFFFFFFFF:Disk error */
-	FATFS* fs,	/* File system object */
-	DWORD clst,	/* Cluster number to scan from */
-	DWORD ncl	/* Number of contiguous clusters to find (1..) */
+FRESULT jnl_replay (	/* Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs		/* File system object (the cache is empty) */
 )
 {
-	BYTE bm, bv;
-	UINT i;
-	DWORD val, scl, ctr;
+	UINT i, n;
+	DWORD sum;
+	BYTE *jb = (BYTE*)fs->jbuf;
+
+
+	fs->jgen = fs->jseq = 0;
+	if (disk_read(fs->drv, jb, fs->jbase, 1) != RES_OK) return FR_DISK_ERR;
+	if (ld_dword(jb + JNL_Sig) != 0x4C4E4A46 || ld_dword(jb + JNL_Seq) != 0xFFFFFFFF) {	/* No superblock? */
+		fs->jbase = 0;				/* The volume has no journal, the reserved sectors are not used */
+		return FR_OK;
+	}
+	fs->jgen = ld_dword(jb + JNL_Gen);
+	fs->jptr = 1;
+	while (fs->jptr < _FS_JOURNAL) {	/* Apply the records in order of sequence number */
+		if (disk_read(fs->drv, jb, fs->jbase + fs->jptr, 1) != RES_OK) return FR_DISK_ERR;
+		n = (UINT)ld_dword(jb + JNL_Cnt);
+		if (ld_dword(jb + JNL_Sig) != 0x4C4E4A46 || ld_dword(jb + JNL_Gen) != fs->jgen || ld_dword(jb + JNL_Seq) != fs->jseq
+			|| n == 0 || n > _FS_WBCACHE || fs->jptr + 1 + n > _FS_JOURNAL) break;	/* End of the journal? */
+		if (disk_read(fs->drv, (BYTE*)fs->wcbuf, fs->jbase + fs->jptr + 1, n) != RES_OK) return FR_DISK_ERR;
+		sum = jnl_sum(0, (BYTE*)fs->wcbuf, n * SS(fs));
+		sum = jnl_sum(sum, jb, JNL_Sum);
+		if (jnl_sum(sum, jb + JNL_Lba, n * 4) != ld_dword(jb + JNL_Sum)) break;	/* Torn record (not committed) */
+		for (i = 0; i < n; i++) {	/* Write the sectors to the home sectors */
+			if (wc_home(fs, (BYTE*)fs->wcbuf + i * SS(fs), ld_dword(jb + JNL_Lba + i * 4), 1) != FR_OK) return FR_DISK_ERR;
+		}
+		fs->jptr += 1 + n;
+		fs->jseq++;
+	}
+	return jnl_checkpoint(fs);		/* Discard the applied records */
+}
+
+#endif
+
+
+/*-----------------------------------------------------------------------*/
+/* Write-back cache - Get the cache line for the sector                  */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT wc_line (	/* Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs,		/* File system object */
+	DWORD sect,		/* Sector number */
+	UINT* line,		/* Pointer to the variable to return the line index */
+	int* hit		/* Pointer to the variable to return whether the sector is in the line */
+)
+{
+	UINT i, ln, lru = 0;
+	FRESULT res = FR_OK;
+
+
+	*hit = 0;
+	for (i = 0; i < _FS_WBCACHE_WAYS; i++) {	/* Search the set for the sector */
+		ln = i * WC_SETS + sect % WC_SETS;
+		if (fs->wctag[ln] == sect) {
+			*hit = 1; lru = ln;
+			break;
+		}
+		if (i == 0 || (fs->wctag[lru] != 0xFFFFFFFF	/* Find an empty line or the least recently used one */
+			&& (fs->wctag[ln] == 0xFFFFFFFF || fs->wcage[ln] < fs->wcage[lru]))) {
+			lru = ln;
+		}
+	}
+#if _FS_JOURNAL
+	if (!*hit && (fs->wcdirty[lru / 8] & (1 << lru % 8))) {	/* Checkpoint the journal when a dirty line is evicted */
+		res = jnl_checkpoint(fs);
+	} else if (!*hit && (fs->wcjnl[lru / 8] & (1 << lru % 8))) {	/* A journaled line only needs to be written home, a replay writes the same data */
+		res = wc_home(fs, (BYTE*)fs->wcbuf + lru * SS(fs), fs->wctag[lru], 1);
+		if (res == FR_OK) fs->wcjnl[lru / 8] &= ~(1 << lru % 8);
+	}
+#else
+	if (!*hit && (fs->wcdirty[lru / 8] & (1 << lru % 8))) {	/* Flush the cache when a dirty line is evicted */
+		res = wc_flush(fs);
+	}
+#endif
+	if (res == FR_OK) {
+		fs->wcage[lru] = ++fs->wctime;
+		*line = lru;
+	}
+	return res;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Write-back cache - Read a sector via the cache                        */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT wc_read (	/* Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs,		/* File system object */
+	BYTE* buff,		/* Data buffer to store the read data */
+	DWORD sect		/* Sector number */
+)
+{
+	UINT ln;
+	int hit;
+	FRESULT res;
+
+
+	res = wc_line(fs, sect, &ln, &hit);
+	if (res == FR_OK) {
+		if (!hit) {		/* Load the sector into the line on a miss */
+			fs->wctag[ln] = 0xFFFFFFFF;
+			if (disk_read(fs->drv, (BYTE*)fs->wcbuf + ln * SS(fs), sect, 1) != RES_OK) return FR_DISK_ERR;
+			fs->wctag[ln] = sect;
+		}
+		mem_cpy(buff, (BYTE*)fs->wcbuf + ln * SS(fs), SS(fs));
+	}
+	return res;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Write-back cache - Write a sector into the cache                      */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT wc_write (	/* Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs,		/* File system object */
+	const BYTE* buff,	/* Data to be written */
+	DWORD sect		/* Sector number */
+)
+{
+	UINT ln;
+	int hit;
+	FRESULT res;
+
+
+	res = wc_line(fs, sect, &ln, &hit);
+	if (res == FR_OK) {
+		mem_cpy((BYTE*)fs->wcbuf + ln * SS(fs), buff, SS(fs));
+		fs->wctag[ln] = sect;
+		fs->wcdirty[ln / 8] |= 1 << ln % 8;
+	}
+	return res;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Write-back cache - Invalidate all lines                               */
+/*-----------------------------------------------------------------------*/
+
+static
+void wc_init (
+	FATFS* fs		/* File system object */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < _FS_WBCACHE; i++) fs->wctag[i] = 0xFFFFFFFF;
+	mem_set(fs->wcdirty, 0, sizeof fs->wcdirty);
+#if _FS_JOURNAL
+	mem_set(fs->wcjnl, 0, sizeof fs->wcjnl);
+#endif
+	fs->wctime = 0;
+}
+
+#endif
+
+
+
+#if _FS_RDAHEAD || _FS_WBCACHE
+/*-----------------------------------------------------------------------*/
+/* Discard cached copies of the sectors to be written directly to disk   */
+/*-----------------------------------------------------------------------*/
+
+static
+void discard_sect (
+	FATFS* fs,		/* File system object */
+	DWORD sect,		/* Start sector of the block to be written */
+	UINT cnt		/* Number of sectors to be written */
+)
+{
+#if _FS_WBCACHE
+	UINT i;
+
+
+#if _FS_JOURNAL
+	for (i = 0; i < _FS_WBCACHE; i++) {
+		if (fs->wctag[i] - sect < cnt && (fs->wcjnl[i / 8] & (1 << i % 8))) {	/* Is a journaled sector to be overwritten? */
+			jnl_checkpoint(fs);		/* Discard the records, or the old data would be replayed over the new data */
+			break;
+		}
+	}
+#endif
+	for (i = 0; i < _FS_WBCACHE; i++) {	/* Drop the lines superseded by the written data */
+		if (fs->wctag[i] - sect < cnt) {
+			fs->wctag[i] = 0xFFFFFFFF;
+			fs->wcdirty[i / 8] &= ~(1 << i % 8);
+		}
+	}
+#endif
+#if _FS_RDAHEAD
+	ra_discard(fs, sect, cnt);
+#endif
+}
+
+#endif
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Move/Flush disk access window in the file system object               */
+/*-----------------------------------------------------------------------*/
+#if !_FS_READONLY
+static
+FRESULT sync_window (	/* Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs			/* File system object */
+)
+{
+	DWORD wsect;
+#if !_FS_WBCACHE
+	UINT nf;
+#endif
+	FRESULT res = FR_OK;
+
+
+	if (fs->wflag) {	/* Write back the sector if it is dirty */
+		wsect = fs->winsect;	/* Current sector number */
+#if _FS_WBCACHE
+		res = wc_write(fs, fs->win, wsect);	/* Put it into the write-back cache (FAT copies are made at flush) */
+		if (res == FR_OK) {
+			fs->wflag = 0;
+#if _FS_RDAHEAD
+			ra_discard(fs, wsect, 1);
+#endif
+		}
+#else
+		if (disk_write(fs->drv, fs->win, wsect, 1) != RES_OK) {
+			res = FR_DISK_ERR;
+		} else {
+			fs->wflag = 0;
+#if _FS_RDAHEAD
+			ra_discard(fs, wsect, 1);
+#endif
+			if (wsect - fs->fatbase < fs->fsize) {		/* Is it in the FAT area? */
+				for (nf = fs->n_fats; nf >= 2; nf--) {	/* Reflect the change to all FAT copies */
+					wsect += fs->fsize;
+					disk_write(fs->drv, fs->win, wsect, 1);
+				}
+			}
+		}
+#endif
+	}
+	return res;
+}
+#endif
+
+
+static
+FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs,			/* File system object */
+	DWORD sector		/* Sector number to make appearance in the fs->win[] */
+)
+{
+	FRESULT res = FR_OK;
+
+
+	if (sector != fs->winsect) {	/* Window offset changed? */
+#if !_FS_READONLY
+		res = sync_window(fs);		/* Write-back changes */
+#endif
+		if (res == FR_OK) {			/* Fill sector window with new data */
+#if _FS_WBCACHE
+			if (wc_read(fs, fs->win, sector) != FR_OK) {
+#else
+			if (disk_read(fs->drv, fs->win, sector, 1) != RES_OK) {
+#endif
+				sector = 0xFFFFFFFF;	/* Invalidate window if data is not reliable */
+				res = FR_DISK_ERR;
+			}
+			fs->winsect = sector;
+		}
+	}
+	return res;
+}
+
+
+
+
+#if !_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* Synchronize file system and strage device                             */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT sync_fs (	/* FR_OK:succeeded, !=0:error */
+	FATFS* fs		/* File system object */
+)
+{
+	FRESULT res;
+
+
+	res = sync_window(fs);
+#if _FS_WBCACHE && !_FS_JOURNAL
+	if (res == FR_OK) res = wc_flush(fs);	/* Flush the write-back cache */
+#endif
+	if (res == FR_OK) {
+		/* Update FSInfo sector if needed */
+		if (fs->fs_type == FS_FAT32 && fs->fsi_flag == 1) {
+			/* Create FSInfo structure */
+			mem_set(fs->win, 0, SS(fs));
+			st_word(fs->win + BS_55AA, 0xAA55);
+			st_dword(fs->win + FSI_LeadSig, 0x41615252);
+			st_dword(fs->win + FSI_StrucSig, 0x61417272);
+			st_dword(fs->win + FSI_Free_Count, fs->free_clst);
+			st_dword(fs->win + FSI_Nxt_Free, fs->last_clst);
+			/* Write it into the FSInfo sector */
+			fs->winsect = fs->volbase + 1;
+#if _FS_JOURNAL
+			fs->wflag = 1;			/* Put it into the cache to be committed with the other changes */
+			res = sync_window(fs);
+#else
+			DISCARD_SECT(fs, fs->winsect, 1);
+			disk_write(fs->drv, fs->win, fs->winsect, 1);
+#endif
+			fs->fsi_flag = 0;
+		}
+#if _FS_JOURNAL
+		if (res == FR_OK && fs->jbase) res = jnl_append(fs);	/* Commit the changes in a single sequential write */
+		if (res == FR_OK && (!fs->jbase || fs->jptr + 1 + _FS_WBCACHE > _FS_JOURNAL)) {
+			res = jnl_checkpoint(fs);	/* Write back the cache if the journal is not used or cannot take the next record */
+		}
+#endif
+	}
+	if (res == FR_OK) {
+		/* Make sure that no pending write process in the physical drive */
+		if (disk_ioctl(fs->drv, CTRL_SYNC, 0) != RES_OK) res = FR_DISK_ERR;
+	}
+
+	return res;
+}
+
+#endif
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Get sector# from cluster#                                             */
+/*-----------------------------------------------------------------------*/
+
+static
+DWORD clust2sect (	/* !=0:Sector number, 0:Failed (invalid cluster#) */
+	FATFS* fs,		/* File system object */
+	DWORD clst		/* Cluster# to be converted */
+)
+{
+	clst -= 2;
+	if (clst >= fs->n_fatent - 2) return 0;		/* Invalid cluster# */
+	return clst * fs->csize + fs->database;
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* FAT access - Read value of a FAT entry                                */
+/*-----------------------------------------------------------------------*/
+
+static
+DWORD get_fat (	/* 0xFFFFFFFF:Disk error, 1:Internal error, 2..0x7FFFFFFF:Cluster status */
+	_FDID* obj,	/* Corresponding object */
+	DWORD clst	/* Cluster number to get the value */
+)
+{
+	UINT wc, bc;
+	DWORD val;
+	FATFS *fs = obj->fs;
+
+
+	if (clst < 2 || clst >= fs->n_fatent) {	/* Check if in valid range */
+		val = 1;	/* Internal error */
+
+	} else {
+		val = 0xFFFFFFFF;	/* Default value falls on disk error */
+
+		switch (fs->fs_type) {
+		case FS_FAT12 :
+			bc = (UINT)clst; bc += bc / 2;
+			if (move_window(fs, fs->fatbase + (bc / SS(fs))) != FR_OK) break;
+			wc = fs->win[bc++ % SS(fs)];
+			if (move_window(fs, fs->fatbase + (bc / SS(fs))) != FR_OK) break;
+			wc |= fs->win[bc % SS(fs)] << 8;
+			val = (clst & 1) ? (wc >> 4) : (wc & 0xFFF);
+			break;
+
+		case FS_FAT16 :
+			if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 2))) != FR_OK) break;
+			val = ld_word(fs->win + clst * 2 % SS(fs));
+			break;
+
+		case FS_FAT32 :
+			if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 4))) != FR_OK) break;
+			val = ld_dword(fs->win + clst * 4 % SS(fs)) & 0x0FFFFFFF;
+			break;
+#if _FS_EXFAT
+		case FS_EXFAT :
+			if ((obj->objsize != 0 && obj->sclust != 0) || obj->stat == 0) {	/* Object except root dir must have valid data length */
+				DWORD cofs = clst - obj->sclust;	/* Offset from start cluster */
+				DWORD clen = (DWORD)((obj->objsize - 1) / SS(fs)) / fs->csize;	/* Number of clusters - 1 */
+
+				if (obj->stat == 2) {	/* Is there no valid chain on the FAT? */
+					if (cofs <= clen) {
+						val = (cofs == clen) ? 0x7FFFFFFF : clst + 1;	/* Generate the value */
+						break;
+					}
+				}
+				if (obj->stat == 3 && cofs < obj->n_cont) {	/* Is it in the 1st fragment? */
+					val = clst + 1; 	/* Generate the value */
+					break;
+				}
+				if (obj->stat != 2) {	/* Get value from FAT if FAT chain is valid */
+					if (obj->n_frag != 0) {	/* Is it on the growing edge? */
+						val = 0x7FFFFFFF;	/* Generate EOC */
+					} else {
+						if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 4))) != FR_OK) break;
+						val = ld_dword(fs->win + clst * 4 % SS(fs)) & 0x7FFFFFFF;
+					}
+					break;
+				}
+			}
+			/* go to default */
+#endif
+		default:
+			val = 1;	/* Internal error */
+		}
+	}
+
+	return val;
+}
+
+
+
+
+#if !_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* FAT access - Change value of a FAT entry                              */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT put_fat (	/* FR_OK(0):succeeded, !=0:error */
+	FATFS* fs,		/* Corresponding file system object */
+	DWORD clst,		/* FAT index number (cluster number) to be changed */
+	DWORD val		/* New value to be set to the entry */
+)
+{
+	UINT bc;
+	BYTE *p;
+	FRESULT res = FR_INT_ERR;
+
+	if (clst >= 2 && clst < fs->n_fatent) {	/* Check if in valid range */
+		switch (fs->fs_type) {
+		case FS_FAT12 :	/* Bitfield items */
+			bc = (UINT)clst; bc += bc / 2;
+			res = move_window(fs, fs->fatbase + (bc / SS(fs)));
+			if (res != FR_OK) break;
+			p = fs->win + bc++ % SS(fs);
+			*p = (clst & 1) ? ((*p & 0x0F) | ((BYTE)val << 4)) : (BYTE)val;
+			fs->wflag = 1;
+			res = move_window(fs, fs->fatbase + (bc / SS(fs)));
+			if (res != FR_OK) break;
+			p = fs->win + bc % SS(fs);
+			*p = (clst & 1) ? (BYTE)(val >> 4) : ((*p & 0xF0) | ((BYTE)(val >> 8) & 0x0F));
+			fs->wflag = 1;
+			break;
+
+		case FS_FAT16 :	/* WORD aligned items */
+			res = move_window(fs, fs->fatbase + (clst / (SS(fs) / 2)));
+			if (res != FR_OK) break;
+			st_word(fs->win + clst * 2 % SS(fs), (WORD)val);
+			fs->wflag = 1;
+			break;
+
+		case FS_FAT32 :	/* DWORD aligned items */
+#if _FS_EXFAT
+		case FS_EXFAT :
+#endif
+			res = move_window(fs, fs->fatbase + (clst / (SS(fs) / 4)));
+			if (res != FR_OK) break;
+			if (!_FS_EXFAT || fs->fs_type != FS_EXFAT) {
+				val = (val & 0x0FFFFFFF) | (ld_dword(fs->win + clst * 4 % SS(fs)) & 0xF0000000);
+			}
+			st_dword(fs->win + clst * 4 % SS(fs), val);
+			fs->wflag = 1;
+			break;
+		}
+#if _FS_FREEMAP
+		if (res == FR_OK && fs->fmap) {	/* Reflect the change to the free cluster map */
+			if (val) {
+				fs->fmap[clst / 32] |= (DWORD)1 << clst % 32;
+			} else {
+				fs->fmap[clst / 32] &= ~((DWORD)1 << clst % 32);
+			}
+		}
+#endif
+	}
+	return res;
+}
+
+#endif /* !_FS_READONLY */
+
+
+
+
+#if _FS_FREEMAP
+/*-----------------------------------------------------------------------*/
+/* Free cluster map - Build the map from the FAT                         */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT fm_build (	/* FR_OK(0):succeeded or no memory, !=0:error */
+	FATFS* fs		/* File system object */
+)
+{
+	DWORD clst, stat, nfree, *map;
+	UINT nw;
+	_FDID obj;
+
+
+	nw = (UINT)((fs->n_fatent + 31) / 32);
+	map = ff_memalloc(nw * sizeof (DWORD));
+	if (!map) return FR_OK;			/* Go on without the map if no memory is available */
+	mem_set(map, 0, nw * sizeof (DWORD));
+	map[0] = 3;						/* Cluster 0 and 1 are reserved */
+	for (clst = fs->n_fatent; clst < nw * 32; clst++) map[clst / 32] |= (DWORD)1 << clst % 32;	/* Out of the volume */
+
+	obj.fs = fs; nfree = 0;
+	for (clst = 2; clst < fs->n_fatent; clst++) {
+		stat = get_fat(&obj, clst);
+		if (stat == 0xFFFFFFFF || stat == 1) {
+			ff_memfree(map);
+			return (stat == 1) ? FR_INT_ERR : FR_DISK_ERR;
+		}
+		if (stat == 0) {
+			nfree++;
+		} else {
+			map[clst / 32] |= (DWORD)1 << clst % 32;
+		}
+	}
+	fs->fmap = map;
+	fs->free_clst = nfree;			/* Now free_clst is valid */
+	fs->fsi_flag |= 1;
+	return FR_OK;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Free cluster map - Find a free cluster                                */
+/*-----------------------------------------------------------------------*/
+
+static
+DWORD fm_find (		/* 0:No free cluster, >=2:Free cluster# */
+	FATFS* fs,		/* File system object */
+	DWORD scl		/* Cluster# to start to search after */
+)
+{
+	DWORD ncl, n;
+
+
+	ncl = scl;
+	for (n = fs->n_fatent - 2; n; n--) {
+		if (++ncl >= fs->n_fatent) ncl = 2;		/* Wrap-around */
+		if (ncl % 32 == 0 && fs->fmap[ncl / 32] == 0xFFFFFFFF && ncl + 32 < fs->n_fatent && n > 32) {
+			ncl += 31; n -= 31;					/* Skip 32 clusters in use at a time */
+			continue;
+		}
+		if (!(fs->fmap[ncl / 32] & (DWORD)1 << ncl % 32)) return ncl;	/* Found a free cluster */
+	}
+	return 0;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Free cluster map - Discard the map                                    */
+/*-----------------------------------------------------------------------*/
+
+static
+void fm_free (
+	FATFS* fs		/* File system object */
+)
+{
+	if (fs->fmap) {
+		ff_memfree(fs->fmap);
+		fs->fmap = 0;
+	}
+}
+
+#endif	/* _FS_FREEMAP */
+
+
+
+
+#if _FS_EXFAT && !_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* exFAT: Accessing FAT and Allocation Bitmap                            */
+/*-----------------------------------------------------------------------*/
+
+/*--------------------------------------*/
+/* Find a contiguous free cluster block */
+/*--------------------------------------*/
+
+static
+DWORD find_bitmap (	/* 0:Not found, 2..:Cluster block found, 0xFFFFFFFF:Disk error */
+	FATFS* fs,	/* File system object */
+	DWORD clst,	/* Cluster number to scan from */
+	DWORD ncl	/* Number of contiguous clusters to find (1..) */
+)
+{
+	BYTE bm, bv;
+	UINT i;
+	DWORD val, scl, ctr;
 
 
 	clst -= 2;	/* The first bit in the bitmap corresponds to cluster #2 */
@@ -1215,6 +1833,34 @@ FRESULT change_bitmap (
 }
 
 
+/*---------------------------------------------*/
+/* Create a contiguous run on the FAT chain    */
+/*---------------------------------------------*/
+
+static
+FRESULT fill_fat_run (
+	FATFS* fs,	/* File system object */
+	DWORD cl,	/* First cluster of the run */
+	DWORD n,	/* Number of clusters in the run */
+	DWORD term	/* Value to set the last FAT entry */
+)
+{
+	FRESULT res;
+	UINT i;
+
+	if (cl < 2 || cl >= fs->n_fatent || n > fs->n_fatent - cl) return FR_INT_ERR;
+	while (n) {	/* Fill the entries a FAT sector at a time */
+		res = move_window(fs, fs->fatbase + cl / (SS(fs) / 4));
+		if (res != FR_OK) return res;
+		for (i = (UINT)(cl % (SS(fs) / 4)); n && i < SS(fs) / 4; i++, cl++, n--) {
+			st_dword(fs->win + i * 4, (n > 1) ? cl + 1 : term);
+		}
+		fs->wflag = 1;
+	}
+	return FR_OK;
+}
+
+
 /*---------------------------------------------*/
 /* Fill the first fragment of the FAT chain    */
 /*---------------------------------------------*/
@@ -1225,11 +1871,10 @@ FRESULT fill_first_frag (
 )
 {
 	FRESULT res;
-	DWORD cl, n;
 
 	if (obj->stat == 3) {	/* Has the object been changed 'fragmented'? */
-		for (cl = obj->sclust, n = obj->n_cont; n; cl++, n--) {	/* Create cluster chain on the FAT */
-			res = put_fat(obj->fs, cl, cl + 1);
+		if (obj->n_cont) {	/* Create cluster chain on the FAT */
+			res = fill_fat_run(obj->fs, obj->sclust, obj->n_cont, obj->sclust + obj->n_cont);
 			if (res != FR_OK) return res;
 		}
 		obj->stat = 0;	/* Change status 'FAT chain is valid' */
@@ -1251,10 +1896,10 @@ FRESULT fill_last_frag (
 {
 	FRESULT res;
 
-	while (obj->n_frag > 0) {	/* Create the last chain on the FAT */
-		res = put_fat(obj->fs, lcl - obj->n_frag + 1, (obj->n_frag > 1) ? lcl - obj->n_frag + 2 : term);
+	if (obj->n_frag > 0) {	/* Create the last chain on the FAT */
+		res = fill_fat_run(obj->fs, lcl - obj->n_frag + 1, obj->n_frag, term);
 		if (res != FR_OK) return res;
-		obj->n_frag--;
+		obj->n_frag = 0;
 	}
 	return FR_OK;
 }
@@ -1292,6 +1937,28 @@ FRESULT remove_chain (	/* FR_OK(0):succeeded, !=0:error */
 		if (res != FR_OK) return res;
 	}
 
+#if _FS_EXFAT
+	/* Remove the rest of the block at a time if the object has no FAT chain */
+	if (fs->fs_type == FS_EXFAT && obj->stat == 2 && obj->objsize) {
+		ecl = obj->sclust + (DWORD)((obj->objsize - 1) / SS(fs)) / fs->csize;	/* Last cluster of the block */
+		if (clst < obj->sclust || clst > ecl || ecl >= fs->n_fatent) return FR_INT_ERR;
+		res = change_bitmap(fs, clst, ecl - clst + 1, 0);	/* Mark the cluster block 'free' on the bitmap */
+		if (res != FR_OK) return res;
+		if (fs->free_clst < fs->n_fatent - 2) {	/* Update FSINFO */
+			fs->free_clst += ecl - clst + 1;
+			if (fs->free_clst > fs->n_fatent - 2) fs->free_clst = fs->n_fatent - 2;
+			fs->fsi_flag |= 1;
+		}
+#if _USE_TRIM
+		rt[0] = clust2sect(fs, clst);					/* Start sector */
+		rt[1] = clust2sect(fs, ecl) + fs->csize - 1;	/* End sector */
+		disk_ioctl(fs->drv, CTRL_TRIM, rt);				/* Inform device the block can be erased */
+#endif
+		if (pclst == 0) obj->stat = 0;	/* Change the object status 'initial' if it has no chain */
+		return FR_OK;
+	}
+#endif
+
 	/* Remove the chain */
 	do {
 		nxt = get_fat(obj, clst);			/* Get cluster status */
@@ -1397,17 +2064,29 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 	} else
 #endif
 	{	/* On the FAT12/16/32 volume */
-		ncl = scl;	/* Start cluster */
-		for (;;) {
-			ncl++;							/* Next cluster */
-			if (ncl >= fs->n_fatent) {		/* Check wrap-around */
-				ncl = 2;
-				if (ncl > scl) return 0;	/* No free cluster */
+#if _FS_FREEMAP
+		if (!fs->fmap) {					/* Build the free cluster map at first allocation */
+			res = fm_build(fs);
+			if (res != FR_OK) return (res == FR_DISK_ERR) ? 0xFFFFFFFF : 1;
+		}
+		if (fs->fmap) {
+			ncl = fm_find(fs, scl);			/* Find a free cluster in the map */
+			if (ncl == 0) return 0;			/* No free cluster */
+		} else
+#endif
+		{
+			ncl = scl;	/* Start cluster */
+			for (;;) {
+				ncl++;							/* Next cluster */
+				if (ncl >= fs->n_fatent) {		/* Check wrap-around */
+					ncl = 2;
+					if (ncl > scl) return 0;	/* No free cluster */
+				}
+				cs = get_fat(obj, ncl);			/* Get the cluster status */
+				if (cs == 0) break;				/* Found a free cluster */
+				if (cs == 1 || cs == 0xFFFFFFFF) return cs;	/* An error occurred */
+				if (ncl == scl) return 0;		/* No free cluster */
 			}
-			cs = get_fat(obj, ncl);			/* Get the cluster status */
-			if (cs == 0) break;				/* Found a free cluster */
-			if (cs == 1 || cs == 0xFFFFFFFF) return cs;	/* An error occurred */
-			if (ncl == scl) return 0;		/* No free cluster */
 		}
 		res = put_fat(fs, ncl, 0xFFFFFFFF);	/* Mark the new cluster 'EOC' */
 		if (res == FR_OK && clst != 0) {
@@ -1423,41 +2102,241 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 		ncl = (res == FR_DISK_ERR) ? 0xFFFFFFFF : 1;	/* Failed. Generate error status */
 	}
 
-	return ncl;		/* Return new cluster number or error status */
-}
+	return ncl;		/* Return new cluster number or error status */
+}
+
+#endif /* !_FS_READONLY */
+
+
+
+
+#if _USE_FASTSEEK
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Convert offset into cluster with link map table        */
+/*-----------------------------------------------------------------------*/
+
+static
+DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
+	FIL* fp,		/* Pointer to the file object */
+	FSIZE_t ofs		/* File offset to be converted to cluster# */
+)
+{
+	DWORD cl, ncl, *tbl;
+	FATFS *fs = fp->obj.fs;
+
+
+	tbl = fp->cltbl + 1;	/* Top of CLMT */
+	cl = (DWORD)(ofs / SS(fs) / fs->csize);	/* Cluster order from top of the file */
+	for (;;) {
+		ncl = *tbl++;			/* Number of cluters in the fragment */
+		if (ncl == 0) return 0;	/* End of table? (error) */
+		if (cl < ncl) break;	/* In this fragment? */
+		cl -= ncl; tbl++;		/* Next fragment */
+	}
+	return cl + *tbl;	/* Return the cluster number */
+}
+
+
+#if _USE_FASTSEEK == 2
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Manage the link map table allocated by FA_LINKMAP      */
+/*-----------------------------------------------------------------------*/
+
+#define CLMT_GROW	16	/* Number of items to be added to the table at a time */
+
+static
+void clmt_free (
+	FIL* fp			/* Pointer to the file object */
+)
+{
+	if (fp->cltlen) {
+		ff_memfree(fp->cltbl);
+		fp->cltbl = 0;		/* Back to normal mode */
+		fp->cltlen = 0;
+	}
+}
+
+
+static
+void clmt_add (
+	FIL* fp,		/* Pointer to the file object */
+	DWORD clst,		/* Top of the clusters appended to the file */
+	DWORD ncl		/* Number of the contiguous clusters */
+)
+{
+	DWORD ulen, *tbl = fp->cltbl;
+
+
+	if (!fp->cltlen) return;
+	ulen = tbl[0];			/* Number of items used */
+	if (ulen > 2 && clst == tbl[ulen - 2] + tbl[ulen - 3]) {	/* Contiguous to the last fragment? */
+		tbl[ulen - 3] += ncl;
+		return;
+	}
+	if (ulen + 2 > fp->cltlen) {	/* Grow the table if needed */
+		tbl = ff_memalloc((UINT)((fp->cltlen + CLMT_GROW) * sizeof (DWORD)));
+		if (!tbl) {			/* Fall back to normal mode if no memory is available */
+			clmt_free(fp);
+			return;
+		}
+		mem_cpy(tbl, fp->cltbl, (UINT)(ulen * sizeof (DWORD)));
+		ff_memfree(fp->cltbl);
+		fp->cltbl = tbl;
+		fp->cltlen += CLMT_GROW;
+	}
+	tbl[ulen - 1] = ncl; tbl[ulen] = clst;	/* Append a new fragment */
+	tbl[ulen + 1] = 0;		/* Terminate table */
+	tbl[0] = ulen + 2;
+}
+
+
+static
+FRESULT clmt_create (	/* FR_OK(0):succeeded or no memory, !=0:error */
+	FIL* fp			/* Pointer to the file object */
+)
+{
+	DWORD cl, pcl, tcl;
+	FATFS *fs = fp->obj.fs;
+
+
+	fp->cltbl = ff_memalloc(CLMT_GROW * sizeof (DWORD));
+	if (!fp->cltbl) return FR_OK;	/* Open the file in normal mode if no memory is available */
+	fp->cltlen = CLMT_GROW;
+	fp->cltbl[0] = 2; fp->cltbl[1] = 0;	/* Empty table */
+	cl = fp->obj.sclust;		/* Origin of the chain */
+	while (cl && cl < fs->n_fatent) {	/* Repeat until end of chain */
+		tcl = cl;
+		do {					/* Get a fragment */
+			pcl = cl;
+			cl = get_fat(&fp->obj, cl);
+			if (cl <= 1 || cl == 0xFFFFFFFF) {
+				clmt_free(fp);
+				return (cl == 0xFFFFFFFF) ? FR_DISK_ERR : FR_INT_ERR;
+			}
+		} while (cl == pcl + 1);
+		clmt_add(fp, tcl, pcl - tcl + 1);	/* Store the length and top of the fragment */
+	}
+	return FR_OK;
+}
+
+
+#if !_FS_READONLY && _FS_MINIMIZE == 0
+static
+void clmt_trim (
+	FIL* fp			/* Pointer to the file object truncated at fptr */
+)
+{
+	DWORD ncl, *tbl;
+	FATFS *fs = fp->obj.fs;
+
+
+	if (!fp->cltlen) return;
+	ncl = (DWORD)((fp->fptr + (DWORD)fs->csize * SS(fs) - 1) / SS(fs) / fs->csize);	/* Number of clusters left */
+	for (tbl = fp->cltbl + 1; *tbl && ncl; tbl += 2) {
+		if (*tbl >= ncl) *tbl = ncl;
+		ncl -= *tbl;
+	}
+	*tbl = 0;				/* Terminate table */
+	fp->cltbl[0] = (DWORD)(tbl - fp->cltbl) + 1;
+}
+#endif
+
+#endif	/* _USE_FASTSEEK == 2 */
+#endif	/* _USE_FASTSEEK */
+
+
+
+
+#if _FS_RDAHEAD
+/*-----------------------------------------------------------------------*/
+/* Read-ahead pool - Refill the pool with the file data from a sector    */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT ra_fill (	/* FR_OK(0):succeeded, !=0:error */
+	FIL* fp,		/* Pointer to the file object */
+	DWORD sect		/* Sector# in the current cluster to be the top of the pool */
+)
+{
+	DWORD clst, ncl;
+	UINT n;
+	FSIZE_t remain;
+	FATFS *fs = fp->obj.fs;
+
+
+	n = fs->csize - (UINT)((sect - fs->database) & (fs->csize - 1));	/* Sectors left in the current cluster */
+	remain = fp->obj.objsize - (fp->fptr & ~(FSIZE_t)(SS(fs) - 1));	/* Bytes left in the file from the sector */
+	for (clst = fp->clust; n < _FS_RDAHEAD && (FSIZE_t)n * SS(fs) < remain; clst = ncl) {
+		ncl = get_fat(&fp->obj, clst);	/* Stretch over the following cluster if contiguous */
+		if (ncl != clst + 1) break;
+		n += fs->csize;
+	}
+	if (n > _FS_RDAHEAD) n = _FS_RDAHEAD;
+	fs->ranum = 0;
+	if (disk_read(fs->drv, (BYTE*)fs->rabuf, sect, n) != RES_OK) return FR_DISK_ERR;	/* Fill the pool in a burst */
+	fs->rasect = sect;
+	fs->ranum = n;
+
+	return FR_OK;
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Read-ahead pool - Load a file data sector through the pool            */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT ra_load (	/* FR_OK(0):succeeded, !=0:error */
+	FIL* fp,		/* Pointer to the file object */
+	DWORD sect		/* Sector# in the current cluster to be loaded into fp->buf[] */
+)
+{
+	FATFS *fs = fp->obj.fs;
+
 
-#endif /* !_FS_READONLY */
+	if (sect - fs->rasect >= fs->ranum) {	/* Not in the pool? */
+#if _USE_STREAM
+		if (fs->rahold) {					/* The pool is referred by f_stream() consumer, bypass it */
+			return (disk_read(fs->drv, fp->buf, sect, 1) != RES_OK) ? FR_DISK_ERR : FR_OK;
+		}
+#endif
+		if (ra_fill(fp, sect) != FR_OK) return FR_DISK_ERR;
+	}
+	mem_cpy(fp->buf, (BYTE*)fs->rabuf + (sect - fs->rasect) * SS(fs), SS(fs));	/* Pick the sector from the pool */
 
+	return FR_OK;
+}
 
 
 
-#if _USE_FASTSEEK
+#if _USE_STREAM
 /*-----------------------------------------------------------------------*/
-/* FAT handling - Convert offset into cluster with link map table        */
+/* Read-ahead pool - Load the sector f_stream() stopped in the middle of */
 /*-----------------------------------------------------------------------*/
 
 static
-DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
-	FIL* fp,		/* Pointer to the file object */
-	FSIZE_t ofs		/* File offset to be converted to cluster# */
+FRESULT ra_resume (	/* FR_OK(0):succeeded, !=0:error */
+	FIL* fp			/* Pointer to the file object */
 )
 {
-	DWORD cl, ncl, *tbl;
 	FATFS *fs = fp->obj.fs;
+	DWORD sect;
 
 
-	tbl = fp->cltbl + 1;	/* Top of CLMT */
-	cl = (DWORD)(ofs / SS(fs) / fs->csize);	/* Cluster order from top of the file */
-	for (;;) {
-		ncl = *tbl++;			/* Number of cluters in the fragment */
-		if (ncl == 0) return 0;	/* End of table? (error) */
-		if (cl < ncl) break;	/* In this fragment? */
-		cl -= ncl; tbl++;		/* Next fragment */
-	}
-	return cl + *tbl;	/* Return the cluster number */
+	if (fp->sect || fp->fptr % SS(fs) == 0) return FR_OK;	/* Sector cache is valid or not needed */
+	sect = clust2sect(fs, fp->clust);
+	if (!sect) return FR_INT_ERR;
+	sect += (DWORD)(fp->fptr / SS(fs) & (fs->csize - 1));
+	if (ra_load(fp, sect) != FR_OK) return FR_DISK_ERR;
+	fp->sect = sect;
+
+	return FR_OK;
 }
+#endif
 
-#endif	/* _USE_FASTSEEK */
+#endif	/* _FS_RDAHEAD */
 
 
 
@@ -1670,6 +2549,22 @@ static
 const BYTE LfnOfs[] = {1,3,5,7,9,14,16,18,20,22,24,28,30};	/* Offset of LFN characters in the directory entry */
 
 
+/*--------------------------------------------------------*/
+/* FAT-LFN: Up-case conversion of a character             */
+/*--------------------------------------------------------*/
+static
+WCHAR up_wchar (	/* Up-cased character */
+	WCHAR chr		/* Character to be up-cased */
+)
+{
+#if _LFN_UPTABLE
+	if (chr < _LFN_UPTABLE) return UpTbl[chr];	/* Look up the flat table */
+	if (chr >= 0x3000 && chr < 0xFF00) return chr;	/* CJK, Hangul and private use area have no case */
+#endif
+	return ff_wtoupper(chr);
+}
+
+
 /*--------------------------------------------------------*/
 /* FAT-LFN: Compare a part of file name with an LFN entry */
 /*--------------------------------------------------------*/
@@ -1681,6 +2576,7 @@ int cmp_lfn (				/* 1:matched, 0:not matched */
 {
 	UINT i, s;
 	WCHAR wc, uc;
+	DWORD w;
 
 
 	if (ld_word(dir + LDIR_FstClusLO) != 0) return 0;	/* Check LDIR_FstClusLO */
@@ -1688,11 +2584,20 @@ int cmp_lfn (				/* 1:matched, 0:not matched */
 	i = ((dir[LDIR_Ord] & 0x3F) - 1) * 13;	/* Offset in the LFN buffer */
 
 	for (wc = 1, s = 0; s < 13; s++) {		/* Process all characters in the entry */
+		if (wc && s < 12 && LfnOfs[s + 1] == LfnOfs[s] + 2 && i + 1 < _MAX_LFN) {	/* Two adjacent characters in the entry? */
+			w = ld_dword(dir + LfnOfs[s]);
+			if ((w & 0xFFFF) && (w >> 16) && w == ((DWORD)lfnbuf[i + 1] << 16 | lfnbuf[i])) {	/* Both matched as is (not terminator) */
+				wc = (WCHAR)(w >> 16);
+				i += 2; s++;
+				continue;
+			}
+		}
 		uc = ld_word(dir + LfnOfs[s]);		/* Pick an LFN character */
 		if (wc) {
-			if (i >= _MAX_LFN || ff_wtoupper(uc) != ff_wtoupper(lfnbuf[i++])) {	/* Compare it */
+			if (i >= _MAX_LFN || (uc != lfnbuf[i] && up_wchar(uc) != up_wchar(lfnbuf[i]))) {	/* Compare it */
 				return 0;					/* Not matched */
 			}
+			i++;
 			wc = uc;
 		} else {
 			if (uc != 0xFFFF) return 0;		/* Check filler */
@@ -1705,7 +2610,7 @@ int cmp_lfn (				/* 1:matched, 0:not matched */
 }
 
 
-#if _FS_MINIMIZE <= 1 || _FS_RPATH >= 2 || _USE_LABEL || _FS_EXFAT
+#if _FS_MINIMIZE <= 1 || _FS_RPATH >= 2 || _USE_LABEL || _FS_EXFAT || _USE_DIRINDEX
 /*-----------------------------------------------------*/
 /* FAT-LFN: Pick a part of file name from an LFN entry */
 /*-----------------------------------------------------*/
@@ -1899,7 +2804,7 @@ WORD xname_sum (		/* Get check sum (to be used as hash) of the name */
 
 
 	while ((chr = *name++) != 0) {
-		chr = ff_wtoupper(chr);		/* File name needs to be ignored case */
+		chr = up_wchar(chr);		/* File name needs to be ignored case */
 		sum = ((sum & 1) ? 0x8000 : 0) + (sum >> 1) + (chr & 0xFF);
 		sum = ((sum & 1) ? 0x8000 : 0) + (sum >> 1) + (chr >> 8);
 	}
@@ -2037,6 +2942,7 @@ FRESULT load_obj_dir (
 	dp->obj.sclust = obj->c_scl;
 	dp->obj.stat = (BYTE)obj->c_size;
 	dp->obj.objsize = obj->c_size & 0xFFFFFF00;
+	dp->obj.n_frag = 0;
 	dp->blk_ofs = obj->c_ofs;
 
 	res = dir_sdi(dp, dp->blk_ofs);	/* Goto object's entry block */
@@ -2122,83 +3028,334 @@ void create_xdir (
 
 
 
-#if _FS_MINIMIZE <= 1 || _FS_RPATH >= 2 || _USE_LABEL || _FS_EXFAT
-/*-----------------------------------------------------------------------*/
-/* Read an object from the directory                                     */
-/*-----------------------------------------------------------------------*/
+#if _FS_MINIMIZE <= 1 || _FS_RPATH >= 2 || _USE_LABEL || _FS_EXFAT
+/*-----------------------------------------------------------------------*/
+/* Read an object from the directory                                     */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT dir_read (
+	DIR* dp,		/* Pointer to the directory object */
+	int vol			/* Filtered by 0:file/directory or 1:volume label */
+)
+{
+	FRESULT res = FR_NO_FILE;
+	FATFS *fs = dp->obj.fs;
+	BYTE a, c;
+#if _USE_LFN != 0
+	BYTE ord = 0xFF, sum = 0xFF;
+#endif
+
+	while (dp->sect) {
+		res = move_window(fs, dp->sect);
+		if (res != FR_OK) break;
+		c = dp->dir[DIR_Name];	/* Test for the entry type */
+		if (c == 0) {
+			res = FR_NO_FILE; break; /* Reached to end of the directory */
+		}
+#if _FS_EXFAT
+		if (fs->fs_type == FS_EXFAT) {	/* On the exFAT volume */
+			if (_USE_LABEL && vol) {
+				if (c == 0x83) break;	/* Volume label entry? */
+			} else {
+				if (c == 0x85) {		/* Start of the file entry block? */
+					dp->blk_ofs = dp->dptr;	/* Get location of the block */
+					res = load_xdir(dp);	/* Load the entry block */
+					if (res == FR_OK) {
+						dp->obj.attr = fs->dirbuf[XDIR_Attr] & AM_MASK;	/* Get attribute */
+					}
+					break;
+				}
+			}
+		} else
+#endif
+		{	/* On the FAT12/16/32 volume */
+			dp->obj.attr = a = dp->dir[DIR_Attr] & AM_MASK;	/* Get attribute */
+#if _USE_LFN != 0	/* LFN configuration */
+			if (c == DDEM || c == '.' || (int)((a & ~AM_ARC) == AM_VOL) != vol) {	/* An entry without valid data */
+				ord = 0xFF;
+			} else {
+				if (a == AM_LFN) {			/* An LFN entry is found */
+					if (c & LLEF) {			/* Is it start of an LFN sequence? */
+						sum = dp->dir[LDIR_Chksum];
+						c &= (BYTE)~LLEF; ord = c;
+						dp->blk_ofs = dp->dptr;
+					}
+					/* Check LFN validity and capture it */
+					ord = (c == ord && sum == dp->dir[LDIR_Chksum] && pick_lfn(fs->lfnbuf, dp->dir)) ? ord - 1 : 0xFF;
+				} else {					/* An SFN entry is found */
+					if (ord || sum != sum_sfn(dp->dir)) {	/* Is there a valid LFN? */
+						dp->blk_ofs = 0xFFFFFFFF;			/* It has no LFN. */
+					}
+					break;
+				}
+			}
+#else		/* Non LFN configuration */
+			if (c != DDEM && c != '.' && a != AM_LFN && (int)((a & ~AM_ARC) == AM_VOL) == vol) {	/* Is it a valid entry? */
+				break;
+			}
+#endif
+		}
+		res = dir_next(dp, 0);		/* Next entry */
+		if (res != FR_OK) break;
+	}
+
+	if (res != FR_OK) dp->sect = 0;		/* Terminate the read operation on error or EOT */
+	return res;
+}
+
+#endif	/* _FS_MINIMIZE <= 1 || _USE_LABEL || _FS_RPATH >= 2 */
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Scan the directory for the object (FAT12/16/32)  */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT dir_scan (	/* FR_OK(0):found, FR_NO_FILE:not found, others:error */
+	DIR* dp,		/* Pointer to the directory object with the file name */
+	int blk			/* 0:Scan to end of the directory, 1:Give up at end of the first entry block */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	BYTE c;
+#if _USE_LFN != 0
+	BYTE a, ord, sum;
+
+	ord = sum = 0xFF; dp->blk_ofs = 0xFFFFFFFF;	/* Reset LFN sequence */
+#endif
+	do {
+		res = move_window(fs, dp->sect);
+		if (res != FR_OK) break;
+		c = dp->dir[DIR_Name];
+		if (c == 0) { res = FR_NO_FILE; break; }	/* Reached to end of table */
+#if _USE_LFN != 0	/* LFN configuration */
+		dp->obj.attr = a = dp->dir[DIR_Attr] & AM_MASK;
+		if (c == DDEM || ((a & AM_VOL) && a != AM_LFN)) {	/* An entry without valid data */
+			ord = 0xFF; dp->blk_ofs = 0xFFFFFFFF;	/* Reset LFN sequence */
+		} else {
+			if (a == AM_LFN) {			/* An LFN entry is found */
+				if (!(dp->fn[NSFLAG] & NS_NOLFN)) {
+					if (c & LLEF) {		/* Is it start of LFN sequence? */
+						sum = dp->dir[LDIR_Chksum];
+						c &= (BYTE)~LLEF; ord = c;	/* LFN start order */
+						dp->blk_ofs = dp->dptr;	/* Start offset of LFN */
+					}
+					/* Check validity of the LFN entry and compare it with given name */
+					ord = (c == ord && sum == dp->dir[LDIR_Chksum] && cmp_lfn(fs->lfnbuf, dp->dir)) ? ord - 1 : 0xFF;
+				}
+			} else {					/* An SFN entry is found */
+				if (!ord && sum == sum_sfn(dp->dir)) break;	/* LFN matched? */
+				if (!(dp->fn[NSFLAG] & NS_LOSS) && !mem_cmp(dp->dir, dp->fn, 11)) break;	/* SFN matched? */
+				ord = 0xFF; dp->blk_ofs = 0xFFFFFFFF;	/* Reset LFN sequence */
+				if (blk) { res = FR_NO_FILE; break; }	/* End of the entry block */
+			}
+		}
+#else		/* Non LFN configuration */
+		dp->obj.attr = dp->dir[DIR_Attr] & AM_MASK;
+		if (!(dp->dir[DIR_Attr] & AM_VOL) && !mem_cmp(dp->dir, dp->fn, 11)) break;	/* Is it a valid entry? */
+		if (blk) { res = FR_NO_FILE; break; }	/* End of the entry block */
+#endif
+		res = dir_next(dp, 0);	/* Next entry */
+	} while (res == FR_OK);
+
+	return res;
+}
+
+
+
+#if _USE_DIRINDEX
+/*-----------------------------------------------------------------------*/
+/* Directory index - Hash table of the entry blocks in a directory       */
+/*-----------------------------------------------------------------------*/
+/* Each entry block is registered with the hash of its SFN and, if it has
+/  an LFN, with the hash of the up-cased LFN. Hash collisions are resolved
+/  by dir_scan() at the candidate offset. */
+
+typedef struct {
+	DWORD	ofs;	/* Offset of the entry block (DIX_EMPTY:empty, DIX_DELETED:deleted) */
+	WORD	hash;	/* Hash value of the name */
+} DIXENT;
+
+#define DIX_EMPTY	0xFFFFFFFF
+#define DIX_DELETED	0xFFFFFFFE
+
+
+static
+WORD dix_sfn (		/* Hash value of the SFN */
+	const BYTE* fn	/* Pointer to the SFN in directory form */
+)
+{
+	WORD hash = 0;
+	UINT i;
+
+
+	for (i = 0; i < 11; i++) hash = ((hash << 5) | (hash >> 11)) + fn[i];
+	return hash;
+}
+
+
+#if _USE_LFN != 0
+static
+WORD dix_lfn (		/* Hash value of the up-cased LFN */
+	const WCHAR* lfn	/* Pointer to the LFN */
+)
+{
+	WORD hash = 0x5A5A;
+
+
+	while (*lfn) hash = ((hash << 5) | (hash >> 11)) + up_wchar(*lfn++);
+	return hash;
+}
+#endif
+
+
+static
+void dix_add (
+	FATFS* fs,		/* File system object */
+	WORD hash,		/* Hash value of the name */
+	DWORD ofs		/* Offset of the entry block */
+)
+{
+	DIXENT *tbl = (DIXENT*)fs->dixtbl;
+	UINT i;
+
+
+	if (!tbl) return;
+	for (i = hash % fs->dixsize; tbl[i].ofs != DIX_EMPTY && tbl[i].ofs != DIX_DELETED; i = (i + 1) % fs->dixsize) ;
+	if (tbl[i].ofs == DIX_EMPTY) {
+		if ((fs->dixused + 1) * 4 > fs->dixsize * 3) {	/* Discard the index if the table is getting full */
+			fs->dixtbl = 0;
+			return;
+		}
+		fs->dixused++;
+	}
+	tbl[i].ofs = ofs;
+	tbl[i].hash = hash;
+}
+
+
+static
+FRESULT dix_build (	/* FR_OK(0):succeeded, !=0:error */
+	DIR* dp,		/* Directory object of the directory to be indexed */
+	void* work,		/* Work area for the index table */
+	UINT len		/* Size of the work area [byte] */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	DIXENT *tbl = (DIXENT*)work;
+	DWORD ofs;
+	UINT i;
+	BYTE c, a;
+#if _USE_LFN != 0
+	BYTE ord = 0xFF, sum = 0xFF;
+#endif
+
+
+	fs->dixsize = len / sizeof (DIXENT);
+	if (fs->dixsize < 4) return FR_NOT_ENOUGH_CORE;
+	for (i = 0; i < fs->dixsize; i++) tbl[i].ofs = DIX_EMPTY;
+	fs->dixtbl = tbl; fs->dixused = 0;
+	fs->dixclst = dp->obj.sclust;
+
+	ofs = DIX_EMPTY;
+	res = dir_sdi(dp, 0);
+	while (res == FR_OK) {
+		res = move_window(fs, dp->sect);
+		if (res != FR_OK) break;
+		c = dp->dir[DIR_Name];
+		if (c == 0) break;				/* Reached to end of table */
+		a = dp->dir[DIR_Attr] & AM_MASK;
+		if (c == DDEM || ((a & AM_VOL) && (_USE_LFN == 0 || a != AM_LFN))) {	/* An entry without valid data */
+#if _USE_LFN != 0
+			ord = 0xFF;
+#endif
+			ofs = DIX_EMPTY;
+		} else {
+#if _USE_LFN != 0
+			if (a == AM_LFN) {			/* An LFN entry is found */
+				if (c & LLEF) {			/* Is it start of LFN sequence? */
+					sum = dp->dir[LDIR_Chksum];
+					c &= (BYTE)~LLEF; ord = c;
+					ofs = dp->dptr;		/* Top of the entry block */
+				}
+				ord = (c == ord && sum == dp->dir[LDIR_Chksum] && pick_lfn(fs->lfnbuf, dp->dir)) ? ord - 1 : 0xFF;
+			} else						/* An SFN entry is found */
+#endif
+			{
+				if (ofs == DIX_EMPTY) ofs = dp->dptr;
+				dix_add(fs, dix_sfn(dp->dir), ofs);
+#if _USE_LFN != 0
+				if (!ord && sum == sum_sfn(dp->dir)) dix_add(fs, dix_lfn(fs->lfnbuf), ofs);	/* Has a valid LFN? */
+				ord = 0xFF;
+#endif
+				ofs = DIX_EMPTY;
+				if (!fs->dixtbl) return FR_NOT_ENOUGH_CORE;	/* The table overflowed */
+			}
+		}
+		res = dir_next(dp, 0);
+	}
+	if (res == FR_NO_FILE) res = FR_OK;		/* Reached to end of the directory */
+	if (res != FR_OK) fs->dixtbl = 0;
+	return res;
+}
+
+
+static
+FRESULT dix_find (	/* FR_OK(0):found, FR_NO_FILE:not found, others:error */
+	DIR* dp			/* Pointer to the directory object with the file name */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	DIXENT *tbl = (DIXENT*)fs->dixtbl;
+	WORD hash[2];
+	UINT i, k, nk = 0;
+
+
+	if (!(dp->fn[NSFLAG] & NS_LOSS)) hash[nk++] = dix_sfn(dp->fn);	/* Can it match an SFN? */
+#if _USE_LFN != 0
+	if (!(dp->fn[NSFLAG] & NS_NOLFN)) hash[nk++] = dix_lfn(fs->lfnbuf);	/* Can it match an LFN? */
+#endif
+	for (k = 0; k < nk; k++) {
+		for (i = hash[k] % fs->dixsize; tbl[i].ofs != DIX_EMPTY; i = (i + 1) % fs->dixsize) {
+			if (tbl[i].ofs == DIX_DELETED || tbl[i].hash != hash[k]) continue;
+			res = dir_sdi(dp, tbl[i].ofs);			/* Go to the candidate entry block */
+			if (res == FR_OK) res = dir_scan(dp, 1);	/* Compare the name */
+			if (res != FR_NO_FILE) return res;		/* Found or error */
+		}
+	}
+	return FR_NO_FILE;
+}
+
 
+#if !_FS_READONLY && _FS_MINIMIZE == 0
 static
-FRESULT dir_read (
-	DIR* dp,		/* Pointer to the directory object */
-	int vol			/* Filtered by 0:file/directory or 1:volume label */
+void dix_remove (
+	DIR* dp			/* Directory object pointing the removed entry */
 )
 {
-	FRESULT res = FR_NO_FILE;
 	FATFS *fs = dp->obj.fs;
-	BYTE a, c;
-#if _USE_LFN != 0
-	BYTE ord = 0xFF, sum = 0xFF;
-#endif
+	DIXENT *tbl = (DIXENT*)fs->dixtbl;
+	DWORD top;
+	UINT i;
 
-	while (dp->sect) {
-		res = move_window(fs, dp->sect);
-		if (res != FR_OK) break;
-		c = dp->dir[DIR_Name];	/* Test for the entry type */
-		if (c == 0) {
-			res = FR_NO_FILE; break; /* Reached to end of the directory */
-		}
-#if _FS_EXFAT
-		if (fs->fs_type == FS_EXFAT) {	/* On the exFAT volume */
-			if (_USE_LABEL && vol) {
-				if (c == 0x83) break;	/* Volume label entry? */
-			} else {
-				if (c == 0x85) {		/* Start of the file entry block? */
-					dp->blk_ofs = dp->dptr;	/* Get location of the block */
-					res = load_xdir(dp);	/* Load the entry block */
-					if (res == FR_OK) {
-						dp->obj.attr = fs->dirbuf[XDIR_Attr] & AM_MASK;	/* Get attribute */
-					}
-					break;
-				}
-			}
-		} else
-#endif
-		{	/* On the FAT12/16/32 volume */
-			dp->obj.attr = a = dp->dir[DIR_Attr] & AM_MASK;	/* Get attribute */
-#if _USE_LFN != 0	/* LFN configuration */
-			if (c == DDEM || c == '.' || (int)((a & ~AM_ARC) == AM_VOL) != vol) {	/* An entry without valid data */
-				ord = 0xFF;
-			} else {
-				if (a == AM_LFN) {			/* An LFN entry is found */
-					if (c & LLEF) {			/* Is it start of an LFN sequence? */
-						sum = dp->dir[LDIR_Chksum];
-						c &= (BYTE)~LLEF; ord = c;
-						dp->blk_ofs = dp->dptr;
-					}
-					/* Check LFN validity and capture it */
-					ord = (c == ord && sum == dp->dir[LDIR_Chksum] && pick_lfn(fs->lfnbuf, dp->dir)) ? ord - 1 : 0xFF;
-				} else {					/* An SFN entry is found */
-					if (ord || sum != sum_sfn(dp->dir)) {	/* Is there a valid LFN? */
-						dp->blk_ofs = 0xFFFFFFFF;			/* It has no LFN. */
-					}
-					break;
-				}
-			}
-#else		/* Non LFN configuration */
-			if (c != DDEM && c != '.' && a != AM_LFN && (int)((a & ~AM_ARC) == AM_VOL) == vol) {	/* Is it a valid entry? */
-				break;
-			}
+
+	if (!tbl || dp->obj.sclust != fs->dixclst) return;
+	top = dp->dptr;
+#if _USE_LFN != 0
+	if (dp->blk_ofs != 0xFFFFFFFF) top = dp->blk_ofs;
 #endif
-		}
-		res = dir_next(dp, 0);		/* Next entry */
-		if (res != FR_OK) break;
+	for (i = 0; i < fs->dixsize; i++) {		/* Mark the slots of the entry block deleted */
+		if (tbl[i].ofs - top <= dp->dptr - top) tbl[i].ofs = DIX_DELETED;
 	}
-
-	if (res != FR_OK) dp->sect = 0;		/* Terminate the read operation on error or EOT */
-	return res;
 }
+#endif
 
-#endif	/* _FS_MINIMIZE <= 1 || _USE_LABEL || _FS_RPATH >= 2 */
+#endif	/* _USE_DIRINDEX */
 
 
 
@@ -2212,10 +3369,8 @@ FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 )
 {
 	FRESULT res;
+#if _FS_EXFAT || _USE_DIRINDEX
 	FATFS *fs = dp->obj.fs;
-	BYTE c;
-#if _USE_LFN != 0
-	BYTE a, ord, sum;
 #endif
 
 	res = dir_sdi(dp, 0);			/* Rewind directory object */
@@ -2233,7 +3388,7 @@ FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 			if (ld_word(fs->dirbuf + XDIR_NameHash) != hash) continue;	/* Skip comparison if hash mismatched */
 			for (nc = fs->dirbuf[XDIR_NumName], di = SZDIRE * 2, ni = 0; nc; nc--, di += 2, ni++) {	/* Compare the name */
 				if ((di % SZDIRE) == 0) di += 2;
-				if (ff_wtoupper(ld_word(fs->dirbuf + di)) != ff_wtoupper(fs->lfnbuf[ni])) break;
+				if (up_wchar(ld_word(fs->dirbuf + di)) != up_wchar(fs->lfnbuf[ni])) break;
 			}
 			if (nc == 0 && !fs->lfnbuf[ni]) break;	/* Name matched? */
 		}
@@ -2241,43 +3396,12 @@ FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 	}
 #endif
 	/* On the FAT12/16/32 volume */
-#if _USE_LFN != 0
-	ord = sum = 0xFF; dp->blk_ofs = 0xFFFFFFFF;	/* Reset LFN sequence */
-#endif
-	do {
-		res = move_window(fs, dp->sect);
-		if (res != FR_OK) break;
-		c = dp->dir[DIR_Name];
-		if (c == 0) { res = FR_NO_FILE; break; }	/* Reached to end of table */
-#if _USE_LFN != 0	/* LFN configuration */
-		dp->obj.attr = a = dp->dir[DIR_Attr] & AM_MASK;
-		if (c == DDEM || ((a & AM_VOL) && a != AM_LFN)) {	/* An entry without valid data */
-			ord = 0xFF; dp->blk_ofs = 0xFFFFFFFF;	/* Reset LFN sequence */
-		} else {
-			if (a == AM_LFN) {			/* An LFN entry is found */
-				if (!(dp->fn[NSFLAG] & NS_NOLFN)) {
-					if (c & LLEF) {		/* Is it start of LFN sequence? */
-						sum = dp->dir[LDIR_Chksum];
-						c &= (BYTE)~LLEF; ord = c;	/* LFN start order */
-						dp->blk_ofs = dp->dptr;	/* Start offset of LFN */
-					}
-					/* Check validity of the LFN entry and compare it with given name */
-					ord = (c == ord && sum == dp->dir[LDIR_Chksum] && cmp_lfn(fs->lfnbuf, dp->dir)) ? ord - 1 : 0xFF;
-				}
-			} else {					/* An SFN entry is found */
-				if (!ord && sum == sum_sfn(dp->dir)) break;	/* LFN matched? */
-				if (!(dp->fn[NSFLAG] & NS_LOSS) && !mem_cmp(dp->dir, dp->fn, 11)) break;	/* SFN matched? */
-				ord = 0xFF; dp->blk_ofs = 0xFFFFFFFF;	/* Reset LFN sequence */
-			}
-		}
-#else		/* Non LFN configuration */
-		dp->obj.attr = dp->dir[DIR_Attr] & AM_MASK;
-		if (!(dp->dir[DIR_Attr] & AM_VOL) && !mem_cmp(dp->dir, dp->fn, 11)) break;	/* Is it a valid entry? */
+#if _USE_DIRINDEX
+	if (fs->dixtbl && dp->obj.sclust == fs->dixclst) {	/* Is the directory indexed? */
+		return dix_find(dp);
+	}
 #endif
-		res = dir_next(dp, 0);	/* Next entry */
-	} while (res == FR_OK);
-
-	return res;
+	return dir_scan(dp, 0);
 }
 
 
@@ -2312,19 +3436,22 @@ FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too many S
 		if (res != FR_OK) return res;
 		dp->blk_ofs = dp->dptr - SZDIRE * (nent - 1);	/* Set the allocated entry block offset */
 
-		if (dp->obj.sclust != 0 && (dp->obj.stat & 4)) {	/* Has the sub-directory been stretched? */
-			dp->obj.objsize += (DWORD)fs->csize * SS(fs);	/* Increase the directory size by cluster size */
+		if (dp->obj.stat & 4) {			/* Has the directory been stretched by new allocation? */
+			dp->obj.stat &= ~4;
 			res = fill_first_frag(&dp->obj);				/* Fill first fragment on the FAT if needed */
 			if (res != FR_OK) return res;
 			res = fill_last_frag(&dp->obj, dp->clust, 0xFFFFFFFF);	/* Fill last fragment on the FAT if needed */
 			if (res != FR_OK) return res;
-			res = load_obj_dir(&dj, &dp->obj);				/* Load the object status */
-			if (res != FR_OK) return res;
-			st_qword(fs->dirbuf + XDIR_FileSize, dp->obj.objsize);		/* Update the allocation status */
-			st_qword(fs->dirbuf + XDIR_ValidFileSize, dp->obj.objsize);
-			fs->dirbuf[XDIR_GenFlags] = dp->obj.stat | 1;
-			res = store_xdir(&dj);							/* Store the object status */
-			if (res != FR_OK) return res;
+			if (dp->obj.sclust != 0) {		/* Is it a sub-directory? */
+				dp->obj.objsize += (DWORD)fs->csize * SS(fs);	/* Increase the directory size by cluster size */
+				res = load_obj_dir(&dj, &dp->obj);			/* Load the object status */
+				if (res != FR_OK) return res;
+				st_qword(fs->dirbuf + XDIR_FileSize, dp->obj.objsize);		/* Update the allocation status */
+				st_qword(fs->dirbuf + XDIR_ValidFileSize, dp->obj.objsize);
+				fs->dirbuf[XDIR_GenFlags] = dp->obj.stat | 1;
+				res = store_xdir(&dj);						/* Store the object status */
+				if (res != FR_OK) return res;
+			}
 		}
 
 		create_xdir(fs->dirbuf, fs->lfnbuf);	/* Create on-memory directory block to be written later */
@@ -2379,6 +3506,17 @@ FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too many S
 			fs->wflag = 1;
 		}
 	}
+#if _USE_DIRINDEX
+	if (res == FR_OK && fs->dixtbl && dp->obj.sclust == fs->dixclst) {	/* Register the entry block to the index */
+#if _USE_LFN != 0
+		nent = (sn[NSFLAG] & NS_LFN) ? (nlen + 12) / 13 : 0;	/* Number of LFN entries */
+		dix_add(fs, dix_sfn(dp->fn), dp->dptr - nent * SZDIRE);
+		if (nent) dix_add(fs, dix_lfn(fs->lfnbuf), dp->dptr - nent * SZDIRE);
+#else
+		dix_add(fs, dix_sfn(dp->fn), dp->dptr);
+#endif
+	}
+#endif
 
 	return res;
 }
@@ -2402,6 +3540,9 @@ FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 #if _USE_LFN != 0	/* LFN configuration */
 	DWORD last = dp->dptr;
 
+#if _USE_DIRINDEX
+	dix_remove(dp);				/* Remove the entry block from the index */
+#endif
 	res = (dp->blk_ofs == 0xFFFFFFFF) ? FR_OK : dir_sdi(dp, dp->blk_ofs);	/* Goto top of the entry block if LFN is exist */
 	if (res == FR_OK) {
 		do {
@@ -2421,6 +3562,9 @@ FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 	}
 #else			/* Non LFN configuration */
 
+#if _USE_DIRINDEX
+	dix_remove(dp);				/* Remove the entry from the index */
+#endif
 	res = move_window(fs, dp->sect);
 	if (res == FR_OK) {
 		dp->dir[DIR_Name] = DDEM;
@@ -2537,7 +3681,7 @@ void get_fileinfo (		/* No return code */
 
 
 
-#if _USE_FIND && _FS_MINIMIZE <= 1
+#if (_USE_FIND || _USE_DIRSNAP) && _FS_MINIMIZE <= 1
 /*-----------------------------------------------------------------------*/
 /* Pattern matching                                                      */
 /*-----------------------------------------------------------------------*/
@@ -2561,7 +3705,7 @@ WCHAR get_achar (		/* Get a character and advances ptr 1 or 2 */
 #endif
 	return chr;
 #else
-	return ff_wtoupper(*(*ptr)++);			/* Get a word and to upper */
+	return up_wchar(*(*ptr)++);			/* Get a word and to upper */
 #endif
 }
 
@@ -2606,7 +3750,132 @@ int pattern_matching (	/* 0:not matched, 1:matched */
 	return 0;
 }
 
-#endif /* _USE_FIND && _FS_MINIMIZE <= 1 */
+#endif /* (_USE_FIND || _USE_DIRSNAP) && _FS_MINIMIZE <= 1 */
+
+
+
+
+#if _USE_DIRSNAP
+/*-----------------------------------------------------------------------*/
+/* Directory snapshot                                                    */
+/*-----------------------------------------------------------------------*/
+
+static
+WORD snap_sum (		/* Check sum of the SFN to detect a replaced entry */
+	const BYTE* dir	/* Pointer to the SFN entry */
+)
+{
+	WORD sum = 0;
+	UINT n = 11;
+
+
+	do sum = (sum >> 1) + (sum << 15) + *dir++; while (--n);
+	return sum;
+}
+
+
+static
+FRESULT snap_follow (	/* FR_OK(0):succeeded, FR_NO_FILE:the entry has gone, !=0:error */
+	DIR* dp,			/* Directory object to return the entry (obj.fs is set) */
+	const DIRSNAP* sp,	/* Snapshot of the directory */
+	UINT idx			/* Index of the entry in the snapshot */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	const SNAPENT *se;
+
+
+	if (idx >= sp->count) return FR_INVALID_PARAMETER;
+	se = &sp->ent[idx];
+	dp->obj = sp->obj;				/* Containing directory */
+	dp->fn[NSFLAG] = 0;
+	res = dir_sdi(dp, se->dptr);	/* Go to the entry */
+	if (res != FR_OK) return res;
+	res = move_window(fs, dp->sect);
+	if (res != FR_OK) return res;
+#if _FS_EXFAT
+	if (fs->fs_type == FS_EXFAT) {
+		if (dp->dir[XDIR_Type] != 0x85) return FR_NO_FILE;
+		dp->blk_ofs = se->dptr;
+		res = load_xdir(dp);		/* Load the entry block */
+		if (res != FR_OK) return res;
+		if (ld_word(fs->dirbuf + XDIR_NameHash) != se->nsum || ld_dword(fs->dirbuf + XDIR_FstClus) != se->sclust) return FR_NO_FILE;
+		dp->obj.attr = fs->dirbuf[XDIR_Attr] & AM_MASK;
+	} else
+#endif
+	{
+		if (dp->dir[DIR_Name] == 0 || dp->dir[DIR_Name] == DDEM || snap_sum(dp->dir) != se->nsum || ld_clust(fs, dp->dir) != se->sclust) return FR_NO_FILE;
+#if _USE_LFN != 0
+		dp->blk_ofs = 0xFFFFFFFF;
+#endif
+		dp->obj.attr = dp->dir[DIR_Attr] & AM_MASK;
+	}
+	return FR_OK;
+}
+
+
+static
+int snap_cmp (			/* <0:a goes first, 0:same, >0:b goes first */
+	const SNAPENT* a,
+	const SNAPENT* b,
+	BYTE opt			/* Sort order */
+)
+{
+	const TCHAR *pa, *pb;
+	DWORD ta, tb;
+	int r = 0;
+	TCHAR ca, cb;
+
+
+	if ((opt & DS_DIRFIRST) && (a->fattrib ^ b->fattrib) & AM_DIR) {	/* Directories go first regardless of DS_DESC */
+		return (a->fattrib & AM_DIR) ? -1 : 1;
+	}
+	switch (opt & 0x0F) {
+	case DS_SIZE :
+		r = (a->fsize == b->fsize) ? 0 : (a->fsize < b->fsize) ? -1 : 1;
+		break;
+	case DS_TIME :
+		ta = (DWORD)a->fdate << 16 | a->ftime; tb = (DWORD)b->fdate << 16 | b->ftime;
+		r = (ta == tb) ? 0 : (ta < tb) ? -1 : 1;
+		break;
+	}
+	if (r == 0) {	/* Compare the names (ignoring ASCII case) */
+		pa = a->fname; pb = b->fname;
+		do {
+			ca = *pa++; cb = *pb++;
+			if (IsLower(ca)) ca -= 0x20;
+			if (IsLower(cb)) cb -= 0x20;
+		} while (ca && ca == cb);
+		r = (ca == cb) ? 0 : ((_LFN_UNICODE ? (WCHAR)ca : (BYTE)ca) < (_LFN_UNICODE ? (WCHAR)cb : (BYTE)cb)) ? -1 : 1;
+	}
+	return (opt & DS_DESC) ? -r : r;
+}
+
+
+static
+void snap_sort (
+	DIRSNAP* sp		/* Snapshot to be sorted */
+)
+{
+	SNAPENT *tbl = sp->ent, se;
+	UINT gap, i, j;
+
+
+	if ((sp->opt & 0x0F) == DS_NONE) return;	/* Keep directory order */
+	for (gap = 1; gap < sp->count / 3; gap = gap * 3 + 1) ;	/* Shell sort (Knuth's gap sequence) */
+	for ( ; gap; gap /= 3) {
+		for (i = gap; i < sp->count; i++) {
+			se = tbl[i];
+			for (j = i; j >= gap && snap_cmp(&tbl[j - gap], &se, sp->opt) > 0; j -= gap) {
+				tbl[j] = tbl[j - gap];
+			}
+			tbl[j] = se;
+		}
+	}
+}
+
+#endif	/* _USE_DIRSNAP */
 
 
 
@@ -3033,6 +4302,24 @@ FRESULT find_volume (	/* FR_OK(0): successful, !=0: any error occurred */
 
 	fs->fs_type = 0;					/* Clear the file system object */
 	fs->drv = LD2PD(vol);				/* Bind the logical drive and a physical drive */
+#if _FS_RDAHEAD
+	fs->ranum = 0;						/* Discard the read-ahead pool */
+#if _USE_STREAM
+	fs->rahold = 0;
+#endif
+#endif
+#if _FS_WBCACHE
+	wc_init(fs);						/* Discard the write-back cache */
+#if _FS_JOURNAL
+	fs->jbase = fs->jseq = 0;			/* No journal until it is found on the volume */
+#endif
+#endif
+#if _FS_FREEMAP
+	fm_free(fs);						/* Discard the free cluster map */
+#endif
+#if _USE_DIRINDEX
+	fs->dixtbl = 0;						/* Discard the directory index */
+#endif
 	stat = disk_initialize(fs->drv);	/* Initialize the physical drive */
 	if (stat & STA_NOINIT) { 			/* Check if the initialization succeeded */
 		return FR_NOT_READY;			/* Failed to initialize due to no medium or hard error */
@@ -3162,6 +4449,14 @@ FRESULT find_volume (	/* FR_OK(0): successful, !=0: any error occurred */
 		}
 		if (fs->fsize < (szbfat + (SS(fs) - 1)) / SS(fs)) return FR_NO_FILESYSTEM;	/* (BPB_FATSz must not be less than the size needed) */
 
+#if _FS_JOURNAL
+		/* Replay the journal if the volume has the one created by f_mkfs() */
+		if (fmt == FS_FAT32 && nrsv >= _FS_JOURNAL + 12) {
+			fs->jbase = fs->fatbase - _FS_JOURNAL;		/* Journal is placed at end of the reserved area */
+			if (jnl_replay(fs) != FR_OK) return FR_DISK_ERR;	/* (jbase is cleared if the superblock is not found) */
+		}
+#endif
+
 #if !_FS_READONLY
 		/* Get FSINFO if available */
 		fs->last_clst = fs->free_clst = 0xFFFFFFFF;		/* Initialize cluster allocation information */
@@ -3244,6 +4539,103 @@ FRESULT validate (	/* Returns FR_OK or FR_INVALID_OBJECT */
 
 
 
+#if _USE_DIRSNAP
+/*-----------------------------------------------------------------------*/
+/* Read the directory into the snapshot                                  */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT snap_load (		/* Fill the snapshot from the directory offset */
+	DIRSNAP* sp,		/* Snapshot (obj, pat, opt, work and len are set) */
+	DWORD ofs			/* Directory offset to start reading */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DIR dj;
+	FILINFO *fno;
+	SNAPENT *se;
+	TCHAR *np;
+	UINT n, sz;
+	DEF_NAMBUF
+
+
+	res = validate(&sp->obj, &fs);	/* Check validity of the snapshot */
+	if (res == FR_OK) {
+		INIT_NAMBUF(fs);
+		/* Work area: file information scratchpad, entry table and name pool growing downward from the end */
+		sz = (sizeof (FILINFO) + sizeof (SNAPENT) - 1) / sizeof (SNAPENT) * sizeof (SNAPENT);
+		if (sp->len < sz + sizeof (SNAPENT)) {
+			res = FR_NOT_ENOUGH_CORE;
+		} else {
+			fno = (FILINFO*)sp->work;
+			sp->ent = (SNAPENT*)((BYTE*)sp->work + sz);
+			np = (TCHAR*)sp->ent + (sp->len - sz) / sizeof (TCHAR);
+			sp->count = 0; sp->next = 0;
+			dj.obj = sp->obj;
+			res = dir_sdi(&dj, ofs);
+			while (res == FR_OK) {
+				res = dir_read(&dj, 0);		/* Read an item */
+				if (res != FR_OK) break;
+				get_fileinfo(&dj, fno);
+				if (!sp->pat || pattern_matching(sp->pat, fno->fname, 0, 0)
+#if _USE_LFN != 0 && _USE_FIND == 2
+					|| pattern_matching(sp->pat, fno->altname, 0, 0)
+#endif
+					) {
+					for (n = 0; fno->fname[n]; n++) ;
+					n++;
+					if ((BYTE*)(np - n) < (BYTE*)(sp->ent + sp->count + 1)) {	/* No room for this item? */
+#if _FS_EXFAT
+						if (fs->fs_type == FS_EXFAT) {
+							sp->next = dj.blk_ofs;
+						} else
+#endif
+						{
+#if _USE_LFN != 0
+							sp->next = (dj.blk_ofs != 0xFFFFFFFF) ? dj.blk_ofs : dj.dptr;	/* Continue from the top of the entry block */
+#else
+							sp->next = dj.dptr;
+#endif
+						}
+						if (sp->count == 0) res = FR_NOT_ENOUGH_CORE;	/* Not even an item fits in the work area */
+						break;
+					}
+					np -= n;
+					mem_cpy(np, fno->fname, n * sizeof (TCHAR));
+					se = &sp->ent[sp->count++];
+					se->fname = np;
+					se->fsize = fno->fsize;
+					se->fdate = fno->fdate;
+					se->ftime = fno->ftime;
+					se->fattrib = fno->fattrib;
+#if _FS_EXFAT
+					if (fs->fs_type == FS_EXFAT) {
+						se->dptr = dj.blk_ofs;
+						se->sclust = ld_dword(fs->dirbuf + XDIR_FstClus);
+						se->nsum = ld_word(fs->dirbuf + XDIR_NameHash);
+					} else
+#endif
+					{
+						se->dptr = dj.dptr;
+						se->sclust = ld_clust(fs, dj.dir);
+						se->nsum = snap_sum(dj.dir);
+					}
+				}
+				res = dir_next(&dj, 0);		/* Increment index for next */
+			}
+			if (res == FR_NO_FILE) res = FR_OK;	/* Reached end of the directory */
+			if (res == FR_OK) snap_sort(sp);
+		}
+		FREE_NAMBUF();
+	}
+	LEAVE_FF(fs, res);
+}
+
+#endif	/* _USE_DIRSNAP */
+
+
+
 
 /*---------------------------------------------------------------------------
 
@@ -3267,6 +4659,9 @@ FRESULT f_mount (
 	int vol;
 	FRESULT res;
 	const TCHAR *rp = path;
+#if _FS_REENTRANT == 2
+	UINT i;
+#endif
 
 
 	/* Get logical drive number */
@@ -3275,17 +4670,39 @@ FRESULT f_mount (
 	cfs = FatFs[vol];					/* Pointer to fs object */
 
 	if (cfs) {
+#if _FS_REENTRANT == 2
+		if (!lock_fs(cfs)) return FR_TIMEOUT;
+		for (i = 0; i < _FS_LOCK && !cfs->iobusy[i]; i++) ;
+		unlock_fs(cfs, FR_OK);
+		if (i < _FS_LOCK) return FR_LOCKED;	/* Transfers without the volume lock are in progress */
+#endif
 #if _FS_LOCK != 0
 		clear_lock(cfs);
 #endif
 #if _FS_REENTRANT						/* Discard sync object of the current volume */
 		if (!ff_del_syncobj(cfs->sobj)) return FR_INT_ERR;
+#endif
+#if _FS_FREEMAP
+		fm_free(cfs);					/* Discard the free cluster map */
+#endif
+#if _FS_JOURNAL
+		if (cfs->fs_type) jnl_checkpoint(cfs);	/* Leave the volume clean for other systems */
 #endif
 		cfs->fs_type = 0;				/* Clear old fs object */
 	}
 
 	if (fs) {
+#if _USE_LFN != 0 && _LFN_UPTABLE
+		if (!UpTbl[0x7F]) {				/* Build the up-case table at first mount */
+			UINT c;
+
+			for (c = 0; c < _LFN_UPTABLE; c++) UpTbl[c] = ff_wtoupper((WCHAR)c);
+		}
+#endif
 		fs->fs_type = 0;				/* Clear new fs object */
+#if _FS_FREEMAP
+		fs->fmap = 0;
+#endif
 #if _FS_REENTRANT						/* Create sync object for the new volume */
 		if (!ff_cre_syncobj((BYTE)vol, &fs->sobj)) return FR_INT_ERR;
 #endif
@@ -3305,9 +4722,12 @@ FRESULT f_mount (
 /* Open or Create a File                                                 */
 /*-----------------------------------------------------------------------*/
 
-FRESULT f_open (
+static
+FRESULT open_file (
 	FIL* fp,			/* Pointer to the blank file object */
-	const TCHAR* path,	/* Pointer to the file name */
+	const TCHAR* path,	/* Pointer to the file name (used when sp is null) */
+	const DIRSNAP* sp,	/* Pointer to the directory snapshot holding the file (null:follow the path) */
+	UINT idx,			/* Index of the file in the snapshot */
 	BYTE mode			/* Access mode and file open mode flags */
 )
 {
@@ -3317,6 +4737,9 @@ FRESULT f_open (
 #if !_FS_READONLY
 	DWORD dw, cl, bcs, clst, sc;
 	FSIZE_t ofs;
+#endif
+#if _USE_FASTSEEK == 2
+	BYTE lmap = mode & FA_LINKMAP;
 #endif
 	DEF_NAMBUF
 
@@ -3325,11 +4748,28 @@ FRESULT f_open (
 
 	/* Get logical drive */
 	mode &= _FS_READONLY ? FA_READ : FA_READ | FA_WRITE | FA_CREATE_ALWAYS | FA_CREATE_NEW | FA_OPEN_ALWAYS | FA_OPEN_APPEND | FA_SEEKEND;
-	res = find_volume(&path, &fs, mode);
+#if _USE_DIRSNAP
+	if (sp) {
+		res = validate((_FDID*)&sp->obj, &fs);	/* Check if the snapshot is of the current mount */
+		if (res == FR_OK && !_FS_READONLY && (mode & ~FA_READ) && (disk_status(fs->drv) & STA_PROTECT)) {
+			res = FR_WRITE_PROTECTED;
+		}
+	} else
+#endif
+	{
+		res = find_volume(&path, &fs, mode);
+	}
 	if (res == FR_OK) {
 		dj.obj.fs = fs;
 		INIT_NAMBUF(fs);
-		res = follow_path(&dj, path);	/* Follow the file path */
+#if _USE_DIRSNAP
+		if (sp) {
+			res = snap_follow(&dj, sp, idx);	/* Go to the entry recorded in the snapshot */
+		} else
+#endif
+		{
+			res = follow_path(&dj, path);	/* Follow the file path */
+		}
 #if !_FS_READONLY	/* R/W configuration */
 		if (res == FR_OK) {
 			if (dj.fn[NSFLAG] & NS_NONAME) {	/* Origin directory itself? */
@@ -3450,6 +4890,7 @@ FRESULT f_open (
 				fp->obj.sclust = ld_dword(fs->dirbuf + XDIR_FstClus);	/* Get object allocation info */
 				fp->obj.objsize = ld_qword(fs->dirbuf + XDIR_FileSize);
 				fp->obj.stat = fs->dirbuf[XDIR_GenFlags] & 2;
+				fp->obj.n_frag = 0;
 			} else
 #endif
 			{
@@ -3458,25 +4899,46 @@ FRESULT f_open (
 			}
 #if _USE_FASTSEEK
 			fp->cltbl = 0;			/* Disable fast seek mode */
+#if _USE_FASTSEEK == 2
+			fp->cltlen = 0;
+#endif
 #endif
 			fp->obj.fs = fs;	 	/* Validate the file object */
 			fp->obj.id = fs->id;
 			fp->flag = mode;		/* Set file access mode */
+#if _FS_CONTIG
+			fp->flag &= (BYTE)~FA_CONTIG;
+#if _FS_EXFAT
+			if (fp->obj.stat == 2) fp->flag |= FA_CONTIG;	/* Contiguous file on the exFAT volume */
+#endif
+			fp->ckpt = 0;
+#endif
 			fp->err = 0;			/* Clear error flag */
 			fp->sect = 0;			/* Invalidate current data sector */
 			fp->fptr = 0;			/* Set file pointer top of the file */
+#if _USE_FASTSEEK == 2
+			if (lmap) res = clmt_create(fp);	/* Create the link map table if FA_LINKMAP is specified */
+#endif
 #if !_FS_READONLY
 #if !_FS_TINY
 			mem_set(fp->buf, 0, _MAX_SS);	/* Clear sector buffer */
 #endif
-			if ((mode & FA_SEEKEND) && fp->obj.objsize > 0) {	/* Seek to end of file if FA_OPEN_APPEND is specified */
+			if (res == FR_OK && (mode & FA_SEEKEND) && fp->obj.objsize > 0) {	/* Seek to end of file if FA_OPEN_APPEND is specified */
 				fp->fptr = fp->obj.objsize;			/* Offset to seek */
 				bcs = (DWORD)fs->csize * SS(fs);	/* Cluster size in byte */
-				clst = fp->obj.sclust;				/* Follow the cluster chain */
-				for (ofs = fp->obj.objsize; res == FR_OK && ofs > bcs; ofs -= bcs) {
-					clst = get_fat(&fp->obj, clst);
-					if (clst <= 1) res = FR_INT_ERR;
-					if (clst == 0xFFFFFFFF) res = FR_DISK_ERR;
+#if _USE_FASTSEEK == 2
+				if (fp->cltbl) {					/* Get the last cluster from the link map */
+					clst = clmt_clust(fp, fp->obj.objsize - 1);
+					ofs = (fp->obj.objsize - 1) % bcs + 1;
+				} else
+#endif
+				{
+					clst = fp->obj.sclust;				/* Follow the cluster chain */
+					for (ofs = fp->obj.objsize; res == FR_OK && ofs > bcs; ofs -= bcs) {
+						clst = get_fat(&fp->obj, clst);
+						if (clst <= 1) res = FR_INT_ERR;
+						if (clst == 0xFFFFFFFF) res = FR_DISK_ERR;
+					}
 				}
 				fp->clust = clst;
 				if (res == FR_OK && ofs % SS(fs)) {	/* Fill sector buffer if not on the sector boundary */
@@ -3502,33 +4964,49 @@ FRESULT f_open (
 }
 
 
+FRESULT f_open (
+	FIL* fp,			/* Pointer to the blank file object */
+	const TCHAR* path,	/* Pointer to the file name */
+	BYTE mode			/* Access mode and file open mode flags */
+)
+{
+	return open_file(fp, path, 0, 0, mode);
+}
+
+
 
 
 /*-----------------------------------------------------------------------*/
-/* Read File                                                             */
+/* Read data from the file at current read/write pointer                */
 /*-----------------------------------------------------------------------*/
 
-FRESULT f_read (
-	FIL* fp, 	/* Pointer to the file object */
-	void* buff,	/* Pointer to data buffer */
-	UINT btr,	/* Number of bytes to read */
-	UINT* br	/* Pointer to number of bytes read */
+static
+FRESULT read_data (	/* FR_OK(0):succeeded, !=0:error (the file object is locked by caller) */
+	FIL* fp,		/* Pointer to the file object */
+	BYTE* rbuff,	/* Pointer to data buffer */
+	UINT btr,		/* Number of bytes to read */
+	UINT* br		/* Pointer to the byte counter to be incremented */
 )
 {
-	FRESULT res;
-	FATFS *fs;
+	FATFS *fs = fp->obj.fs;
 	DWORD clst, sect;
 	FSIZE_t remain;
 	UINT rcnt, cc, csect;
-	BYTE *rbuff = (BYTE*)buff;
+#if _USE_STREAM
+	FRESULT res;
+#endif
+#if _FS_REENTRANT == 2
+	DRESULT dr;
+	UINT slot;
+	int lk;
+#endif
 
 
-	*br = 0;	/* Clear read byte counter */
-	res = validate(&fp->obj, &fs);				/* Check validity of the file object */
-	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
-	if (!(fp->flag & FA_READ)) LEAVE_FF(fs, FR_DENIED); /* Check access mode */
 	remain = fp->obj.objsize - fp->fptr;
 	if (btr > remain) btr = (UINT)remain;		/* Truncate btr by remaining bytes */
+#if _USE_STREAM
+	if (btr && (res = ra_resume(fp)) != FR_OK) return res;	/* Load the sector left by f_stream() */
+#endif
 
 	for ( ;  btr;								/* Repeat until all data read */
 		rbuff += rcnt, fp->fptr += rcnt, *br += rcnt, btr -= rcnt) {
@@ -3538,6 +5016,11 @@ FRESULT f_read (
 				if (fp->fptr == 0) {			/* On the top of the file? */
 					clst = fp->obj.sclust;		/* Follow cluster chain from the origin */
 				} else {						/* Middle or end of the file */
+#if _FS_CONTIG
+					if (fp->flag & FA_CONTIG) {
+						clst = fp->clust + 1;		/* Next cluster in the contiguous block */
+					} else
+#endif
 #if _USE_FASTSEEK
 					if (fp->cltbl) {
 						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
@@ -3547,19 +5030,47 @@ FRESULT f_read (
 						clst = get_fat(&fp->obj, fp->clust);	/* Follow cluster chain on the FAT */
 					}
 				}
-				if (clst < 2) ABORT(fs, FR_INT_ERR);
-				if (clst == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
+				if (clst < 2) return FR_INT_ERR;
+				if (clst == 0xFFFFFFFF) return FR_DISK_ERR;
 				fp->clust = clst;				/* Update current cluster */
 			}
 			sect = clust2sect(fs, fp->clust);	/* Get current sector */
-			if (!sect) ABORT(fs, FR_INT_ERR);
+			if (!sect) return FR_INT_ERR;
 			sect += csect;
 			cc = btr / SS(fs);					/* When remaining bytes >= sector size, */
 			if (cc) {							/* Read maximum contiguous sectors directly */
 				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
 					cc = fs->csize - csect;
 				}
-				if (disk_read(fs->drv, rbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
+#if _FS_REENTRANT == 2
+				for (slot = 0; slot < _FS_LOCK && fs->iobusy[slot]; slot++) ;	/* Get a free in-flight slot */
+				lk = 1;
+				if (slot < _FS_LOCK) {			/* Release the volume while transferring data to the user buffer */
+					fs->iobusy[slot] = 1;		/* (the volume is not unmounted until the slot is freed) */
+					unlock_fs(fs, FR_OK);
+					dr = disk_read(fs->drv, rbuff, sect, cc);
+					lk = lock_fs(fs);
+				} else {
+					dr = disk_read(fs->drv, rbuff, sect, cc);	/* (no free slot, transfer under the volume lock) */
+				}
+				if (!lk) {						/* Volume could not be locked again, the file object is still valid */
+					if (dr == RES_OK) {			/* Count the data transferred */
+#if !_FS_READONLY && _FS_MINIMIZE <= 2
+						if ((fp->flag & FA_DIRTY) && fp->sect - sect < cc) {
+							mem_cpy(rbuff + ((fp->sect - sect) * SS(fs)), fp->buf, SS(fs));
+						}
+#endif
+						rcnt = SS(fs) * cc;
+						fp->fptr += rcnt; *br += rcnt;
+					}
+					fs->iobusy[slot] = 0;		/* No access to the volume after here */
+					return FR_TIMEOUT;
+				}
+				if (slot < _FS_LOCK) fs->iobusy[slot] = 0;
+				if (dr != RES_OK) return FR_DISK_ERR;
+#else
+				if (disk_read(fs->drv, rbuff, sect, cc) != RES_OK) return FR_DISK_ERR;
+#endif
 #if !_FS_READONLY && _FS_MINIMIZE <= 2			/* Replace one of the read sectors with cached data if it contains a dirty sector */
 #if _FS_TINY
 				if (fs->wflag && fs->winsect - sect < cc) {
@@ -3578,11 +5089,16 @@ FRESULT f_read (
 			if (fp->sect != sect) {			/* Load data sector if not in cache */
 #if !_FS_READONLY
 				if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
-					if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+					DISCARD_SECT(fs, fp->sect, 1);
+					if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) return FR_DISK_ERR;
 					fp->flag &= (BYTE)~FA_DIRTY;
 				}
 #endif
-				if (disk_read(fs->drv, fp->buf, sect, 1) != RES_OK)	ABORT(fs, FR_DISK_ERR);	/* Fill sector cache */
+#if _FS_RDAHEAD
+				if (ra_load(fp, sect) != FR_OK) return FR_DISK_ERR;	/* Fill sector cache through the read-ahead pool */
+#else
+				if (disk_read(fs->drv, fp->buf, sect, 1) != RES_OK)	return FR_DISK_ERR;	/* Fill sector cache */
+#endif
 			}
 #endif
 			fp->sect = sect;
@@ -3590,43 +5106,233 @@ FRESULT f_read (
 		rcnt = SS(fs) - (UINT)fp->fptr % SS(fs);	/* Number of bytes left in the sector */
 		if (rcnt > btr) rcnt = btr;					/* Clip it by btr if needed */
 #if _FS_TINY
-		if (move_window(fs, fp->sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Move sector window */
+		if (move_window(fs, fp->sect) != FR_OK) return FR_DISK_ERR;	/* Move sector window */
 		mem_cpy(rbuff, fs->win + fp->fptr % SS(fs), rcnt);	/* Extract partial sector */
 #else
 		mem_cpy(rbuff, fp->buf + fp->fptr % SS(fs), rcnt);	/* Extract partial sector */
 #endif
 	}
 
+
+	return FR_OK;
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Read File                                                             */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_read (
+	FIL* fp, 	/* Pointer to the file object */
+	void* buff,	/* Pointer to data buffer */
+	UINT btr,	/* Number of bytes to read */
+	UINT* br	/* Pointer to number of bytes read */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+
+
+	*br = 0;	/* Clear read byte counter */
+	res = validate(&fp->obj, &fs);				/* Check validity of the file object */
+	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
+	if (!(fp->flag & FA_READ)) LEAVE_FF(fs, FR_DENIED); /* Check access mode */
+	res = read_data(fp, (BYTE*)buff, btr, br);	/* Transfer the data */
+	if (res == FR_TIMEOUT) LEAVE_FF(fs, res);	/* Volume lock not taken back (not an error of the file) */
+	if (res != FR_OK) ABORT(fs, res);
+
 	LEAVE_FF(fs, FR_OK);
 }
 
 
 
 
-#if !_FS_READONLY
+#if _USE_IOVEC
 /*-----------------------------------------------------------------------*/
-/* Write File                                                            */
+/* Read File into Scattered Buffers                                      */
 /*-----------------------------------------------------------------------*/
 
-FRESULT f_write (
+FRESULT f_readv (
 	FIL* fp,			/* Pointer to the file object */
-	const void* buff,	/* Pointer to the data to be written */
-	UINT btw,			/* Number of bytes to write */
-	UINT* bw			/* Pointer to number of bytes written */
+	const FIOV* iov,	/* Pointer to the array of buffer segments */
+	UINT iovcnt,		/* Number of segments in the array */
+	UINT* br			/* Pointer to number of bytes read */
 )
 {
 	FRESULT res;
 	FATFS *fs;
-	DWORD clst, sect;
-	UINT wcnt, cc, csect;
-	const BYTE *wbuff = (const BYTE*)buff;
+	UINT i, n;
 
 
-	*bw = 0;	/* Clear write byte counter */
-	res = validate(&fp->obj, &fs);			/* Check validity of the file object */
+	*br = 0;	/* Clear read byte counter */
+	res = validate(&fp->obj, &fs);				/* Check validity of the file object */
 	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
-	if (!(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);	/* Check access mode */
+	if (!(fp->flag & FA_READ)) LEAVE_FF(fs, FR_DENIED); /* Check access mode */
+
+	for (i = 0; i < iovcnt; i++) {				/* Fill each segment in order */
+		n = 0;
+		res = read_data(fp, (BYTE*)iov[i].buf, iov[i].len, &n);	/* Aligned middle goes to the disk directly */
+		*br += n;
+		if (res == FR_TIMEOUT) LEAVE_FF(fs, res);	/* Volume lock not taken back (not an error of the file) */
+		if (res != FR_OK) ABORT(fs, res);
+		if (n < iov[i].len) break;				/* End of file */
+	}
+
+	LEAVE_FF(fs, FR_OK);
+}
+#endif
+
+
+
+
+#if _USE_ASYNC
+/*-----------------------------------------------------------------------*/
+/* Read File Asynchronously                                              */
+/*-----------------------------------------------------------------------*/
+
+static
+void read_async_cplt (
+	DRESULT dr,		/* Result of the disk transfer */
+	void* arg		/* Pointer to the read request */
+)
+{
+	FREQ *rq = (FREQ*)arg;
+	FRESULT res = (dr == RES_OK) ? FR_OK : FR_DISK_ERR;
+
+
+	if (rq->busy) {		/* Completed before f_read_async() returns (e.g. in place by the driver)? */
+		rq->res = res;	/* Defer the callback until the volume is unlocked */
+		rq->done = 1;
+	} else {
+		rq->func(res, rq->arg);
+	}
+}
+
+
+FRESULT f_read_async (
+	FIL* fp,		/* Pointer to the file object */
+	FREQ* rq		/* Pointer to the read request */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DWORD clst, ncl, sect;
+	FSIZE_t remain;
+	UINT btr, cc, csect;
+	DRESULT dr;
+
+
+	rq->br = 0;	/* Clear read byte counter */
+	rq->busy = rq->done = 0;
+	res = validate(&fp->obj, &fs);				/* Check validity of the file object */
+	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
+	if (!(fp->flag & FA_READ)) LEAVE_FF(fs, FR_DENIED); /* Check access mode */
+	remain = fp->obj.objsize - fp->fptr;
+	btr = rq->btr;
+	if (btr > remain) btr = (UINT)remain;		/* Truncate btr by remaining bytes */
+
+	if (fp->fptr % SS(fs) || btr < SS(fs)) {	/* Partial sector? */
+		cc = SS(fs) - (UINT)fp->fptr % SS(fs);
+		if (btr > cc) btr = cc;					/* Read up to the sector boundary in place */
+		res = read_data(fp, (BYTE*)rq->buff, btr, &rq->br);
+		if (res != FR_OK) ABORT(fs, res);
+		rq->res = FR_OK;						/* Completed already */
+		rq->done = 1;
+		goto complete;
+	}
+
+	csect = (UINT)(fp->fptr / SS(fs) & (fs->csize - 1));	/* Sector offset in the cluster */
+	clst = fp->clust;
+	if (csect == 0) {							/* On the cluster boundary? */
+		if (fp->fptr == 0) {					/* On the top of the file? */
+			clst = fp->obj.sclust;
+		} else {
+#if _USE_FASTSEEK
+			if (fp->cltbl) {
+				clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
+			} else
+#endif
+			{
+				clst = get_fat(&fp->obj, fp->clust);
+			}
+		}
+		if (clst < 2) ABORT(fs, FR_INT_ERR);
+		if (clst == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
+	}
+	sect = clust2sect(fs, clst);				/* Get current sector */
+	if (!sect) ABORT(fs, FR_INT_ERR);
+	sect += csect;
+	cc = fs->csize - csect;						/* Sectors left in the cluster */
+	for (ncl = clst; cc < btr / SS(fs); ncl++) {	/* Stretch over the following clusters if contiguous */
+		if (get_fat(&fp->obj, ncl) != ncl + 1) break;
+		cc += fs->csize;
+	}
+	if (cc > btr / SS(fs)) cc = btr / SS(fs);	/* Clip it by btr */
+#if !_FS_READONLY
+#if _FS_TINY
+	if (fs->wflag && fs->winsect - sect < cc && sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Write-back sector cache */
+#else
+	if ((fp->flag & FA_DIRTY) && fp->sect - sect < cc) {	/* Write-back sector cache since the disk gets read behind it */
+		DISCARD_SECT(fs, fp->sect, 1);
+		if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+		fp->flag &= (BYTE)~FA_DIRTY;
+	}
+#endif
+#endif
+	rq->br = SS(fs) * cc;						/* Number of bytes submitted, the callback can see it */
+	fp->fptr += rq->br;							/* Move the file pointer prior to the completion */
+	clst = fp->clust;
+	fp->clust = (sect + cc - 1 - fs->database) / fs->csize + 2;	/* Cluster of the last sector submitted */
+	rq->busy = 1;
+	dr = disk_read_async(fs->drv, (BYTE*)rq->buff, sect, cc, read_async_cplt, rq);	/* Submit the transfer */
+	if (dr != RES_OK) {							/* Not submitted (the callback is not called) */
+		rq->busy = 0;
+		fp->fptr -= rq->br;
+		fp->clust = clst;
+		rq->br = 0;
+		if (dr == RES_NOTRDY) LEAVE_FF(fs, FR_OK);	/* Queue of the driver is full (br = 0) */
+		ABORT(fs, FR_DISK_ERR);
+	}
+
+complete:
+#if _FS_REENTRANT
+	unlock_fs(fs, FR_OK);
+#endif
+	rq->busy = 0;								/* Completion after here calls the callback directly */
+	if (rq->done) rq->func(rq->res, rq->arg);	/* Completed in f_read_async(), call the callback out of the lock */
+	return FR_OK;
+}
+#endif
+
+
+
+
+#if !_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* Write data to the file at current read/write pointer                 */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT write_data (	/* FR_OK(0):succeeded, !=0:error (the file object is locked by caller) */
+	FIL* fp,			/* Pointer to the file object */
+	const BYTE* wbuff,	/* Pointer to the data to be written */
+	UINT btw,			/* Number of bytes to write */
+	UINT* bw			/* Pointer to the byte counter to be incremented */
+)
+{
+	FATFS *fs = fp->obj.fs;
+	DWORD clst, sect;
+	UINT wcnt, cc, csect;
+#if _USE_STREAM
+	FRESULT res;
+#endif
 
+
+#if _USE_STREAM
+	if (btw && (res = ra_resume(fp)) != FR_OK) return res;	/* Load the sector left by f_stream() */
+#endif
 	/* Check fptr wrap-around (file size cannot reach 4GiB on FATxx) */
 	if ((!_FS_EXFAT || fs->fs_type != FS_EXFAT) && (DWORD)(fp->fptr + btw) < (DWORD)fp->fptr) {
 		btw = (UINT)(0xFFFFFFFF - (DWORD)fp->fptr);
@@ -3641,11 +5347,26 @@ FRESULT f_write (
 					clst = fp->obj.sclust;	/* Follow from the origin */
 					if (clst == 0) {		/* If no cluster is allocated, */
 						clst = create_chain(&fp->obj, 0);	/* create a new cluster chain */
+#if _USE_FASTSEEK == 2
+						if (clst >= 2 && clst != 0xFFFFFFFF) clmt_add(fp, clst, 1);	/* Put it into the link map */
+#endif
 					}
 				} else {					/* On the middle or end of the file */
+#if _FS_CONTIG
+					if (fp->fptr >= fp->obj.objsize) fp->flag &= (BYTE)~FA_CONTIG;	/* The chain is going to be stretched */
+					if (fp->flag & FA_CONTIG) {
+						clst = fp->clust + 1;	/* Next cluster in the contiguous block */
+					} else
+#endif
 #if _USE_FASTSEEK
 					if (fp->cltbl) {
 						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
+#if _USE_FASTSEEK == 2
+						if (clst == 0 && fp->cltlen) {		/* Stretch the chain if it is out of the link map */
+							clst = create_chain(&fp->obj, fp->clust);
+							if (clst >= 2 && clst != 0xFFFFFFFF) clmt_add(fp, clst, 1);
+						}
+#endif
 					} else
 #endif
 					{
@@ -3653,28 +5374,30 @@ FRESULT f_write (
 					}
 				}
 				if (clst == 0) break;		/* Could not allocate a new cluster (disk full) */
-				if (clst == 1) ABORT(fs, FR_INT_ERR);
-				if (clst == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
+				if (clst == 1) return FR_INT_ERR;
+				if (clst == 0xFFFFFFFF) return FR_DISK_ERR;
 				fp->clust = clst;			/* Update current cluster */
 				if (fp->obj.sclust == 0) fp->obj.sclust = clst;	/* Set start cluster if the first write */
 			}
 #if _FS_TINY
-			if (fs->winsect == fp->sect && sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Write-back sector cache */
+			if (fs->winsect == fp->sect && sync_window(fs) != FR_OK) return FR_DISK_ERR;	/* Write-back sector cache */
 #else
 			if (fp->flag & FA_DIRTY) {		/* Write-back sector cache */
-				if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+				DISCARD_SECT(fs, fp->sect, 1);
+				if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) return FR_DISK_ERR;
 				fp->flag &= (BYTE)~FA_DIRTY;
 			}
 #endif
 			sect = clust2sect(fs, fp->clust);	/* Get current sector */
-			if (!sect) ABORT(fs, FR_INT_ERR);
+			if (!sect) return FR_INT_ERR;
 			sect += csect;
 			cc = btw / SS(fs);				/* When remaining bytes >= sector size, */
 			if (cc) {						/* Write maximum contiguous sectors directly */
 				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
 					cc = fs->csize - csect;
 				}
-				if (disk_write(fs->drv, wbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
+				DISCARD_SECT(fs, sect, cc);
+				if (disk_write(fs->drv, wbuff, sect, cc) != RES_OK) return FR_DISK_ERR;
 #if _FS_MINIMIZE <= 2
 #if _FS_TINY
 				if (fs->winsect - sect < cc) {	/* Refill sector cache if it gets invalidated by the direct write */
@@ -3693,14 +5416,14 @@ FRESULT f_write (
 			}
 #if _FS_TINY
 			if (fp->fptr >= fp->obj.objsize) {	/* Avoid silly cache filling on the growing edge */
-				if (sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);
+				if (sync_window(fs) != FR_OK) return FR_DISK_ERR;
 				fs->winsect = sect;
 			}
 #else
 			if (fp->sect != sect && 		/* Fill sector cache with file data */
 				fp->fptr < fp->obj.objsize &&
 				disk_read(fs->drv, fp->buf, sect, 1) != RES_OK) {
-					ABORT(fs, FR_DISK_ERR);
+					return FR_DISK_ERR;
 			}
 #endif
 			fp->sect = sect;
@@ -3708,7 +5431,7 @@ FRESULT f_write (
 		wcnt = SS(fs) - (UINT)fp->fptr % SS(fs);	/* Number of bytes left in the sector */
 		if (wcnt > btw) wcnt = btw;					/* Clip it by btw if needed */
 #if _FS_TINY
-		if (move_window(fs, fp->sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Move sector window */
+		if (move_window(fs, fp->sect) != FR_OK) return FR_DISK_ERR;	/* Move sector window */
 		mem_cpy(fs->win + fp->fptr % SS(fs), wbuff, wcnt);	/* Fit data to the sector */
 		fs->wflag = 1;
 #else
@@ -3717,10 +5440,78 @@ FRESULT f_write (
 #endif
 	}
 
+	return FR_OK;
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Write File                                                            */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_write (
+	FIL* fp,			/* Pointer to the file object */
+	const void* buff,	/* Pointer to the data to be written */
+	UINT btw,			/* Number of bytes to write */
+	UINT* bw			/* Pointer to number of bytes written */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+
+
+	*bw = 0;	/* Clear write byte counter */
+	res = validate(&fp->obj, &fs);			/* Check validity of the file object */
+	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
+	if (!(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);	/* Check access mode */
+
+	res = write_data(fp, (const BYTE*)buff, btw, bw);	/* Transfer the data */
+	if (res != FR_OK) ABORT(fs, res);
+
+	fp->flag |= FA_MODIFIED;				/* Set file change flag */
+
+	LEAVE_FF(fs, FR_OK);
+}
+
+
+
+
+#if _USE_IOVEC
+/*-----------------------------------------------------------------------*/
+/* Write File from Gathered Buffers                                      */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_writev (
+	FIL* fp,			/* Pointer to the file object */
+	const FIOV* iov,	/* Pointer to the array of data segments */
+	UINT iovcnt,		/* Number of segments in the array */
+	UINT* bw			/* Pointer to number of bytes written */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	UINT i, n;
+
+
+	*bw = 0;	/* Clear write byte counter */
+	res = validate(&fp->obj, &fs);			/* Check validity of the file object */
+	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
+	if (!(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);	/* Check access mode */
+
+	for (i = 0; i < iovcnt; i++) {			/* Write out each segment in order */
+		n = 0;
+		res = write_data(fp, (const BYTE*)iov[i].buf, iov[i].len, &n);	/* Aligned middle goes to the disk directly */
+		*bw += n;
+		if (res != FR_OK) ABORT(fs, res);
+		if (n < iov[i].len) break;			/* Disk full or size limit */
+	}
+
 	fp->flag |= FA_MODIFIED;				/* Set file change flag */
 
 	LEAVE_FF(fs, FR_OK);
 }
+#endif
 
 
 
@@ -3747,9 +5538,18 @@ FRESULT f_sync (
 		if (fp->flag & FA_MODIFIED) {	/* Is there any change to the file? */
 #if !_FS_TINY
 			if (fp->flag & FA_DIRTY) {	/* Write-back cached data if needed */
+				DISCARD_SECT(fs, fp->sect, 1);
 				if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) LEAVE_FF(fs, FR_DISK_ERR);
 				fp->flag &= (BYTE)~FA_DIRTY;
 			}
+#endif
+#if _FS_CONTIG
+			if ((fp->flag & FA_CONTIG) && fp->ckpt && fp->ckpt < _FS_CONTIG) {	/* Only the timestamp would change, defer it to the checkpoint */
+				fp->ckpt++;
+				res = sync_fs(fs);
+				LEAVE_FF(fs, res);
+			}
+			fp->ckpt = 1;
 #endif
 			/* Update the directory entry */
 			tm = GET_FATTIME();				/* Modified time */
@@ -3818,6 +5618,9 @@ FRESULT f_close (
 	FATFS *fs;
 
 #if !_FS_READONLY
+#if _FS_CONTIG
+	fp->ckpt = 0;						/* Update the directory entry regardless of the checkpoint */
+#endif
 	res = f_sync(fp);					/* Flush cached data */
 	if (res == FR_OK)
 #endif
@@ -3829,6 +5632,9 @@ FRESULT f_close (
 			if (res == FR_OK)
 #endif
 			{
+#if _USE_FASTSEEK == 2
+				clmt_free(fp);			/* Discard the link map table */
+#endif
 				fp->obj.fs = 0;			/* Invalidate file object */
 			}
 #if _FS_REENTRANT
@@ -4007,6 +5813,9 @@ FRESULT f_lseek (
 	FATFS *fs;
 	DWORD clst, bcs, nsect;
 	FSIZE_t ifptr;
+#if _FS_CONTIG || _FS_EXFAT
+	DWORD n;
+#endif
 #if _USE_FASTSEEK
 	DWORD cl, pcl, ncl, tcl, dsc, tlen, ulen, *tbl;
 #endif
@@ -4022,6 +5831,9 @@ FRESULT f_lseek (
 
 #if _USE_FASTSEEK
 	if (fp->cltbl) {	/* Fast seek */
+#if _USE_FASTSEEK == 2
+		if (ofs == CREATE_LINKMAP && fp->cltlen) LEAVE_FF(fs, FR_OK);	/* The table allocated by FA_LINKMAP is always up to date */
+#endif
 		if (ofs == CREATE_LINKMAP) {	/* Create CLMT */
 			tbl = fp->cltbl;
 			tlen = *tbl++; ulen = 2;	/* Given table size and required table size */
@@ -4059,11 +5871,16 @@ FRESULT f_lseek (
 #if !_FS_TINY
 #if !_FS_READONLY
 					if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
+						DISCARD_SECT(fs, fp->sect, 1);
 						if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
 						fp->flag &= (BYTE)~FA_DIRTY;
 					}
 #endif
+#if _FS_RDAHEAD
+					if (ra_load(fp, dsc) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Load current sector through the read-ahead pool */
+#else
 					if (disk_read(fs->drv, fp->buf, dsc, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Load current sector */
+#endif
 #endif
 					fp->sect = dsc;
 				}
@@ -4080,6 +5897,9 @@ FRESULT f_lseek (
 		if (ofs > fp->obj.objsize && (_FS_READONLY || !(fp->flag & FA_WRITE))) {	/* In read-only mode, clip offset with the file size */
 			ofs = fp->obj.objsize;
 		}
+#if _FS_CONTIG
+		if (ofs > fp->obj.objsize) fp->flag &= (BYTE)~FA_CONTIG;	/* The chain is going to be stretched */
+#endif
 		ifptr = fp->fptr;
 		fp->fptr = nsect = 0;
 		if (ofs) {
@@ -4102,6 +5922,22 @@ FRESULT f_lseek (
 				fp->clust = clst;
 			}
 			if (clst != 0) {
+#if _FS_CONTIG || _FS_EXFAT
+				n = 0;
+#if _FS_CONTIG
+				if (fp->flag & FA_CONTIG) n = (DWORD)((ofs - 1) / bcs);	/* Calculate the cluster in the contiguous block */
+#endif
+#if _FS_EXFAT
+				if (fs->fs_type == FS_EXFAT && fp->obj.stat == 2 && fp->obj.objsize > fp->fptr) {	/* Calculate the cluster in the block without FAT chain */
+					n = (DWORD)((((ofs < fp->obj.objsize - fp->fptr) ? ofs : fp->obj.objsize - fp->fptr) - 1) / bcs);
+				}
+#endif
+				if (n) {
+					ofs -= (FSIZE_t)n * bcs; fp->fptr += (FSIZE_t)n * bcs;
+					clst += n;
+					fp->clust = clst;
+				}
+#endif
 				while (ofs > bcs) {						/* Cluster following loop */
 					ofs -= bcs; fp->fptr += bcs;
 #if !_FS_READONLY
@@ -4139,11 +5975,16 @@ FRESULT f_lseek (
 #if !_FS_TINY
 #if !_FS_READONLY
 			if (fp->flag & FA_DIRTY) {			/* Write-back dirty sector cache */
+				DISCARD_SECT(fs, fp->sect, 1);
 				if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
 				fp->flag &= (BYTE)~FA_DIRTY;
 			}
 #endif
+#if _FS_RDAHEAD
+			if (ra_load(fp, nsect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Fill sector cache through the read-ahead pool */
+#else
 			if (disk_read(fs->drv, fp->buf, nsect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Fill sector cache */
+#endif
 #endif
 			fp->sect = nsect;
 		}
@@ -4345,6 +6186,84 @@ FRESULT f_findfirst (
 
 
 
+#if _USE_DIRSNAP
+/*-----------------------------------------------------------------------*/
+/* Take a Snapshot of the Directory                                      */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_snapdir (
+	DIRSNAP* sp,			/* Pointer to the blank snapshot object */
+	const TCHAR* path,		/* Pointer to the directory path */
+	const TCHAR* pattern,	/* Pointer to the matching pattern (null:all items) */
+	BYTE opt,				/* Sort order (DS_NONE, DS_NAME, DS_SIZE or DS_TIME, and DS_DIRFIRST/DS_DESC) */
+	void* work,				/* Pointer to the work area holding the entry table and names (pointer aligned) */
+	UINT len				/* Size of the work area [byte] */
+)
+{
+	FRESULT res;
+	DIR dj;
+
+
+	if (!sp || !work) return FR_INVALID_PARAMETER;
+	sp->obj.fs = 0;
+	sp->count = 0;
+	res = f_opendir(&dj, path);		/* Open the target directory */
+	if (res == FR_OK) {
+		sp->obj = dj.obj;			/* Save the directory object */
+		res = f_closedir(&dj);		/* The snapshot does not hold the directory open */
+	}
+	if (res == FR_OK) {
+		sp->pat = pattern;
+		sp->opt = opt;
+		sp->work = work;
+		sp->len = len;
+		res = snap_load(sp, 0);		/* Read the first page */
+	}
+	return res;
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Take Next Page of the Directory Snapshot                              */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_snapnext (
+	DIRSNAP* sp		/* Pointer to the snapshot object */
+)
+{
+	if (!sp) return FR_INVALID_OBJECT;
+	if (!sp->next) {		/* The last page has been taken */
+		sp->count = 0;
+		return FR_OK;
+	}
+	return snap_load(sp, sp->next);	/* Replace the snapshot with the next page */
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Open a File in the Directory Snapshot                                 */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_snapopen (
+	FIL* fp,			/* Pointer to the blank file object */
+	const DIRSNAP* sp,	/* Pointer to the snapshot */
+	UINT idx,			/* Index of the file in the snapshot */
+	BYTE mode			/* Access mode (FA_READ, FA_WRITE and FA_OPEN_APPEND) */
+)
+{
+	if (!sp) return FR_INVALID_OBJECT;
+	mode &= FA_READ | FA_WRITE | FA_SEEKEND;	/* The file is not created nor truncated */
+	return open_file(fp, 0, sp, idx, mode);
+}
+
+#endif	/* _USE_DIRSNAP */
+
+
+
 #if _FS_MINIMIZE == 0
 /*-----------------------------------------------------------------------*/
 /* Get File Status                                                       */
@@ -4401,6 +6320,11 @@ FRESULT f_getfree (
 
 	/* Get logical drive */
 	res = find_volume(&path, &fs, 0);
+#if _FS_FREEMAP
+	if (res == FR_OK && fs->fs_type != FS_EXFAT && !fs->fmap) {
+		res = fm_build(fs);			/* Build the free cluster map (free_clst gets valid) */
+	}
+#endif
 	if (res == FR_OK) {
 		*fatfs = fs;				/* Return ptr to the fs object */
 		/* If free_clst is valid, return it without full cluster scan */
@@ -4500,8 +6424,15 @@ FRESULT f_truncate (
 		}
 		fp->obj.objsize = fp->fptr;	/* Set file size to current R/W point */
 		fp->flag |= FA_MODIFIED;
+#if _FS_CONTIG
+		fp->ckpt = 0;					/* Size is changed, update the directory entry at next f_sync() */
+#endif
+#if _USE_FASTSEEK == 2
+		clmt_trim(fp);				/* Remove the clusters from the link map */
+#endif
 #if !_FS_TINY
 		if (res == FR_OK && (fp->flag & FA_DIRTY)) {
+			DISCARD_SECT(fs, fp->sect, 1);
 			if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) {
 				res = FR_DISK_ERR;
 			} else {
@@ -4563,6 +6494,7 @@ FRESULT f_unlink (
 					obj.sclust = dclst = ld_dword(fs->dirbuf + XDIR_FstClus);
 					obj.objsize = ld_qword(fs->dirbuf + XDIR_FileSize);
 					obj.stat = fs->dirbuf[XDIR_GenFlags] & 2;
+					obj.n_frag = 0;
 				} else
 #endif
 				{
@@ -4581,6 +6513,7 @@ FRESULT f_unlink (
 						if (fs->fs_type == FS_EXFAT) {
 							sdj.obj.objsize = obj.objsize;
 							sdj.obj.stat = obj.stat;
+							sdj.obj.n_frag = 0;
 						}
 #endif
 						res = dir_sdi(&sdj, 0);
@@ -4601,6 +6534,9 @@ FRESULT f_unlink (
 					res = remove_chain(&dj.obj, dclst, 0);
 #endif
 				}
+#if _USE_DIRINDEX
+				if (dclst && dclst == fs->dixclst) fs->dixtbl = 0;	/* Discard the index of the removed directory */
+#endif
 				if (res == FR_OK) res = sync_fs(fs);
 			}
 		}
@@ -4623,6 +6559,7 @@ FRESULT f_mkdir (
 {
 	FRESULT res;
 	DIR dj;
+	_FDID sobj;
 	FATFS *fs;
 	BYTE *dir;
 	UINT n;
@@ -4641,8 +6578,9 @@ FRESULT f_mkdir (
 			res = FR_INVALID_NAME;
 		}
 		if (res == FR_NO_FILE) {				/* Can create a new directory */
-			dcl = create_chain(&dj.obj, 0);		/* Allocate a cluster for the new directory table */
-			dj.obj.objsize = (DWORD)fs->csize * SS(fs);
+			sobj.fs = fs;						/* New object to allocate the chain, the parent directory object is kept intact */
+			sobj.objsize = (DWORD)fs->csize * SS(fs);
+			dcl = create_chain(&sobj, 0);		/* Allocate a cluster for the new directory table */
 			res = FR_OK;
 			if (dcl == 0) res = FR_DENIED;		/* No space to allocate a new cluster */
 			if (dcl == 1) res = FR_INT_ERR;
@@ -4680,8 +6618,8 @@ FRESULT f_mkdir (
 				if (fs->fs_type == FS_EXFAT) {	/* Initialize directory entry block */
 					st_dword(fs->dirbuf + XDIR_ModTime, tm);	/* Created time */
 					st_dword(fs->dirbuf + XDIR_FstClus, dcl);	/* Table start cluster */
-					st_dword(fs->dirbuf + XDIR_FileSize, (DWORD)dj.obj.objsize);	/* File size needs to be valid */
-					st_dword(fs->dirbuf + XDIR_ValidFileSize, (DWORD)dj.obj.objsize);
+					st_dword(fs->dirbuf + XDIR_FileSize, (DWORD)sobj.objsize);	/* File size needs to be valid */
+					st_dword(fs->dirbuf + XDIR_ValidFileSize, (DWORD)sobj.objsize);
 					fs->dirbuf[XDIR_GenFlags] = 3;				/* Initialize the object flag (contiguous) */
 					fs->dirbuf[XDIR_Attr] = AM_DIR;				/* Attribute */
 					res = store_xdir(&dj);
@@ -4698,7 +6636,7 @@ FRESULT f_mkdir (
 					res = sync_fs(fs);
 				}
 			} else {
-				remove_chain(&dj.obj, dcl, 0);		/* Could not register, remove cluster chain */
+				remove_chain(&sobj, dcl, 0);		/* Could not register, remove cluster chain */
 			}
 		}
 		FREE_NAMBUF();
@@ -5207,6 +7145,13 @@ FRESULT f_expand (
 			fp->obj.sclust = scl;		/* Update object allocation information */
 			fp->obj.objsize = fsz;
 			if (_FS_EXFAT) fp->obj.stat = 2;	/* Set status 'contiguous chain' */
+#if _USE_FASTSEEK == 2
+			clmt_add(fp, scl, tcl);		/* Put the block into the link map */
+#endif
+#if _FS_CONTIG
+			fp->flag |= FA_CONTIG;		/* Enter contiguous stream mode */
+			fp->ckpt = 0;
+#endif
 			fp->flag |= FA_MODIFIED;
 			if (fs->free_clst <= fs->n_fatent - 2) {	/* Update FSINFO */
 				fs->free_clst -= tcl;
@@ -5222,6 +7167,53 @@ FRESULT f_expand (
 
 
 
+
+#if _USE_DIRINDEX
+/*-----------------------------------------------------------------------*/
+/* Build a hash index of the directory                                   */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_dirindex (
+	const TCHAR* path,	/* Pointer to the directory path to be indexed */
+	void* work,			/* Pointer to the work area for the index (NULL:discard the index) */
+	UINT len			/* Size of the work area [byte] */
+)
+{
+	FRESULT res;
+	DIR dj;
+	FATFS *fs;
+	DEF_NAMBUF
+
+
+	/* Get logical drive */
+	res = find_volume(&path, &fs, 0);
+	if (res == FR_OK) {
+		fs->dixtbl = 0;						/* Discard current index */
+		if (work) {
+			if (fs->fs_type == FS_EXFAT) LEAVE_FF(fs, FR_INVALID_PARAMETER);	/* exFAT entries have the name hash in itself */
+			dj.obj.fs = fs;
+			INIT_NAMBUF(fs);
+			res = follow_path(&dj, path);	/* Follow the path to the directory */
+			if (res == FR_OK && !(dj.fn[NSFLAG] & NS_NONAME)) {	/* It is not the origin directory itself */
+				if (dj.obj.attr & AM_DIR) {
+					dj.obj.sclust = ld_clust(fs, dj.dir);	/* Open the sub-directory */
+				} else {
+					res = FR_NO_PATH;		/* It is a file */
+				}
+			}
+			if (res == FR_OK) res = dix_build(&dj, work, len);	/* Scan the directory and build the index */
+			FREE_NAMBUF();
+			if (res == FR_NO_FILE) res = FR_NO_PATH;
+		}
+	}
+
+	LEAVE_FF(fs, res);
+}
+
+#endif /* _USE_DIRINDEX */
+
+
+
 #if _USE_FORWARD
 /*-----------------------------------------------------------------------*/
 /* Forward data to the stream directly                                   */
@@ -5272,11 +7264,16 @@ FRESULT f_forward (
 		if (fp->sect != sect) {		/* Fill sector cache with file data */
 #if !_FS_READONLY
 			if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
+				DISCARD_SECT(fs, fp->sect, 1);
 				if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
 				fp->flag &= (BYTE)~FA_DIRTY;
 			}
 #endif
+#if _FS_RDAHEAD
+			if (ra_load(fp, sect) != FR_OK) ABORT(fs, FR_DISK_ERR);
+#else
 			if (disk_read(fs->drv, fp->buf, sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+#endif
 		}
 		dbuf = fp->buf;
 #endif
@@ -5293,17 +7290,174 @@ FRESULT f_forward (
 
 
 
+#if _USE_STREAM
+/*-----------------------------------------------------------------------*/
+/* Stream data to the consumer by reference                              */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_stream (
+	FIL* fp, 						/* Pointer to the file object */
+	UINT (*func)(const BYTE*,UINT),	/* Pointer to the streaming function */
+	UINT btf,						/* Number of bytes to stream */
+	UINT* bf						/* Pointer to number of bytes streamed */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DWORD clst, sect;
+	FSIZE_t remain;
+	UINT rcnt, csect, ofs;
+
+
+	*bf = 0;	/* Clear transfer byte counter */
+	res = validate(&fp->obj, &fs);		/* Check validity of the file object */
+	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);
+	if (!(fp->flag & FA_READ)) LEAVE_FF(fs, FR_DENIED);	/* Check access mode */
+#if !_FS_READONLY
+	if (fp->flag & FA_DIRTY) {			/* Write-back dirty sector cache so that the disk has the latest data */
+		DISCARD_SECT(fs, fp->sect, 1);
+		if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+		fp->flag &= (BYTE)~FA_DIRTY;
+	}
+#endif
+
+	remain = fp->obj.objsize - fp->fptr;
+	if (btf > remain) btf = (UINT)remain;			/* Truncate btf by remaining bytes */
+
+	for ( ;  btf && (*func)(0, 0);					/* Repeat until all data transferred or stream goes busy */
+		fp->fptr += rcnt, *bf += rcnt, btf -= rcnt) {
+		csect = (UINT)(fp->fptr / SS(fs) & (fs->csize - 1));	/* Sector offset in the cluster */
+		clst = fp->clust;
+		if (fp->fptr % SS(fs) == 0 && csect == 0) {	/* On the cluster boundary? */
+			if (fp->fptr == 0) {					/* On the top of the file? */
+				clst = fp->obj.sclust;
+			} else {
+#if _USE_FASTSEEK
+				if (fp->cltbl) {
+					clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
+				} else
+#endif
+				{
+					clst = get_fat(&fp->obj, fp->clust);
+				}
+			}
+			if (clst <= 1) ABORT(fs, FR_INT_ERR);
+			if (clst == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
+		}
+		sect = clust2sect(fs, clst);				/* Get current data sector */
+		if (!sect) ABORT(fs, FR_INT_ERR);
+		sect += csect;
+		if (sect - fs->rasect >= fs->ranum) {		/* Not in the pool? */
+			if (fs->rahold) break;					/* Pool is still referred by the consumer, try again after f_release() */
+			fp->clust = clst;						/* Update current cluster */
+			if (ra_fill(fp, sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Refill the pool in a burst */
+		}
+		ofs = (UINT)(sect - fs->rasect) * SS(fs) + (UINT)fp->fptr % SS(fs);	/* Offset of the data in the pool */
+		rcnt = (fs->csize - csect) * SS(fs) - (UINT)fp->fptr % SS(fs);	/* Number of bytes left in the cluster */
+		for ( ; rcnt < btf && ofs + rcnt < fs->ranum * SS(fs); clst++) {	/* Stretch over the following clusters in the pool if contiguous */
+			if (get_fat(&fp->obj, clst) != clst + 1) break;
+			rcnt += fs->csize * SS(fs);
+		}
+		if (ofs + rcnt > fs->ranum * SS(fs)) rcnt = fs->ranum * SS(fs) - ofs;	/* Clip it at end of the pool */
+		if (rcnt > btf) rcnt = btf;					/* Clip it by btf if needed */
+		rcnt = (*func)((const BYTE*)fs->rabuf + ofs, rcnt);	/* Pass the reference to the pooled data */
+		if (!rcnt) ABORT(fs, FR_INT_ERR);
+		fs->rahold++;								/* The consumer holds the pool until f_release() */
+		fp->clust = (fs->rasect + (ofs + rcnt - 1) / SS(fs) - fs->database) / fs->csize + 2;	/* Cluster of the last byte passed */
+	}
+
+	if (fp->fptr % SS(fs)) {						/* Stopped in middle of a sector? */
+		sect = clust2sect(fs, fp->clust) + (UINT)(fp->fptr / SS(fs) & (fs->csize - 1));
+		if (fp->sect != sect) fp->sect = 0;			/* Invalidate sector cache, the following read/write loads it (ra_resume) */
+	}
+
+	LEAVE_FF(fs, FR_OK);
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Release a reference passed by f_stream()                              */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_release (
+	FATFS* fs		/* File system object the data was streamed from */
+)
+{
+	if (!fs || !fs->fs_type || !fs->rahold) return FR_INVALID_OBJECT;
+#if _FS_REENTRANT
+	if (!lock_fs(fs)) return FR_TIMEOUT;
+#endif
+	fs->rahold--;
+
+	LEAVE_FF(fs, FR_OK);
+}
+#endif /* _USE_STREAM */
+
+
+
 #if _USE_MKFS && !_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* Create an FAT/exFAT volume                                            */
 /*-----------------------------------------------------------------------*/
 
-FRESULT f_mkfs (
-	const TCHAR* path,	/* Logical drive number */
+static
+FRESULT mkfs_clear (	/* FR_OK:succeeded, FR_DISK_ERR:disk error */
+	BYTE pdrv,			/* Physical drive number */
+	const BYTE* buf,	/* Working buffer filled with zero */
+	DWORD sz_buf,		/* Size of working buffer [sector] */
+	DWORD sect,			/* Start sector to be cleared */
+	DWORD nsect,		/* Number of sectors to be cleared */
+	BYTE opt			/* Format option (FM_FAST:Let the device zero-fill the sectors if possible) */
+)
+{
+	DWORD n, tbl[2];
+
+
+	if (!nsect) return FR_OK;
+	if (opt & FM_FAST) {	/* Fast format: try to zero-fill the block by the device (e.g. erase) */
+		tbl[0] = sect; tbl[1] = sect + nsect - 1;
+		if (disk_ioctl(pdrv, CTRL_ZERO, tbl) == RES_OK) return FR_OK;
+	}
+	do {	/* Write the zero-filled buffer in multi-sector writes */
+		n = (nsect > sz_buf) ? sz_buf : nsect;
+		if (disk_write(pdrv, buf, sect, (UINT)n) != RES_OK) return FR_DISK_ERR;
+		sect += n; nsect -= n;
+	} while (nsect);
+
+	return FR_OK;
+}
+
+
+static
+FRESULT mkfs_plan (		/* FR_OK:succeeded, FR_DISK_ERR:disk error */
+	FMKFS* job,			/* Incremental format job */
+	BYTE* buf,			/* Working buffer */
+	DWORD b_vol,		/* Volume start sector */
+	DWORD sect,			/* Start sector of the system area to be cleared */
+	DWORD nsect,		/* Number of sectors of the system area */
+	WORD ss				/* Sector size */
+)
+{
+	mem_set(buf, 0, ss);	/* Invalidate the current VBR until the format is completed */
+	if (disk_write(LD2PD(job->vol), buf, b_vol, 1) != RES_OK) return FR_DISK_ERR;
+	job->sect = sect; job->nsect = nsect;	/* Area to be cleared by f_mkfs_step() */
+	job->ss = ss;
+	job->stat = 1;
+
+	return FR_OK;
+}
+
+
+static
+FRESULT mkfs_vol (
+	int vol,			/* Logical drive number */
 	BYTE opt,			/* Format option */
 	DWORD au,			/* Size of allocation unit (cluster) [byte] */
 	void* work,			/* Pointer to working buffer */
-	UINT len			/* Size of working buffer */
+	UINT len,			/* Size of working buffer */
+	FMKFS* job			/* Incremental format job (NULL:format at once, stat 0:plan, stat 1:system area has been cleared) */
 )
 {
 	const UINT n_fats = 1;		/* Number of FATs for FAT12/16/32 volume (1 or 2) */
@@ -5316,7 +7470,6 @@ FRESULT f_mkfs (
 	DWORD b_vol, b_fat, b_data;				/* Base LBA for volume, fat, data */
 	DWORD sz_vol, sz_rsv, sz_fat, sz_dir;	/* Size for volume, fat, dir, data */
 	UINT i;
-	int vol;
 	DSTATUS stat;
 #if _USE_TRIM || _FS_EXFAT
 	DWORD tbl[3];
@@ -5324,8 +7477,6 @@ FRESULT f_mkfs (
 
 
 	/* Check mounted drive and clear work area */
-	vol = get_ldnumber(&path);					/* Get target logical drive */
-	if (vol < 0) return FR_INVALID_DRIVE;
 	if (FatFs[vol]) FatFs[vol]->fs_type = 0;	/* Clear the volume */
 	pdrv = LD2PD(vol);	/* Physical drive */
 	part = LD2PT(vol);	/* Partition (0:create as new, 1-4:get from partition table) */
@@ -5394,8 +7545,10 @@ FRESULT f_mkfs (
 
 		if (sz_vol < 0x1000) return FR_MKFS_ABORTED;	/* Too small volume? */
 #if _USE_TRIM
-		tbl[0] = b_vol; tbl[1] = b_vol + sz_vol - 1;	/* Inform the device the volume area may be erased */
-		disk_ioctl(pdrv, CTRL_TRIM, tbl);
+		if (!job || !job->stat) {	/* Not on the cleared volume */
+			tbl[0] = b_vol; tbl[1] = b_vol + sz_vol - 1;	/* Inform the device the volume area may be erased */
+			disk_ioctl(pdrv, CTRL_TRIM, tbl);
+		}
 #endif
 		/* Determine FAT location, data location and number of clusters */
 		if (!au) {	/* au auto-selection */
@@ -5410,6 +7563,7 @@ FRESULT f_mkfs (
 		n_clst = (sz_vol - (b_data - b_vol)) / au;				/* Number of clusters */
 		if (n_clst <16) return FR_MKFS_ABORTED;					/* Too few clusters? */
 		if (n_clst > MAX_EXFAT) return FR_MKFS_ABORTED;			/* Too many clusters? */
+		if (job && !job->stat) return mkfs_plan(job, buf, b_vol, b_fat, sz_fat, ss);	/* Incremental format: the FAT is to be cleared */
 
 		szb_bit = (n_clst + 7) / 8;						/* Size of allocation bitmap */
 		tbl[0] = (szb_bit + au * ss - 1) / (au * ss);	/* Number of allocation bitmap clusters */
@@ -5483,7 +7637,11 @@ FRESULT f_mkfs (
 			n = (nsect > sz_buf) ? sz_buf : nsect;	/* Write the buffered data */
 			if (disk_write(pdrv, buf, sect, n) != RES_OK) return FR_DISK_ERR;
 			sect += n; nsect -= n;
-		} while (nsect);
+		} while (nsect && nb);
+		if (!job) {		/* Clear rest of the FAT */
+			mem_set(buf, 0, szb_buf);
+			if (mkfs_clear(pdrv, buf, sz_buf, sect, nsect, opt) != FR_OK) return FR_DISK_ERR;
+		}
 
 		/* Initialize the root directory */
 		mem_set(buf, 0, szb_buf);
@@ -5560,6 +7718,9 @@ FRESULT f_mkfs (
 				n_clst = sz_vol / pau;	/* Number of clusters */
 				sz_fat = (n_clst * 4 + 8 + ss - 1) / ss;	/* FAT size [sector] */
 				sz_rsv = 32;	/* Number of reserved sectors */
+#if _FS_JOURNAL
+				if (sz_rsv < _FS_JOURNAL + 12) sz_rsv = _FS_JOURNAL + 12;	/* Reserve the journal area at end of the reserved area */
+#endif
 				sz_dir = 0;		/* No static directory */
 				if (n_clst <= MAX_FAT16 || n_clst > MAX_FAT32) return FR_MKFS_ABORTED;
 			} else {				/* FAT12/16 volume */
@@ -5621,9 +7782,21 @@ FRESULT f_mkfs (
 		} while (1);
 
 #if _USE_TRIM
-		tbl[0] = b_vol; tbl[1] = b_vol + sz_vol - 1;	/* Inform the device the volume area can be erased */
-		disk_ioctl(pdrv, CTRL_TRIM, tbl);
+		if (!job || !job->stat) {	/* Not on the cleared volume */
+			tbl[0] = b_vol; tbl[1] = b_vol + sz_vol - 1;	/* Inform the device the volume area can be erased */
+			disk_ioctl(pdrv, CTRL_TRIM, tbl);
+		}
+#endif
+		if (job && !job->stat) {	/* Incremental format: FATs and root directory are to be cleared */
+			sect = b_fat; nsect = sz_fat * n_fats + ((fmt == FS_FAT32) ? pau : sz_dir);
+#if _FS_JOURNAL
+			if (fmt == FS_FAT32) {	/* and the journal area in front of the FAT */
+				sect -= _FS_JOURNAL; nsect += _FS_JOURNAL;
+			}
 #endif
+			return mkfs_plan(job, buf, b_vol, sect, nsect, ss);
+		}
+
 		/* Create FAT VBR */
 		mem_set(buf, 0, ss);
 		mem_cpy(buf + BS_JmpBoot, "\xEB\xFE\x90" "MSDOS5.0", 11);/* Boot jump code (x86), OEM name */
@@ -5671,6 +7844,13 @@ FRESULT f_mkfs (
 			st_word(buf + BS_55AA, 0xAA55);
 			disk_write(pdrv, buf, b_vol + 7, 1);		/* Write backup FSINFO (VBR + 7) */
 			disk_write(pdrv, buf, b_vol + 1, 1);		/* Write original FSINFO (VBR + 1) */
+#if _FS_JOURNAL
+			mem_set(buf, 0, (UINT)szb_buf);
+			if (!job && mkfs_clear(pdrv, buf, sz_buf, b_fat - _FS_JOURNAL + 1, _FS_JOURNAL - 1, opt) != FR_OK) return FR_DISK_ERR;	/* Clear the records */
+			st_dword(buf + JNL_Sig, 0x4C4E4A46);		/* Create an empty journal (generation 0) */
+			st_dword(buf + JNL_Seq, 0xFFFFFFFF);
+			if (disk_write(pdrv, buf, b_fat - _FS_JOURNAL, 1) != RES_OK) return FR_DISK_ERR;	/* Write the journal superblock */
+#endif
 		}
 
 		/* Initialize FAT area */
@@ -5684,22 +7864,15 @@ FRESULT f_mkfs (
 			} else {
 				st_dword(buf + 0, (fmt == FS_FAT12) ? 0xFFFFF8 : 0xFFFFFFF8);	/* Entry 0 and 1 */
 			}
-			nsect = sz_fat;		/* Number of FAT sectors */
-			do {	/* Fill FAT sectors */
-				n = (nsect > sz_buf) ? sz_buf : nsect;
-				if (disk_write(pdrv, buf, sect, (UINT)n) != RES_OK) return FR_DISK_ERR;
-				mem_set(buf, 0, ss);
-				sect += n; nsect -= n;
-			} while (nsect);
+			if (disk_write(pdrv, buf, sect, 1) != RES_OK) return FR_DISK_ERR;	/* Write the first FAT sector */
+			mem_set(buf, 0, ss);
+			if (!job && mkfs_clear(pdrv, buf, sz_buf, sect + 1, sz_fat - 1, opt) != FR_OK) return FR_DISK_ERR;	/* Fill rest of the FAT sectors */
+			sect += sz_fat;
 		}
 
 		/* Initialize root directory (fill with zero) */
 		nsect = (fmt == FS_FAT32) ? pau : sz_dir;	/* Number of root directory sectors */
-		do {
-			n = (nsect > sz_buf) ? sz_buf : nsect;
-			if (disk_write(pdrv, buf, sect, (UINT)n) != RES_OK) return FR_DISK_ERR;
-			sect += n; nsect -= n;
-		} while (nsect);
+		if (!job && mkfs_clear(pdrv, buf, sz_buf, sect, nsect, opt) != FR_OK) return FR_DISK_ERR;
 	}
 
 	/* Determine system ID in the partition table */
@@ -5749,6 +7922,84 @@ FRESULT f_mkfs (
 }
 
 
+FRESULT f_mkfs (
+	const TCHAR* path,	/* Logical drive number */
+	BYTE opt,			/* Format option */
+	DWORD au,			/* Size of allocation unit (cluster) [byte] */
+	void* work,			/* Pointer to working buffer */
+	UINT len			/* Size of working buffer */
+)
+{
+	int vol;
+
+
+	vol = get_ldnumber(&path);					/* Get target logical drive */
+	if (vol < 0) return FR_INVALID_DRIVE;
+
+	return mkfs_vol(vol, opt, au, work, len, 0);
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Create an FAT/exFAT volume in steps                                   */
+/*-----------------------------------------------------------------------*/
+/* f_mkfs_start() determines the layout and invalidates the volume, then
+/  each f_mkfs_step() clears a part of the system area (FAT and root
+/  directory). The volume is created by the step that clears the last
+/  sector. The working buffer and the job must be kept until then. */
+
+FRESULT f_mkfs_start (
+	FMKFS* job,			/* Pointer to the format job to be created */
+	const TCHAR* path,	/* Logical drive number */
+	BYTE opt,			/* Format option */
+	DWORD au,			/* Size of allocation unit (cluster) [byte] */
+	void* work,			/* Pointer to working buffer */
+	UINT len			/* Size of working buffer */
+)
+{
+	int vol;
+
+
+	if (!job) return FR_INVALID_PARAMETER;
+	vol = get_ldnumber(&path);					/* Get target logical drive */
+	if (vol < 0) return FR_INVALID_DRIVE;
+
+	job->vol = (BYTE)vol; job->opt = opt; job->au = au;
+	job->work = work; job->len = len;
+	job->stat = 0;
+	return mkfs_vol(vol, opt, au, work, len, job);	/* Plan the format */
+}
+
+
+FRESULT f_mkfs_step (
+	FMKFS* job,			/* Pointer to the format job */
+	DWORD nsect			/* Number of sectors to be cleared in this step */
+)
+{
+	FRESULT res;
+	DWORD sz_buf;
+
+
+	if (!job || job->stat != 1) return FR_INVALID_PARAMETER;	/* Not in progress? */
+
+	if (job->nsect) {
+		if (nsect > job->nsect) nsect = job->nsect;
+		sz_buf = job->len / job->ss;
+		mem_set(job->work, 0, sz_buf * job->ss);
+		res = mkfs_clear(LD2PD(job->vol), (BYTE*)job->work, sz_buf, job->sect, nsect, job->opt);
+		if (res != FR_OK) return res;
+		job->sect += nsect; job->nsect -= nsect;
+		if (job->nsect) return FR_OK;	/* Not finished yet */
+	}
+	res = mkfs_vol(job->vol, job->opt, job->au, job->work, job->len, job);	/* Create the volume on the cleared area */
+	if (res == FR_OK) job->stat = 2;
+
+	return res;
+}
+
+
 
 #if _MULTI_PARTITION
 /*-----------------------------------------------------------------------*/
@@ -102,6 +102,9 @@ typedef struct {
 #endif
 #if _FS_REENTRANT
 	_SYNC_t	sobj;			/* Identifier of sync object */
+#if _FS_REENTRANT == 2
+	volatile BYTE	iobusy[_FS_LOCK];	/* Transfers in progress without the volume lock (slot flags) */
+#endif
 #endif
 #if !_FS_READONLY
 	DWORD	last_clst;		/* Last allocated cluster */
@@ -123,6 +126,38 @@ typedef struct {
 	DWORD	database;		/* Data base sector */
 	DWORD	winsect;		/* Current sector appearing in the win[] */
 	BYTE	win[_MAX_SS];	/* Disk access window for Directory, FAT (and file data at tiny cfg) */
+#if _FS_RDAHEAD
+	DWORD	rasect;			/* Top sector of the read-ahead data in rabuf[] */
+	UINT	ranum;			/* Number of valid sectors in rabuf[] (0:empty) */
+	DWORD	rabuf[_FS_RDAHEAD * _MAX_SS / 4];	/* Read-ahead pool (word aligned for DMA) */
+#if _USE_STREAM
+	UINT	rahold;			/* Number of references to rabuf[] held by f_stream() consumers */
+#endif
+#endif
+#if _FS_WBCACHE
+	DWORD	wctag[_FS_WBCACHE];	/* Sector number held in each cache line (0xFFFFFFFF:empty) */
+	DWORD	wcage[_FS_WBCACHE];	/* Last access time of each cache line (for LRU) */
+	DWORD	wctime;			/* Access counter of the cache */
+	BYTE	wcdirty[(_FS_WBCACHE + 7) / 8];	/* Dirty flags of the cache lines (bitmap) */
+	DWORD	wcbuf[_FS_WBCACHE * _MAX_SS / 4];	/* Cache lines in [way][set] order (word aligned for DMA) */
+#if _FS_JOURNAL
+	BYTE	wcjnl[(_FS_WBCACHE + 7) / 8];	/* Journaled flags of the cache lines (bitmap, home sector not updated yet) */
+	DWORD	jbase;			/* Journal base sector (0:journal not used on the volume) */
+	DWORD	jgen;			/* Generation of the journal */
+	DWORD	jseq;			/* Sequence number of the next record */
+	UINT	jptr;			/* Offset of the next record in the journal */
+	DWORD	jbuf[(_FS_WBCACHE + 1) * _MAX_SS / 4];	/* Journal record, header and lines (word aligned for DMA) */
+#endif
+#endif
+#if _FS_FREEMAP
+	DWORD*	fmap;			/* Free cluster map (bit set:in use, NULL:not built) */
+#endif
+#if _USE_DIRINDEX
+	void*	dixtbl;			/* Directory index table (NULL:no index) */
+	UINT	dixsize;		/* Number of slots in the index table */
+	UINT	dixused;		/* Number of used slots in the index table (including deleted ones) */
+	DWORD	dixclst;		/* Start cluster of the indexed directory (0:root) */
+#endif
 } FATFS;
 
 
@@ -165,6 +200,12 @@ typedef struct {
 #endif
 #if _USE_FASTSEEK
 	DWORD*	cltbl;			/* Pointer to the cluster link map table (nulled on open, set by application) */
+#if _USE_FASTSEEK == 2
+	DWORD	cltlen;			/* Size of the link map table allocated by FA_LINKMAP [items] (0:not allocated) */
+#endif
+#endif
+#if _FS_CONTIG
+	WORD	ckpt;			/* Number of f_sync() calls since the last directory update in contiguous stream mode (0:update needed) */
 #endif
 #if !_FS_TINY
 	BYTE	buf[_MAX_SS];	/* File private data read/write window */
@@ -209,6 +250,76 @@ typedef struct {
 
 
 
+/* Directory snapshot entry (SNAPENT) */
+
+typedef struct {
+	FSIZE_t	fsize;			/* File size */
+	DWORD	sclust;			/* Start cluster (0:no data) */
+	DWORD	dptr;			/* Offset of the entry in the directory (exFAT: top of the entry block) */
+	WORD	fdate;			/* Modified date */
+	WORD	ftime;			/* Modified time */
+	WORD	nsum;			/* Sum of the SFN or exFAT name hash to detect a replaced entry */
+	BYTE	fattrib;		/* File attribute */
+	TCHAR*	fname;			/* Pointer to the file name in the name pool */
+} SNAPENT;
+
+
+
+/* Directory snapshot (DIRSNAP) */
+
+typedef struct {
+	_FDID	obj;			/* Directory of the snapshot (valid while the volume is kept mounted) */
+	const TCHAR* pat;		/* Pointer to the name matching pattern (null:all items) */
+	BYTE	opt;			/* Sort order */
+	void*	work;			/* Pointer to the work area */
+	UINT	len;			/* Size of the work area [byte] */
+	SNAPENT* ent;			/* Entry table in the work area (ent[0]..ent[count-1]) */
+	UINT	count;			/* Number of entries in the snapshot */
+	DWORD	next;			/* Directory offset of the next page (0:no more item) */
+} DIRSNAP;
+
+
+
+/* Buffer segment for vectored I/O (FIOV) */
+
+typedef struct {
+	void*	buf;			/* Pointer to the data buffer */
+	UINT	len;			/* Number of bytes in the buffer */
+} FIOV;
+
+
+
+/* Incremental format job (FMKFS) */
+
+typedef struct {
+	BYTE	vol;			/* Logical drive number */
+	BYTE	opt;			/* Format option */
+	BYTE	stat;			/* Job status (0:planning, 1:clearing the system area, 2:completed) */
+	WORD	ss;				/* Sector size */
+	DWORD	au;				/* Size of allocation unit [byte] */
+	void*	work;			/* Pointer to the working buffer */
+	UINT	len;			/* Size of the working buffer */
+	DWORD	sect;			/* Next sector to be cleared */
+	DWORD	nsect;			/* Number of sectors left to be cleared */
+} FMKFS;
+
+
+
+/* File copy statistics (FCOPY) */
+
+typedef struct {
+	FSIZE_t	nbyte;			/* Number of bytes copied */
+	DWORD	nchunk;			/* Number of chunks transferred */
+	DWORD	time;			/* Elapsed time [ms] */
+	DWORD	rtime;			/* Time spent in reading the source [ms] */
+	DWORD	wtime;			/* Time spent in writing the destination [ms] */
+	DWORD	rwait;			/* Time the reader waited for a free buffer [ms] */
+	DWORD	wwait;			/* Time the writer waited for the data [ms] */
+	DWORD	rate;			/* Throughput [byte/s] */
+} FCOPY;
+
+
+
 /* File function return code (FRESULT) */
 
 typedef enum {
@@ -236,6 +347,21 @@ typedef enum {
 
 
 
+/* Asynchronous read request (FREQ) */
+
+typedef struct {
+	void*	buff;			/* Pointer to the data buffer, kept until the completion (in) */
+	UINT	btr;			/* Number of bytes to read (in) */
+	UINT	br;				/* Number of bytes read or submitted (out) */
+	void	(*func)(FRESULT res, void* arg);	/* Completion callback (in) */
+	void*	arg;			/* Argument passed to the completion callback (in) */
+	volatile BYTE	busy;	/* f_read_async() is running on the request */
+	volatile BYTE	done;	/* The request completed while busy */
+	volatile FRESULT	res;	/* Result of the request completed while busy */
+} FREQ;
+
+
+
 /*--------------------------------------------------------------*/
 /* FatFs module application interface                           */
 
@@ -243,6 +369,9 @@ FRESULT f_open (FIL* fp, const TCHAR* path, BYTE mode);				/* Open or create a f
 FRESULT f_close (FIL* fp);											/* Close an open file object */
 FRESULT f_read (FIL* fp, void* buff, UINT btr, UINT* br);			/* Read data from the file */
 FRESULT f_write (FIL* fp, const void* buff, UINT btw, UINT* bw);	/* Write data to the file */
+FRESULT f_readv (FIL* fp, const FIOV* iov, UINT iovcnt, UINT* br);	/* Read data from the file into scattered buffers */
+FRESULT f_writev (FIL* fp, const FIOV* iov, UINT iovcnt, UINT* bw);	/* Write data to the file from gathered buffers */
+FRESULT f_read_async (FIL* fp, FREQ* rq);							/* Submit an asynchronous read of the file */
 FRESULT f_lseek (FIL* fp, FSIZE_t ofs);								/* Move file pointer of the file object */
 FRESULT f_truncate (FIL* fp);										/* Truncate the file */
 FRESULT f_sync (FIL* fp);											/* Flush cached data of the writing file */
@@ -251,6 +380,9 @@ FRESULT f_closedir (DIR* dp);										/* Close an open directory */
 FRESULT f_readdir (DIR* dp, FILINFO* fno);							/* Read a directory item */
 FRESULT f_findfirst (DIR* dp, FILINFO* fno, const TCHAR* path, const TCHAR* pattern);	/* Find first file */
 FRESULT f_findnext (DIR* dp, FILINFO* fno);							/* Find next file */
+FRESULT f_snapdir (DIRSNAP* sp, const TCHAR* path, const TCHAR* pattern, BYTE opt, void* work, UINT len);	/* Take a sorted snapshot of the directory */
+FRESULT f_snapnext (DIRSNAP* sp);									/* Take next page of the directory snapshot */
+FRESULT f_snapopen (FIL* fp, const DIRSNAP* sp, UINT idx, BYTE mode);	/* Open a file in the directory snapshot */
 FRESULT f_mkdir (const TCHAR* path);								/* Create a sub directory */
 FRESULT f_unlink (const TCHAR* path);								/* Delete an existing file or directory */
 FRESULT f_rename (const TCHAR* path_old, const TCHAR* path_new);	/* Rename/Move a file or directory */
@@ -264,9 +396,15 @@ FRESULT f_getfree (const TCHAR* path, DWORD* nclst, FATFS** fatfs);	/* Get numbe
 FRESULT f_getlabel (const TCHAR* path, TCHAR* label, DWORD* vsn);	/* Get volume label */
 FRESULT f_setlabel (const TCHAR* label);							/* Set volume label */
 FRESULT f_forward (FIL* fp, UINT(*func)(const BYTE*,UINT), UINT btf, UINT* bf);	/* Forward data to the stream */
+FRESULT f_stream (FIL* fp, UINT(*func)(const BYTE*,UINT), UINT btf, UINT* bf);	/* Pass references to the file data to the stream */
+FRESULT f_release (FATFS* fs);										/* Release a reference passed by f_stream */
 FRESULT f_expand (FIL* fp, FSIZE_t szf, BYTE opt);					/* Allocate a contiguous block to the file */
+FRESULT f_copy (const TCHAR* src, const TCHAR* dst, UINT chunk, FCOPY* st);	/* Copy a file with overlapped read and write */
+FRESULT f_dirindex (const TCHAR* path, void* work, UINT len);		/* Build a hash index of the directory */
 FRESULT f_mount (FATFS* fs, const TCHAR* path, BYTE opt);			/* Mount/Unmount a logical drive */
 FRESULT f_mkfs (const TCHAR* path, BYTE opt, DWORD au, void* work, UINT len);	/* Create a FAT volume */
+FRESULT f_mkfs_start (FMKFS* job, const TCHAR* path, BYTE opt, DWORD au, void* work, UINT len);	/* Start to create a FAT volume in steps */
+FRESULT f_mkfs_step (FMKFS* job, DWORD nsect);						/* Clear a part of the system area, create the volume at last */
 FRESULT f_fdisk (BYTE pdrv, const DWORD* szt, void* work);			/* Divide a physical drive into some partitions */
 int f_putc (TCHAR c, FIL* fp);										/* Put a character to the file */
 int f_puts (const TCHAR* str, FIL* cp);								/* Put a string to the file */
@@ -300,11 +438,13 @@ DWORD get_fattime (void);
 #if _USE_LFN != 0						/* Unicode - OEM code conversion */
 WCHAR ff_convert (WCHAR chr, UINT dir);	/* OEM-Unicode bidirectional conversion */
 WCHAR ff_wtoupper (WCHAR chr);			/* Unicode upper-case conversion */
-#if _USE_LFN == 3						/* Memory functions */
+#endif
+
+/* Memory functions */
+#if _USE_LFN == 3 || _FS_FREEMAP || _USE_FASTSEEK == 2 || _USE_COPY
 void* ff_memalloc (UINT msize);			/* Allocate memory block */
 void ff_memfree (void* mblock);			/* Free memory block */
 #endif
-#endif
 
 /* Sync functions */
 #if _FS_REENTRANT
@@ -329,6 +469,15 @@ int ff_del_syncobj (_SYNC_t sobj);				/* Delete a sync object */
 #define	FA_CREATE_ALWAYS	0x08
 #define	FA_OPEN_ALWAYS		0x10
 #define	FA_OPEN_APPEND		0x30
+#define	FA_LINKMAP			0x40
+
+/* Sort orders (4th argument of f_snapdir) */
+#define DS_NONE		0x00
+#define DS_NAME		0x01
+#define DS_SIZE		0x02
+#define DS_TIME		0x03
+#define DS_DIRFIRST	0x10
+#define DS_DESC		0x20
 
 /* Fast seek controls (2nd argument of f_lseek) */
 #define CREATE_LINKMAP	((FSIZE_t)0 - 1)
@@ -339,6 +488,7 @@ int ff_del_syncobj (_SYNC_t sobj);				/* Delete a sync object */
 #define FM_EXFAT	0x04
 #define FM_ANY		0x07
 #define FM_SFD		0x08
+#define FM_FAST		0x10
 
 /* Filesystem type (FATFS.fs_type) */
 #define FS_FAT12	1
@@ -43,6 +43,12 @@ uint8_t FATFS_LinkDriverEx(const Diskio_drvTypeDef *drv, char *path, uint8_t lun
 
   if(disk.nbr < _VOLUMES)
   {
+#if _FS_REENTRANT == 2
+    if(!ff_cre_syncobj(disk.nbr, &disk.sobj[disk.nbr]))
+    {
+      return ret;
+    }
+#endif /* _FS_REENTRANT == 2 */
     disk.is_initialized[disk.nbr] = 0;
     disk.drv[disk.nbr] = drv;
     disk.lun[disk.nbr] = lun;
@@ -87,6 +93,9 @@ uint8_t FATFS_UnLinkDriverEx(char *path, uint8_t lun)
     DiskNum = path[0] - '0';
     if(disk.drv[DiskNum] != 0)
     {
+#if _FS_REENTRANT == 2
+      ff_del_syncobj(disk.sobj[DiskNum]);
+#endif /* _FS_REENTRANT == 2 */
       disk.drv[DiskNum] = 0;
       disk.lun[DiskNum] = 0;
       disk.nbr--;
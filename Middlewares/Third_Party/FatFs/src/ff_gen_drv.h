@@ -46,6 +46,9 @@ typedef struct
 #if _USE_IOCTL == 1
   DRESULT (*disk_ioctl)      (BYTE, BYTE, void*);              /*!< I/O control operation when _USE_IOCTL = 1 */
 #endif /* _USE_IOCTL == 1 */
+#if _USE_ASYNC == 1
+  DRESULT (*disk_read_async) (BYTE, BYTE*, DWORD, UINT, DISKIO_CB, void*); /*!< Submit Read Sector(s) when _USE_ASYNC = 1 (0: not supported) */
+#endif /* _USE_ASYNC == 1 */
 
 }Diskio_drvTypeDef;
 
@@ -58,6 +61,9 @@ typedef struct
   const Diskio_drvTypeDef *drv[_VOLUMES];
   uint8_t                 lun[_VOLUMES];
   volatile uint8_t        nbr;
+#if _FS_REENTRANT == 2
+  _SYNC_t                 sobj[_VOLUMES];   /*!< Serializes the driver access when the volume lock is released for data transfer */
+#endif /* _FS_REENTRANT == 2 */
 
 }Disk_drvTypeDef;
 
@@ -61,17 +61,54 @@
 
 
 #define	_USE_MKFS		1
-/* This option switches f_mkfs() function. (0:Disable or 1:Enable) */
+/* This option switches f_mkfs(), f_mkfs_start() and f_mkfs_step() functions.
+/  (0:Disable or 1:Enable) */
 
 
 #define	_USE_FASTSEEK	1
-/* This option switches fast seek function. (0:Disable or 1:Enable) */
+/* This option switches fast seek function. (0:Disable, 1:Enable or 2:Enable with
+/  automatic link map)
+/  When set to 2, f_open() with FA_LINKMAP flag creates the cluster link map table
+/  of the file in a memory block allocated with ff_memalloc() and enables fast seek
+/  mode. The table is extended on the file growth by f_write() and f_expand(),
+/  trimmed by f_truncate() and freed by f_close(). If the memory allocation failed,
+/  the file works in normal mode. Note that f_lseek() in fast seek mode does not
+/  expand the file. Also the memory functions in syscall.c need to be added to the
+/  project. */
 
 
 #define	_USE_EXPAND		0
 /* This option switches f_expand function. (0:Disable or 1:Enable) */
 
 
+#define	_USE_IOVEC		0
+/* This option switches vectored I/O functions, f_readv() and f_writev().
+/  (0:Disable or 1:Enable) They transfer an array of buffer segments in a call.
+/  Whole sectors in the middle of each segment are transferred to/from the disk
+/  directly with multiple sector transfer and only the partial sectors at the
+/  edges go through the sector buffer. f_writev() also needs _FS_READONLY == 0. */
+
+
+#define	_USE_DIRINDEX	0
+/* This option switches f_dirindex() function. (0:Disable or 1:Enable)
+/  f_dirindex() builds a hash index of a directory in a work area given by the
+/  application. Then lookups of the names in the directory (f_open, f_stat and etc..)
+/  go directly to the candidate entries instead of scanning the whole directory.
+/  The index is updated on creation and removal of the entries. This option is
+/  effective on FAT12/16/32 volumes. */
+
+
+#define	_USE_DIRSNAP	0
+/* This option switches directory snapshot functions, f_snapdir(), f_snapnext() and
+/  f_snapopen(). (0:Disable or 1:Enable)
+/  f_snapdir() reads a directory in one pass into a work area given by the
+/  application: name, size, timestamp, attribute, start cluster and entry offset of
+/  each item matching the pattern, optionally sorted. Then the items are accessed by
+/  index and f_snapopen() opens a file at the recorded entry without searching the
+/  directory. When the work area is full, f_snapnext() takes the next page. The
+/  snapshot needs to be taken again after the directory is modified. */
+
+
 #define _USE_CHMOD		0
 /* This option switches attribute manipulation functions, f_chmod() and f_utime().
 /  (0:Disable or 1:Enable) Also _FS_READONLY needs to be 0 to enable this option. */
@@ -86,6 +123,27 @@
 /* This option switches f_forward() function. (0:Disable or 1:Enable) */
 
 
+#define	_USE_STREAM		0
+/* This option switches f_stream() and f_release() functions. (0:Disable or 1:Enable)
+/  f_stream() works like f_forward() but passes the streaming function pointers
+/  into the read-ahead pool instead of copying the data, up to a run of contiguous
+/  clusters in a call. Each accepted block is held until the consumer calls
+/  f_release(), and the pool is not refilled while any block is held. This is for
+/  the consumers that send the data without copying it, such as lwIP httpd with
+/  LWIP_HTTPD_FATFS or USB endpoint DMA. _FS_RDAHEAD needs to be enabled to use
+/  this option. */
+
+
+#define	_USE_COPY		0
+/* This option switches f_copy() function. (0:Disable or 1:Enable)
+/  f_copy() copies a file through two transfer buffers of the given size. The
+/  source file is read by a worker task while the calling task writes the other
+/  buffer to the destination file, so that the transfers overlap when the files
+/  are on different volumes. The time spent in the transfers and waiting for the
+/  other side is returned with the throughput. The function is in option/fcopy.c,
+/  it needs CMSIS-OS and the memory functions in syscall.c. */
+
+
 /*---------------------------------------------------------------------------/
 / Locale and Namespace Configurations
 /---------------------------------------------------------------------------*/
@@ -137,6 +195,15 @@
 /  ff_memfree(), must be added to the project. */
 
 
+#define	_LFN_UPTABLE	0
+/* This option builds a flat up-case table of the characters below this value at
+/  the first f_mount() to speed up the LFN matching in the directory lookup.
+/  (0:Disable or 0x80..0x10000) The table occupies _LFN_UPTABLE * 2 bytes in RAM.
+/  0x100 covers ASCII and Latin-1, 0x250 all of the Latin scripts and 0x530 also
+/  Greek and Cyrillic. Characters of the CJK blocks are not converted. This option
+/  has no effect when _USE_LFN == 0. */
+
+
 #define	_LFN_UNICODE	0
 /* This option switches character encoding on the API. (0:ANSI/OEM or 1:UTF-16)
 /  To use Unicode string for the path name, enable LFN and set _LFN_UNICODE = 1.
@@ -230,6 +297,79 @@
 /  buffer in the file system object (FATFS) is used for the file data transfer. */
 
 
+#define	_FS_RDAHEAD	0
+/* This option sets the size of the read-ahead pool in unit of sector. (0:Disable)
+/  When enabled, each file system object (FATFS) holds a pool of _FS_RDAHEAD sectors.
+/  A partial sector read via f_read(), f_lseek() or f_forward() that misses the pool
+/  refills it with the rest of the current cluster and the following contiguous
+/  clusters of the file in a single multi-sector disk_read() call. It should be set
+/  to a multiple of the cluster size for the best efficiency. The pool is word
+/  aligned so that the disk driver can transfer it with DMA directly. This option
+/  is not available at the tiny buffer configuration (_FS_TINY = 1). */
+
+
+#define	_FS_WBCACHE			0
+#define	_FS_WBCACHE_WAYS	4
+/* The _FS_WBCACHE option sets the number of lines of the write-back sector cache
+/  placed between the sector window and the disk. (0:Disable)
+/  When enabled, FAT and directory sectors written back from the window are held in
+/  the cache and written to the disk at f_sync(), f_close() or when a dirty line is
+/  evicted. Then all dirty lines are sorted by sector number, and contiguous runs
+/  are written in a single multi-sector disk_write() call, including the mirrored
+/  FAT copies. The cache is _FS_WBCACHE_WAYS-way set associative with LRU
+/  replacement and _FS_WBCACHE must be a multiple of _FS_WBCACHE_WAYS. Each line
+/  takes _MAX_SS bytes in the file system object. Note that changes made after the
+/  last f_sync() are lost on a power failure. This option is not available at the
+/  tiny buffer configuration (_FS_TINY = 1) and read-only configuration. */
+
+
+#define	_FS_JOURNAL	0
+/* This option sets the size of the metadata journal in unit of sector. (0:Disable)
+/  When enabled, f_sync() and f_close() write the dirty lines of the write-back cache
+/  to the journal as a record in a single sequential write instead of writing each
+/  FAT and directory sector (and the mirrored FAT copies) to its home location. The
+/  journaled sectors are written to the home locations lazily, when the journal is
+/  full, a journaled line is evicted from the cache or the volume is unmounted.
+/  At mount time, the committed records are replayed to the volume, so that the
+/  file system is recovered to the state of the last f_sync() after a power failure
+/  as long as the changes between f_sync() calls fit in the write-back cache.
+/  The journal is placed at end of the reserved area of FAT32 volumes, and f_mkfs()
+/  reserves _FS_JOURNAL + 12 sectors at least and creates an empty journal there.
+/  The journal is used only on the volumes which have it. The reserved sectors of
+/  other volumes (e.g. boot code) are not touched, and the FAT12/16 and exFAT
+/  volumes do not have the journal. Note that other systems do not replay the
+/  journal, so that the volume needs to be unmounted cleanly before it is used by
+/  another system. The record is built in a buffer of _FS_WBCACHE + 1 sectors in
+/  the file system object. _FS_WBCACHE needs to be enabled and _FS_JOURNAL must be
+/  in range of _FS_WBCACHE + 2 to 1024. */
+
+
+#define	_FS_FREEMAP	0
+/* This option switches the free cluster map for FAT12/16/32 volumes. (0:Disable or 1:Enable)
+/  When enabled, a bitmap of the cluster allocation status is built in the memory at
+/  the first cluster allocation or f_getfree() call after the volume is mounted, and
+/  kept up to date on every FAT change. Then create_chain() and f_getfree() no longer
+/  scan the FAT. The bitmap takes (number of clusters / 8) bytes and it is allocated
+/  with ff_memalloc(), so that the memory functions in syscall.c need to be added to
+/  the project. If the allocation failed, the FAT is scanned as usual. An application
+/  can call f_getfree() after f_mount() to build the map at a convenient time. exFAT
+/  volumes use the allocation bitmap on the volume instead. This option is not
+/  available at read-only configuration. */
+
+
+#define	_FS_CONTIG	0
+/* This option switches the contiguous stream mode. (0:Disable or 1-65535:Enable)
+/  A file allocated by f_expand() with opt = 1 (and a contiguous file on the exFAT
+/  volume) is put in contiguous stream mode. Then f_read(), f_write() and f_lseek()
+/  calculate the cluster number arithmetically instead of following the chain on
+/  the FAT, as long as the file is not stretched beyond the allocated block.
+/  Since the directory entry of such a file changes only in the timestamp, f_sync()
+/  writes back the file data but updates the directory entry only at every
+/  _FS_CONTIG-th call. f_close() and f_truncate() always update it. This gives a
+/  deterministic write latency to the real-time recorders. This option is not
+/  available at read-only configuration. */
+
+
 #define _FS_EXFAT	0
 /* This option switches support of exFAT file system. (0:Disable or 1:Enable)
 /  When enable exFAT, also LFN needs to be enabled. (_USE_LFN >= 1)
@@ -298,6 +438,17 @@
 /      ff_req_grant(), ff_rel_grant(), ff_del_syncobj() and ff_cre_syncobj()
 /      function, must be added to the project. Samples are available in
 /      option/syscall.c.
+/   2: Enable re-entrancy with finer grain. The volume lock protects only the
+/      FAT, directory and sector window state. Multiple sector reads from the
+/      file into the user buffer by f_read() and f_readv() are done with the
+/      volume lock released, so that other tasks can work on the volume while
+/      the transfer is waiting for DMA. The generic disk I/O layer (diskio.c)
+/      serializes the driver access by a sync object per drive. File lock
+/      (_FS_LOCK > 0) is needed to protect the files being transferred, and it
+/      is not available at the tiny buffer configuration. f_mount() returns
+/      FR_LOCKED while such a transfer is in progress on the volume. When the
+/      volume lock cannot be taken back after a transfer, f_read() returns
+/      FR_TIMEOUT with the transferred data counted and the file is kept valid.
 /
 /  The _FS_TIMEOUT defines timeout period in unit of time tick.
 /  The _SYNC_t defines O/S dependent sync object type. e.g. HANDLE, ID, OS_EVENT*,
@@ -306,7 +457,7 @@
 
 /* #include <windows.h>	// O/S definitions  */
 
-#if _USE_LFN == 3
+#if _USE_LFN == 3 || _FS_FREEMAP || _USE_FASTSEEK == 2
 
 #if !defined(ff_malloc) || !defined(ff_free)
 #include <stdlib.h>
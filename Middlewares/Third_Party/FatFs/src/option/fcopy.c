@@ -0,0 +1,303 @@
+/*------------------------------------------------------------------------*/
+/* File copy with overlapped read and write for FatFs                     */
+/*   COPYRIGHT 2017 STMicroelectronics                                    */
+/*------------------------------------------------------------------------*/
+
+/**
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2017 STMicroelectronics. All rights reserved.
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                       opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+**/
+
+
+
+#include <string.h>
+#include "../ff.h"
+
+
+#if _USE_COPY
+
+#if _FS_READONLY
+#error _USE_COPY needs _FS_READONLY == 0
+#endif
+
+#include "cmsis_os.h"
+
+#define COPY_NBUF		2						/* Number of transfer buffers */
+#define COPY_STACK_SIZE	(4 * configMINIMAL_STACK_SIZE)	/* Stack size of the reader task [word] */
+#define COPY_PRIORITY	osPriorityNormal		/* Priority of the reader task */
+
+#if (osCMSIS < 0x20000U)
+typedef osMessageQId COPYQ;
+#else
+typedef osMessageQueueId_t COPYQ;
+#endif
+
+/* Copy job shared by the reader task and the writer (calling task) */
+typedef struct {
+	FIL		src;				/* Source file */
+	FIL		dst;				/* Destination file */
+	UINT	chunk;				/* Size of the transfer buffers */
+	BYTE*	buf[COPY_NBUF];		/* Transfer buffers */
+	UINT	len[COPY_NBUF];		/* Number of bytes in the buffers */
+	COPYQ	empty;				/* Buffers to be filled by the reader */
+	COPYQ	full;				/* Buffers to be written by the writer */
+	volatile BYTE abort;		/* The writer failed, the reader stops */
+	FRESULT	rres;				/* Result of the reader */
+	DWORD	rtime;				/* Time spent in f_read() [tick] */
+	DWORD	rwait;				/* Time waited for a free buffer [tick] */
+} COPYJOB;
+
+
+
+/*------------------------------------------------------------------------*/
+/* OS dependent helpers                                                   */
+/*------------------------------------------------------------------------*/
+
+static DWORD copy_tick (void)
+{
+#if (osCMSIS < 0x20000U)
+	return osKernelSysTick();
+#else
+	return osKernelGetTickCount();
+#endif
+}
+
+
+static DWORD copy_ms (	/* Returns the time in milliseconds */
+	DWORD tick			/* Time in kernel tick */
+)
+{
+#if (osCMSIS < 0x20000U)
+	return (DWORD)((uint64_t)tick * 1000 / osKernelSysTickFrequency);
+#else
+	return (DWORD)((uint64_t)tick * 1000 / osKernelGetTickFreq());
+#endif
+}
+
+
+static COPYQ copy_qcreate (void)
+{
+#if (osCMSIS < 0x20000U)
+	osMessageQDef(FCOPY_Queue, COPY_NBUF, uint32_t);
+	return osMessageCreate(osMessageQ(FCOPY_Queue), NULL);
+#else
+	return osMessageQueueNew(COPY_NBUF, sizeof (uint32_t), NULL);
+#endif
+}
+
+
+static void copy_qdelete (
+	COPYQ q
+)
+{
+	if (q) {
+#if (osCMSIS < 0x20000U)
+		osMessageDelete(q);
+#else
+		osMessageQueueDelete(q);
+#endif
+	}
+}
+
+
+static void copy_put (	/* Pass a buffer to the other side */
+	COPYQ q,
+	UINT idx
+)
+{
+#if (osCMSIS < 0x20000U)
+	osMessagePut(q, (uint32_t)idx, osWaitForever);
+#else
+	uint32_t v = (uint32_t)idx;
+
+	osMessageQueuePut(q, &v, 0, osWaitForever);
+#endif
+}
+
+
+static UINT copy_get (	/* Wait for a buffer from the other side */
+	COPYQ q
+)
+{
+#if (osCMSIS < 0x20000U)
+	osEvent ev = osMessageGet(q, osWaitForever);
+
+	return (UINT)ev.value.v;
+#else
+	uint32_t v = 0;
+
+	osMessageQueueGet(q, &v, NULL, osWaitForever);
+	return (UINT)v;
+#endif
+}
+
+
+
+/*------------------------------------------------------------------------*/
+/* Reader task                                                            */
+/*------------------------------------------------------------------------*/
+/* Fills the free buffers from the source file until the end of file, an
+/  error or an abort request of the writer. The last buffer passed to the
+/  writer has less than chunk bytes (0 bytes on error or abort).
+*/
+
+#if (osCMSIS < 0x20000U)
+static void copy_reader (void const* arg)
+#else
+static void copy_reader (void* arg)
+#endif
+{
+	COPYJOB *job = (COPYJOB*)arg;
+	UINT i, br, chunk = job->chunk;
+	DWORD t;
+
+
+	do {
+		t = copy_tick();
+		i = copy_get(job->empty);
+		job->rwait += copy_tick() - t;
+		br = 0;
+		if (!job->abort && job->rres == FR_OK) {
+			t = copy_tick();
+			job->rres = f_read(&job->src, job->buf[i], chunk, &br);
+			job->rtime += copy_tick() - t;
+		}
+		job->len[i] = br;
+		copy_put(job->full, i);		/* The job must not be touched after the last one */
+	} while (br == chunk);
+
+#if (osCMSIS < 0x20000U)
+	osThreadTerminate(osThreadGetId());
+#else
+	osThreadExit();
+#endif
+}
+
+
+
+/*------------------------------------------------------------------------*/
+/* Copy a File                                                            */
+/*------------------------------------------------------------------------*/
+/* The destination file is created or overwritten. When the reader task
+/  cannot be created, or the files are on the same volume at _FS_REENTRANT
+/  == 0, the copy is done in the calling task without overlap.
+*/
+
+FRESULT f_copy (
+	const TCHAR* src,	/* Pointer to the source file name */
+	const TCHAR* dst,	/* Pointer to the destination file name */
+	UINT chunk,			/* Size of each transfer buffer [byte] */
+	FCOPY* st			/* Pointer to return the statistics (null: not needed) */
+)
+{
+	FRESULT res, res2;
+	COPYJOB *job;
+	UINT i, n, bw, ofs;
+	DWORD t, t0, wtime = 0, wwait = 0, nchunk = 0;
+	FSIZE_t nbyte = 0;
+	UINT par = 0;
+#if (osCMSIS >= 0x20000U)
+	osThreadAttr_t attr;
+#endif
+
+
+	ofs = (sizeof (COPYJOB) + 31) & ~31;	/* Put the buffers at cache line boundary */
+	if (chunk == 0 || chunk > (0x7FFFFFFF - ofs) / COPY_NBUF) return FR_INVALID_PARAMETER;
+	job = ff_memalloc(ofs + COPY_NBUF * chunk);
+	if (!job) return FR_NOT_ENOUGH_CORE;
+	memset(job, 0, sizeof (COPYJOB));
+	job->chunk = chunk;
+	for (i = 0; i < COPY_NBUF; i++) job->buf[i] = (BYTE*)job + ofs + i * chunk;
+
+	t0 = copy_tick();
+	res = f_open(&job->src, src, FA_READ);
+	if (res == FR_OK) {
+		res = f_open(&job->dst, dst, FA_WRITE | FA_CREATE_ALWAYS);
+		if (res == FR_OK) {
+#if _USE_EXPAND
+			f_expand(&job->dst, f_size(&job->src), 1);	/* Allocate the destination in a contiguous block if possible */
+#endif
+			if (_FS_REENTRANT || job->src.obj.fs != job->dst.obj.fs) {	/* Can the transfers overlap? */
+				job->empty = copy_qcreate();
+				job->full = copy_qcreate();
+				if (job->empty && job->full) {
+					for (i = 0; i < COPY_NBUF; i++) copy_put(job->empty, i);
+#if (osCMSIS < 0x20000U)
+					osThreadDef(FCOPY, copy_reader, COPY_PRIORITY, 0, COPY_STACK_SIZE);
+					par = (osThreadCreate(osThread(FCOPY), job) != NULL);
+#else
+					memset(&attr, 0, sizeof attr);
+					attr.name = "FCOPY";
+					attr.stack_size = COPY_STACK_SIZE * 4;
+					attr.priority = COPY_PRIORITY;
+					par = (osThreadNew(copy_reader, job, &attr) != NULL);
+#endif
+				}
+			}
+
+			do {
+				if (par) {				/* Get the next filled buffer from the reader */
+					t = copy_tick();
+					i = copy_get(job->full);
+					wwait += copy_tick() - t;
+					n = job->len[i];
+				} else {				/* Fill the buffer here */
+					i = 0; n = 0;
+					if (res == FR_OK) {
+						t = copy_tick();
+						job->rres = f_read(&job->src, job->buf[0], chunk, &n);
+						job->rtime += copy_tick() - t;
+						if (job->rres != FR_OK) n = 0;
+					}
+				}
+				if (n && res == FR_OK) {
+					t = copy_tick();
+					res = f_write(&job->dst, job->buf[i], n, &bw);
+					wtime += copy_tick() - t;
+					if (res == FR_OK && bw < n) res = FR_DENIED;	/* Disk full */
+					if (res != FR_OK) job->abort = 1;				/* Stop the reader */
+					nbyte += bw; nchunk++;
+				}
+				if (par) copy_put(job->empty, i);	/* Return the buffer to the reader */
+			} while (n == chunk);
+			if (res == FR_OK) res = job->rres;
+
+#if _USE_EXPAND
+			if (res == FR_OK) res = f_truncate(&job->dst);	/* Discard the rest of the allocated block */
+#endif
+			t = copy_tick();
+			res2 = f_close(&job->dst);
+			wtime += copy_tick() - t;
+			if (res == FR_OK) res = res2;
+		}
+		f_close(&job->src);
+	}
+	t0 = copy_tick() - t0;
+
+	if (st) {
+		st->nbyte = nbyte;
+		st->nchunk = nchunk;
+		st->time = copy_ms(t0);
+		st->rtime = copy_ms(job->rtime);
+		st->wtime = copy_ms(wtime);
+		st->rwait = copy_ms(job->rwait);
+		st->wwait = copy_ms(wwait);
+		st->rate = st->time ? (DWORD)((uint64_t)nbyte * 1000 / st->time) : 0;
+	}
+	copy_qdelete(job->empty);
+	copy_qdelete(job->full);
+	ff_memfree(job);
+
+	return res;
+}
+
+#endif /* _USE_COPY */
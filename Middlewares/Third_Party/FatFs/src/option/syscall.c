@@ -148,7 +148,7 @@ void ff_rel_grant (
 
 
 
-#if _USE_LFN == 3	/* LFN with a working buffer on the heap */
+#if _USE_LFN == 3 || _FS_FREEMAP || _USE_FASTSEEK == 2 || _USE_COPY	/* Memory blocks on the heap for LFN, free cluster map, link map and copy buffers */
 /*------------------------------------------------------------------------*/
 /* Allocate a memory block                                                */
 /*------------------------------------------------------------------------*/
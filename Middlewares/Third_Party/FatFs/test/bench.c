@@ -0,0 +1,830 @@
+/**
+  ******************************************************************************
+  * @file    bench.c
+  * @author  MCD Application Team
+  * @brief   Host benchmark of FatFs on an image file. Each test reports the
+             number of disk_read/disk_write calls and sectors, the number of
+             non-sequential accesses and the wall time.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2017 STMicroelectronics. All rights reserved.
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                       opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+**/
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "ff_gen_drv.h"
+#include "image_diskio.h"
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  const char *name;
+  FRESULT (*func)(void);
+} BENCH_TestTypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define BENCH_CHUNK       32768     /* Transfer size of the sequential tests */
+#define BENCH_FILE_SIZE   (16UL * 1024 * 1024)
+#define BENCH_RANDOM_OPS  4000
+#define BENCH_STORM_FILES 500
+#define BENCH_DIR_DEPTH   32
+#define BENCH_FRAG_FILES  64
+#define BENCH_VIDEO_SIZE  ((FSIZE_t)3 * 1024 * 1024 * 1024)
+#define BENCH_VIDEO_FILES 2
+#define BENCH_LIST_FILES  300
+#define BENCH_SMALL_SIZE  (300UL * 1024)
+#define BENCH_SMALL_READ  100       /* Read size of the small read test */
+#define BENCH_FRAMES      4000      /* Frames of the vectored I/O tests */
+#define BENCH_FRAME_HEAD  16        /* Header of each frame */
+#define BENCH_FRAME_DATA  4096      /* Payload of each frame */
+#define BENCH_INDEX_FILES 2000
+#define BENCH_INDEX_OPS   4000
+#define BENCH_LFN_FILES   2000      /* Files of 5 entries, 10k entries a directory */
+#define BENCH_LFN_OPS     2000
+
+#define CHECK(expr)  do { FRESULT res_ = (expr); if (res_ != FR_OK) { printf("  %s failed (%d)\n", #expr, res_); return res_; } } while (0)
+
+/* Names of the LFN lookup tests: the LFN entries are stored from the end of the
+   name, a long common suffix makes each lookup compare most of the name. The
+   Latin-1 names are given in code page 850 (_CODE_PAGE) */
+static const char * const LfnNames[][2] =
+{
+  { "lfnascii/%04d Field Recording Archive Master Take.wav",
+    "lfnascii/%04d FIELD RECORDING ARCHIVE MASTER TAKE.WAV" },
+  { "lfnlatin/%04d Enregistrement \x90t\x82 \x90mission D\x82" "finitive.wav",
+    "lfnlatin/%04d ENREGISTREMENT \x90T\x90 \x90MISSION D\x90" "FINITIVE.WAV" },
+};
+
+/* Private variables ---------------------------------------------------------*/
+static char DiskPath[4];
+static FATFS FatFs;
+static FIL File;
+static BYTE Work[_MAX_SS * 64];
+static BYTE Buffer[BENCH_CHUNK];
+static BYTE Format = FM_FAT32;
+#if _USE_DIRINDEX
+static DWORD Index[16384];          /* Work area of the directory index */
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Returns the monotonic time in milliseconds
+  */
+static double BENCH_Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/**
+  * @brief  Makes a path on the benchmark drive
+  */
+static const char *BENCH_Path(const char *fmt, int n)
+{
+  static char path[64];
+  int len;
+
+  len = snprintf(path, sizeof path, "%s", DiskPath);
+  snprintf(path + len, sizeof path - len, fmt, n);
+  return path;
+}
+
+/**
+  * @brief  Fills the buffer with a pattern depending on the file offset
+  */
+static void BENCH_Pattern(BYTE *buff, UINT len, DWORD ofs)
+{
+  UINT i;
+
+  for (i = 0; i < len; i++)
+  {
+    buff[i] = (BYTE)((ofs + i) * 7 + ((ofs + i) >> 9));
+  }
+}
+
+/**
+  * @brief  Creates a new volume on the image and mounts it
+  */
+static FRESULT BENCH_Format(void)
+{
+  f_mount(NULL, DiskPath, 0);
+  CHECK(f_mkfs(DiskPath, Format, 0, Work, sizeof Work));
+  CHECK(f_mount(&FatFs, DiskPath, 1));
+  return FR_OK;
+}
+
+/**
+  * @brief  Sequential write of a large file
+  */
+static FRESULT BENCH_SeqWrite(void)
+{
+  DWORD ofs;
+  UINT bw;
+
+  CHECK(f_open(&File, BENCH_Path("seq.bin", 0), FA_WRITE | FA_CREATE_ALWAYS));
+  for (ofs = 0; ofs < BENCH_FILE_SIZE; ofs += BENCH_CHUNK)
+  {
+    BENCH_Pattern(Buffer, BENCH_CHUNK, ofs);
+    CHECK(f_write(&File, Buffer, BENCH_CHUNK, &bw));
+    if (bw != BENCH_CHUNK) return FR_DENIED;
+  }
+  CHECK(f_close(&File));
+  return FR_OK;
+}
+
+/**
+  * @brief  Sequential read of the large file
+  */
+static FRESULT BENCH_SeqRead(void)
+{
+  static BYTE expect[BENCH_CHUNK];
+  DWORD ofs;
+  UINT br;
+
+  CHECK(f_open(&File, BENCH_Path("seq.bin", 0), FA_READ));
+  for (ofs = 0; ofs < BENCH_FILE_SIZE; ofs += BENCH_CHUNK)
+  {
+    CHECK(f_read(&File, Buffer, BENCH_CHUNK, &br));
+    BENCH_Pattern(expect, BENCH_CHUNK, ofs);
+    if (br != BENCH_CHUNK || memcmp(Buffer, expect, BENCH_CHUNK)) return FR_INT_ERR;
+  }
+  CHECK(f_close(&File));
+  return FR_OK;
+}
+
+/**
+  * @brief  Random small reads of the large file
+  */
+static FRESULT BENCH_RandRead(void)
+{
+  BYTE expect[100];
+  DWORD ofs;
+  UINT br;
+  int i;
+
+  srand(1);
+  CHECK(f_open(&File, BENCH_Path("seq.bin", 0), FA_READ));
+  for (i = 0; i < BENCH_RANDOM_OPS; i++)
+  {
+    ofs = (DWORD)rand() % (BENCH_FILE_SIZE - sizeof expect);
+    CHECK(f_lseek(&File, ofs));
+    CHECK(f_read(&File, Buffer, sizeof expect, &br));
+    BENCH_Pattern(expect, sizeof expect, ofs);
+    if (br != sizeof expect || memcmp(Buffer, expect, sizeof expect)) return FR_INT_ERR;
+  }
+  CHECK(f_close(&File));
+  return FR_OK;
+}
+
+/**
+  * @brief  Reads a file in small chunks, each one a partial sector read
+  */
+static FRESULT BENCH_SmallRead(void)
+{
+  static BYTE expect[BENCH_SMALL_READ];
+  DWORD ofs;
+  UINT bw, br;
+
+  CHECK(f_open(&File, BENCH_Path("small.bin", 0), FA_WRITE | FA_CREATE_ALWAYS));
+  for (ofs = 0; ofs < BENCH_SMALL_SIZE; ofs += BENCH_CHUNK)
+  {
+    BENCH_Pattern(Buffer, BENCH_CHUNK, ofs);
+    CHECK(f_write(&File, Buffer, BENCH_CHUNK, &bw));
+  }
+  CHECK(f_close(&File));
+  CHECK(f_open(&File, BENCH_Path("small.bin", 0), FA_READ));
+  for (ofs = 0; ofs < BENCH_SMALL_SIZE; ofs += br)
+  {
+    CHECK(f_read(&File, Buffer, BENCH_SMALL_READ, &br));
+    BENCH_Pattern(expect, br, ofs);
+    if (br == 0 || memcmp(Buffer, expect, br)) return FR_INT_ERR;
+  }
+  CHECK(f_close(&File));
+  return FR_OK;
+}
+
+/**
+  * @brief  Fills a frame of the vectored I/O tests: the header holds the frame
+  *         number and the payload a pattern depending on the file offset
+  */
+static void BENCH_Frame(BYTE *head, BYTE *data, DWORD n)
+{
+  DWORD ofs = n * (BENCH_FRAME_HEAD + BENCH_FRAME_DATA);
+
+  memset(head, 0, BENCH_FRAME_HEAD);
+  memcpy(head, &n, sizeof n);
+  BENCH_Pattern(data, BENCH_FRAME_DATA, ofs + BENCH_FRAME_HEAD);
+}
+
+/**
+  * @brief  Writes the frames, gathering the header and payload of each frame
+  *         in a f_writev call
+  */
+static FRESULT BENCH_FrameWritev(void)
+{
+#if _USE_IOVEC
+  BYTE head[BENCH_FRAME_HEAD];
+  FIOV iov[2] = { { head, BENCH_FRAME_HEAD }, { Buffer, BENCH_FRAME_DATA } };
+  DWORD n;
+  UINT bw;
+
+  CHECK(f_open(&File, BENCH_Path("frames.bin", 0), FA_WRITE | FA_CREATE_ALWAYS));
+  for (n = 0; n < BENCH_FRAMES; n++)
+  {
+    BENCH_Frame(head, Buffer, n);
+    CHECK(f_writev(&File, iov, 2, &bw));
+    if (bw != BENCH_FRAME_HEAD + BENCH_FRAME_DATA) return FR_DENIED;
+  }
+  CHECK(f_close(&File));
+#endif
+  return FR_OK;
+}
+
+/**
+  * @brief  Reads the frames with a f_read call for the header and another one
+  *         for the payload
+  */
+static FRESULT BENCH_FrameRead(void)
+{
+  static BYTE expect[BENCH_FRAME_HEAD + BENCH_FRAME_DATA];
+  BYTE head[BENCH_FRAME_HEAD];
+  DWORD n;
+  UINT br1, br2;
+
+  CHECK(f_open(&File, BENCH_Path("frames.bin", 0), FA_READ));
+  for (n = 0; n < BENCH_FRAMES; n++)
+  {
+    CHECK(f_read(&File, head, BENCH_FRAME_HEAD, &br1));
+    CHECK(f_read(&File, Buffer, BENCH_FRAME_DATA, &br2));
+    BENCH_Frame(expect, expect + BENCH_FRAME_HEAD, n);
+    if (br1 + br2 != BENCH_FRAME_HEAD + BENCH_FRAME_DATA
+        || memcmp(head, expect, BENCH_FRAME_HEAD) || memcmp(Buffer, expect + BENCH_FRAME_HEAD, BENCH_FRAME_DATA)) return FR_INT_ERR;
+  }
+  CHECK(f_close(&File));
+  return FR_OK;
+}
+
+/**
+  * @brief  Reads the frames, scattering each one to the header and payload
+  *         buffers in a f_readv call
+  */
+static FRESULT BENCH_FrameReadv(void)
+{
+#if _USE_IOVEC
+  static BYTE expect[BENCH_FRAME_HEAD + BENCH_FRAME_DATA];
+  BYTE head[BENCH_FRAME_HEAD];
+  FIOV iov[2] = { { head, BENCH_FRAME_HEAD }, { Buffer, BENCH_FRAME_DATA } };
+  DWORD n;
+  UINT br;
+
+  CHECK(f_open(&File, BENCH_Path("frames.bin", 0), FA_READ));
+  for (n = 0; n < BENCH_FRAMES; n++)
+  {
+    CHECK(f_readv(&File, iov, 2, &br));
+    BENCH_Frame(expect, expect + BENCH_FRAME_HEAD, n);
+    if (br != BENCH_FRAME_HEAD + BENCH_FRAME_DATA
+        || memcmp(head, expect, BENCH_FRAME_HEAD) || memcmp(Buffer, expect + BENCH_FRAME_HEAD, BENCH_FRAME_DATA)) return FR_INT_ERR;
+  }
+  CHECK(f_close(&File));
+#endif
+  return FR_OK;
+}
+
+/**
+  * @brief  Random sector writes into the large file with periodic f_sync
+  */
+static FRESULT BENCH_RandWrite(void)
+{
+  DWORD ofs;
+  UINT bw;
+  int i;
+
+  srand(2);
+  CHECK(f_open(&File, BENCH_Path("seq.bin", 0), FA_READ | FA_WRITE));
+  for (i = 0; i < BENCH_RANDOM_OPS; i++)
+  {
+    ofs = ((DWORD)rand() % (BENCH_FILE_SIZE / 512)) * 512;
+    BENCH_Pattern(Buffer, 512, ofs);
+    CHECK(f_lseek(&File, ofs));
+    CHECK(f_write(&File, Buffer, 512, &bw));
+    if (i % 100 == 99) CHECK(f_sync(&File));
+  }
+  CHECK(f_close(&File));
+  return FR_OK;
+}
+
+/**
+  * @brief  Creates and deletes many small files in a directory
+  */
+static FRESULT BENCH_Storm(void)
+{
+  int round, i;
+  UINT bw;
+
+  CHECK(f_mkdir(BENCH_Path("storm", 0)));
+  BENCH_Pattern(Buffer, 1024, 0);
+  for (round = 0; round < 2; round++)
+  {
+    for (i = 0; i < BENCH_STORM_FILES; i++)
+    {
+      CHECK(f_open(&File, BENCH_Path("storm/file_with_long_name_%04d.dat", i), FA_WRITE | FA_CREATE_NEW));
+      CHECK(f_write(&File, Buffer, 1024, &bw));
+      CHECK(f_close(&File));
+    }
+    for (i = 0; i < BENCH_STORM_FILES; i++)
+    {
+      CHECK(f_unlink(BENCH_Path("storm/file_with_long_name_%04d.dat", i)));
+    }
+  }
+  CHECK(f_unlink(BENCH_Path("storm", 0)));
+  return FR_OK;
+}
+
+/**
+  * @brief  Creates a deep directory tree and resolves paths through it
+  */
+static FRESULT BENCH_DeepDir(void)
+{
+  static char path[BENCH_DIR_DEPTH * 12 + 16];
+  FILINFO fno;
+  int i, len;
+
+  len = snprintf(path, sizeof path, "%s", DiskPath);
+  for (i = 0; i < BENCH_DIR_DEPTH; i++)
+  {
+    len += snprintf(path + len, sizeof path - len, "%sdir%02d", i ? "/" : "", i);
+    CHECK(f_mkdir(path));
+  }
+  snprintf(path + len, sizeof path - len, "/leaf.txt");
+  CHECK(f_open(&File, path, FA_WRITE | FA_CREATE_NEW));
+  CHECK(f_close(&File));
+  for (i = 0; i < 1000; i++)
+  {
+    CHECK(f_stat(path, &fno));
+  }
+  return FR_OK;
+}
+
+/**
+  * @brief  Writes a large file into a fragmented volume and reads it back
+  */
+static FRESULT BENCH_Fragmented(void)
+{
+  DWORD ofs;
+  UINT bw, br;
+  int i, n;
+
+  CHECK(BENCH_Format());
+  BENCH_Pattern(Buffer, 4096, 0);
+  for (i = 0; i < BENCH_FRAG_FILES; i++)
+  {
+    CHECK(f_open(&File, BENCH_Path("frag%02d.bin", i), FA_WRITE | FA_CREATE_NEW));
+    CHECK(f_close(&File));
+  }
+  for (n = 0; n < 16; n++)      /* Interleave the clusters of the files */
+  {
+    for (i = 0; i < BENCH_FRAG_FILES; i++)
+    {
+      CHECK(f_open(&File, BENCH_Path("frag%02d.bin", i), FA_WRITE | FA_OPEN_APPEND));
+      CHECK(f_write(&File, Buffer, 4096, &bw));
+      CHECK(f_close(&File));
+    }
+  }
+  for (i = 0; i < BENCH_FRAG_FILES; i += 2)
+  {
+    CHECK(f_unlink(BENCH_Path("frag%02d.bin", i)));
+  }
+  CHECK(f_open(&File, BENCH_Path("big.bin", 0), FA_WRITE | FA_CREATE_NEW | FA_READ));
+  for (ofs = 0; ofs < BENCH_FILE_SIZE / 4; ofs += BENCH_CHUNK)
+  {
+    CHECK(f_write(&File, Buffer, BENCH_CHUNK, &bw));
+  }
+  CHECK(f_lseek(&File, 0));
+  for (ofs = 0; ofs < BENCH_FILE_SIZE / 4; ofs += BENCH_CHUNK)
+  {
+    CHECK(f_read(&File, Buffer, BENCH_CHUNK, &br));
+  }
+  CHECK(f_close(&File));
+  return FR_OK;
+}
+
+/**
+  * @brief  Records multi-GB video files allocated by f_expand and plays them with
+  *         seeks. Only the recorded chunks are written, so the image stays sparse.
+  */
+static FRESULT BENCH_Video(void)
+{
+  BYTE expect[100];
+  FSIZE_t ofs;
+  DWORD nclst;
+  FATFS *fs;
+  UINT bw, br;
+  int i, n;
+
+  CHECK(BENCH_Format());
+  CHECK(f_getfree(DiskPath, &nclst, &fs));
+  if ((FSIZE_t)nclst * fs->csize * IMG_SECTOR_SIZE < BENCH_VIDEO_FILES * BENCH_VIDEO_SIZE + BENCH_FILE_SIZE)
+  {
+    printf("  video: skipped, the volume is too small\n");
+    return FR_OK;
+  }
+  for (i = 0; i < BENCH_VIDEO_FILES; i++)
+  {
+    CHECK(f_open(&File, BENCH_Path("video%d.mp4", i), FA_WRITE | FA_READ | FA_CREATE_NEW));
+    CHECK(f_expand(&File, BENCH_VIDEO_SIZE, 1));
+    for (n = 0; n < 64; n++)
+    {
+      ofs = BENCH_VIDEO_SIZE / 64 * n;
+      BENCH_Pattern(Buffer, BENCH_CHUNK, (DWORD)ofs);
+      CHECK(f_lseek(&File, ofs));
+      CHECK(f_write(&File, Buffer, BENCH_CHUNK, &bw));
+    }
+    CHECK(f_close(&File));
+  }
+  /* Append to the first file, it gets fragmented since the second one follows it */
+  CHECK(f_open(&File, BENCH_Path("video%d.mp4", 0), FA_WRITE | FA_OPEN_APPEND));
+  for (n = 0; n < 64; n++)
+  {
+    CHECK(f_write(&File, Buffer, BENCH_CHUNK, &bw));
+  }
+  CHECK(f_close(&File));
+  srand(3);
+  for (i = 0; i < BENCH_VIDEO_FILES; i++)
+  {
+    CHECK(f_open(&File, BENCH_Path("video%d.mp4", i), FA_READ));
+    for (n = 0; n < 200; n++)
+    {
+      ofs = BENCH_VIDEO_SIZE / 64 * (rand() % 64) + rand() % (BENCH_CHUNK - sizeof expect);
+      CHECK(f_lseek(&File, ofs));
+      CHECK(f_read(&File, Buffer, sizeof expect, &br));
+      BENCH_Pattern(expect, sizeof expect, (DWORD)ofs);
+      if (br != sizeof expect || memcmp(Buffer, expect, sizeof expect)) return FR_INT_ERR;
+    }
+    CHECK(f_close(&File));
+  }
+  /* Cut the second file to half and delete both */
+  CHECK(f_open(&File, BENCH_Path("video%d.mp4", 1), FA_WRITE));
+  CHECK(f_lseek(&File, BENCH_VIDEO_SIZE / 2));
+  CHECK(f_truncate(&File));
+  CHECK(f_close(&File));
+  for (i = 0; i < BENCH_VIDEO_FILES; i++)
+  {
+    CHECK(f_unlink(BENCH_Path("video%d.mp4", i)));
+  }
+  return FR_OK;
+}
+
+/**
+  * @brief  Creates the files of the listing tests in reverse order of the names
+  */
+static FRESULT BENCH_ListMake(void)
+{
+  DWORD n;
+  UINT bw;
+  int i;
+
+  CHECK(f_mkdir(BENCH_Path("list", 0)));
+  for (i = BENCH_LIST_FILES - 1; i >= 0; i--)
+  {
+    n = (DWORD)i;
+    CHECK(f_open(&File, BENCH_Path("list/track_%03d_with_long_name.wav", i), FA_WRITE | FA_CREATE_NEW));
+    CHECK(f_write(&File, &n, sizeof n, &bw));
+    CHECK(f_close(&File));
+    CHECK(f_open(&File, BENCH_Path("list/cover_%03d.jpg", i), FA_WRITE | FA_CREATE_NEW));
+    CHECK(f_close(&File));
+  }
+  return FR_OK;
+}
+
+/**
+  * @brief  Opens every listed file the way the explorer apps do: the directory
+  *         is read again up to the file index and the file is opened by name
+  */
+static FRESULT BENCH_ListScan(void)
+{
+  char name[300];
+  FILINFO fno;
+  DIR dir;
+  DWORD n;
+  UINT br;
+  int i, k;
+
+  for (i = 0; i < BENCH_LIST_FILES; i++)
+  {
+    CHECK(f_findfirst(&dir, &fno, BENCH_Path("list", 0), "*.wav"));
+    for (k = 0; k < i && fno.fname[0]; k++)
+    {
+      CHECK(f_findnext(&dir, &fno));
+    }
+    CHECK(f_closedir(&dir));
+    if (!fno.fname[0]) return FR_NO_FILE;
+    snprintf(name, sizeof name, "%slist/%s", DiskPath, fno.fname);
+    CHECK(f_open(&File, name, FA_READ));
+    CHECK(f_read(&File, &n, sizeof n, &br));
+    CHECK(f_close(&File));
+    if (br != sizeof n || n >= BENCH_LIST_FILES) return FR_INT_ERR;
+  }
+  return FR_OK;
+}
+
+/**
+  * @brief  Opens every listed file from a directory snapshot sorted by name
+  */
+static FRESULT BENCH_ListSnap(void)
+{
+  DIRSNAP snap;
+  DWORD n, expect = 0;
+  UINT i, br;
+
+  CHECK(f_snapdir(&snap, BENCH_Path("list", 0), "*.wav", DS_NAME, Work, sizeof Work));
+  while (snap.count)
+  {
+    for (i = 0; i < snap.count; i++)
+    {
+      CHECK(f_snapopen(&File, &snap, i, FA_READ));
+      CHECK(f_read(&File, &n, sizeof n, &br));
+      CHECK(f_close(&File));
+      if (br != sizeof n || n != expect++) return FR_INT_ERR;
+    }
+    CHECK(f_snapnext(&snap));
+  }
+  return expect == BENCH_LIST_FILES ? FR_OK : FR_INT_ERR;
+}
+
+/**
+  * @brief  Creates the files of the directory index tests
+  */
+static FRESULT BENCH_IndexMake(void)
+{
+  int i;
+
+  CHECK(f_mkdir(BENCH_Path("index", 0)));
+  for (i = 0; i < BENCH_INDEX_FILES; i++)
+  {
+    CHECK(f_open(&File, BENCH_Path("index/Sample Recording %04d.wav", i), FA_WRITE | FA_CREATE_NEW));
+    CHECK(f_close(&File));
+  }
+  return FR_OK;
+}
+
+/**
+  * @brief  Looks up random names in the directory, half of them in another case
+  *         and one in eight missing
+  */
+static FRESULT BENCH_IndexLookup(void)
+{
+  FILINFO fno;
+  FRESULT res;
+  int i, n;
+
+  srand(4);
+  for (i = 0; i < BENCH_INDEX_OPS; i++)
+  {
+    n = rand() % (BENCH_INDEX_FILES + BENCH_INDEX_FILES / 8);
+    res = f_stat(BENCH_Path((i & 1) ? "index/SAMPLE RECORDING %04d.WAV" : "index/Sample Recording %04d.wav", n), &fno);
+    if (res != (n < BENCH_INDEX_FILES ? FR_OK : FR_NO_FILE)) return res != FR_OK ? res : FR_INT_ERR;
+  }
+  return FR_OK;
+}
+
+/**
+  * @brief  Looks up the names in the directory by scanning it
+  */
+static FRESULT BENCH_IndexScan(void)
+{
+  return BENCH_IndexLookup();
+}
+
+/**
+  * @brief  Looks up the names in the directory through its hash index
+  */
+static FRESULT BENCH_IndexHash(void)
+{
+#if _USE_DIRINDEX
+  if (FatFs.fs_type == FS_EXFAT)
+  {
+    printf("  index hash: skipped, exFAT entries have their own hash\n");
+    return FR_OK;
+  }
+  CHECK(f_dirindex(BENCH_Path("index", 0), Index, sizeof Index));
+  CHECK(BENCH_IndexLookup());
+  CHECK(f_dirindex(DiskPath, NULL, 0));
+#endif
+  return FR_OK;
+}
+
+/**
+  * @brief  Creates the directories of the LFN lookup tests
+  */
+static FRESULT BENCH_LfnMake(void)
+{
+  unsigned int i;
+  int n;
+
+  CHECK(f_mkdir(BENCH_Path("lfnascii", 0)));
+  CHECK(f_mkdir(BENCH_Path("lfnlatin", 0)));
+  for (i = 0; i < sizeof LfnNames / sizeof LfnNames[0]; i++)
+  {
+    for (n = 0; n < BENCH_LFN_FILES; n++)
+    {
+      CHECK(f_open(&File, BENCH_Path(LfnNames[i][0], n), FA_WRITE | FA_CREATE_NEW));
+      CHECK(f_close(&File));
+    }
+  }
+  return FR_OK;
+}
+
+/**
+  * @brief  Looks up random names of a LFN directory, half of them in upper case
+  * @param  set: Index of the names in LfnNames
+  */
+static FRESULT BENCH_LfnLookup(int set)
+{
+  FILINFO fno;
+  int i, n;
+
+  srand(5);
+  for (i = 0; i < BENCH_LFN_OPS; i++)
+  {
+    n = rand() % BENCH_LFN_FILES;
+    CHECK(f_stat(BENCH_Path(LfnNames[set][i & 1], n), &fno));
+  }
+  return FR_OK;
+}
+
+/**
+  * @brief  Looks up ASCII long file names
+  */
+static FRESULT BENCH_LfnAscii(void)
+{
+  return BENCH_LfnLookup(0);
+}
+
+/**
+  * @brief  Looks up Latin-1 long file names
+  */
+static FRESULT BENCH_LfnLatin(void)
+{
+  return BENCH_LfnLookup(1);
+}
+
+/**
+  * @brief  Writes small formatted images to be used as the fuzzer seeds
+  */
+static int BENCH_Seeds(const char *dir)
+{
+  static const struct { const char *name; BYTE fmt; DWORD sectors; } seeds[] =
+  {
+    { "fat12.img", FM_FAT | FM_SFD, 256 },
+    { "fat16.img", FM_FAT | FM_SFD, 8192 },
+#if _FS_EXFAT
+    { "exfat.img", FM_EXFAT | FM_SFD, 4096 },
+#endif
+    { "mbr.img", FM_FAT, 1024 },
+  };
+  char name[256];
+  UINT bw, i;
+
+  for (i = 0; i < sizeof seeds / sizeof seeds[0]; i++)
+  {
+    snprintf(name, sizeof name, "%s/%s", dir, seeds[i].name);
+    unlink(name);
+    if (IMG_Open(name, seeds[i].sectors) != 0
+        || f_mkfs(DiskPath, seeds[i].fmt, 0, Work, sizeof Work) != FR_OK
+        || f_mount(&FatFs, DiskPath, 1) != FR_OK
+        || f_mkdir(BENCH_Path("sub", 0)) != FR_OK
+        || f_open(&File, BENCH_Path("sub/a long file name.txt", 0), FA_WRITE | FA_CREATE_NEW) != FR_OK
+        || f_write(&File, "FatFs", 5, &bw) != FR_OK
+        || f_close(&File) != FR_OK
+        || f_mount(NULL, DiskPath, 0) != FR_OK)
+    {
+      printf("cannot create %s\n", name);
+      return 1;
+    }
+    IMG_Close();
+    printf("%s\n", name);
+  }
+  return 0;
+}
+
+/**
+  * @brief  Prints the usage
+  */
+static int BENCH_Usage(void)
+{
+  printf("usage: fatfs_bench [-i image] [-s sectors] [-f fat|fat32|exfat] [-t trace] [-z seed_dir]\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  static const BENCH_TestTypeDef tests[] =
+  {
+    { "format",      BENCH_Format },
+    { "seq write",   BENCH_SeqWrite },
+    { "seq read",    BENCH_SeqRead },
+    { "rand read",   BENCH_RandRead },
+    { "small read",  BENCH_SmallRead },
+    { "frame wrv",   BENCH_FrameWritev },
+    { "frame read",  BENCH_FrameRead },
+    { "frame rdv",   BENCH_FrameReadv },
+    { "rand write",  BENCH_RandWrite },
+    { "storm",       BENCH_Storm },
+    { "deep dir",    BENCH_DeepDir },
+    { "fragmented",  BENCH_Fragmented },
+    { "video",       BENCH_Video },
+    { "list make",   BENCH_ListMake },
+    { "list scan",   BENCH_ListScan },
+    { "list snap",   BENCH_ListSnap },
+    { "index make",  BENCH_IndexMake },
+    { "index scan",  BENCH_IndexScan },
+    { "index hash",  BENCH_IndexHash },
+    { "lfn make",    BENCH_LfnMake },
+    { "lfn ascii",   BENCH_LfnAscii },
+    { "lfn latin",   BENCH_LfnLatin },
+  };
+  const char *image = "bench.img", *trace = NULL, *seeds = NULL;
+  DWORD sectors = 131072;
+  FILE *tf = NULL;
+  double t0, t1;
+  unsigned int i;
+  int opt;
+  FRESULT res = FR_OK;
+
+  while ((opt = getopt(argc, argv, "i:s:f:t:z:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'i': image = optarg; break;
+    case 's': sectors = (DWORD)strtoul(optarg, NULL, 0); break;
+    case 't': trace = optarg; break;
+    case 'z': seeds = optarg; break;
+    case 'f':
+      if (!strcmp(optarg, "fat")) Format = FM_FAT;
+      else if (!strcmp(optarg, "fat32")) Format = FM_FAT32;
+      else if (!strcmp(optarg, "exfat")) Format = FM_EXFAT;
+      else return BENCH_Usage();
+      break;
+    default:
+      return BENCH_Usage();
+    }
+  }
+
+  if (FATFS_LinkDriver(&IMG_Driver, DiskPath) != 0) return 1;
+  if (seeds != NULL) return BENCH_Seeds(seeds);
+
+  if (IMG_Open(image, sectors) != 0)
+  {
+    printf("cannot open %s\n", image);
+    return 1;
+  }
+  if (trace != NULL && (tf = fopen(trace, "w")) == NULL)
+  {
+    printf("cannot open %s\n", trace);
+    return 1;
+  }
+
+  printf("%-12s %10s %10s %10s %10s %8s %6s %10s\n", "test", "rd calls", "rd sect", "wr calls", "wr sect", "seeks", "syncs", "time [ms]");
+  for (i = 0; i < sizeof tests / sizeof tests[0] && res == FR_OK; i++)
+  {
+    if (tf != NULL)
+    {
+      fprintf(tf, "# %s\n", tests[i].name);
+    }
+    IMG_SetTrace(tf);
+    IMG_ResetStats();
+    t0 = BENCH_Now();
+    res = tests[i].func();
+    t1 = BENCH_Now();
+    IMG_SetTrace(NULL);
+    printf("%-12s %10lu %10lu %10lu %10lu %8lu %6lu %10.1f%s\n", tests[i].name,
+           IMG_Stats.nread, IMG_Stats.sread, IMG_Stats.nwrite, IMG_Stats.swrite,
+           IMG_Stats.seeks, IMG_Stats.nsync, t1 - t0, res == FR_OK ? "" : "  FAILED");
+  }
+
+  f_mount(NULL, DiskPath, 0);
+  FATFS_UnLinkDriver(DiskPath);
+  IMG_Close();
+  if (tf != NULL)
+  {
+    fclose(tf);
+  }
+  return res == FR_OK ? 0 : 1;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,366 @@
+/**
+  ******************************************************************************
+  * @file    cmsis_os.c
+  * @author  MCD Application Team
+  * @brief   Subset of the CMSIS-RTOS v1 API on POSIX threads for the host
+             functional tests. The return values follow the FreeRTOS based
+             implementation: the wait functions return osOK when the object
+             has been taken and osErrorOS on timeout.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2017 STMicroelectronics. All rights reserved.
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                       opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+**/
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include "cmsis_os.h"
+
+/* Private typedef -----------------------------------------------------------*/
+struct os_thread_cb
+{
+  pthread_t               thread;
+  os_pthread              func;
+  void                    *arg;
+};
+
+/* Mutexes and semaphores: a counter protected by a mutex */
+struct os_sync_cb
+{
+  pthread_mutex_t         lock;
+  pthread_cond_t          cond;
+  int32_t                 count;
+};
+
+struct os_messageQ_cb
+{
+  pthread_mutex_t         lock;
+  pthread_cond_t          cond;
+  uint32_t                size;
+  uint32_t                head;
+  uint32_t                used;
+  uint32_t                items[1];
+};
+
+/* Private variables ---------------------------------------------------------*/
+static __thread struct os_thread_cb *CurrentThread;
+static struct os_thread_cb MainThread;
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Converts a timeout to an absolute time of the condition wait
+  */
+static void os_deadline(struct timespec *ts, uint32_t millisec)
+{
+  clock_gettime(CLOCK_REALTIME, ts);
+  ts->tv_sec += millisec / 1000;
+  ts->tv_nsec += (long)(millisec % 1000) * 1000000;
+  if (ts->tv_nsec >= 1000000000)
+  {
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000;
+  }
+}
+
+/**
+  * @brief  Waits on the condition of an object with its lock taken
+  * @retval 0 when signalled, ETIMEDOUT on timeout
+  */
+static int os_wait(pthread_cond_t *cond, pthread_mutex_t *lock, uint32_t millisec)
+{
+  struct timespec ts;
+
+  if (millisec == 0)
+  {
+    return ETIMEDOUT;
+  }
+  if (millisec == osWaitForever)
+  {
+    return pthread_cond_wait(cond, lock);
+  }
+  os_deadline(&ts, millisec);
+  return pthread_cond_timedwait(cond, lock, &ts);
+}
+
+static void *os_thread_start(void *arg)
+{
+  CurrentThread = arg;
+  CurrentThread->func(CurrentThread->arg);
+  return NULL;
+}
+
+static struct os_sync_cb *os_sync_create(int32_t count)
+{
+  struct os_sync_cb *s = malloc(sizeof *s);
+
+  if (s != NULL)
+  {
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    s->count = count;
+  }
+  return s;
+}
+
+static osStatus os_sync_wait(struct os_sync_cb *s, uint32_t millisec)
+{
+  osStatus ret = osOK;
+
+  if (s == NULL)
+  {
+    return osErrorParameter;
+  }
+  pthread_mutex_lock(&s->lock);
+  while (s->count == 0)
+  {
+    if (os_wait(&s->cond, &s->lock, millisec) == ETIMEDOUT && s->count == 0)
+    {
+      ret = osErrorOS;
+      break;
+    }
+  }
+  if (ret == osOK)
+  {
+    s->count--;
+  }
+  pthread_mutex_unlock(&s->lock);
+  return ret;
+}
+
+static osStatus os_sync_release(struct os_sync_cb *s)
+{
+  if (s == NULL)
+  {
+    return osErrorParameter;
+  }
+  pthread_mutex_lock(&s->lock);
+  s->count++;
+  pthread_cond_signal(&s->cond);
+  pthread_mutex_unlock(&s->lock);
+  return osOK;
+}
+
+static osStatus os_sync_delete(struct os_sync_cb *s)
+{
+  if (s == NULL)
+  {
+    return osErrorParameter;
+  }
+  pthread_cond_destroy(&s->cond);
+  pthread_mutex_destroy(&s->lock);
+  free(s);
+  return osOK;
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+int32_t osKernelRunning(void)
+{
+  return 1;
+}
+
+uint32_t osKernelSysTick(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+osThreadId osThreadCreate(const osThreadDef_t *thread_def, void *argument)
+{
+  struct os_thread_cb *t = malloc(sizeof *t);
+  pthread_attr_t attr;
+  int err;
+
+  if (t == NULL)
+  {
+    return NULL;
+  }
+  t->func = thread_def->pthread;
+  t->arg = argument;
+  /* Created detached: the thread may terminate and free t before the return */
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  err = pthread_create(&t->thread, &attr, os_thread_start, t);
+  pthread_attr_destroy(&attr);
+  if (err != 0)
+  {
+    free(t);
+    return NULL;
+  }
+  return t;
+}
+
+osThreadId osThreadGetId(void)
+{
+  return CurrentThread != NULL ? CurrentThread : &MainThread;
+}
+
+osStatus osThreadTerminate(osThreadId thread_id)
+{
+  if (thread_id != CurrentThread || thread_id == NULL)
+  {
+    return osErrorParameter;    /* Only the termination of the calling thread is supported */
+  }
+  free(thread_id);
+  CurrentThread = NULL;
+  pthread_exit(NULL);
+}
+
+osStatus osDelay(uint32_t millisec)
+{
+  struct timespec ts;
+
+  ts.tv_sec = millisec / 1000;
+  ts.tv_nsec = (long)(millisec % 1000) * 1000000;
+  nanosleep(&ts, NULL);
+  return osOK;
+}
+
+osMutexId osMutexCreate(const osMutexDef_t *mutex_def)
+{
+  (void)mutex_def;
+  return os_sync_create(1);
+}
+
+osStatus osMutexWait(osMutexId mutex_id, uint32_t millisec)
+{
+  return os_sync_wait(mutex_id, millisec);
+}
+
+osStatus osMutexRelease(osMutexId mutex_id)
+{
+  return os_sync_release(mutex_id);
+}
+
+osStatus osMutexDelete(osMutexId mutex_id)
+{
+  return os_sync_delete(mutex_id);
+}
+
+osSemaphoreId osSemaphoreCreate(const osSemaphoreDef_t *semaphore_def, int32_t count)
+{
+  (void)semaphore_def;
+  return os_sync_create(count);
+}
+
+int32_t osSemaphoreWait(osSemaphoreId semaphore_id, uint32_t millisec)
+{
+  return os_sync_wait(semaphore_id, millisec);
+}
+
+osStatus osSemaphoreRelease(osSemaphoreId semaphore_id)
+{
+  return os_sync_release(semaphore_id);
+}
+
+osStatus osSemaphoreDelete(osSemaphoreId semaphore_id)
+{
+  return os_sync_delete(semaphore_id);
+}
+
+osMessageQId osMessageCreate(const osMessageQDef_t *queue_def, osThreadId thread_id)
+{
+  struct os_messageQ_cb *q;
+
+  (void)thread_id;
+  if (queue_def->queue_sz == 0 || queue_def->item_sz > sizeof (uint32_t))
+  {
+    return NULL;
+  }
+  q = malloc(sizeof *q + (queue_def->queue_sz - 1) * sizeof (uint32_t));
+  if (q != NULL)
+  {
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->cond, NULL);
+    q->size = queue_def->queue_sz;
+    q->head = q->used = 0;
+  }
+  return q;
+}
+
+osStatus osMessagePut(osMessageQId queue_id, uint32_t info, uint32_t millisec)
+{
+  osStatus ret = osOK;
+
+  if (queue_id == NULL)
+  {
+    return osErrorParameter;
+  }
+  pthread_mutex_lock(&queue_id->lock);
+  while (queue_id->used == queue_id->size)
+  {
+    if (os_wait(&queue_id->cond, &queue_id->lock, millisec) == ETIMEDOUT
+        && queue_id->used == queue_id->size)
+    {
+      ret = osErrorOS;
+      break;
+    }
+  }
+  if (ret == osOK)
+  {
+    queue_id->items[(queue_id->head + queue_id->used) % queue_id->size] = info;
+    queue_id->used++;
+    pthread_cond_broadcast(&queue_id->cond);
+  }
+  pthread_mutex_unlock(&queue_id->lock);
+  return ret;
+}
+
+osEvent osMessageGet(osMessageQId queue_id, uint32_t millisec)
+{
+  osEvent event;
+
+  event.def.message_id = queue_id;
+  event.value.v = 0;
+  if (queue_id == NULL)
+  {
+    event.status = osErrorParameter;
+    return event;
+  }
+  event.status = osEventMessage;
+  pthread_mutex_lock(&queue_id->lock);
+  while (queue_id->used == 0)
+  {
+    if (os_wait(&queue_id->cond, &queue_id->lock, millisec) == ETIMEDOUT
+        && queue_id->used == 0)
+    {
+      event.status = millisec ? osEventTimeout : osOK;
+      break;
+    }
+  }
+  if (event.status == osEventMessage)
+  {
+    event.value.v = queue_id->items[queue_id->head];
+    queue_id->head = (queue_id->head + 1) % queue_id->size;
+    queue_id->used--;
+    pthread_cond_broadcast(&queue_id->cond);
+  }
+  pthread_mutex_unlock(&queue_id->lock);
+  return event;
+}
+
+osStatus osMessageDelete(osMessageQId queue_id)
+{
+  if (queue_id == NULL)
+  {
+    return osErrorParameter;
+  }
+  pthread_cond_destroy(&queue_id->cond);
+  pthread_mutex_destroy(&queue_id->lock);
+  free(queue_id);
+  return osOK;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
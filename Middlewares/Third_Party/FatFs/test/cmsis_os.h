@@ -0,0 +1,150 @@
+/**
+  ******************************************************************************
+  * @file    cmsis_os.h
+  * @author  MCD Application Team
+  * @brief   Subset of the CMSIS-RTOS v1 API on POSIX threads, used by the host
+             functional tests to run the RTOS parts of FatFs (syscall.c,
+             fcopy.c and the RTOS disk drivers). One tick is one millisecond.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2017 STMicroelectronics. All rights reserved.
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                       opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+**/
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CMSIS_OS_H
+#define __CMSIS_OS_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define osCMSIS                   0x10002       /* API version */
+#define osWaitForever             0xFFFFFFFF    /* Wait forever timeout value */
+#define osKernelSysTickFrequency  1000
+#define configMINIMAL_STACK_SIZE  128
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum
+{
+  osPriorityIdle          = -3,
+  osPriorityLow           = -2,
+  osPriorityBelowNormal   = -1,
+  osPriorityNormal        =  0,
+  osPriorityAboveNormal   = +1,
+  osPriorityHigh          = +2,
+  osPriorityRealtime      = +3,
+  osPriorityError         =  0x84
+} osPriority;
+
+typedef enum
+{
+  osOK                    =     0,
+  osEventSignal           =  0x08,
+  osEventMessage          =  0x10,
+  osEventMail             =  0x20,
+  osEventTimeout          =  0x40,
+  osErrorParameter        =  0x80,
+  osErrorResource         =  0x81,
+  osErrorTimeoutResource  =  0xC1,
+  osErrorISR              =  0x82,
+  osErrorNoMemory         =  0x85,
+  osErrorOS               =  0xFF,
+  os_status_reserved      =  0x7FFFFFFF
+} osStatus;
+
+typedef void (*os_pthread) (void const *argument);
+
+typedef struct os_thread_cb *osThreadId;
+typedef struct os_sync_cb *osMutexId;
+typedef struct os_sync_cb *osSemaphoreId;
+typedef struct os_messageQ_cb *osMessageQId;
+
+typedef struct os_thread_def
+{
+  char                   *name;
+  os_pthread             pthread;
+  osPriority             tpriority;
+  uint32_t               instances;
+  uint32_t               stacksize;
+} osThreadDef_t;
+
+typedef struct os_mutex_def
+{
+  uint32_t               dummy;
+} osMutexDef_t;
+
+typedef struct os_semaphore_def
+{
+  uint32_t               dummy;
+} osSemaphoreDef_t;
+
+typedef struct os_messageQ_def
+{
+  uint32_t               queue_sz;
+  uint32_t               item_sz;
+} osMessageQDef_t;
+
+typedef struct
+{
+  osStatus               status;
+  union
+  {
+    uint32_t             v;
+    void                 *p;
+    int32_t              signals;
+  } value;
+  union
+  {
+    osMessageQId         message_id;
+  } def;
+} osEvent;
+
+/* Exported macro ------------------------------------------------------------*/
+#define osThreadDef(name, thread, priority, instances, stacksz)  \
+const osThreadDef_t os_thread_def_##name = { #name, (thread), (priority), (instances), (stacksz) }
+#define osThread(name)  &os_thread_def_##name
+
+#define osMutexDef(name)  const osMutexDef_t os_mutex_def_##name = { 0 }
+#define osMutex(name)  &os_mutex_def_##name
+
+#define osSemaphoreDef(name)  const osSemaphoreDef_t os_semaphore_def_##name = { 0 }
+#define osSemaphore(name)  &os_semaphore_def_##name
+
+#define osMessageQDef(name, queue_sz, type)  \
+const osMessageQDef_t os_messageQ_def_##name = { (queue_sz), sizeof (type) }
+#define osMessageQ(name)  &os_messageQ_def_##name
+
+/* Exported functions ------------------------------------------------------- */
+int32_t osKernelRunning(void);
+uint32_t osKernelSysTick(void);
+
+osThreadId osThreadCreate(const osThreadDef_t *thread_def, void *argument);
+osThreadId osThreadGetId(void);
+osStatus osThreadTerminate(osThreadId thread_id);
+osStatus osDelay(uint32_t millisec);
+
+osMutexId osMutexCreate(const osMutexDef_t *mutex_def);
+osStatus osMutexWait(osMutexId mutex_id, uint32_t millisec);
+osStatus osMutexRelease(osMutexId mutex_id);
+osStatus osMutexDelete(osMutexId mutex_id);
+
+osSemaphoreId osSemaphoreCreate(const osSemaphoreDef_t *semaphore_def, int32_t count);
+int32_t osSemaphoreWait(osSemaphoreId semaphore_id, uint32_t millisec);
+osStatus osSemaphoreRelease(osSemaphoreId semaphore_id);
+osStatus osSemaphoreDelete(osSemaphoreId semaphore_id);
+
+osMessageQId osMessageCreate(const osMessageQDef_t *queue_def, osThreadId thread_id);
+osStatus osMessagePut(osMessageQId queue_id, uint32_t info, uint32_t millisec);
+osEvent osMessageGet(osMessageQId queue_id, uint32_t millisec);
+osStatus osMessageDelete(osMessageQId queue_id);
+
+#endif /* __CMSIS_OS_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,78 @@
+/*---------------------------------------------------------------------------/
+/  FatFs - Configuration file for the host benchmark and fuzz harness
+/---------------------------------------------------------------------------*/
+
+/* Start from the default configuration and enable the functions exercised by
+/  the harness. Other options (e.g. _FS_RDAHEAD, _FS_WBCACHE, _FS_JOURNAL) can
+/  be overridden here to compare their effect on the benchmark. */
+
+#include "ffconf_template.h"
+
+#undef	_USE_FIND
+#define _USE_FIND		1
+
+#undef	_USE_EXPAND
+#define	_USE_EXPAND		1
+
+#undef	_USE_IOVEC
+#define	_USE_IOVEC		1
+
+#undef	_USE_DIRINDEX
+#define	_USE_DIRINDEX	1
+
+#undef	_USE_DIRSNAP
+#define	_USE_DIRSNAP	1
+
+#undef	_USE_LABEL
+#define _USE_LABEL		1
+
+#undef	_FS_RPATH
+#define _FS_RPATH		2
+
+#undef	_VOLUMES
+#define _VOLUMES		1
+
+#undef	_USE_TRIM
+#define	_USE_TRIM		1
+
+#undef	_FS_EXFAT
+#define _FS_EXFAT		1
+
+/* The read-ahead pool serves the partial sector reads (small read test) */
+#undef	_FS_RDAHEAD
+#define	_FS_RDAHEAD		16
+
+#undef	_USE_STREAM
+#define	_USE_STREAM		1
+
+/* Flat up-case table of Basic Latin to Cyrillic for the LFN lookup tests */
+#undef	_LFN_UPTABLE
+#define	_LFN_UPTABLE	0x530
+
+/* The functional tests (fatfs_test) are built with FATFS_TEST defined. They
+/  also cover the RTOS dependent options, on the pthread based CMSIS-OS stub
+/  of this directory (cmsis_os.c). */
+#ifdef FATFS_TEST
+
+#undef	_FS_REENTRANT
+#define	_FS_REENTRANT	2
+#include "cmsis_os.h"
+#define _FS_TIMEOUT		1000
+#define _SYNC_t			osSemaphoreId
+
+#undef	_FS_LOCK
+#define	_FS_LOCK		8
+
+#undef	_USE_COPY
+#define	_USE_COPY		1
+
+/* Journaled write-back cache of the power cut test. The free cluster count is
+/  counted on the FAT after a mount so that the test checks the FAT itself. */
+#undef	_FS_WBCACHE
+#define	_FS_WBCACHE		16
+#undef	_FS_JOURNAL
+#define	_FS_JOURNAL		64
+#undef	_FS_NOFSINFO
+#define	_FS_NOFSINFO	1
+
+#endif /* FATFS_TEST */
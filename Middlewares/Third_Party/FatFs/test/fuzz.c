@@ -0,0 +1,192 @@
+/**
+  ******************************************************************************
+  * @file    fuzz.c
+  * @author  MCD Application Team
+  * @brief   libFuzzer entry point mounting the mutated volume images. The image
+             is mounted (find_volume), the directory tree is walked, the files
+             are read and some changes are made to the volume.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2017 STMicroelectronics. All rights reserved.
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                       opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+**/
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ff_gen_drv.h"
+#include "image_diskio.h"
+
+/* Private define ------------------------------------------------------------*/
+#define FUZZ_MAX_SECTORS  16384     /* Largest image to be mounted (8 MB) */
+#define FUZZ_MAX_DEPTH    8         /* Depth limit of the directory walk */
+#define FUZZ_MAX_ENTRIES  256       /* Number of entries visited in total */
+
+/* Private variables ---------------------------------------------------------*/
+static char DiskPath[4];
+static FATFS FatFs;
+static BYTE Buffer[4096];
+static int Entries;
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Reads a file through and seeks in it
+  */
+static void FUZZ_File(const char *path)
+{
+  FIL fil;
+  UINT br;
+  int n;
+
+  if (f_open(&fil, path, FA_READ) != FR_OK) return;
+  for (n = 0; n < 16 && f_read(&fil, Buffer, sizeof Buffer, &br) == FR_OK && br; n++) ;
+  f_lseek(&fil, f_size(&fil) / 2);
+  f_read(&fil, Buffer, 1, &br);
+  f_close(&fil);
+}
+
+/**
+  * @brief  Walks the directory tree
+  */
+static void FUZZ_Dir(char *path, UINT len, int depth)
+{
+  DIR dir;
+  FILINFO fno;
+
+  if (f_opendir(&dir, path) != FR_OK) return;
+  while (Entries < FUZZ_MAX_ENTRIES && f_readdir(&dir, &fno) == FR_OK && fno.fname[0])
+  {
+    Entries++;
+    if (len + strlen(fno.fname) + 2 > 300) continue;
+    snprintf(path + len, 300 - len, "/%s", fno.fname);
+    if (fno.fattrib & AM_DIR)
+    {
+      if (depth < FUZZ_MAX_DEPTH) FUZZ_Dir(path, (UINT)strlen(path), depth + 1);
+    }
+    else
+    {
+      FUZZ_File(path);
+    }
+    path[len] = 0;
+  }
+  f_closedir(&dir);
+}
+
+/**
+  * @brief  Takes sorted snapshots of the root directory and opens the files in it
+  */
+static void FUZZ_Snap(void)
+{
+  DIRSNAP snap;
+  FIL fil;
+  BYTE data[64];
+  UINT i, br;
+
+  if (f_snapdir(&snap, DiskPath, NULL, DS_NAME | DS_DIRFIRST, Buffer, sizeof Buffer) != FR_OK) return;
+  do
+  {
+    for (i = 0; i < snap.count; i++)
+    {
+      if (f_snapopen(&fil, &snap, i, FA_READ) == FR_OK)
+      {
+        f_read(&fil, data, sizeof data, &br);
+        f_close(&fil);
+      }
+    }
+  } while (snap.count && f_snapnext(&snap) == FR_OK);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  static BYTE *image;
+  static int linked;
+  char path[300];
+  DWORD nsect, nclst;
+  FATFS *fs;
+  FIL fil;
+  UINT bw;
+
+  if (!linked)
+  {
+    if (FATFS_LinkDriver(&IMG_Driver, DiskPath) != 0) abort();
+    image = malloc((size_t)FUZZ_MAX_SECTORS * IMG_SECTOR_SIZE);
+    if (image == NULL) abort();
+    linked = 1;
+  }
+  if (size == 0 || size > (size_t)FUZZ_MAX_SECTORS * IMG_SECTOR_SIZE) return 0;
+
+  /* Put the input into a writable image padded to the sector boundary */
+  nsect = (DWORD)((size + IMG_SECTOR_SIZE - 1) / IMG_SECTOR_SIZE);
+  memcpy(image, data, size);
+  memset(image + size, 0, (size_t)nsect * IMG_SECTOR_SIZE - size);
+  IMG_Attach(image, nsect);
+
+  if (f_mount(&FatFs, DiskPath, 1) == FR_OK)
+  {
+    Entries = 0;
+    snprintf(path, sizeof path, "%s", DiskPath);
+    path[strlen(path) - 1] = 0;    /* Remove the trailing separator */
+    FUZZ_Dir(path, (UINT)strlen(path), 0);
+    FUZZ_Snap();
+    f_getlabel(DiskPath, path, &nclst);
+    f_getfree(DiskPath, &nclst, &fs);
+
+    /* Modify the volume */
+    snprintf(path, sizeof path, "%sfuzz", DiskPath);
+    if (f_mkdir(path) == FR_OK)
+    {
+      snprintf(path, sizeof path, "%sfuzz/new file.txt", DiskPath);
+      if (f_open(&fil, path, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK)
+      {
+        memset(Buffer, 0x55, sizeof Buffer);
+        f_write(&fil, Buffer, sizeof Buffer, &bw);
+        f_close(&fil);
+      }
+      f_unlink(path);
+      snprintf(path, sizeof path, "%sfuzz", DiskPath);
+      f_unlink(path);
+    }
+    f_mount(NULL, DiskPath, 0);
+  }
+  IMG_Close();
+  return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+/**
+  * @brief  Runs the entry point on the given files (replay without libFuzzer)
+  */
+int main(int argc, char **argv)
+{
+  static uint8_t data[FUZZ_MAX_SECTORS * IMG_SECTOR_SIZE];
+  FILE *fp;
+  size_t size;
+  int i;
+
+  for (i = 1; i < argc; i++)
+  {
+    fp = fopen(argv[i], "rb");
+    if (fp == NULL)
+    {
+      printf("cannot open %s\n", argv[i]);
+      return 1;
+    }
+    size = fread(data, 1, sizeof data, fp);
+    fclose(fp);
+    LLVMFuzzerTestOneInput(data, size);
+    printf("%s: done\n", argv[i]);
+  }
+  return 0;
+}
+#endif /* FUZZ_STANDALONE */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,406 @@
+/**
+  ******************************************************************************
+  * @file    image_diskio.c
+  * @author  MCD Application Team
+  * @brief   Image file Disk I/O driver for the host benchmark and fuzz harness.
+             The volume is a memory-mapped image file (or a memory buffer) and
+             every access is counted and optionally traced at sector level.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2017 STMicroelectronics. All rights reserved.
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                       opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+**/
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "ff_gen_drv.h"
+#include "image_diskio.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Disk status */
+static volatile DSTATUS Stat = STA_NOINIT;
+/* Image in the memory */
+static BYTE *Image;
+static DWORD ImageSectors;
+/* Image file mapped by IMG_Open (-1: memory buffer given by IMG_Attach) */
+static int ImageFd = -1;
+/* Sector following the last access, to count the seeks */
+static DWORD NextSector;
+/* Access trace output (NULL: no trace) */
+static FILE *TraceFile;
+/* Time spent in each read/write access in microseconds */
+static unsigned int Latency;
+/* Number of accesses running, to trap the concurrent entries */
+static int Running;
+/* Sectors that can be written before the simulated power failure (-1: none) */
+static long CutSectors = -1;
+
+IMG_StatsTypeDef IMG_Stats;
+
+/* Private function prototypes -----------------------------------------------*/
+DSTATUS IMG_initialize (BYTE);
+DSTATUS IMG_status (BYTE);
+DRESULT IMG_read (BYTE, BYTE*, DWORD, UINT);
+#if _USE_WRITE == 1
+  DRESULT IMG_write (BYTE, const BYTE*, DWORD, UINT);
+#endif /* _USE_WRITE == 1 */
+#if _USE_IOCTL == 1
+  DRESULT IMG_ioctl (BYTE, BYTE, void*);
+#endif /* _USE_IOCTL == 1 */
+
+const Diskio_drvTypeDef IMG_Driver =
+{
+  IMG_initialize,
+  IMG_status,
+  IMG_read,
+#if  _USE_WRITE == 1
+  IMG_write,
+#endif /* _USE_WRITE == 1 */
+#if  _USE_IOCTL == 1
+  IMG_ioctl,
+#endif /* _USE_IOCTL == 1 */
+#if  _USE_ASYNC == 1
+  0,
+#endif /* _USE_ASYNC == 1 */
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Counts and traces an access to the image
+  * @param  op: 'R' for read, 'W' for write, 'Z' for zero fill
+  * @param  sector: Start sector of the access
+  * @param  count: Number of sectors
+  * @retval None
+  */
+static void IMG_Account(char op, DWORD sector, UINT count)
+{
+  if (sector != NextSector)
+  {
+    IMG_Stats.seeks++;
+  }
+  NextSector = sector + count;
+  if (TraceFile != NULL)
+  {
+    fprintf(TraceFile, "%c %lu %u\n", op, (unsigned long)sector, count);
+  }
+}
+
+/**
+  * @brief  Enters an access: counts an overlap with another one and waits
+  *         for the access latency
+  * @param  None
+  * @retval None
+  */
+static void IMG_Enter(void)
+{
+  struct timespec ts;
+
+  if (__atomic_fetch_add(&Running, 1, __ATOMIC_ACQUIRE) != 0)
+  {
+    __atomic_fetch_add(&IMG_Stats.overlaps, 1, __ATOMIC_RELAXED);
+  }
+  if (Latency)
+  {
+    ts.tv_sec = 0;
+    ts.tv_nsec = (long)Latency * 1000;
+    nanosleep(&ts, NULL);
+  }
+}
+
+/**
+  * @brief  Leaves an access
+  * @param  None
+  * @retval None
+  */
+static void IMG_Leave(void)
+{
+  __atomic_fetch_sub(&Running, 1, __ATOMIC_RELEASE);
+}
+
+/**
+  * @brief  Applies the simulated power failure to a write
+  * @param  count: Number of sectors to write
+  * @retval Number of sectors reaching the image, the following ones are lost
+  */
+static UINT IMG_Cut(UINT count)
+{
+  if (CutSectors < 0)
+  {
+    return count;
+  }
+  if ((long)count > CutSectors)
+  {
+    count = (UINT)CutSectors;
+  }
+  CutSectors -= count;
+  return count;
+}
+
+/**
+  * @brief  Maps an image file as the volume
+  * @param  path: Image file name
+  * @param  sectors: Size of the image to be created (0: use the existing size)
+  * @retval 0 on success, -1 on error
+  */
+int IMG_Open(const char *path, DWORD sectors)
+{
+  struct stat st;
+  void *p;
+
+  IMG_Close();
+  ImageFd = open(path, O_RDWR | (sectors ? O_CREAT : 0), 0644);
+  if (ImageFd < 0)
+  {
+    return -1;
+  }
+  if ((sectors && ftruncate(ImageFd, (off_t)sectors * IMG_SECTOR_SIZE) != 0)
+      || fstat(ImageFd, &st) != 0 || st.st_size < IMG_SECTOR_SIZE)
+  {
+    IMG_Close();
+    return -1;
+  }
+  p = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, ImageFd, 0);
+  if (p == MAP_FAILED)
+  {
+    IMG_Close();
+    return -1;
+  }
+  Image = p;
+  ImageSectors = (DWORD)(st.st_size / IMG_SECTOR_SIZE);
+  Stat = 0;
+  return 0;
+}
+
+/**
+  * @brief  Uses a memory buffer as the volume
+  * @param  mem: Buffer holding the image
+  * @param  sectors: Size of the buffer in unit of sector
+  * @retval None
+  */
+void IMG_Attach(BYTE *mem, DWORD sectors)
+{
+  IMG_Close();
+  Image = mem;
+  ImageSectors = sectors;
+  Stat = 0;
+}
+
+/**
+  * @brief  Releases the image
+  * @param  None
+  * @retval None
+  */
+void IMG_Close(void)
+{
+  if (ImageFd >= 0)
+  {
+    if (Image != NULL)
+    {
+      munmap(Image, (size_t)ImageSectors * IMG_SECTOR_SIZE);
+    }
+    close(ImageFd);
+    ImageFd = -1;
+  }
+  Image = NULL;
+  ImageSectors = 0;
+  Stat = STA_NOINIT;
+}
+
+/**
+  * @brief  Sets the output of the sector access trace
+  * @param  fp: Trace output (NULL: stop tracing)
+  * @retval None
+  */
+void IMG_SetTrace(FILE *fp)
+{
+  TraceFile = fp;
+}
+
+/**
+  * @brief  Clears the access counters
+  * @param  None
+  * @retval None
+  */
+void IMG_ResetStats(void)
+{
+  memset(&IMG_Stats, 0, sizeof IMG_Stats);
+}
+
+/**
+  * @brief  Sets the time taken by each read and write access, to let other
+  *         threads run while a transfer is in progress
+  * @param  us: Latency in microseconds (0: none)
+  * @retval None
+  */
+void IMG_SetLatency(unsigned int us)
+{
+  Latency = us;
+}
+
+/**
+  * @brief  Simulates a power failure: the writes stop reaching the image after
+  *         the given number of sectors, a write crossing the limit is torn and
+  *         the writes fail from then on
+  * @param  sectors: Number of sectors still written (-1: no power failure)
+  * @retval None
+  */
+void IMG_SetPowerCut(long sectors)
+{
+  CutSectors = sectors;
+}
+
+/**
+  * @brief  Initializes a Drive
+  * @param  lun : not used
+  * @retval DSTATUS: Operation status
+  */
+DSTATUS IMG_initialize(BYTE lun)
+{
+  return Stat;
+}
+
+/**
+  * @brief  Gets Disk Status
+  * @param  lun : not used
+  * @retval DSTATUS: Operation status
+  */
+DSTATUS IMG_status(BYTE lun)
+{
+  return Stat;
+}
+
+/**
+  * @brief  Reads Sector(s)
+  * @param  lun : not used
+  * @param  *buff: Data buffer to store read data
+  * @param  sector: Sector address (LBA)
+  * @param  count: Number of sectors to read
+  * @retval DRESULT: Operation result
+  */
+DRESULT IMG_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+  if (Stat & STA_NOINIT) return RES_NOTRDY;
+  if (sector >= ImageSectors || count > ImageSectors - sector) return RES_ERROR;
+
+  IMG_Enter();
+  memcpy(buff, Image + (size_t)sector * IMG_SECTOR_SIZE, (size_t)count * IMG_SECTOR_SIZE);
+  IMG_Stats.nread++;
+  IMG_Stats.sread += count;
+  IMG_Account('R', sector, count);
+  IMG_Leave();
+  return RES_OK;
+}
+
+/**
+  * @brief  Writes Sector(s)
+  * @param  lun : not used
+  * @param  *buff: Data to be written
+  * @param  sector: Sector address (LBA)
+  * @param  count: Number of sectors to write
+  * @retval DRESULT: Operation result
+  */
+#if _USE_WRITE == 1
+DRESULT IMG_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+  UINT n;
+
+  if (Stat & STA_NOINIT) return RES_NOTRDY;
+  if (sector >= ImageSectors || count > ImageSectors - sector) return RES_ERROR;
+
+  IMG_Enter();
+  n = IMG_Cut(count);
+  memcpy(Image + (size_t)sector * IMG_SECTOR_SIZE, buff, (size_t)n * IMG_SECTOR_SIZE);
+  IMG_Stats.nwrite++;
+  IMG_Stats.swrite += count;
+  IMG_Account('W', sector, count);
+  IMG_Leave();
+  return (n == count) ? RES_OK : RES_ERROR;
+}
+#endif /* _USE_WRITE == 1 */
+
+/**
+  * @brief  I/O control operation
+  * @param  lun : not used
+  * @param  cmd: Control code
+  * @param  *buff: Buffer to send/receive control data
+  * @retval DRESULT: Operation result
+  */
+#if _USE_IOCTL == 1
+DRESULT IMG_ioctl(BYTE lun, BYTE cmd, void *buff)
+{
+  DRESULT res = RES_ERROR;
+  DWORD *range;
+  UINT n;
+
+  if (Stat & STA_NOINIT) return RES_NOTRDY;
+
+  switch (cmd)
+  {
+  /* Make sure that no pending write process (the mapping is written back by the OS) */
+  case CTRL_SYNC :
+    IMG_Stats.nsync++;
+    res = RES_OK;
+    break;
+
+  /* Get number of sectors on the disk (DWORD) */
+  case GET_SECTOR_COUNT :
+    *(DWORD*)buff = ImageSectors;
+    res = RES_OK;
+    break;
+
+  /* Get R/W sector size (WORD) */
+  case GET_SECTOR_SIZE :
+    *(WORD*)buff = IMG_SECTOR_SIZE;
+    res = RES_OK;
+    break;
+
+  /* Get erase block size in unit of sector (DWORD) */
+  case GET_BLOCK_SIZE :
+    *(DWORD*)buff = 1;
+    res = RES_OK;
+    break;
+
+  /* Inform the data in the block is no longer needed (nothing to do on an image) */
+  case CTRL_TRIM :
+    res = RES_OK;
+    break;
+
+  /* Fill the sector range with zero (DWORD[2]: start and end sector) */
+  case CTRL_ZERO :
+    range = (DWORD*)buff;
+    if (range[0] <= range[1] && range[1] < ImageSectors)
+    {
+      n = IMG_Cut((UINT)(range[1] - range[0] + 1));
+      memset(Image + (size_t)range[0] * IMG_SECTOR_SIZE, 0, (size_t)n * IMG_SECTOR_SIZE);
+      IMG_Account('Z', range[0], (UINT)(range[1] - range[0] + 1));
+      res = (n == range[1] - range[0] + 1) ? RES_OK : RES_ERROR;
+    }
+    else
+    {
+      res = RES_PARERR;
+    }
+    break;
+
+  default:
+    res = RES_PARERR;
+  }
+
+  return res;
+}
+#endif /* _USE_IOCTL == 1 */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
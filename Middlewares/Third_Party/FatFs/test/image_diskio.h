@@ -0,0 +1,57 @@
+/**
+  ******************************************************************************
+  * @file    image_diskio.h
+  * @author  MCD Application Team
+  * @brief   Header for image_diskio.c module. Image file disk driver used by
+             the host benchmark and fuzz harness.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2017 STMicroelectronics. All rights reserved.
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                       opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+**/
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __IMAGE_DISKIO_H
+#define __IMAGE_DISKIO_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include "ff_gen_drv.h"
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  unsigned long nread;    /*!< Number of disk_read calls                        */
+  unsigned long sread;    /*!< Number of sectors read                           */
+  unsigned long nwrite;   /*!< Number of disk_write calls                       */
+  unsigned long swrite;   /*!< Number of sectors written                        */
+  unsigned long seeks;    /*!< Number of accesses not following the last one    */
+  unsigned long nsync;    /*!< Number of CTRL_SYNC requests                     */
+  unsigned long overlaps; /*!< Number of accesses entered while another one was running */
+} IMG_StatsTypeDef;
+
+/* Exported constants --------------------------------------------------------*/
+/* Sector size of the image in bytes */
+#define IMG_SECTOR_SIZE           512
+
+/* Exported functions ------------------------------------------------------- */
+extern const Diskio_drvTypeDef  IMG_Driver;
+extern IMG_StatsTypeDef         IMG_Stats;
+
+int  IMG_Open(const char *path, DWORD sectors);
+void IMG_Attach(BYTE *mem, DWORD sectors);
+void IMG_Close(void);
+void IMG_SetTrace(FILE *fp);
+void IMG_ResetStats(void);
+void IMG_SetLatency(unsigned int us);
+void IMG_SetPowerCut(long sectors);
+
+#endif /* __IMAGE_DISKIO_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
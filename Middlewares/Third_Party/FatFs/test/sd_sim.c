@@ -0,0 +1,300 @@
+/**
+  ******************************************************************************
+  * @file    sd_sim.c
+  * @author  MCD Application Team
+  * @brief   Simulated SD card of the BSP v1 API, for the host tests of the SD
+             disk I/O driver templates.
+             A transfer is run by a DMA thread which copies the blocks and
+             calls the completion callback of the driver, the card being busy
+             meanwhile. The D-Cache model assumes that the bytes written by
+             the CPU are held in dirty lines: invalidating a line that has not
+             been cleaned during the operation loses the bytes of the line not
+             written by a DMA transfer (they are overwritten with 0xEE and
+             counted), and a DMA write from a line not cleaned is counted as
+             stale.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2017 STMicroelectronics. All rights reserved.
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                       opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+**/
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "sd_sim.h"
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  uintptr_t start;
+  uintptr_t end;
+} SIM_RangeTypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define SIM_RANGES        64        /* Ranges tracked during an operation */
+#define SIM_DMA_DELAY_NS  20000     /* Duration of a DMA transfer */
+
+/* Private variables ---------------------------------------------------------*/
+SIM_StatsTypeDef SIM_Stats;
+
+static uint8_t *Card;
+static uint32_t CardBlocks;
+
+/* Transfer in progress, handed to the DMA thread */
+static pthread_t DmaThread;
+static pthread_mutex_t DmaLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t DmaCond = PTHREAD_COND_INITIALIZER;
+static struct
+{
+  uint8_t *buff;
+  uint32_t block;
+  uint32_t count;
+  int write;
+} DmaRequest;
+static int DmaPending;
+static int DmaQuit;
+static int Busy;
+
+/* Lines cleaned and bytes filled by the DMA since SIM_Reset() */
+static SIM_RangeTypeDef Cleaned[SIM_RANGES];
+static SIM_RangeTypeDef Filled[SIM_RANGES];
+static unsigned int NumCleaned, NumFilled;
+
+/* Private functions ---------------------------------------------------------*/
+
+static void SIM_AddRange(SIM_RangeTypeDef *list, unsigned int *num, uintptr_t start, uintptr_t end)
+{
+  if (*num < SIM_RANGES)
+  {
+    list[*num].start = start;
+    list[*num].end = end;
+    (*num)++;
+  }
+}
+
+static int SIM_InRange(const SIM_RangeTypeDef *list, unsigned int num, uintptr_t start, uintptr_t end)
+{
+  unsigned int i;
+
+  for (i = 0; i < num; i++)
+  {
+    if (start >= list[i].start && end <= list[i].end) return 1;
+  }
+  return 0;
+}
+
+static uintptr_t SIM_LineStart(const void *addr)
+{
+  return (uintptr_t)addr & ~(uintptr_t)(SIM_CACHE_LINE - 1);
+}
+
+static uintptr_t SIM_LineEnd(const void *addr, int32_t size)
+{
+  return ((uintptr_t)addr + size + SIM_CACHE_LINE - 1) & ~(uintptr_t)(SIM_CACHE_LINE - 1);
+}
+
+/**
+  * @brief  DMA thread: runs the transfers and signals their completion
+  */
+static void *SIM_DmaThread(void *arg)
+{
+  struct timespec ts = { 0, SIM_DMA_DELAY_NS };
+  int write;
+
+  (void)arg;
+  pthread_mutex_lock(&DmaLock);
+  for (;;)
+  {
+    while (!DmaPending && !DmaQuit) pthread_cond_wait(&DmaCond, &DmaLock);
+    if (DmaQuit) break;
+    pthread_mutex_unlock(&DmaLock);
+
+    nanosleep(&ts, NULL);
+    write = DmaRequest.write;
+    if (write)
+    {
+      memcpy(Card + (size_t)DmaRequest.block * BLOCKSIZE, DmaRequest.buff, (size_t)DmaRequest.count * BLOCKSIZE);
+    }
+    else
+    {
+      memcpy(DmaRequest.buff, Card + (size_t)DmaRequest.block * BLOCKSIZE, (size_t)DmaRequest.count * BLOCKSIZE);
+    }
+
+    pthread_mutex_lock(&DmaLock);
+    DmaPending = 0;
+    pthread_mutex_unlock(&DmaLock);
+    __atomic_store_n(&Busy, 0, __ATOMIC_RELEASE);
+
+    /* the interrupt of the end of transfer */
+    if (write)
+    {
+      BSP_SD_WriteCpltCallback();
+    }
+    else
+    {
+      BSP_SD_ReadCpltCallback();
+    }
+    pthread_mutex_lock(&DmaLock);
+  }
+  pthread_mutex_unlock(&DmaLock);
+  return NULL;
+}
+
+/**
+  * @brief  Checks and starts a DMA transfer
+  */
+static uint8_t SIM_StartDma(uint32_t *pData, uint32_t addr, uint32_t count, int write)
+{
+  uintptr_t start = (uintptr_t)pData;
+  uintptr_t end = start + (uintptr_t)count * BLOCKSIZE;
+
+  if (__atomic_load_n(&Busy, __ATOMIC_ACQUIRE) || count == 0 || addr + count > CardBlocks)
+  {
+    return MSD_ERROR;
+  }
+  if (start & 3)
+  {
+    SIM_Stats.unaligned++;
+    return MSD_ERROR;
+  }
+
+  if (write)
+  {
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+    if (!SIM_InRange(Cleaned, NumCleaned, SIM_LineStart(pData), SIM_LineEnd(pData, count * BLOCKSIZE)))
+    {
+      SIM_Stats.stale++;
+    }
+#endif
+    SIM_Stats.writes++;
+  }
+  else
+  {
+    SIM_AddRange(Filled, &NumFilled, start, end);
+    SIM_Stats.reads++;
+  }
+  SIM_Stats.sectors += count;
+
+  __atomic_store_n(&Busy, 1, __ATOMIC_RELEASE);
+  pthread_mutex_lock(&DmaLock);
+  DmaRequest.buff = (uint8_t*)pData;
+  DmaRequest.block = addr;
+  DmaRequest.count = count;
+  DmaRequest.write = write;
+  DmaPending = 1;
+  pthread_cond_signal(&DmaCond);
+  pthread_mutex_unlock(&DmaLock);
+  return MSD_OK;
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Attaches the card memory and starts the DMA thread
+  * @param  card: Content of the card
+  * @param  blocks: Number of blocks of the card
+  */
+void SIM_Init(uint8_t *card, uint32_t blocks)
+{
+  Card = card;
+  CardBlocks = blocks;
+  DmaQuit = 0;
+  pthread_create(&DmaThread, NULL, SIM_DmaThread, NULL);
+  SIM_Reset();
+}
+
+/**
+  * @brief  Starts an operation: clears the counters and the cache state
+  */
+void SIM_Reset(void)
+{
+  memset(&SIM_Stats, 0, sizeof SIM_Stats);
+  NumCleaned = NumFilled = 0;
+}
+
+/**
+  * @brief  Stops the DMA thread
+  */
+void SIM_Deinit(void)
+{
+  pthread_mutex_lock(&DmaLock);
+  DmaQuit = 1;
+  pthread_cond_signal(&DmaCond);
+  pthread_mutex_unlock(&DmaLock);
+  pthread_join(DmaThread, NULL);
+}
+
+uint8_t BSP_SD_Init(void)
+{
+  return MSD_OK;
+}
+
+uint8_t BSP_SD_GetCardState(void)
+{
+  return __atomic_load_n(&Busy, __ATOMIC_ACQUIRE) ? SD_TRANSFER_BUSY : SD_TRANSFER_OK;
+}
+
+void BSP_SD_GetCardInfo(BSP_SD_CardInfo *CardInfo)
+{
+  CardInfo->LogBlockNbr = CardBlocks;
+  CardInfo->LogBlockSize = BLOCKSIZE;
+}
+
+uint8_t BSP_SD_ReadBlocks_DMA(uint32_t *pData, uint32_t ReadAddr, uint32_t NumOfBlocks)
+{
+  return SIM_StartDma(pData, ReadAddr, NumOfBlocks, 0);
+}
+
+uint8_t BSP_SD_WriteBlocks_DMA(uint32_t *pData, uint32_t WriteAddr, uint32_t NumOfBlocks)
+{
+  return SIM_StartDma(pData, WriteAddr, NumOfBlocks, 1);
+}
+
+uint8_t BSP_SD_Erase(uint32_t StartAddr, uint32_t EndAddr)
+{
+  if (StartAddr > EndAddr || EndAddr >= CardBlocks)
+  {
+    return MSD_ERROR;
+  }
+  memset(Card + (size_t)StartAddr * BLOCKSIZE, 0, (size_t)(EndAddr - StartAddr + 1) * BLOCKSIZE);
+  return MSD_OK;
+}
+
+void SCB_CleanDCache_by_Addr(uint32_t *addr, int32_t dsize)
+{
+  SIM_AddRange(Cleaned, &NumCleaned, SIM_LineStart(addr), SIM_LineEnd(addr, dsize));
+}
+
+void SCB_CleanInvalidateDCache_by_Addr(uint32_t *addr, int32_t dsize)
+{
+  SIM_AddRange(Cleaned, &NumCleaned, SIM_LineStart(addr), SIM_LineEnd(addr, dsize));
+}
+
+void SCB_InvalidateDCache_by_Addr(uint32_t *addr, int32_t dsize)
+{
+  uintptr_t line, b;
+
+  for (line = SIM_LineStart(addr); line < SIM_LineEnd(addr, dsize); line += SIM_CACHE_LINE)
+  {
+    if (SIM_InRange(Cleaned, NumCleaned, line, line + SIM_CACHE_LINE)) continue;
+
+    /* the dirty bytes of the line are dropped, keep only the DMA data */
+    for (b = line; b < line + SIM_CACHE_LINE; b++)
+    {
+      if (!SIM_InRange(Filled, NumFilled, b, b + 1))
+      {
+        *(uint8_t*)b = 0xEE;
+        SIM_Stats.lost++;
+      }
+    }
+  }
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
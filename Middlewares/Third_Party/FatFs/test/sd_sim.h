@@ -0,0 +1,85 @@
+/**
+  ******************************************************************************
+  * @file    sd_sim.h
+  * @author  MCD Application Team
+  * @brief   Simulated SD card of the BSP v1 API, for the host tests of the SD
+             disk I/O driver templates. The DMA transfers run on a thread and
+             complete through the BSP callbacks, and a model of the D-Cache
+             reports the data lost by a wrong cache maintenance.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2017 STMicroelectronics. All rights reserved.
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                       opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+**/
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SD_SIM_H
+#define __SD_SIM_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define MSD_OK                    ((uint8_t)0x00)
+#define MSD_ERROR                 ((uint8_t)0x01)
+
+#define SD_TRANSFER_OK            ((uint8_t)0x00)
+#define SD_TRANSFER_BUSY          ((uint8_t)0x01)
+
+#define BLOCKSIZE                 512
+#define SIM_CACHE_LINE            32
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  uint32_t LogBlockNbr;             /* Card capacity in blocks */
+  uint32_t LogBlockSize;            /* Block size in bytes */
+} BSP_SD_CardInfo;
+
+typedef struct
+{
+  unsigned long reads;              /* Read DMA transfers */
+  unsigned long writes;             /* Write DMA transfers */
+  unsigned long sectors;            /* Sectors transferred */
+  unsigned long unaligned;          /* Transfers refused, buffer not 4-Byte aligned */
+  unsigned long lost;               /* Bytes lost by the invalidation of a dirty line */
+  unsigned long stale;              /* Write transfers from lines not cleaned */
+} SIM_StatsTypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+#define ALIGN_32BYTES(buf)        buf __attribute__ ((aligned (32)))
+#define __ALIGN_BEGIN
+#define __ALIGN_END               __attribute__ ((aligned (4)))
+
+/* Exported variables --------------------------------------------------------*/
+extern SIM_StatsTypeDef SIM_Stats;
+
+/* Exported functions ------------------------------------------------------- */
+void SIM_Init(uint8_t *card, uint32_t blocks);
+void SIM_Reset(void);
+void SIM_Deinit(void);
+
+uint8_t BSP_SD_Init(void);
+uint8_t BSP_SD_GetCardState(void);
+void BSP_SD_GetCardInfo(BSP_SD_CardInfo *CardInfo);
+uint8_t BSP_SD_ReadBlocks_DMA(uint32_t *pData, uint32_t ReadAddr, uint32_t NumOfBlocks);
+uint8_t BSP_SD_WriteBlocks_DMA(uint32_t *pData, uint32_t WriteAddr, uint32_t NumOfBlocks);
+uint8_t BSP_SD_Erase(uint32_t StartAddr, uint32_t EndAddr);
+
+/* Implemented by the driver */
+void BSP_SD_ReadCpltCallback(void);
+void BSP_SD_WriteCpltCallback(void);
+
+void SCB_CleanDCache_by_Addr(uint32_t *addr, int32_t dsize);
+void SCB_InvalidateDCache_by_Addr(uint32_t *addr, int32_t dsize);
+void SCB_CleanInvalidateDCache_by_Addr(uint32_t *addr, int32_t dsize);
+
+#endif /* __SD_SIM_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,320 @@
+/**
+  ******************************************************************************
+  * @file    sd_test.c
+  * @author  MCD Application Team
+  * @brief   Host tests of the SD DMA RTOS bounce driver template
+             (sd_diskio_dma_rtos_bounce_template_bspv1.c) on the simulated SD
+             card of sd_sim.c. Built as fatfs_sdtest, and as
+             fatfs_sdtest_cache with ENABLE_SD_DMA_CACHE_MAINTENANCE.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2017 STMicroelectronics. All rights reserved.
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                       opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+**/
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ff_gen_drv.h"
+#include "sd_diskio_dma_rtos_bounce.h"
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  const char *name;
+  int (*func)(void);
+} TEST_TestTypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define TEST_BLOCKS       8192      /* 4MB card */
+#define TEST_MAX_COUNT    128       /* Sectors of a request at most */
+#define TEST_GUARD        64        /* Guard bytes around the user buffer */
+#define TEST_LOOPS        3000      /* Random requests of the read and write tests */
+#define TEST_BOUNCE       8         /* SD_BOUNCE_SECTORS of the driver */
+#define TEST_FILE_SIZE    (256UL * 1024)
+
+/* Counts a failed check and reports it */
+#define TEST_ASSERT(expr)  do { if (!(expr)) { printf("  %s:%d: %s\n", __FILE__, __LINE__, #expr); Failures++; } } while (0)
+/* Checks a FatFs call and leaves the test when it fails */
+#define CHECK(expr)  do { FRESULT res_ = (expr); if (res_ != FR_OK) { printf("  %s:%d: %s failed (%d)\n", __FILE__, __LINE__, #expr, res_); return ++Failures; } } while (0)
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t *Card;
+static uint8_t *Shadow;             /* Expected content of the card */
+ALIGN_32BYTES(static uint8_t Area[TEST_GUARD + TEST_MAX_COUNT * BLOCKSIZE + TEST_GUARD]);
+static char DiskPath[4];
+static FATFS FatFs;
+static FIL File;
+static BYTE Work[_MAX_SS * 16];
+static int Failures;
+
+/* Private function prototypes -----------------------------------------------*/
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Draws the size of a request, mostly short ones
+  */
+static UINT TEST_Count(void)
+{
+  return (rand() % 4) ? 1 + rand() % 16 : 1 + rand() % TEST_MAX_COUNT;
+}
+
+/**
+  * @brief  Number of DMA transfers expected for a request
+  * @param  buff: User buffer of the request
+  * @param  count: Number of sectors
+  * @param  write: 1 for a write request
+  */
+static unsigned long TEST_Transfers(const uint8_t *buff, UINT count, int write)
+{
+  if ((uintptr_t)buff & 3)
+  {
+    /* the whole request goes through the bounce pool */
+    return (count + TEST_BOUNCE - 1) / TEST_BOUNCE;
+  }
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+  if (!write && ((uintptr_t)buff & (SIM_CACHE_LINE - 1)))
+  {
+    /* first and last sectors bounced, inner sectors read directly */
+    return (count > 2) ? 3 : 1;
+  }
+#else
+  (void)write;
+#endif
+  return 1;
+}
+
+/**
+  * @brief  Checks that the guard bytes around the user buffer are untouched
+  */
+static int TEST_CheckGuards(const uint8_t *buff, UINT count)
+{
+  const uint8_t *p;
+
+  for (p = Area; p < buff; p++)
+  {
+    if (*p != 0xA5) return 0;
+  }
+  for (p = buff + count * BLOCKSIZE; p < Area + sizeof Area; p++)
+  {
+    if (*p != 0xA5) return 0;
+  }
+  return 1;
+}
+
+/**
+  * @brief  Random reads at every alignment of the user buffer
+  */
+static int TEST_Read(void)
+{
+  uint8_t *buff;
+  DWORD sector;
+  UINT i, count;
+
+  for (i = 0; i < TEST_LOOPS; i++)
+  {
+    count = TEST_Count();
+    sector = rand() % (TEST_BLOCKS - count + 1);
+    buff = Area + TEST_GUARD - 32 + rand() % 64;
+    memset(Area, 0xA5, sizeof Area);
+
+    SIM_Reset();
+    TEST_ASSERT(SD_Driver.disk_read(0, buff, sector, count) == RES_OK);
+    TEST_ASSERT(memcmp(buff, Card + sector * BLOCKSIZE, count * BLOCKSIZE) == 0);
+    TEST_ASSERT(TEST_CheckGuards(buff, count));
+    TEST_ASSERT(SIM_Stats.reads == TEST_Transfers(buff, count, 0));
+    TEST_ASSERT(SIM_Stats.sectors == count);
+    TEST_ASSERT(SIM_Stats.unaligned == 0);
+    TEST_ASSERT(SIM_Stats.lost == 0);
+    if (Failures)
+    {
+      printf("  read of %u sectors at offset %d\n", count, (int)((uintptr_t)buff & 31));
+      break;
+    }
+  }
+  return Failures;
+}
+
+/**
+  * @brief  Random writes at every alignment of the user buffer
+  */
+static int TEST_Write(void)
+{
+  uint8_t *buff;
+  DWORD sector;
+  UINT i, j, count;
+
+  for (i = 0; i < TEST_LOOPS; i++)
+  {
+    count = TEST_Count();
+    sector = rand() % (TEST_BLOCKS - count + 1);
+    buff = Area + TEST_GUARD - 32 + rand() % 64;
+    memset(Area, 0xA5, sizeof Area);
+    for (j = 0; j < count * BLOCKSIZE; j++)
+    {
+      buff[j] = (uint8_t)rand();
+    }
+    memcpy(Shadow + sector * BLOCKSIZE, buff, count * BLOCKSIZE);
+
+    SIM_Reset();
+    TEST_ASSERT(SD_Driver.disk_write(0, buff, sector, count) == RES_OK);
+    TEST_ASSERT(memcmp(Card + sector * BLOCKSIZE, buff, count * BLOCKSIZE) == 0);
+    TEST_ASSERT(TEST_CheckGuards(buff, count));
+    TEST_ASSERT(SIM_Stats.writes == TEST_Transfers(buff, count, 1));
+    TEST_ASSERT(SIM_Stats.sectors == count);
+    TEST_ASSERT(SIM_Stats.unaligned == 0);
+    TEST_ASSERT(SIM_Stats.stale == 0);
+    if (Failures)
+    {
+      printf("  write of %u sectors at offset %d\n", count, (int)((uintptr_t)buff & 31));
+      break;
+    }
+  }
+  /* the writes only changed their own sectors */
+  TEST_ASSERT(memcmp(Card, Shadow, (size_t)TEST_BLOCKS * BLOCKSIZE) == 0);
+  return Failures;
+}
+
+/**
+  * @brief  Transfers of the largest request, for each kind of buffer
+  */
+static int TEST_Transfer(void)
+{
+  static const struct
+  {
+    int ofs;                        /* Offset of the buffer from a cache line */
+    unsigned long reads;
+  } cases[] =
+  {
+    { 0,  1 },
+    { 1,  TEST_MAX_COUNT / TEST_BOUNCE },
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+    { 4,  3 },
+#else
+    { 4,  1 },
+#endif
+  };
+  unsigned int i;
+
+  for (i = 0; i < sizeof cases / sizeof cases[0]; i++)
+  {
+    SIM_Reset();
+    TEST_ASSERT(SD_Driver.disk_read(0, Area + TEST_GUARD + cases[i].ofs, 0, TEST_MAX_COUNT) == RES_OK);
+    TEST_ASSERT(SIM_Stats.reads == cases[i].reads);
+  }
+
+  /* an unaligned write is bounced in chunks too */
+  SIM_Reset();
+  TEST_ASSERT(SD_Driver.disk_write(0, Area + TEST_GUARD + 1, 0, TEST_MAX_COUNT) == RES_OK);
+  TEST_ASSERT(SIM_Stats.writes == TEST_MAX_COUNT / TEST_BOUNCE);
+  return Failures;
+}
+
+/**
+  * @brief  FatFs on the driver: a file written and read back from unaligned
+  *         buffers, which are passed to the driver for the whole sectors
+  */
+static int TEST_FatFs(void)
+{
+  static BYTE buffer[32768 + 3];
+  DWORD ofs;
+  UINT n, i, bw, br;
+  unsigned long reads = 0, sectors = 0;
+
+  CHECK(f_mkfs(DiskPath, FM_FAT | FM_SFD, 4096, Work, sizeof Work));
+  CHECK(f_mount(&FatFs, DiskPath, 1));
+
+  CHECK(f_open(&File, "test.bin", FA_WRITE | FA_CREATE_ALWAYS));
+  for (ofs = 0; ofs < TEST_FILE_SIZE; ofs += n)
+  {
+    n = 1 + rand() % 32768;
+    if (n > TEST_FILE_SIZE - ofs) n = TEST_FILE_SIZE - ofs;
+    for (i = 0; i < n; i++) buffer[1 + i] = (BYTE)((ofs + i) * 13 + ((ofs + i) >> 9));
+    CHECK(f_write(&File, buffer + 1, n, &bw));
+    TEST_ASSERT(bw == n);
+  }
+  CHECK(f_close(&File));
+
+  CHECK(f_open(&File, "test.bin", FA_READ));
+  for (ofs = 0; ofs < TEST_FILE_SIZE; ofs += n)
+  {
+    n = 1 + rand() % 32768;
+    SIM_Reset();
+    CHECK(f_read(&File, buffer + 3, n, &br));
+    reads += SIM_Stats.reads;
+    sectors += SIM_Stats.sectors;
+    TEST_ASSERT(SIM_Stats.unaligned == 0);
+    TEST_ASSERT(SIM_Stats.lost == 0);
+    n = br;
+    for (i = 0; i < n; i++)
+    {
+      if (buffer[3 + i] != (BYTE)((ofs + i) * 13 + ((ofs + i) >> 9))) break;
+    }
+    TEST_ASSERT(i == n);
+  }
+  TEST_ASSERT(ofs == TEST_FILE_SIZE);
+  CHECK(f_close(&File));
+  printf("  %lu sectors read in %lu DMA transfers\n", sectors, reads);
+  return Failures;
+}
+
+int main(int argc, char **argv)
+{
+  static const TEST_TestTypeDef tests[] =
+  {
+    { "read",        TEST_Read },
+    { "write",       TEST_Write },
+    { "transfer",    TEST_Transfer },
+    { "fatfs",       TEST_FatFs },
+  };
+  unsigned int i;
+  int n, failed = 0, run = 0;
+
+  Card = malloc((size_t)TEST_BLOCKS * BLOCKSIZE);
+  Shadow = malloc((size_t)TEST_BLOCKS * BLOCKSIZE);
+  if (Card == NULL || Shadow == NULL) return 1;
+  for (i = 0; i < TEST_BLOCKS * BLOCKSIZE; i++)
+  {
+    Card[i] = (uint8_t)(i * 7 + (i >> 9));
+  }
+  memcpy(Shadow, Card, (size_t)TEST_BLOCKS * BLOCKSIZE);
+
+  SIM_Init(Card, TEST_BLOCKS);
+  if (FATFS_LinkDriver(&SD_Driver, DiskPath) != 0 || SD_Driver.disk_initialize(0) != 0) return 1;
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+  printf("cache maintenance enabled\n");
+#endif
+
+  for (i = 0; i < sizeof tests / sizeof tests[0]; i++)
+  {
+    for (n = 1; n < argc && strcmp(argv[n], tests[i].name); n++) ;
+    if (argc > 1 && n == argc) continue;  /* Not selected on the command line */
+    printf("%s\n", tests[i].name);
+    Failures = 0;
+    srand(1);
+    tests[i].func();
+    f_mount(NULL, DiskPath, 0);
+    run++;
+    if (Failures)
+    {
+      printf("  FAILED\n");
+      failed++;
+    }
+  }
+  printf("%d tests, %d failed\n", run, failed);
+
+  FATFS_UnLinkDriver(DiskPath);
+  SIM_Deinit();
+  free(Shadow);
+  free(Card);
+  return failed ? 1 : 0;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,863 @@
+/**
+  ******************************************************************************
+  * @file    test.c
+  * @author  MCD Application Team
+  * @brief   Host functional tests of FatFs on a RAM disk. Each test checks the
+             behavior of an option that the benchmark only measures.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2017 STMicroelectronics. All rights reserved.
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                       opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+**/
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "ff_gen_drv.h"
+#include "image_diskio.h"
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  const char *name;
+  int (*func)(void);
+} TEST_TestTypeDef;
+
+/* State of a thread of the stress test */
+typedef struct
+{
+  pthread_t thread;
+  int n;                            /* Thread number */
+  unsigned int seed;                /* Random seed of the thread */
+  unsigned long ops;                /* Number of operations done */
+  unsigned long errors;             /* Number of failed operations */
+} TEST_ThreadTypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define TEST_SECTORS      163840    /* 80MB, large enough for FAT32 at 512 bytes cluster */
+#define TEST_STREAM_SIZE  (256UL * 1024)
+#define TEST_STREAM_REFS  64        /* Blocks held by the stream consumer at a time */
+#define TEST_READERS      4         /* Reader threads of the stress test */
+#define TEST_READER_SIZE  (256UL * 1024)
+#define TEST_READER_LOOPS 4         /* Times each reader reads its file */
+#define TEST_UNLOCK_LATENCY 300000  /* Latency of the disk in the unlocked read test [us] */
+#define TEST_CUT_SECTORS  69632     /* 34MB, the smallest FAT32 volume at 512 bytes cluster */
+#define TEST_CUT_OPS      40        /* Operations of the power cut scenario */
+#define TEST_COPY_CHUNK   4096      /* Transfer buffer size of the copy test */
+#define TEST_COPY_LOOPS   200       /* Copies of each size */
+#define TEST_ASYNC_SIZE   30000     /* File read by the chained asynchronous reads */
+#define TEST_ASYNC_START  100       /* Offset of the first read, not on a sector boundary */
+#define TEST_ASYNC_CHUNK  4096      /* Bytes requested by each read */
+
+/* Counts a failed check and reports it */
+#define TEST_ASSERT(expr)  do { if (!(expr)) { printf("  %s:%d: %s\n", __FILE__, __LINE__, #expr); Failures++; } } while (0)
+/* Checks a FatFs call and leaves the test when it fails */
+#define CHECK(expr)  do { FRESULT res_ = (expr); if (res_ != FR_OK) { printf("  %s:%d: %s failed (%d)\n", __FILE__, __LINE__, #expr, res_); return ++Failures; } } while (0)
+
+/* Result of the read of the unlocked read test */
+typedef struct
+{
+  pthread_t thread;
+  FRESULT res;
+  UINT br;
+} TEST_ReadTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+static char DiskPath[4];
+static FATFS FatFs;
+static FIL File;
+static BYTE *Image;
+static BYTE Work[_MAX_SS * 64];
+static BYTE Buffer[32768];
+static int Failures;
+static int StressDone;
+
+#if _USE_STREAM
+/* Blocks passed to the stream consumer and not released yet */
+static struct
+{
+  const BYTE *ptr;
+  UINT len;
+} StreamRefs[TEST_STREAM_REFS];
+static UINT StreamHeld;
+#endif
+
+#if _USE_ASYNC
+/* State of the chained asynchronous reads */
+static DWORD AsyncOfs;              /* File offset of the next read */
+static UINT AsyncCalls;             /* Completions */
+static FRESULT AsyncRes;            /* First error */
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Makes a path on the test drive
+  */
+static const char *TEST_Path(const char *fmt, int n)
+{
+  static char path[64];
+  int len;
+
+  len = snprintf(path, sizeof path, "%s", DiskPath);
+  snprintf(path + len, sizeof path - len, fmt, n);
+  return path;
+}
+
+/**
+  * @brief  Fills the buffer with a pattern depending on the file offset
+  */
+static void TEST_Pattern(BYTE *buff, UINT len, DWORD ofs)
+{
+  UINT i;
+
+  for (i = 0; i < len; i++)
+  {
+    buff[i] = (BYTE)((ofs + i) * 7 + ((ofs + i) >> 9));
+  }
+}
+
+/**
+  * @brief  Checks the buffer against the pattern
+  */
+static int TEST_CheckPattern(const BYTE *buff, UINT len, DWORD ofs)
+{
+  UINT i;
+
+  for (i = 0; i < len; i++)
+  {
+    if (buff[i] != (BYTE)((ofs + i) * 7 + ((ofs + i) >> 9))) return 0;
+  }
+  return 1;
+}
+
+/**
+  * @brief  Creates a file filled with the pattern
+  * @param  base: Offset of the pattern at the start of the file
+  */
+static FRESULT TEST_MakeFile(const char *path, DWORD size, DWORD base)
+{
+  DWORD ofs;
+  UINT bw, n;
+  FRESULT res;
+
+  res = f_open(&File, path, FA_WRITE | FA_CREATE_ALWAYS);
+  for (ofs = 0; res == FR_OK && ofs < size; ofs += n)
+  {
+    n = size - ofs < sizeof Buffer ? (UINT)(size - ofs) : sizeof Buffer;
+    TEST_Pattern(Buffer, n, base + ofs);
+    res = f_write(&File, Buffer, n, &bw);
+    if (res == FR_OK && bw != n) res = FR_DENIED;
+  }
+  if (res == FR_OK) res = f_close(&File);
+  return res;
+}
+
+/**
+  * @brief  Creates a new FAT32 volume on the RAM disk and mounts it
+  * @param  sectors: Size of the volume, TEST_SECTORS at most
+  */
+static FRESULT TEST_Format(DWORD sectors)
+{
+  FRESULT res;
+
+  f_mount(NULL, DiskPath, 0);
+  memset(Image, 0, (size_t)sectors * IMG_SECTOR_SIZE);
+  IMG_Attach(Image, sectors);
+  res = f_mkfs(DiskPath, FM_FAT32 | FM_SFD, 512, Work, sizeof Work);
+  if (res == FR_OK) res = f_mount(&FatFs, DiskPath, 1);
+  return res;
+}
+
+#if _USE_STREAM
+/**
+  * @brief  Stream consumer holding each block until it is released
+  * @param  ptr: Block of data (NULL: query if the consumer is ready)
+  * @param  len: Length of the block
+  * @retval Number of bytes accepted (ready state on query)
+  */
+static UINT TEST_StreamFunc(const BYTE *ptr, UINT len)
+{
+  if (len == 0) return StreamHeld < TEST_STREAM_REFS;
+  StreamRefs[StreamHeld].ptr = ptr;
+  StreamRefs[StreamHeld].len = len;
+  StreamHeld++;
+  return len;
+}
+
+/**
+  * @brief  Checks the held blocks against the file data and releases them
+  * @param  ofs: File offset of the first held block, advanced past the blocks
+  */
+static void TEST_StreamRelease(DWORD *ofs)
+{
+  const BYTE *pool = (const BYTE*)FatFs.rabuf;
+  UINT i;
+
+  for (i = 0; i < StreamHeld; i++)
+  {
+    /* The consumer gets references into the read-ahead pool, not copies */
+    TEST_ASSERT(StreamRefs[i].ptr >= pool);
+    TEST_ASSERT(StreamRefs[i].ptr + StreamRefs[i].len <= pool + _FS_RDAHEAD * _MAX_SS);
+    TEST_ASSERT(TEST_CheckPattern(StreamRefs[i].ptr, StreamRefs[i].len, *ofs));
+    *ofs += StreamRefs[i].len;
+    TEST_ASSERT(f_release(&FatFs) == FR_OK);
+  }
+  StreamHeld = 0;
+  TEST_ASSERT(f_release(&FatFs) == FR_INVALID_OBJECT);
+}
+#endif
+
+/**
+  * @brief  Streams a file through f_stream() with the blocks held by the
+  *         consumer, and reads another file while the pool is held
+  */
+static int TEST_Stream(void)
+{
+#if _USE_STREAM
+  static FIL other;
+  DWORD ofs = 0, rofs, sect;
+  UINT bf, br;
+  int stalls = 0;
+
+  CHECK(TEST_Format(TEST_SECTORS));
+  CHECK(TEST_MakeFile(TEST_Path("stream.bin", 0), TEST_STREAM_SIZE, 0));
+  CHECK(TEST_MakeFile(TEST_Path("other.bin", 0), TEST_STREAM_SIZE, 0));
+  CHECK(f_open(&File, TEST_Path("stream.bin", 0), FA_READ));
+  CHECK(f_open(&other, TEST_Path("other.bin", 0), FA_READ));
+
+  /* Start in the middle of a sector */
+  CHECK(f_read(&File, Buffer, 100, &br));
+  TEST_ASSERT(br == 100 && TEST_CheckPattern(Buffer, br, 0));
+  ofs = 100;
+
+  while (ofs < TEST_STREAM_SIZE)
+  {
+    IMG_ResetStats();
+    CHECK(f_stream(&File, TEST_StreamFunc, TEST_STREAM_SIZE, &bf));
+    TEST_ASSERT(bf > 0 && StreamHeld > 0);
+    /* The pool is refilled by multi-sector reads only */
+    TEST_ASSERT(IMG_Stats.sread >= IMG_Stats.nread);
+    TEST_ASSERT(IMG_Stats.nwrite == 0);
+
+    /* The pool is held: f_stream() stops, f_read() loads single sectors
+       into its own buffer and the held data stays intact */
+    if (ofs + bf < TEST_STREAM_SIZE && StreamHeld < TEST_STREAM_REFS)
+    {
+      IMG_ResetStats();
+      CHECK(f_stream(&File, TEST_StreamFunc, TEST_STREAM_SIZE, &bf));
+      TEST_ASSERT(bf == 0 && IMG_Stats.nread == 0);
+      stalls++;
+    }
+    rofs = (DWORD)(rand() % (TEST_STREAM_SIZE - 600));
+    IMG_ResetStats();
+    CHECK(f_lseek(&other, rofs));
+    CHECK(f_read(&other, Buffer, 600, &br));
+    TEST_ASSERT(br == 600 && TEST_CheckPattern(Buffer, br, rofs));
+    TEST_ASSERT(IMG_Stats.nread == IMG_Stats.sread);
+    TEST_StreamRelease(&ofs);
+  }
+  TEST_ASSERT(ofs == TEST_STREAM_SIZE);
+  TEST_ASSERT(f_tell(&File) == TEST_STREAM_SIZE);
+  TEST_ASSERT(stalls > 0);
+
+  /* f_read() refills the pool again after the release */
+  IMG_ResetStats();
+  CHECK(f_lseek(&other, 1000));
+  CHECK(f_read(&other, Buffer, 100, &br));
+  TEST_ASSERT(br == 100 && TEST_CheckPattern(Buffer, br, 1000));
+  TEST_ASSERT(IMG_Stats.sread > IMG_Stats.nread);
+
+  /* A stream stopped in the middle of a sector does not copy the sector into
+     the file buffer, it is loaded by the following f_read() */
+  CHECK(f_lseek(&File, 0));
+  CHECK(f_read(&File, Buffer, 100, &br));
+  sect = File.sect;
+  CHECK(f_stream(&File, TEST_StreamFunc, 700, &bf));
+  TEST_ASSERT(bf == 700 && sect != 0 && File.sect == 0);
+  ofs = 100;
+  TEST_StreamRelease(&ofs);
+  CHECK(f_read(&File, Buffer, 300, &br));
+  TEST_ASSERT(br == 300 && TEST_CheckPattern(Buffer, br, 800));
+
+  CHECK(f_close(&other));
+  CHECK(f_close(&File));
+#else
+  printf("  skipped, _USE_STREAM is disabled\n");
+#endif
+  return 0;
+}
+
+#if _FS_REENTRANT == 2
+/**
+  * @brief  Reader thread of the stress test: reads its file in random sized
+  *         chunks, mostly multi-sector reads done with the volume unlocked
+  */
+static void *TEST_StressReader(void *arg)
+{
+  TEST_ThreadTypeDef *t = arg;
+  BYTE *buff = malloc(16384);
+  char name[32];
+  FIL fil;
+  DWORD ofs, base = (DWORD)t->n * TEST_READER_SIZE;
+  UINT len, br;
+  int loop;
+
+  snprintf(name, sizeof name, "%sreader%d.bin", DiskPath, t->n);
+  for (loop = 0; buff != NULL && loop < TEST_READER_LOOPS; loop++)
+  {
+    if (f_open(&fil, name, FA_READ) != FR_OK)
+    {
+      t->errors++;
+      continue;
+    }
+    ofs = (loop & 1) ? (DWORD)(rand_r(&t->seed) % 1000) : 0;
+    if (f_lseek(&fil, ofs) != FR_OK) t->errors++;
+    while (ofs < TEST_READER_SIZE)
+    {
+      len = (UINT)(rand_r(&t->seed) % 16384) + 1;
+      if (f_read(&fil, buff, len, &br) != FR_OK || br == 0
+          || !TEST_CheckPattern(buff, br, base + ofs))
+      {
+        t->errors++;
+        break;
+      }
+      ofs += br;
+      t->ops++;
+    }
+    if (f_close(&fil) != FR_OK) t->errors++;
+  }
+  free(buff);
+  return NULL;
+}
+
+/**
+  * @brief  Metadata thread of the stress test: creates, writes, renames and
+  *         deletes small files and directories until the readers are done
+  */
+static void *TEST_StressMeta(void *arg)
+{
+  TEST_ThreadTypeDef *t = arg;
+  static BYTE buff[4096];
+  char name[32], name2[32];
+  FILINFO fno;
+  FATFS *fs;
+  FIL fil;
+  DWORD nclst;
+  UINT len, bw;
+  int i = 0;
+
+  TEST_Pattern(buff, sizeof buff, 0);
+  while (!__atomic_load_n(&StressDone, __ATOMIC_ACQUIRE))
+  {
+    snprintf(name, sizeof name, "%smeta/file %d.txt", DiskPath, i);
+    snprintf(name2, sizeof name2, "%smeta/renamed %d.txt", DiskPath, i);
+    len = (UINT)(rand_r(&t->seed) % sizeof buff) + 1;
+    if (f_open(&fil, name, FA_WRITE | FA_CREATE_NEW) != FR_OK
+        || f_write(&fil, buff, len, &bw) != FR_OK || bw != len
+        || f_close(&fil) != FR_OK
+        || f_stat(name, &fno) != FR_OK || fno.fsize != len
+        || f_rename(name, name2) != FR_OK
+        || f_unlink(name2) != FR_OK
+        || f_getfree(DiskPath, &nclst, &fs) != FR_OK)
+    {
+      t->errors++;
+    }
+    if (i % 8 == 0)
+    {
+      snprintf(name, sizeof name, "%smeta/dir %d", DiskPath, i);
+      if (f_mkdir(name) != FR_OK || f_unlink(name) != FR_OK) t->errors++;
+    }
+    i++;
+    t->ops++;
+  }
+  return NULL;
+}
+#endif
+
+/**
+  * @brief  Runs reader threads on their own files together with a thread
+  *         changing the metadata (_FS_REENTRANT == 2). The driver has a latency
+  *         and traps concurrent entries.
+  */
+static int TEST_Stress(void)
+{
+#if _FS_REENTRANT == 2
+  static TEST_ThreadTypeDef threads[TEST_READERS + 1];
+  DWORD free0, free1;
+  FATFS *fs;
+  int i;
+
+  CHECK(TEST_Format(TEST_SECTORS));
+  for (i = 0; i < TEST_READERS; i++)
+  {
+    CHECK(f_open(&File, TEST_Path("reader%d.bin", i), FA_WRITE | FA_CREATE_NEW));
+    CHECK(f_close(&File));
+  }
+  /* Write the files interleaved so that they are fragmented */
+  for (i = 0; i < (int)(TEST_READERS * TEST_READER_SIZE / 8192); i++)
+  {
+    DWORD ofs = (DWORD)(i / TEST_READERS) * 8192;
+    int n = i % TEST_READERS;
+    UINT bw;
+
+    TEST_Pattern(Buffer, 8192, (DWORD)n * TEST_READER_SIZE + ofs);
+    CHECK(f_open(&File, TEST_Path("reader%d.bin", n), FA_WRITE | FA_OPEN_APPEND));
+    CHECK(f_write(&File, Buffer, 8192, &bw));
+    CHECK(f_close(&File));
+  }
+  CHECK(f_mkdir(TEST_Path("meta", 0)));
+  CHECK(f_getfree(DiskPath, &free0, &fs));
+
+  IMG_ResetStats();
+  IMG_SetLatency(20);
+  StressDone = 0;
+  for (i = 0; i <= TEST_READERS; i++)
+  {
+    threads[i].n = i;
+    threads[i].seed = (unsigned int)i + 1;
+    threads[i].ops = threads[i].errors = 0;
+    TEST_ASSERT(pthread_create(&threads[i].thread, NULL,
+                               i < TEST_READERS ? TEST_StressReader : TEST_StressMeta, &threads[i]) == 0);
+  }
+  for (i = 0; i < TEST_READERS; i++)
+  {
+    pthread_join(threads[i].thread, NULL);
+  }
+  __atomic_store_n(&StressDone, 1, __ATOMIC_RELEASE);
+  pthread_join(threads[TEST_READERS].thread, NULL);
+  IMG_SetLatency(0);
+
+  for (i = 0; i <= TEST_READERS; i++)
+  {
+    TEST_ASSERT(threads[i].errors == 0);
+    TEST_ASSERT(threads[i].ops > 0);
+  }
+  printf("  %lu reads, %lu metadata operations\n", threads[0].ops * TEST_READERS, threads[TEST_READERS].ops);
+  /* The driver is never entered twice at a time */
+  TEST_ASSERT(IMG_Stats.overlaps == 0);
+
+  /* The volume is consistent after a remount */
+  CHECK(f_mount(&FatFs, DiskPath, 1));
+  CHECK(f_getfree(DiskPath, &free1, &fs));
+  TEST_ASSERT(free0 == free1);
+  CHECK(f_unlink(TEST_Path("meta", 0)));
+#else
+  printf("  skipped, _FS_REENTRANT is not 2\n");
+#endif
+  return 0;
+}
+
+#if _FS_REENTRANT == 2
+/**
+  * @brief  Reads a sector from the open file, in a single transfer
+  */
+static void *TEST_UnlockedReader(void *arg)
+{
+  TEST_ReadTypeDef *rd = arg;
+
+  rd->res = f_read(&File, Buffer, IMG_SECTOR_SIZE, &rd->br);
+  return NULL;
+}
+
+/**
+  * @brief  Starts a read and waits until its transfer runs without the volume
+  *         lock
+  */
+static int TEST_StartUnlocked(TEST_ReadTypeDef *rd)
+{
+  int i, n;
+
+  rd->res = FR_INT_ERR;
+  rd->br = 0;
+  if (pthread_create(&rd->thread, NULL, TEST_UnlockedReader, rd) != 0) return 0;
+  for (n = 0; n < 1000; n++)
+  {
+    for (i = 0; i < _FS_LOCK && !FatFs.iobusy[i]; i++) ;
+    if (i < _FS_LOCK) return 1;
+    usleep(100);
+  }
+  return 0;
+}
+#endif
+
+/**
+  * @brief  Reads a file with the transfer done without the volume lock. The
+  *         volume cannot be unmounted during the transfer, and the read that
+  *         cannot take the lock back returns FR_TIMEOUT with the data counted
+  *         and the file object still valid.
+  */
+static int TEST_Unlocked(void)
+{
+#if _FS_REENTRANT == 2
+  TEST_ReadTypeDef rd;
+
+  CHECK(TEST_Format(TEST_SECTORS));
+  CHECK(TEST_MakeFile(TEST_Path("unlocked.bin", 0), 2 * IMG_SECTOR_SIZE, 0));
+  CHECK(f_open(&File, TEST_Path("unlocked.bin", 0), FA_READ));
+  memset(Buffer, 0, sizeof Buffer);
+  IMG_SetLatency(TEST_UNLOCK_LATENCY);
+
+  /* Unmount during the transfer */
+  TEST_ASSERT(TEST_StartUnlocked(&rd));
+  TEST_ASSERT(f_mount(NULL, DiskPath, 0) == FR_LOCKED);
+  pthread_join(rd.thread, NULL);
+  CHECK(rd.res);
+  TEST_ASSERT(rd.br == IMG_SECTOR_SIZE && TEST_CheckPattern(Buffer, rd.br, 0));
+
+  /* Volume held by another task until the lock times out */
+  TEST_ASSERT(TEST_StartUnlocked(&rd));
+  TEST_ASSERT(ff_req_grant(FatFs.sobj));
+  pthread_join(rd.thread, NULL);
+  ff_rel_grant(FatFs.sobj);
+  IMG_SetLatency(0);
+  TEST_ASSERT(rd.res == FR_TIMEOUT);
+  TEST_ASSERT(rd.br == IMG_SECTOR_SIZE && TEST_CheckPattern(Buffer, rd.br, IMG_SECTOR_SIZE));
+  TEST_ASSERT(File.err == 0 && File.fptr == 2 * IMG_SECTOR_SIZE);
+  CHECK(f_lseek(&File, 0));
+  CHECK(f_read(&File, Buffer, 2 * IMG_SECTOR_SIZE, &rd.br));
+  TEST_ASSERT(rd.br == 2 * IMG_SECTOR_SIZE && TEST_CheckPattern(Buffer, rd.br, 0));
+  CHECK(f_close(&File));
+  CHECK(f_mount(NULL, DiskPath, 0));
+#else
+  printf("  skipped, _FS_REENTRANT is not 2\n");
+#endif
+  return 0;
+}
+
+/**
+  * @brief  Runs an operation of the power cut scenario. Each operation is
+  *         committed to the volume before it returns.
+  * @param  i: Index of the operation
+  */
+static FRESULT TEST_CutOp(int i)
+{
+  char path[64], path2[64];
+
+  if (i == 0) return f_mkdir(TEST_Path("pc", 0));
+  snprintf(path, sizeof path, "%spc/Power Cut File %02d.bin", DiskPath, i - (i % 4 == 3 || i % 4 == 0 ? 2 : 0));
+  switch (i % 4)
+  {
+    case 1:
+    case 2:
+      /* The pattern of each file starts at its size to tell the files apart */
+      return TEST_MakeFile(path, (DWORD)i * 300 + 100, (DWORD)i * 300 + 100);
+    case 3:
+      return f_unlink(path);
+    default:
+      if (i % 8 == 0) return f_mkdir(TEST_Path("pc/Directory %02d", i));
+      snprintf(path2, sizeof path2, "%spc/Renamed %02d.bin", DiskPath, i);
+      return f_rename(path, path2);
+  }
+}
+
+/**
+  * @brief  Signature of the content of the test directory: the names and sizes
+  *         of its entries in directory order and the free cluster count
+  */
+static DWORD TEST_CutState(void)
+{
+  DWORD h = 2166136261UL;
+  FILINFO fno;
+  DIR dir;
+  UINT i;
+
+  if (f_opendir(&dir, TEST_Path("pc", 0)) == FR_OK)
+  {
+    while (f_readdir(&dir, &fno) == FR_OK && fno.fname[0])
+    {
+      for (i = 0; fno.fname[i]; i++) h = (h ^ (BYTE)fno.fname[i]) * 16777619UL;
+      h = (h ^ (DWORD)fno.fsize) * 16777619UL;
+      h = (h ^ fno.fattrib) * 16777619UL;
+    }
+    f_closedir(&dir);
+  }
+  return (h ^ FatFs.free_clst) * 16777619UL;
+}
+
+/**
+  * @brief  Checks the content of the files of the test directory after a
+  *         remount
+  */
+static int TEST_CutCheck(void)
+{
+  char path[_MAX_LFN + 8];
+  FILINFO fno;
+  DIR dir;
+  UINT br;
+  int ok = 1;
+
+  if (f_opendir(&dir, TEST_Path("pc", 0)) != FR_OK) return 1;
+  while (ok && f_readdir(&dir, &fno) == FR_OK && fno.fname[0])
+  {
+    if (fno.fattrib & AM_DIR) continue;
+    snprintf(path, sizeof path, "%spc/%s", DiskPath, fno.fname);
+    ok = f_open(&File, path, FA_READ) == FR_OK
+         && f_read(&File, Buffer, sizeof Buffer, &br) == FR_OK && br == fno.fsize
+         && TEST_CheckPattern(Buffer, br, (DWORD)fno.fsize);
+    f_close(&File);
+  }
+  f_closedir(&dir);
+  return ok;
+}
+
+/**
+  * @brief  Cuts the power at each sector written by a sequence of operations
+  *         on a journaled volume, then remounts it. The journal replay has to
+  *         give the state after the last operation done or after the one that
+  *         was interrupted, never a mix of both.
+  */
+static int TEST_PowerCut(void)
+{
+#if _FS_JOURNAL
+  static DWORD sig[TEST_CUT_OPS + 1];
+  DWORD nclst, span, state;
+  unsigned long total, cut;
+  FATFS *fs;
+  BYTE *snap;
+  int i;
+
+  CHECK(TEST_Format(TEST_CUT_SECTORS));
+  TEST_ASSERT(FatFs.jbase != 0);
+  CHECK(f_getfree(DiskPath, &nclst, &fs));
+  snap = malloc((size_t)TEST_CUT_SECTORS * IMG_SECTOR_SIZE);
+  if (snap == NULL) return ++Failures;
+  memcpy(snap, Image, (size_t)TEST_CUT_SECTORS * IMG_SECTOR_SIZE);
+
+  /* Reference run: the state after each operation. The runs with a power cut
+     do the same accesses so that they write the same sectors. */
+  IMG_ResetStats();
+  sig[0] = TEST_CutState();
+  for (i = 0; i < TEST_CUT_OPS; i++)
+  {
+    CHECK(TEST_CutOp(i));
+    sig[i + 1] = TEST_CutState();
+  }
+  total = IMG_Stats.swrite;
+  TEST_ASSERT(TEST_CutCheck());
+  f_mount(NULL, DiskPath, 0);
+  for (span = TEST_CUT_SECTORS; span > 0
+       && !memcmp(Image + (span - 1) * IMG_SECTOR_SIZE, snap + (span - 1) * IMG_SECTOR_SIZE, IMG_SECTOR_SIZE); span--) ;
+  printf("  %d operations, %lu sectors written\n", TEST_CUT_OPS, total);
+
+  for (cut = 0; cut < total && !Failures; cut++)
+  {
+    memcpy(Image, snap, (size_t)span * IMG_SECTOR_SIZE);
+    CHECK(f_mount(&FatFs, DiskPath, 1));
+    CHECK(f_getfree(DiskPath, &nclst, &fs));
+    IMG_SetPowerCut((long)cut);
+    TEST_CutState();
+    for (i = 0; i < TEST_CUT_OPS && TEST_CutOp(i) == FR_OK; i++)
+    {
+      TEST_CutState();
+    }
+    f_mount(NULL, DiskPath, 0);     /* Power lost, the object is dropped */
+    IMG_SetPowerCut(-1);
+
+    /* The replay at the mount gives the state of operation i or i + 1 */
+    CHECK(f_mount(&FatFs, DiskPath, 1));
+    CHECK(f_getfree(DiskPath, &nclst, &fs));
+    state = TEST_CutState();
+    TEST_ASSERT(state == sig[i] || (i < TEST_CUT_OPS && state == sig[i + 1]));
+    TEST_ASSERT(TEST_CutCheck());
+    f_mount(NULL, DiskPath, 0);
+    if (Failures) printf("  power cut after %lu sectors, %d operations done\n", cut, i);
+  }
+  free(snap);
+#else
+  printf("  skipped, _FS_JOURNAL is 0\n");
+#endif
+  return 0;
+}
+
+#if _USE_ASYNC
+/**
+  * @brief  Completion of an asynchronous read, submits the next one from the
+  *         callback until the end of the file
+  */
+static void TEST_AsyncFunc(FRESULT res, void *arg)
+{
+  FREQ *rq = (FREQ *)arg;
+
+  AsyncCalls++;
+  if (res == FR_OK && File.fptr != AsyncOfs + rq->br) res = FR_INT_ERR;
+  if (res != FR_OK || rq->br == 0)
+  {
+    if (AsyncRes == FR_OK) AsyncRes = res;
+    return;                         /* Error or end of the file */
+  }
+  AsyncOfs += rq->br;
+  rq->buff = Buffer + AsyncOfs;
+  rq->btr = TEST_ASYNC_CHUNK;
+  res = f_read_async(&File, rq);
+  if (res != FR_OK && AsyncRes == FR_OK) AsyncRes = res;
+}
+#endif
+
+/**
+  * @brief  Reads a file with asynchronous reads chained in the completion
+  *         callback. The callback must be called out of the volume lock, with
+  *         the byte count and the file pointer of the completed read.
+  */
+static int TEST_Async(void)
+{
+#if _USE_ASYNC
+  FREQ rq;
+
+  CHECK(TEST_Format(TEST_SECTORS));
+  CHECK(TEST_MakeFile(TEST_Path("async.bin", 0), TEST_ASYNC_SIZE, 0));
+  memset(Buffer, 0, sizeof Buffer);
+  CHECK(f_open(&File, TEST_Path("async.bin", 0), FA_READ));
+  CHECK(f_lseek(&File, TEST_ASYNC_START));
+  AsyncOfs = TEST_ASYNC_START;
+  AsyncCalls = 0;
+  AsyncRes = FR_OK;
+  rq.buff = Buffer + AsyncOfs;
+  rq.btr = TEST_ASYNC_CHUNK;
+  rq.func = TEST_AsyncFunc;
+  rq.arg = &rq;
+  CHECK(f_read_async(&File, &rq));
+  CHECK(AsyncRes);
+  printf("  %u reads\n", AsyncCalls);
+  TEST_ASSERT(AsyncOfs == TEST_ASYNC_SIZE);
+  TEST_ASSERT(TEST_CheckPattern(Buffer + TEST_ASYNC_START, TEST_ASYNC_SIZE - TEST_ASYNC_START, TEST_ASYNC_START));
+  CHECK(f_close(&File));
+#else
+  printf("  skipped, _USE_ASYNC is 0\n");
+#endif
+  return 0;
+}
+
+/**
+  * @brief  Uses a FAT32 volume whose reserved area is large enough for the
+  *         journal but has no journal superblock, as written by another system
+  *         with boot code there. The journal must not be used and the reserved
+  *         sectors must be left as they are.
+  */
+static int TEST_NoJournal(void)
+{
+#if _FS_JOURNAL
+  DWORD nclst, state, rsv;
+  FATFS *fs;
+  int i;
+
+  CHECK(TEST_Format(TEST_CUT_SECTORS));
+  rsv = FatFs.fatbase;
+  f_mount(NULL, DiskPath, 0);
+  memset(Image + 12 * IMG_SECTOR_SIZE, 0xCC, (size_t)(rsv - 12) * IMG_SECTOR_SIZE);
+
+  CHECK(f_mount(&FatFs, DiskPath, 1));
+  TEST_ASSERT(FatFs.jbase == 0);
+  CHECK(f_getfree(DiskPath, &nclst, &fs));
+  for (i = 0; i < TEST_CUT_OPS; i++)
+  {
+    CHECK(TEST_CutOp(i));
+  }
+  state = TEST_CutState();
+  f_mount(NULL, DiskPath, 0);
+  for (i = 12 * IMG_SECTOR_SIZE; i < (int)(rsv * IMG_SECTOR_SIZE) && Image[i] == 0xCC; i++) ;
+  TEST_ASSERT(i == (int)(rsv * IMG_SECTOR_SIZE));
+
+  CHECK(f_mount(&FatFs, DiskPath, 1));
+  CHECK(f_getfree(DiskPath, &nclst, &fs));
+  TEST_ASSERT(FatFs.jbase == 0);
+  TEST_ASSERT(TEST_CutState() == state);
+  TEST_ASSERT(TEST_CutCheck());
+#else
+  printf("  skipped, _FS_JOURNAL is 0\n");
+#endif
+  return 0;
+}
+
+/**
+  * @brief  Copies files of sizes around the chunk size with f_copy(). The job
+  *         is freed as soon as the writer has the last buffer, while the reader
+  *         task may still be running: the copies are repeated so that a late
+  *         access of the reader is seen under AddressSanitizer.
+  */
+static int TEST_Copy(void)
+{
+#if _USE_COPY
+  static const DWORD sizes[] = { 0, 100, TEST_COPY_CHUNK, 3 * TEST_COPY_CHUNK, 3 * TEST_COPY_CHUNK + 17 };
+  char src[16], dst[16];
+  FCOPY st;
+  UINT i, n, br;
+
+  CHECK(TEST_Format(TEST_SECTORS));
+  snprintf(dst, sizeof dst, "%sdst.bin", DiskPath);
+  for (i = 0; i < sizeof sizes / sizeof sizes[0]; i++)
+  {
+    snprintf(src, sizeof src, "%ssrc%u.bin", DiskPath, i);
+    CHECK(TEST_MakeFile(src, sizes[i], sizes[i]));
+    for (n = 0; n < TEST_COPY_LOOPS; n++)
+    {
+      CHECK(f_copy(src, dst, TEST_COPY_CHUNK, &st));
+      TEST_ASSERT(st.nbyte == sizes[i]);
+      TEST_ASSERT(st.nchunk == (sizes[i] + TEST_COPY_CHUNK - 1) / TEST_COPY_CHUNK);
+    }
+    CHECK(f_open(&File, dst, FA_READ));
+    CHECK(f_read(&File, Buffer, sizeof Buffer, &br));
+    CHECK(f_close(&File));
+    TEST_ASSERT(br == sizes[i] && TEST_CheckPattern(Buffer, br, sizes[i]));
+  }
+  TEST_ASSERT(f_copy(TEST_Path("none.bin", 0), dst, TEST_COPY_CHUNK, &st) == FR_NO_FILE);
+  TEST_ASSERT(f_copy(src, dst, 0, &st) == FR_INVALID_PARAMETER);
+#else
+  printf("  skipped, _USE_COPY is 0\n");
+#endif
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  static const TEST_TestTypeDef tests[] =
+  {
+    { "stream",      TEST_Stream },
+    { "stress",      TEST_Stress },
+    { "unlocked",    TEST_Unlocked },
+    { "power cut",   TEST_PowerCut },
+    { "no journal",  TEST_NoJournal },
+    { "copy",        TEST_Copy },
+    { "async",       TEST_Async },
+  };
+  unsigned int i;
+  int n, failed = 0, run = 0;
+
+  Image = malloc((size_t)TEST_SECTORS * IMG_SECTOR_SIZE);
+  if (Image == NULL || FATFS_LinkDriver(&IMG_Driver, DiskPath) != 0) return 1;
+
+  for (i = 0; i < sizeof tests / sizeof tests[0]; i++)
+  {
+    for (n = 1; n < argc && strcmp(argv[n], tests[i].name); n++) ;
+    if (argc > 1 && n == argc) continue;  /* Not selected on the command line */
+    printf("%s\n", tests[i].name);
+    Failures = 0;
+    srand(1);
+    tests[i].func();
+    f_mount(NULL, DiskPath, 0);
+    run++;
+    if (Failures)
+    {
+      printf("  FAILED\n");
+      failed++;
+    }
+  }
+  printf("%d tests, %d failed\n", run, failed);
+
+  FATFS_UnLinkDriver(DiskPath);
+  IMG_Close();
+  free(Image);
+  return failed ? 1 : 0;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -93,6 +93,8 @@ set(lwipnetif_SRCS
     ${LWIP_DIR}/src/netif/ethernet.c
     ${LWIP_DIR}/src/netif/bridgeif.c
     ${LWIP_DIR}/src/netif/bridgeif_fdb.c
+    ${LWIP_DIR}/src/netif/ethrx.c
+    ${LWIP_DIR}/src/netif/ethtx.c
     ${LWIP_DIR}/src/netif/slipif.c
 )
 
@@ -85,6 +85,8 @@ APIFILES=$(LWIPDIR)/api/api_lib.c \
 NETIFFILES=$(LWIPDIR)/netif/ethernet.c \
 	$(LWIPDIR)/netif/bridgeif.c \
 	$(LWIPDIR)/netif/bridgeif_fdb.c \
+	$(LWIPDIR)/netif/ethrx.c \
+	$(LWIPDIR)/netif/ethtx.c \
 	$(LWIPDIR)/netif/slipif.c
 
 # SIXLOWPAN: 6LoWPAN
@@ -38,6 +38,133 @@
 
 #include HTTPD_FSDATA_FILE
 
+#if LWIP_HTTPD_FATFS
+#include "lwip/mem.h"
+#include "ff.h"
+
+#if !LWIP_HTTPD_DYNAMIC_FILE_READ || !LWIP_SUPPORT_CUSTOM_PBUF
+#error LWIP_HTTPD_FATFS needs LWIP_HTTPD_DYNAMIC_FILE_READ and LWIP_SUPPORT_CUSTOM_PBUF
+#endif
+#if !_USE_STREAM
+#error LWIP_HTTPD_FATFS needs _USE_STREAM in ffconf.h
+#endif
+
+/** A block of the FatFs read-ahead pool passed as a pbuf */
+struct fs_fatfs_ref {
+  struct pbuf_custom pc;
+  FATFS *fatfs;
+};
+
+/* f_stream() consumer state of the running fs_read_ref() (tcpip_thread only) */
+static struct fs_fatfs_ref *fs_fatfs_next;
+static struct pbuf *fs_fatfs_block;
+
+static void
+fs_fatfs_ref_free(struct pbuf *p)
+{
+  struct fs_fatfs_ref *ref = (struct fs_fatfs_ref *)p;
+
+  f_release(ref->fatfs);
+  mem_free(ref);
+}
+
+/** f_stream() consumer: takes a reference to a single block */
+static UINT
+fs_fatfs_take(const BYTE *ptr, UINT len)
+{
+  struct fs_fatfs_ref *ref = fs_fatfs_next;
+
+  if (len == 0) {
+    /* ready as long as the block is not taken */
+    return ref != NULL;
+  }
+  if (len > 0xFFFF) {
+    len = 0xFFFF;
+  }
+  fs_fatfs_next = NULL;
+  ref->pc.custom_free_function = fs_fatfs_ref_free;
+  fs_fatfs_block = pbuf_alloced_custom(PBUF_RAW, (u16_t)len, PBUF_REF, &ref->pc,
+                                       LWIP_CONST_CAST(void *, ptr), (u16_t)len);
+  return len;
+}
+
+static err_t
+fs_fatfs_open(struct fs_file *file, const char *name)
+{
+  static char path[LWIP_HTTPD_FATFS_PATH_LEN + 1];
+  FIL *fil;
+
+  if (strlen(LWIP_HTTPD_FATFS_ROOT) + strlen(name) > LWIP_HTTPD_FATFS_PATH_LEN) {
+    return ERR_VAL;
+  }
+  strcpy(path, LWIP_HTTPD_FATFS_ROOT);
+  strcat(path, name);
+  fil = (FIL *)mem_malloc(sizeof(FIL));
+  if (fil == NULL) {
+    return ERR_MEM;
+  }
+  if (f_open(fil, path, FA_READ) != FR_OK) {
+    mem_free(fil);
+    return ERR_VAL;
+  }
+  file->data = NULL;
+  file->len = (int)f_size(fil);
+  file->index = 0;
+  file->pextension = fil;
+  /* the length is known: Content-Length can be sent for persistent connections */
+  file->flags = FS_FILE_FLAGS_HEADER_PERSISTENT;
+  file->is_fatfs_file = 1;
+  return ERR_OK;
+}
+
+/**
+ * Reads a block of a FatFs file without copying it: *p gets a pbuf referring
+ * to the data in the FatFs read-ahead pool. The pool is not refilled until
+ * the pbuf is freed, so hold it only until the data has been sent.
+ *
+ * @return number of bytes in *p, 0 if the pool is held by other blocks not
+ *         containing the data (try again after freeing them) or FS_READ_EOF
+ */
+int
+fs_read_ref(struct fs_file *file, int count, struct pbuf **p)
+{
+  FIL *fil = (FIL *)file->pextension;
+  UINT bf;
+  FRESULT res;
+
+  *p = NULL;
+  if (file->index == file->len) {
+    return FS_READ_EOF;
+  }
+  LWIP_ASSERT("not a FatFs file", file->is_fatfs_file);
+  fs_fatfs_next = (struct fs_fatfs_ref *)mem_malloc(sizeof(struct fs_fatfs_ref));
+  if (fs_fatfs_next == NULL) {
+    return 0;
+  }
+  fs_fatfs_next->fatfs = fil->obj.fs;
+  fs_fatfs_block = NULL;
+  res = f_stream(fil, fs_fatfs_take, (UINT)count, &bf);
+  if (fs_fatfs_next != NULL) {
+    /* no block taken */
+    mem_free(fs_fatfs_next);
+    fs_fatfs_next = NULL;
+  }
+  if (fs_fatfs_block != NULL) {
+    file->index += (int)bf;
+    *p = fs_fatfs_block;
+    fs_fatfs_block = NULL;
+  }
+  if (res != FR_OK) {
+    if (*p != NULL) {
+      pbuf_free(*p);
+      *p = NULL;
+    }
+    return FS_READ_EOF;
+  }
+  return (int)bf;
+}
+#endif /* LWIP_HTTPD_FATFS */
+
 /*-----------------------------------------------------------------------------------*/
 
 #if LWIP_HTTPD_CUSTOM_FILES
@@ -62,6 +189,9 @@ fs_open(struct fs_file *file, const char *name)
     return ERR_ARG;
   }
 
+#if LWIP_HTTPD_FATFS
+  file->is_fatfs_file = 0;
+#endif /* LWIP_HTTPD_FATFS */
 #if LWIP_HTTPD_CUSTOM_FILES
   if (fs_open_custom(file, name)) {
     file->is_custom_file = 1;
@@ -87,6 +217,14 @@ fs_open(struct fs_file *file, const char *name)
       return ERR_OK;
     }
   }
+#if LWIP_HTTPD_FATFS
+  if (fs_fatfs_open(file, name) == ERR_OK) {
+#if LWIP_HTTPD_FILE_STATE
+    file->state = fs_state_init(file, name);
+#endif /* #if LWIP_HTTPD_FILE_STATE */
+    return ERR_OK;
+  }
+#endif /* LWIP_HTTPD_FATFS */
   /* file not found */
   return ERR_VAL;
 }
@@ -100,6 +238,12 @@ fs_close(struct fs_file *file)
     fs_close_custom(file);
   }
 #endif /* LWIP_HTTPD_CUSTOM_FILES */
+#if LWIP_HTTPD_FATFS
+  if (file->is_fatfs_file) {
+    f_close((FIL *)file->pextension);
+    mem_free(file->pextension);
+  }
+#endif /* LWIP_HTTPD_FATFS */
 #if LWIP_HTTPD_FILE_STATE
   fs_state_free(file, file->state);
 #endif /* #if LWIP_HTTPD_FILE_STATE */
@@ -123,6 +267,16 @@ fs_read(struct fs_file *file, char *buffer, int count)
   LWIP_UNUSED_ARG(callback_fn);
   LWIP_UNUSED_ARG(callback_arg);
 #endif /* LWIP_HTTPD_FS_ASYNC_READ */
+#if LWIP_HTTPD_FATFS
+  if (file->is_fatfs_file) {
+    UINT br;
+    if (f_read((FIL *)file->pextension, buffer, (UINT)count, &br) != FR_OK) {
+      return FS_READ_EOF;
+    }
+    file->index += (int)br;
+    return (int)br;
+  }
+#endif /* LWIP_HTTPD_FATFS */
 #if LWIP_HTTPD_CUSTOM_FILES
   if (file->is_custom_file) {
 #if LWIP_HTTPD_FS_ASYNC_READ
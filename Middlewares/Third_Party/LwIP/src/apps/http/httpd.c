@@ -238,6 +238,19 @@ struct http_ssi_tag_description {
 
 #endif /* LWIP_HTTPD_SSI */
 
+#if LWIP_HTTPD_FATFS
+/** FatFs blocks written to TCP without copying them: TCP refers to their data
+ * until it is acknowledged, so they are held until then */
+struct http_fatfs_refs {
+  struct pbuf *p[LWIP_HTTPD_FATFS_REFS];
+  u32_t end[LWIP_HTTPD_FATFS_REFS]; /* 'written' after the last byte of each block */
+  u8_t first;     /* Index of the oldest block */
+  u8_t count;     /* Number of blocks held */
+  u32_t written;  /* Number of bytes written to the pcb */
+  u32_t acked;    /* Number of bytes acknowledged by the remote host */
+};
+#endif /* LWIP_HTTPD_FATFS */
+
 struct http_state {
 #if LWIP_HTTPD_KILL_OLD_ON_CONNECTIONS_EXCEEDED
   struct http_state *next;
@@ -257,6 +270,9 @@ struct http_state {
 #endif /* LWIP_HTTPD_DYNAMIC_FILE_READ */
   u32_t left;       /* Number of unsent bytes in buf. */
   u8_t retries;
+#if LWIP_HTTPD_FATFS
+  struct http_fatfs_refs refs;
+#endif /* LWIP_HTTPD_FATFS */
 #if LWIP_HTTPD_SUPPORT_11_KEEPALIVE
   u8_t keepalive;
 #endif /* LWIP_HTTPD_SUPPORT_11_KEEPALIVE */
@@ -507,6 +523,26 @@ http_state_eof(struct http_state *hs)
 #endif /* LWIP_HTTPD_SUPPORT_REQUESTLIST */
 }
 
+#if LWIP_HTTPD_FATFS
+/** Free the FatFs blocks acknowledged by the remote host (or all of them if
+ * TCP does not refer to them anymore)
+ */
+static void
+http_free_refs(struct http_state *hs, u8_t all)
+{
+  struct http_fatfs_refs *refs = &hs->refs;
+
+  while (refs->count > 0) {
+    if (!all && ((s32_t)(refs->acked - refs->end[refs->first]) < 0)) {
+      break;
+    }
+    pbuf_free(refs->p[refs->first]);
+    refs->first = (u8_t)((refs->first + 1) % LWIP_HTTPD_FATFS_REFS);
+    refs->count--;
+  }
+}
+#endif /* LWIP_HTTPD_FATFS */
+
 /** Free a struct http_state.
  * Also frees the file data if dynamic.
  */
@@ -515,6 +551,9 @@ http_state_free(struct http_state *hs)
 {
   if (hs != NULL) {
     http_state_eof(hs);
+#if LWIP_HTTPD_FATFS
+    http_free_refs(hs, 1);
+#endif /* LWIP_HTTPD_FATFS */
     http_remove_connection(hs);
     HTTP_FREE_HTTP_STATE(hs);
   }
@@ -523,6 +562,7 @@ http_state_free(struct http_state *hs)
 /** Call tcp_write() in a loop trying smaller and smaller length
  *
  * @param pcb altcp_pcb to send
+ * @param hs connection state
  * @param ptr Data to send
  * @param length Length of data to send (in/out: on return, contains the
  *        amount of data sent)
@@ -530,7 +570,7 @@ http_state_free(struct http_state *hs)
  * @return the return value of tcp_write
  */
 static err_t
-http_write(struct altcp_pcb *pcb, const void *ptr, u16_t *length, u8_t apiflags)
+http_write(struct altcp_pcb *pcb, struct http_state *hs, const void *ptr, u16_t *length, u8_t apiflags)
 {
   u16_t len, max_len;
   err_t err;
@@ -570,6 +610,9 @@ http_write(struct altcp_pcb *pcb, const void *ptr, u16_t *length, u8_t apiflags)
   if (err == ERR_OK) {
     LWIP_DEBUGF(HTTPD_DEBUG | LWIP_DBG_TRACE, ("Sent %d bytes\n", len));
     *length = len;
+#if LWIP_HTTPD_FATFS
+    hs->refs.written += len;
+#endif /* LWIP_HTTPD_FATFS */
   } else {
     LWIP_DEBUGF(HTTPD_DEBUG | LWIP_DBG_TRACE, ("Send failed with err %d (\"%s\")\n", err, lwip_strerr(err)));
     *length = 0;
@@ -581,6 +624,7 @@ http_write(struct altcp_pcb *pcb, const void *ptr, u16_t *length, u8_t apiflags)
      request */
   altcp_nagle_enable(pcb);
 #endif
+  LWIP_UNUSED_ARG(hs);
 
   return err;
 }
@@ -612,6 +656,13 @@ http_close_or_abort_conn(struct altcp_pcb *pcb, struct http_state *hs, u8_t abor
   }
 #endif /* LWIP_HTTPD_SUPPORT_POST*/
 
+#if LWIP_HTTPD_FATFS
+  if ((hs != NULL) && (hs->refs.count > 0)) {
+    /* TCP still refers to FatFs blocks that are freed with the state:
+       drop the unacknowledged data instead of sending it later */
+    abort_conn = 1;
+  }
+#endif /* LWIP_HTTPD_FATFS */
 
   altcp_arg(pcb, NULL);
   altcp_recv(pcb, NULL);
@@ -657,6 +708,9 @@ http_eof(struct altcp_pcb *pcb, struct http_state *hs)
   /* HTTP/1.1 persistent connection? (Not supported for SSI) */
 #if LWIP_HTTPD_SUPPORT_11_KEEPALIVE
   if (hs->keepalive) {
+#if LWIP_HTTPD_FATFS
+    struct http_fatfs_refs refs = hs->refs;
+#endif /* LWIP_HTTPD_FATFS */
     http_remove_connection(hs);
 
     http_state_eof(hs);
@@ -664,11 +718,21 @@ http_eof(struct altcp_pcb *pcb, struct http_state *hs)
     /* restore state: */
     hs->pcb = pcb;
     hs->keepalive = 1;
+#if LWIP_HTTPD_FATFS
+    hs->refs = refs;
+#endif /* LWIP_HTTPD_FATFS */
     http_add_connection(hs);
     /* ensure nagle doesn't interfere with sending all data as fast as possible: */
     altcp_nagle_disable(pcb);
   } else
 #endif /* LWIP_HTTPD_SUPPORT_11_KEEPALIVE */
+#if LWIP_HTTPD_FATFS
+  if (hs->refs.count > 0) {
+    /* TCP refers to FatFs blocks until they are acknowledged: close the file
+       now and the connection when http_sent() has freed them */
+    http_state_eof(hs);
+  } else
+#endif /* LWIP_HTTPD_FATFS */
   {
     http_close_conn(pcb, hs);
   }
@@ -1033,7 +1097,7 @@ http_send_headers(struct altcp_pcb *pcb, struct http_state *hs)
     if (hs->hdr_index < NUM_FILE_HDR_STRINGS - 1) {
       apiflags |= TCP_WRITE_FLAG_MORE;
     }
-    err = http_write(pcb, ptr, &sendlen, apiflags);
+    err = http_write(pcb, hs, ptr, &sendlen, apiflags);
     if ((err == ERR_OK) && (old_sendlen != sendlen)) {
       /* Remember that we added some more data to be transmitted. */
       data_to_send = HTTP_DATA_TO_SEND_CONTINUE;
@@ -1083,6 +1147,58 @@ http_send_headers(struct altcp_pcb *pcb, struct http_state *hs)
 }
 #endif /* LWIP_HTTPD_DYNAMIC_HEADERS */
 
+#if LWIP_HTTPD_FATFS
+/** Sub-function of http_check_eof(): take the next block of a FatFs file
+ * without copying it. The block is held until the remote host has
+ * acknowledged it.
+ *
+ * @returns: 0 if the file is finished or no data has been read
+ *           1 if the file is not finished and data has been read
+ *           -1 if the data has to be read into the buffer (the read-ahead
+ *              pool is held by other connections)
+ */
+static int
+http_check_eof_ref(struct altcp_pcb *pcb, struct http_state *hs, int bytes_left)
+{
+  struct http_fatfs_refs *refs = &hs->refs;
+  struct pbuf *p;
+  int count;
+  u8_t i;
+
+  if (refs->count == LWIP_HTTPD_FATFS_REFS) {
+    /* Wait for the oldest block to be acknowledged */
+    return 0;
+  }
+  count = fs_read_ref(hs->handle, bytes_left, &p);
+  if (count < 0) {
+    LWIP_DEBUGF(HTTPD_DEBUG, ("End of file.\n"));
+    http_eof(pcb, hs);
+    return 0;
+  }
+  if (count == 0) {
+    /* The read-ahead pool is held by other blocks: wait for our own blocks
+       to be acknowledged, or read a copy if none is in flight */
+    return (refs->count > 0) ? 0 : -1;
+  }
+
+  LWIP_DEBUGF(HTTPD_DEBUG, ("Referred %d bytes.\n", count));
+  /* The block is written on its own (after the headers), so it ends 'count'
+     bytes after the data written so far */
+  i = (u8_t)((refs->first + refs->count) % LWIP_HTTPD_FATFS_REFS);
+  refs->p[i] = p;
+  refs->end[i] = refs->written + (u32_t)count;
+  refs->count++;
+  hs->left = (u32_t)count;
+  hs->file = (const char *)p->payload;
+  if (hs->buf != NULL) {
+    /* The buffer of a previous copy: free it so that the block is not copied */
+    mem_free(hs->buf);
+    hs->buf = NULL;
+  }
+  return 1;
+}
+#endif /* LWIP_HTTPD_FATFS */
+
 /** Sub-function of http_send(): end-of-file (or block) is reached,
  * either close the file or read the next block (if supported).
  *
@@ -1114,6 +1230,18 @@ http_check_eof(struct altcp_pcb *pcb, struct http_state *hs)
     return 0;
   }
 #if LWIP_HTTPD_DYNAMIC_FILE_READ
+#if LWIP_HTTPD_FATFS
+  if (hs->handle->is_fatfs_file
+#if LWIP_HTTPD_SSI
+      && (hs->ssi == NULL)
+#endif /* LWIP_HTTPD_SSI */
+     ) {
+    count = http_check_eof_ref(pcb, hs, bytes_left);
+    if (count >= 0) {
+      return (u8_t)count;
+    }
+  }
+#endif /* LWIP_HTTPD_FATFS */
   /* Do we already have a send buffer allocated? */
   if (hs->buf) {
     /* Yes - get the length of the buffer */
@@ -1199,7 +1327,7 @@ http_send_data_nonssi(struct altcp_pcb *pcb, struct http_state *hs)
    * Just send the data as we received it from the file. */
   len = (u16_t)LWIP_MIN(hs->left, 0xffff);
 
-  err = http_write(pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
+  err = http_write(pcb, hs, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
   if (err == ERR_OK) {
     data_to_send = 1;
     hs->file += len;
@@ -1237,7 +1365,7 @@ http_send_data_ssi(struct altcp_pcb *pcb, struct http_state *hs)
   if (ssi->parsed > hs->file) {
     len = (u16_t)LWIP_MIN(ssi->parsed - hs->file, 0xffff);
 
-    err = http_write(pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
+    err = http_write(pcb, hs, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
     if (err == ERR_OK) {
       data_to_send = 1;
       hs->file += len;
@@ -1413,7 +1541,7 @@ http_send_data_ssi(struct altcp_pcb *pcb, struct http_state *hs)
               len = (u16_t)LWIP_MIN(ssi->tag_started - hs->file, 0xffff);
 #endif /* LWIP_HTTPD_SSI_INCLUDE_TAG*/
 
-              err = http_write(pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
+              err = http_write(pcb, hs, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
               if (err == ERR_OK) {
                 data_to_send = 1;
 #if !LWIP_HTTPD_SSI_INCLUDE_TAG
@@ -1454,7 +1582,7 @@ http_send_data_ssi(struct altcp_pcb *pcb, struct http_state *hs)
           len = (u16_t)LWIP_MIN(ssi->tag_started - hs->file, 0xffff);
 #endif /* LWIP_HTTPD_SSI_INCLUDE_TAG*/
           if (len != 0) {
-            err = http_write(pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
+            err = http_write(pcb, hs, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
           } else {
             err = ERR_OK;
           }
@@ -1491,7 +1619,7 @@ http_send_data_ssi(struct altcp_pcb *pcb, struct http_state *hs)
              * single tag insert buffer per connection. If we don't do
              * this, insert corruption can occur if more than one insert
              * is processed before we call tcp_output. */
-            err = http_write(pcb, &(ssi->tag_insert[ssi->tag_index]), &len,
+            err = http_write(pcb, hs, &(ssi->tag_insert[ssi->tag_index]), &len,
                              HTTP_IS_TAG_VOLATILE(hs));
             if (err == ERR_OK) {
               data_to_send = 1;
@@ -1538,7 +1666,7 @@ http_send_data_ssi(struct altcp_pcb *pcb, struct http_state *hs)
       len = (u16_t)LWIP_MIN(ssi->parsed - hs->file, 0xffff);
     }
 
-    err = http_write(pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
+    err = http_write(pcb, hs, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
     if (err == ERR_OK) {
       data_to_send = 1;
       hs->file += len;
@@ -2451,6 +2579,10 @@ http_sent(void *arg, struct altcp_pcb *pcb, u16_t len)
   }
 
   hs->retries = 0;
+#if LWIP_HTTPD_FATFS
+  hs->refs.acked += len;
+  http_free_refs(hs, 0);
+#endif /* LWIP_HTTPD_FATFS */
 
   http_send(pcb, hs);
 
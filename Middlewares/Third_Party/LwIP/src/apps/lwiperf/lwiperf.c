@@ -422,6 +422,10 @@ lwiperf_tx_start_impl(const ip_addr_t *remote_ip, u16_t remote_port, lwiperf_set
   tcp_sent(newpcb, lwiperf_tcp_client_sent);
   tcp_poll(newpcb, lwiperf_tcp_poll, 2U);
   tcp_err(newpcb, lwiperf_tcp_err);
+#if TCP_LARGE_SEND
+  /* queue the MSS-sized writes as large segments, cut in tcp_output */
+  tcp_large_send_enable(newpcb);
+#endif /* TCP_LARGE_SEND */
 
   ip_addr_copy(remote_addr, *remote_ip);
 
@@ -65,6 +65,39 @@ u16_t lwip_standard_chksum(const void *dataptr, int len);
 # define LWIP_CHKSUM_ALGORITHM 0
 #endif
 
+/* LWIP_CHKSUM_ALGORITHM selects the implementation of lwip_standard_chksum:
+ *   1: byte by byte, for any platform
+ *   2: 16-bit loads (default)
+ *   3: 32-bit loads, 8 bytes per iteration, carries added back on every add
+ *   4: 32-bit loads summed in a 64-bit accumulator, 32 bytes per iteration
+ *      (needs LWIP_HAVE_INT64)
+ * LWIP_CHKSUM_COPY_ALGORITHM == 2 (see lwip_chksum_copy) uses the same
+ * accumulator as version #4. */
+#if (LWIP_CHKSUM_ALGORITHM == 4) || (LWIP_CHKSUM_COPY_ALGORITHM == 2)
+#if !LWIP_HAVE_INT64
+#error "LWIP_CHKSUM_ALGORITHM 4 and LWIP_CHKSUM_COPY_ALGORITHM 2 need LWIP_HAVE_INT64"
+#endif
+
+/** Fold a 64-bit sum of 32-bit words to the 16-bit Internet sum */
+static u16_t
+lwip_chksum_fold64(u64_t sum, int odd)
+{
+  u32_t acc;
+
+  sum = (sum >> 32) + (sum & 0xffffffffUL);
+  sum = (sum >> 32) + (sum & 0xffffffffUL);
+  acc = (u32_t)sum;
+  acc = FOLD_U32T(acc);
+  acc = FOLD_U32T(acc);
+
+  /* Swap if alignment was odd */
+  if (odd) {
+    acc = SWAP_BYTES_IN_WORD(acc);
+  }
+  return (u16_t)acc;
+}
+#endif /* (LWIP_CHKSUM_ALGORITHM == 4) || (LWIP_CHKSUM_COPY_ALGORITHM == 2) */
+
 #if (LWIP_CHKSUM_ALGORITHM == 1) /* Version #1 */
 /**
  * lwip checksum
@@ -255,6 +288,70 @@ lwip_standard_chksum(const void *dataptr, int len)
 }
 #endif
 
+#if (LWIP_CHKSUM_ALGORITHM == 4) /* Alternative version #4 */
+/**
+ * Checksum 32 bits at a time. The words are summed in a 64-bit accumulator,
+ * so the carries are only added back once at the end, and the main loop is
+ * unrolled to 32 bytes per iteration, which lets the compiler use load
+ * multiple and add with carry on 32-bit cores.
+ *
+ * @param dataptr points to start of data to be summed at any boundary
+ * @param len length of data to be summed
+ * @return host order (!) lwip checksum (non-inverted Internet sum)
+ */
+u16_t
+lwip_standard_chksum(const void *dataptr, int len)
+{
+  const u8_t *pb = (const u8_t *)dataptr;
+  const u32_t *pl;
+  u16_t t = 0;
+  u64_t sum = 0;
+  /* starts at odd byte address? */
+  int odd = ((mem_ptr_t)pb & 1);
+
+  if (odd && len > 0) {
+    ((u8_t *)&t)[1] = *pb++;
+    len--;
+  }
+
+  /* Get aligned to u32_t */
+  if (((mem_ptr_t)pb & 2) && len > 1) {
+    sum += *(const u16_t *)(const void *)pb;
+    pb += 2;
+    len -= 2;
+  }
+
+  pl = (const u32_t *)(const void *)pb;
+  while (len >= 32) {
+    sum += (u64_t)pl[0] + pl[1] + pl[2] + pl[3];
+    sum += (u64_t)pl[4] + pl[5] + pl[6] + pl[7];
+    pl += 8;
+    len -= 32;
+  }
+  while (len >= 4) {
+    sum += *pl++;
+    len -= 4;
+  }
+
+  pb = (const u8_t *)pl;
+  /* 16-bit aligned word remaining? */
+  if (len > 1) {
+    sum += *(const u16_t *)(const void *)pb;
+    pb += 2;
+    len -= 2;
+  }
+
+  /* dangling tail byte remaining? */
+  if (len > 0) {
+    ((u8_t *)&t)[0] = *pb;
+  }
+
+  sum += t;
+
+  return lwip_chksum_fold64(sum, odd);
+}
+#endif
+
 /** Parts of the pseudo checksum which are common to IPv4 and IPv6 */
 static u16_t
 inet_cksum_pseudo_base(struct pbuf *p, u8_t proto, u16_t proto_len, u32_t acc)
@@ -606,3 +703,138 @@ lwip_chksum_copy(void *dst, const void *src, u16_t len)
   return LWIP_CHKSUM(dst, len);
 }
 #endif /* (LWIP_CHKSUM_COPY_ALGORITHM == 1) */
+
+#if (LWIP_CHKSUM_COPY_ALGORITHM == 2) /* Version #2 */
+/** Copy and checksum in one pass: each word is loaded once, summed and stored.
+ * When src and dst are not equally aligned, falls back to version #1, since
+ * unaligned word stores are not available on every core.
+ */
+u16_t
+lwip_chksum_copy(void *dst, const void *src, u16_t len)
+{
+  const u8_t *ps = (const u8_t *)src;
+  u8_t *pd = (u8_t *)dst;
+  const u32_t *pls;
+  u32_t *pld;
+  u32_t w0, w1, w2, w3;
+  u16_t w;
+  u16_t t = 0;
+  u64_t sum = 0;
+  int n = len;
+  int odd;
+
+  if (((mem_ptr_t)ps ^ (mem_ptr_t)pd) & 3) {
+    MEMCPY(dst, src, len);
+    return LWIP_CHKSUM(dst, len);
+  }
+
+  /* starts at odd byte address? */
+  odd = ((mem_ptr_t)ps & 1);
+  if (odd && n > 0) {
+    *pd = *ps;
+    ((u8_t *)&t)[1] = *ps;
+    pd++;
+    ps++;
+    n--;
+  }
+
+  /* Get aligned to u32_t */
+  if (((mem_ptr_t)ps & 2) && n > 1) {
+    w = *(const u16_t *)(const void *)ps;
+    *(u16_t *)(void *)pd = w;
+    sum += w;
+    ps += 2;
+    pd += 2;
+    n -= 2;
+  }
+
+  pls = (const u32_t *)(const void *)ps;
+  pld = (u32_t *)(void *)pd;
+  while (n >= 16) {
+    w0 = pls[0];
+    w1 = pls[1];
+    w2 = pls[2];
+    w3 = pls[3];
+    pld[0] = w0;
+    pld[1] = w1;
+    pld[2] = w2;
+    pld[3] = w3;
+    sum += (u64_t)w0 + w1 + w2 + w3;
+    pls += 4;
+    pld += 4;
+    n -= 16;
+  }
+  while (n >= 4) {
+    w0 = *pls++;
+    *pld++ = w0;
+    sum += w0;
+    n -= 4;
+  }
+
+  ps = (const u8_t *)pls;
+  pd = (u8_t *)pld;
+  /* 16-bit aligned word remaining? */
+  if (n > 1) {
+    w = *(const u16_t *)(const void *)ps;
+    *(u16_t *)(void *)pd = w;
+    sum += w;
+    ps += 2;
+    pd += 2;
+    n -= 2;
+  }
+
+  /* dangling tail byte remaining? */
+  if (n > 0) {
+    *pd = *ps;
+    ((u8_t *)&t)[0] = *ps;
+  }
+
+  sum += t;
+
+  return lwip_chksum_fold64(sum, odd);
+}
+#endif /* (LWIP_CHKSUM_COPY_ALGORITHM == 2) */
+
+/**
+ * Update a checksum for a 16-bit field of the data changed from old_val to
+ * new_val, without summing the data again (RFC 1624, eqn. 3).
+ * All values are taken as they are in the packet (network order).
+ *
+ * @param chksum the checksum as found in the header
+ * @param old_val previous value of the field
+ * @param new_val new value of the field
+ * @return updated checksum to be saved directly in the header
+ */
+u16_t
+inet_chksum_adjust(u16_t chksum, u16_t old_val, u16_t new_val)
+{
+  u32_t acc;
+
+  /* HC' = ~(~HC + ~m + m') */
+  acc = (u32_t)(u16_t)~chksum + (u16_t)~old_val + new_val;
+  acc = FOLD_U32T(acc);
+  acc = FOLD_U32T(acc);
+  return (u16_t)~acc;
+}
+
+/**
+ * Same as inet_chksum_adjust() for a 32-bit field (e.g. an IPv4 address or a
+ * TCP sequence number), taken as it is in the packet.
+ *
+ * @param chksum the checksum as found in the header
+ * @param old_val previous value of the field
+ * @param new_val new value of the field
+ * @return updated checksum to be saved directly in the header
+ */
+u16_t
+inet_chksum_adjust32(u16_t chksum, u32_t old_val, u32_t new_val)
+{
+  u32_t acc;
+
+  acc = (u32_t)(u16_t)~chksum;
+  acc += (u16_t)~(old_val & 0xffffUL) + (u16_t)~(old_val >> 16);
+  acc += (new_val & 0xffffUL) + (new_val >> 16);
+  acc = FOLD_U32T(acc);
+  acc = FOLD_U32T(acc);
+  return (u16_t)~acc;
+}
@@ -229,6 +229,12 @@ PACK_STRUCT_END
 #if LWIP_TCP && LWIP_NETIF_TX_SINGLE_PBUF && !TCP_OVERSIZE
 #error "LWIP_NETIF_TX_SINGLE_PBUF needs TCP_OVERSIZE enabled to create single-pbuf TCP packets"
 #endif
+#if LWIP_TCP && TCP_LARGE_SEND && LWIP_NETIF_TX_SINGLE_PBUF
+#error "TCP_LARGE_SEND chains several pbufs per segment and cannot be used with LWIP_NETIF_TX_SINGLE_PBUF"
+#endif
+#if LWIP_TCP && TCP_LARGE_SEND && (TCP_LARGE_SEND_SIZE > (0xffff - TCP_HLEN - TCP_MAX_OPTION_BYTES))
+#error "TCP_LARGE_SEND_SIZE plus the TCP header must fit in an u16_t, so, you have to reduce it in your lwipopts.h"
+#endif
 #if LWIP_NETCONN && LWIP_TCP
 #if NETCONN_COPY != TCP_WRITE_FLAG_COPY
 #error "NETCONN_COPY != TCP_WRITE_FLAG_COPY"
@@ -215,12 +215,9 @@ icmp_input(struct pbuf *p, struct netif *inp)
         ICMPH_TYPE_SET(iecho, ICMP_ER);
 #if CHECKSUM_GEN_ICMP
         IF__NETIF_CHECKSUM_ENABLED(inp, NETIF_CHECKSUM_GEN_ICMP) {
-          /* adjust the checksum */
-          if (iecho->chksum > PP_HTONS(0xffffU - (ICMP_ECHO << 8))) {
-            iecho->chksum = (u16_t)(iecho->chksum + PP_HTONS((u16_t)(ICMP_ECHO << 8)) + 1);
-          } else {
-            iecho->chksum = (u16_t)(iecho->chksum + PP_HTONS(ICMP_ECHO << 8));
-          }
+          /* adjust the checksum for the type (upper byte of the first word) */
+          iecho->chksum = inet_chksum_adjust(iecho->chksum, PP_HTONS(ICMP_ECHO << 8),
+                                             PP_HTONS(ICMP_ER << 8));
         }
 #if LWIP_CHECKSUM_CTRL_PER_NETIF
         else {
@@ -329,12 +329,10 @@ ip4_forward(struct pbuf *p, struct ip_hdr *iphdr, struct netif *inp)
     return;
   }
 
-  /* Incrementally update the IP checksum. */
-  if (IPH_CHKSUM(iphdr) >= PP_HTONS(0xffffU - 0x100)) {
-    IPH_CHKSUM_SET(iphdr, (u16_t)(IPH_CHKSUM(iphdr) + PP_HTONS(0x100) + 1));
-  } else {
-    IPH_CHKSUM_SET(iphdr, (u16_t)(IPH_CHKSUM(iphdr) + PP_HTONS(0x100)));
-  }
+  /* Incrementally update the IP checksum (TTL is the upper byte of its word). */
+  IPH_CHKSUM_SET(iphdr, inet_chksum_adjust(IPH_CHKSUM(iphdr),
+                                           lwip_htons((u16_t)((IPH_TTL(iphdr) + 1) << 8)),
+                                           lwip_htons((u16_t)(IPH_TTL(iphdr) << 8))));
 
   LWIP_DEBUGF(IP_DEBUG, ("ip4_forward: forwarding packet to %"U16_F".%"U16_F".%"U16_F".%"U16_F"\n",
                          ip4_addr1_16(ip4_current_dest_addr()), ip4_addr2_16(ip4_current_dest_addr()),
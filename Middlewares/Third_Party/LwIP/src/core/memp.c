@@ -93,6 +93,46 @@ const struct memp_desc *const memp_pools[MEMP_MAX] = {
 #define MEMP_OVERFLOW_CHECK 1
 #endif
 
+#if MEMP_CACHE_SIZE < 1
+#error "MEMP_CACHE_SIZE must be at least 1"
+#endif
+
+#if MEMP_LOCKFREE && !MEMP_MEM_MALLOC
+#if MEMP_SANITY_CHECK
+#error "MEMP_SANITY_CHECK is not supported with MEMP_LOCKFREE"
+#endif
+
+/** Size of one element in the pool memory, including the sanity regions */
+#if MEMP_OVERFLOW_CHECK
+#define MEMP_ELEM_SIZE(desc) (MEMP_SIZE + (desc)->size + MEM_SANITY_REGION_AFTER_ALIGNED)
+#else
+#define MEMP_ELEM_SIZE(desc) (MEMP_SIZE + (desc)->size)
+#endif
+/** Index + 1 of the first element of a free list head */
+#define MEMP_LF_IDX(head)       ((u16_t)((head) & 0xffff))
+/** Next value of a free list head with idx as first element */
+#define MEMP_LF_HEAD(head, idx) ((((head) & 0xffff0000UL) + 0x10000UL) | (idx))
+
+/** Get a pool element from its index + 1 */
+static struct memp *
+memp_lf_elem(const struct memp_desc *desc, u16_t idx)
+{
+  /* cast through void* to get rid of alignment warnings */
+  return (struct memp *)(void *)((u8_t *)LWIP_MEM_ALIGN(desc->base) + (size_t)(idx - 1) * MEMP_ELEM_SIZE(desc));
+}
+
+/** Get the index + 1 of a pool element */
+static u16_t
+memp_lf_index(const struct memp_desc *desc, const struct memp *memp)
+{
+  size_t offset = (size_t)((const u8_t *)memp - (u8_t *)LWIP_MEM_ALIGN(desc->base));
+
+  LWIP_ASSERT("memp_free: element not in pool",
+              (offset % MEMP_ELEM_SIZE(desc)) == 0 && (offset / MEMP_ELEM_SIZE(desc)) < desc->num);
+  return (u16_t)(offset / MEMP_ELEM_SIZE(desc) + 1);
+}
+#endif /* MEMP_LOCKFREE && !MEMP_MEM_MALLOC */
+
 #if MEMP_SANITY_CHECK && !MEMP_MEM_MALLOC
 /**
  * Check that memp-lists don't form a circle, using "Floyd's cycle-finding algorithm".
@@ -180,7 +220,11 @@ memp_init_pool(const struct memp_desc *desc)
   int i;
   struct memp *memp;
 
+#if MEMP_LOCKFREE
+  *desc->tab = 0;
+#else
   *desc->tab = NULL;
+#endif
   memp = (struct memp *)LWIP_MEM_ALIGN(desc->base);
 #if MEMP_MEM_INIT
   /* force memset on pool memory */
@@ -192,8 +236,13 @@ memp_init_pool(const struct memp_desc *desc)
 #endif
   /* create a linked list of memp elements */
   for (i = 0; i < desc->num; ++i) {
+#if MEMP_LOCKFREE
+    memp->next_idx = MEMP_LF_IDX(*desc->tab);
+    *desc->tab = (u32_t)(i + 1);
+#else
     memp->next = *desc->tab;
     *desc->tab = memp;
+#endif
 #if MEMP_OVERFLOW_CHECK
     memp_overflow_init_element(memp, desc);
 #endif /* MEMP_OVERFLOW_CHECK */
@@ -240,37 +289,198 @@ memp_init(void)
 #endif /* MEMP_OVERFLOW_CHECK >= 2 */
 }
 
-static void *
-#if !MEMP_OVERFLOW_CHECK
-do_memp_malloc_pool(const struct memp_desc *desc)
-#else
-do_memp_malloc_pool_fn(const struct memp_desc *desc, const char *file, const int line)
-#endif
+#if MEMP_STATS
+/** Account for n elements taken out of a pool (asked: number wanted) */
+static void
+memp_stats_take(const struct memp_desc *desc, u16_t n, u16_t asked)
+{
+  desc->stats->used = (mem_size_t)(desc->stats->used + n);
+  if (desc->stats->used > desc->stats->max) {
+    desc->stats->max = desc->stats->used;
+  }
+  if (n < asked) {
+    desc->stats->err++;
+  }
+}
+#endif /* MEMP_STATS */
+
+/**
+ * Take up to n elements off the free list of a pool.
+ *
+ * @param desc the pool
+ * @param elem where to store the elements (struct memp pointers)
+ * @param n number of elements wanted
+ * @return number of elements stored in elem
+ */
+static u16_t
+memp_take(const struct memp_desc *desc, void **elem, u16_t n)
 {
+  u16_t i;
+#if MEMP_MEM_MALLOC || MEMP_LOCKFREE
+#if MEMP_STATS
+  SYS_ARCH_DECL_PROTECT(old_level);
+#endif
+#if MEMP_MEM_MALLOC
+  for (i = 0; i < n; i++) {
+    elem[i] = mem_malloc(MEMP_SIZE + MEMP_ALIGN_SIZE(desc->size));
+    if (elem[i] == NULL) {
+      break;
+    }
+  }
+#else /* MEMP_MEM_MALLOC */
+  struct memp *memp;
+  u32_t head, prev;
+  u16_t idx, j;
+
+  head = *desc->tab;
+  for (;;) {
+    /* Find what follows the first n elements. If the list changes meanwhile,
+       the indexes read may be outdated (we stay in the pool memory anyway),
+       but then the head changed too and the compare-and-swap fails. */
+    idx = MEMP_LF_IDX(head);
+    for (i = 0; (i < n) && (idx != 0) && (idx <= desc->num); i++) {
+      idx = memp_lf_elem(desc, idx)->next_idx;
+    }
+    if (i == 0) {
+      break;
+    }
+    prev = sys_arch_cas32(desc->tab, head, MEMP_LF_HEAD(head, idx));
+    if (prev == head) {
+      /* the elements are ours now */
+      idx = MEMP_LF_IDX(head);
+      for (j = 0; j < i; j++) {
+        memp = memp_lf_elem(desc, idx);
+        elem[j] = memp;
+        idx = memp->next_idx;
+      }
+      break;
+    }
+    head = prev;
+  }
+#endif /* MEMP_MEM_MALLOC */
+#if MEMP_STATS
+  SYS_ARCH_PROTECT(old_level);
+  memp_stats_take(desc, i, n);
+  SYS_ARCH_UNPROTECT(old_level);
+#endif
+#else /* MEMP_MEM_MALLOC || MEMP_LOCKFREE */
   struct memp *memp;
   SYS_ARCH_DECL_PROTECT(old_level);
 
-#if MEMP_MEM_MALLOC
-  memp = (struct memp *)mem_malloc(MEMP_SIZE + MEMP_ALIGN_SIZE(desc->size));
   SYS_ARCH_PROTECT(old_level);
-#else /* MEMP_MEM_MALLOC */
+  for (i = 0; (i < n) && (*desc->tab != NULL); i++) {
+    memp = *desc->tab;
+    *desc->tab = memp->next;
+    elem[i] = memp;
+  }
+#if MEMP_STATS
+  memp_stats_take(desc, i, n);
+#endif
+  SYS_ARCH_UNPROTECT(old_level);
+#endif /* MEMP_MEM_MALLOC || MEMP_LOCKFREE */
+  return i;
+}
+
+/**
+ * Put n elements back on the free list of a pool.
+ *
+ * @param desc the pool
+ * @param mem the elements (as returned by memp_malloc_pool)
+ * @param n number of elements
+ * @return 1 if the free list was empty before, 0 otherwise
+ */
+static int
+memp_give(const struct memp_desc *desc, void *const *mem, u16_t n)
+{
+  int empty;
+  u16_t i;
+#if MEMP_MEM_MALLOC || MEMP_LOCKFREE
+#if MEMP_STATS
+  SYS_ARCH_DECL_PROTECT(old_level);
+
   SYS_ARCH_PROTECT(old_level);
+  desc->stats->used = (mem_size_t)(desc->stats->used - n);
+  SYS_ARCH_UNPROTECT(old_level);
+#endif
+#if MEMP_MEM_MALLOC
+  LWIP_UNUSED_ARG(desc);
+  for (i = 0; i < n; i++) {
+    mem_free((u8_t *)mem[i] - MEMP_SIZE);
+  }
+  empty = 0;
+#else /* MEMP_MEM_MALLOC */
+  struct memp *last, *memp;
+  u32_t head, prev;
+  u16_t first_idx;
+
+  /* link the elements together first, then push them in one go */
+  last = (struct memp *)(void *)((u8_t *)mem[0] - MEMP_SIZE);
+  first_idx = memp_lf_index(desc, last);
+  for (i = 1; i < n; i++) {
+    memp = (struct memp *)(void *)((u8_t *)mem[i] - MEMP_SIZE);
+    memp->next_idx = first_idx;
+    first_idx = memp_lf_index(desc, memp);
+  }
 
-  memp = *desc->tab;
+  head = *desc->tab;
+  for (;;) {
+    last->next_idx = MEMP_LF_IDX(head);
+    prev = sys_arch_cas32(desc->tab, head, MEMP_LF_HEAD(head, first_idx));
+    if (prev == head) {
+      break;
+    }
+    head = prev;
+  }
+  empty = (MEMP_LF_IDX(head) == 0);
 #endif /* MEMP_MEM_MALLOC */
+#else /* MEMP_MEM_MALLOC || MEMP_LOCKFREE */
+  struct memp *memp;
+  SYS_ARCH_DECL_PROTECT(old_level);
+
+  SYS_ARCH_PROTECT(old_level);
+#if MEMP_STATS
+  desc->stats->used = (mem_size_t)(desc->stats->used - n);
+#endif
+  empty = (*desc->tab == NULL);
+  for (i = 0; i < n; i++) {
+    memp = (struct memp *)(void *)((u8_t *)mem[i] - MEMP_SIZE);
+    memp->next = *desc->tab;
+    *desc->tab = memp;
+  }
+
+#if MEMP_SANITY_CHECK
+  LWIP_ASSERT("memp sanity", memp_sanity(desc));
+#endif /* MEMP_SANITY_CHECK */
 
-  if (memp != NULL) {
+  SYS_ARCH_UNPROTECT(old_level);
+#endif /* MEMP_MEM_MALLOC || MEMP_LOCKFREE */
+  return empty;
+}
+
+static u16_t
+#if !MEMP_OVERFLOW_CHECK
+do_memp_malloc_pool_bulk(const struct memp_desc *desc, void **mem, u16_t n)
+#else
+do_memp_malloc_pool_bulk_fn(const struct memp_desc *desc, void **mem, u16_t n, const char *file, const int line)
+#endif
+{
+  struct memp *memp;
+  u16_t i, count;
+
+  count = memp_take(desc, mem, n);
+  for (i = 0; i < count; i++) {
+    memp = (struct memp *)mem[i];
+#if MEMP_OVERFLOW_CHECK
 #if !MEMP_MEM_MALLOC
 #if MEMP_OVERFLOW_CHECK == 1
     memp_overflow_check_element(memp, desc);
-#endif /* MEMP_OVERFLOW_CHECK */
-
-    *desc->tab = memp->next;
-#if MEMP_OVERFLOW_CHECK
+#endif /* MEMP_OVERFLOW_CHECK == 1 */
+#if MEMP_LOCKFREE
+    memp->next_idx = 0;
+#else
     memp->next = NULL;
-#endif /* MEMP_OVERFLOW_CHECK */
+#endif
 #endif /* !MEMP_MEM_MALLOC */
-#if MEMP_OVERFLOW_CHECK
     memp->file = file;
     memp->line = line;
 #if MEMP_MEM_MALLOC
@@ -279,24 +489,32 @@ do_memp_malloc_pool_fn(const struct memp_desc *desc, const char *file, const int
 #endif /* MEMP_OVERFLOW_CHECK */
     LWIP_ASSERT("memp_malloc: memp properly aligned",
                 ((mem_ptr_t)memp % MEM_ALIGNMENT) == 0);
-#if MEMP_STATS
-    desc->stats->used++;
-    if (desc->stats->used > desc->stats->max) {
-      desc->stats->max = desc->stats->used;
-    }
-#endif
-    SYS_ARCH_UNPROTECT(old_level);
     /* cast through u8_t* to get rid of alignment warnings */
-    return ((u8_t *)memp + MEMP_SIZE);
-  } else {
-#if MEMP_STATS
-    desc->stats->err++;
-#endif
-    SYS_ARCH_UNPROTECT(old_level);
+    mem[i] = ((u8_t *)memp + MEMP_SIZE);
+  }
+  if (count < n) {
     LWIP_DEBUGF(MEMP_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("memp_malloc: out of memory in pool %s\n", desc->desc));
   }
+  return count;
+}
+
+static void *
+#if !MEMP_OVERFLOW_CHECK
+do_memp_malloc_pool(const struct memp_desc *desc)
+#else
+do_memp_malloc_pool_fn(const struct memp_desc *desc, const char *file, const int line)
+#endif
+{
+  void *mem;
 
-  return NULL;
+#if !MEMP_OVERFLOW_CHECK
+  if (do_memp_malloc_pool_bulk(desc, &mem, 1) == 0) {
+#else
+  if (do_memp_malloc_pool_bulk_fn(desc, &mem, 1, file, line) == 0) {
+#endif
+    return NULL;
+  }
+  return mem;
 }
 
 /**
@@ -325,6 +543,35 @@ memp_malloc_pool_fn(const struct memp_desc *desc, const char *file, const int li
 #endif
 }
 
+/**
+ * Get up to n elements from a custom pool at once, taking the free list
+ * (lock or compare-and-swap) only once.
+ *
+ * @param desc the pool to get the elements from
+ * @param mem array where to store the allocated elements
+ * @param n number of elements wanted
+ *
+ * @return number of elements stored in mem, less than n if the pool ran out
+ */
+u16_t
+#if !MEMP_OVERFLOW_CHECK
+memp_malloc_pool_bulk(const struct memp_desc *desc, void **mem, u16_t n)
+#else
+memp_malloc_pool_bulk_fn(const struct memp_desc *desc, void **mem, u16_t n, const char *file, const int line)
+#endif
+{
+  LWIP_ASSERT("invalid pool desc", desc != NULL);
+  if ((desc == NULL) || (mem == NULL) || (n == 0)) {
+    return 0;
+  }
+
+#if !MEMP_OVERFLOW_CHECK
+  return do_memp_malloc_pool_bulk(desc, mem, n);
+#else
+  return do_memp_malloc_pool_bulk_fn(desc, mem, n, file, line);
+#endif
+}
+
 /**
  * Get an element from a specific pool.
  *
@@ -355,42 +602,56 @@ memp_malloc_fn(memp_t type, const char *file, const int line)
   return memp;
 }
 
-static void
-do_memp_free_pool(const struct memp_desc *desc, void *mem)
+/**
+ * Get up to n elements from a specific pool at once, taking the free list
+ * (lock or compare-and-swap) only once.
+ *
+ * @param type the pool to get the elements from
+ * @param mem array where to store the allocated elements
+ * @param n number of elements wanted
+ *
+ * @return number of elements stored in mem, less than n if the pool ran out
+ */
+u16_t
+#if !MEMP_OVERFLOW_CHECK
+memp_malloc_bulk(memp_t type, void **mem, u16_t n)
+#else
+memp_malloc_bulk_fn(memp_t type, void **mem, u16_t n, const char *file, const int line)
+#endif
 {
-  struct memp *memp;
-  SYS_ARCH_DECL_PROTECT(old_level);
-
-  LWIP_ASSERT("memp_free: mem properly aligned",
-              ((mem_ptr_t)mem % MEM_ALIGNMENT) == 0);
-
-  /* cast through void* to get rid of alignment warnings */
-  memp = (struct memp *)(void *)((u8_t *)mem - MEMP_SIZE);
+  LWIP_ERROR("memp_malloc_bulk: type < MEMP_MAX", (type < MEMP_MAX), return 0;);
 
-  SYS_ARCH_PROTECT(old_level);
+  if ((mem == NULL) || (n == 0)) {
+    return 0;
+  }
 
-#if MEMP_OVERFLOW_CHECK == 1
-  memp_overflow_check_element(memp, desc);
-#endif /* MEMP_OVERFLOW_CHECK */
+#if MEMP_OVERFLOW_CHECK >= 2
+  memp_overflow_check_all();
+#endif /* MEMP_OVERFLOW_CHECK >= 2 */
 
-#if MEMP_STATS
-  desc->stats->used--;
+#if !MEMP_OVERFLOW_CHECK
+  return do_memp_malloc_pool_bulk(memp_pools[type], mem, n);
+#else
+  return do_memp_malloc_pool_bulk_fn(memp_pools[type], mem, n, file, line);
 #endif
+}
 
-#if MEMP_MEM_MALLOC
-  LWIP_UNUSED_ARG(desc);
-  SYS_ARCH_UNPROTECT(old_level);
-  mem_free(memp);
-#else /* MEMP_MEM_MALLOC */
-  memp->next = *desc->tab;
-  *desc->tab = memp;
+static int
+do_memp_free_pool_bulk(const struct memp_desc *desc, void **mem, u16_t n)
+{
+  u16_t i;
 
-#if MEMP_SANITY_CHECK
-  LWIP_ASSERT("memp sanity", memp_sanity(desc));
-#endif /* MEMP_SANITY_CHECK */
+  for (i = 0; i < n; i++) {
+    LWIP_ASSERT("memp_free: mem != NULL", mem[i] != NULL);
+    LWIP_ASSERT("memp_free: mem properly aligned",
+                ((mem_ptr_t)mem[i] % MEM_ALIGNMENT) == 0);
+#if MEMP_OVERFLOW_CHECK == 1
+    /* cast through void* to get rid of alignment warnings */
+    memp_overflow_check_element((struct memp *)(void *)((u8_t *)mem[i] - MEMP_SIZE), desc);
+#endif /* MEMP_OVERFLOW_CHECK */
+  }
 
-  SYS_ARCH_UNPROTECT(old_level);
-#endif /* !MEMP_MEM_MALLOC */
+  return memp_give(desc, mem, n);
 }
 
 /**
@@ -407,7 +668,26 @@ memp_free_pool(const struct memp_desc *desc, void *mem)
     return;
   }
 
-  do_memp_free_pool(desc, mem);
+  do_memp_free_pool_bulk(desc, &mem, 1);
+}
+
+/**
+ * Put n custom pool elements back into their pool at once, taking the free
+ * list (lock or compare-and-swap) only once.
+ *
+ * @param desc the pool where to put the elements
+ * @param mem array of the elements to free (none may be NULL)
+ * @param n number of elements
+ */
+void
+memp_free_pool_bulk(const struct memp_desc *desc, void **mem, u16_t n)
+{
+  LWIP_ASSERT("invalid pool desc", desc != NULL);
+  if ((desc == NULL) || (mem == NULL) || (n == 0)) {
+    return;
+  }
+
+  do_memp_free_pool_bulk(desc, mem, n);
 }
 
 /**
@@ -419,9 +699,7 @@ memp_free_pool(const struct memp_desc *desc, void *mem)
 void
 memp_free(memp_t type, void *mem)
 {
-#ifdef LWIP_HOOK_MEMP_AVAILABLE
-  struct memp *old_first;
-#endif
+  int was_empty;
 
   LWIP_ERROR("memp_free: type < MEMP_MAX", (type < MEMP_MAX), return;);
 
@@ -433,15 +711,127 @@ memp_free(memp_t type, void *mem)
   memp_overflow_check_all();
 #endif /* MEMP_OVERFLOW_CHECK >= 2 */
 
+  was_empty = do_memp_free_pool_bulk(memp_pools[type], &mem, 1);
+
 #ifdef LWIP_HOOK_MEMP_AVAILABLE
-  old_first = *memp_pools[type]->tab;
+  if (was_empty) {
+    LWIP_HOOK_MEMP_AVAILABLE(type);
+  }
+#else
+  LWIP_UNUSED_ARG(was_empty);
 #endif
+}
 
-  do_memp_free_pool(memp_pools[type], mem);
+/**
+ * Put n elements back into their pool at once, taking the free list (lock or
+ * compare-and-swap) only once.
+ *
+ * @param type the pool where to put the elements
+ * @param mem array of the elements to free (none may be NULL)
+ * @param n number of elements
+ */
+void
+memp_free_bulk(memp_t type, void **mem, u16_t n)
+{
+  int was_empty;
+
+  LWIP_ERROR("memp_free_bulk: type < MEMP_MAX", (type < MEMP_MAX), return;);
+
+  if ((mem == NULL) || (n == 0)) {
+    return;
+  }
+
+#if MEMP_OVERFLOW_CHECK >= 2
+  memp_overflow_check_all();
+#endif /* MEMP_OVERFLOW_CHECK >= 2 */
+
+  was_empty = do_memp_free_pool_bulk(memp_pools[type], mem, n);
 
 #ifdef LWIP_HOOK_MEMP_AVAILABLE
-  if (old_first == NULL) {
+  if (was_empty) {
     LWIP_HOOK_MEMP_AVAILABLE(type);
   }
+#else
+  LWIP_UNUSED_ARG(was_empty);
 #endif
 }
+
+/**
+ * @ingroup mempool
+ * Initialize a cache of free elements of a pool. The cache belongs to one
+ * thread, which allocates and frees elements with memp_cache_malloc() and
+ * memp_cache_free() instead of memp_malloc_pool() and memp_free_pool().
+ * Elements can still be freed to the pool by other threads.
+ *
+ * @param cache the cache
+ * @param desc the pool the elements come from (memp_pools[type] for the
+ *        pools of lwIP)
+ */
+void
+memp_cache_init(struct memp_cache *cache, const struct memp_desc *desc)
+{
+  LWIP_ASSERT("invalid pool desc", desc != NULL);
+
+  cache->desc = desc;
+  cache->count = 0;
+}
+
+/**
+ * @ingroup mempool
+ * Allocate an element from a cache. An empty cache is refilled with half of
+ * MEMP_CACHE_SIZE elements from the pool in one bulk allocation.
+ *
+ * @param cache the cache
+ * @return a pointer to the allocated memory or a NULL pointer if the cache is
+ *         empty and the pool too
+ */
+void *
+memp_cache_malloc(struct memp_cache *cache)
+{
+  if (cache->count == 0) {
+    cache->count = memp_malloc_pool_bulk(cache->desc, cache->elem, (MEMP_CACHE_SIZE + 1) / 2);
+    if (cache->count == 0) {
+      return NULL;
+    }
+  }
+  cache->count--;
+  return cache->elem[cache->count];
+}
+
+/**
+ * @ingroup mempool
+ * Free an element to a cache. A full cache first gives the older half of its
+ * elements back to the pool in one bulk free.
+ *
+ * @param cache the cache
+ * @param mem the element to free, allocated from the pool of the cache
+ */
+void
+memp_cache_free(struct memp_cache *cache, void *mem)
+{
+  u16_t n;
+
+  if (mem == NULL) {
+    return;
+  }
+  if (cache->count == MEMP_CACHE_SIZE) {
+    n = (MEMP_CACHE_SIZE + 1) / 2;
+    memp_free_pool_bulk(cache->desc, cache->elem, n);
+    cache->count = (u16_t)(MEMP_CACHE_SIZE - n);
+    memmove(&cache->elem[0], &cache->elem[n], cache->count * sizeof(void *));
+  }
+  cache->elem[cache->count++] = mem;
+}
+
+/**
+ * @ingroup mempool
+ * Give all the elements of a cache back to the pool.
+ *
+ * @param cache the cache
+ */
+void
+memp_cache_flush(struct memp_cache *cache)
+{
+  memp_free_pool_bulk(cache->desc, cache->elem, cache->count);
+  cache->count = 0;
+}
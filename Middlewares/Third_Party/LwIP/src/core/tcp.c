@@ -182,6 +182,16 @@ struct tcp_pcb **const tcp_pcb_lists[] = {&tcp_listen_pcbs.pcbs, &tcp_bound_pcbs
          &tcp_active_pcbs, &tcp_tw_pcbs
 };
 
+#if TCP_PCB_HASH
+#if (TCP_PCB_HASH_SIZE & (TCP_PCB_HASH_SIZE - 1)) || (TCP_PCB_LISTEN_HASH_SIZE & (TCP_PCB_LISTEN_HASH_SIZE - 1))
+#error "TCP_PCB_HASH_SIZE and TCP_PCB_LISTEN_HASH_SIZE must be powers of 2"
+#endif
+/** Hash table of the pcbs in tcp_active_pcbs and tcp_tw_pcbs */
+struct tcp_pcb *tcp_conn_hash[TCP_PCB_HASH_SIZE];
+/** Hash table of the pcbs in tcp_listen_pcbs */
+struct tcp_pcb_listen *tcp_listen_hash[TCP_PCB_LISTEN_HASH_SIZE];
+#endif /* TCP_PCB_HASH */
+
 u8_t tcp_active_pcbs_changed;
 
 /** Timer counter to handle calling slow-timer from tcp_tmr() */
@@ -1393,6 +1403,7 @@ tcp_slowtmr_start:
         LWIP_ASSERT("tcp_slowtmr: first pcb == tcp_active_pcbs", tcp_active_pcbs == pcb);
         tcp_active_pcbs = pcb->next;
       }
+      TCP_HASH_RMV(&tcp_active_pcbs, pcb);
 
       if (pcb_reset) {
         tcp_rst(pcb, pcb->snd_nxt, pcb->rcv_nxt, &pcb->local_ip, &pcb->remote_ip,
@@ -1459,6 +1470,7 @@ tcp_slowtmr_start:
         LWIP_ASSERT("tcp_slowtmr: first pcb == tcp_tw_pcbs", tcp_tw_pcbs == pcb);
         tcp_tw_pcbs = pcb->next;
       }
+      TCP_HASH_RMV(&tcp_tw_pcbs, pcb);
       pcb2 = pcb;
       pcb = pcb->next;
       tcp_free(pcb2);
@@ -2206,6 +2218,62 @@ tcp_pcb_remove(struct tcp_pcb **pcblist, struct tcp_pcb *pcb)
   LWIP_ASSERT("tcp_pcb_remove: tcp_pcbs_sane()", tcp_pcbs_sane());
 }
 
+#if TCP_PCB_HASH
+/** Get the hash bucket a pcb of a list belongs to (NULL if none) */
+static struct tcp_pcb **
+tcp_pcb_hash_bucket(struct tcp_pcb **pcblist, struct tcp_pcb *pcb)
+{
+  if ((pcblist == &tcp_active_pcbs) || (pcblist == &tcp_tw_pcbs)) {
+    return &tcp_conn_hash[TCP_PCB_HASH_CONN(pcb->local_port, pcb->remote_port)];
+  } else if (pcblist == &tcp_listen_pcbs.pcbs) {
+    /* listen pcbs share the first members (including hash_next) with pcbs */
+    return (struct tcp_pcb **)&tcp_listen_hash[TCP_PCB_HASH_LISTEN(pcb->local_port)];
+  }
+  return NULL;
+}
+
+/**
+ * Called by TCP_REG: add a pcb registered to one of the lists to the hash
+ * table for tcp_input().
+ *
+ * @param pcblist the list the pcb has been added to
+ * @param pcb the tcp_pcb added
+ */
+void
+tcp_pcb_hash_reg(struct tcp_pcb **pcblist, struct tcp_pcb *pcb)
+{
+  struct tcp_pcb **bucket = tcp_pcb_hash_bucket(pcblist, pcb);
+
+  if (bucket != NULL) {
+    pcb->hash_next = *bucket;
+    *bucket = pcb;
+  }
+}
+
+/**
+ * Called by TCP_RMV: remove a pcb removed from one of the lists from the hash
+ * table (its ports must not have changed).
+ *
+ * @param pcblist the list the pcb has been removed from
+ * @param pcb the tcp_pcb removed
+ */
+void
+tcp_pcb_hash_rmv(struct tcp_pcb **pcblist, struct tcp_pcb *pcb)
+{
+  struct tcp_pcb **bucket = tcp_pcb_hash_bucket(pcblist, pcb);
+
+  if (bucket != NULL) {
+    for (; *bucket != NULL; bucket = &(*bucket)->hash_next) {
+      if (*bucket == pcb) {
+        *bucket = pcb->hash_next;
+        break;
+      }
+    }
+    pcb->hash_next = NULL;
+  }
+}
+#endif /* TCP_PCB_HASH */
+
 /**
  * Calculates a new initial sequence number for new connections.
  *
@@ -247,7 +247,14 @@ tcp_input(struct pbuf *p, struct netif *inp)
      for an active connection. */
   prev = NULL;
 
+#if TCP_PCB_HASH
+  for (pcb = tcp_conn_hash[TCP_PCB_HASH_CONN(tcphdr->dest, tcphdr->src)]; pcb != NULL; pcb = pcb->hash_next) {
+    if (pcb->state == TIME_WAIT) {
+      continue;
+    }
+#else /* TCP_PCB_HASH */
   for (pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
+#endif /* TCP_PCB_HASH */
     LWIP_ASSERT("tcp_input: active pcb->state != CLOSED", pcb->state != CLOSED);
     LWIP_ASSERT("tcp_input: active pcb->state != TIME-WAIT", pcb->state != TIME_WAIT);
     LWIP_ASSERT("tcp_input: active pcb->state != LISTEN", pcb->state != LISTEN);
@@ -263,6 +270,7 @@ tcp_input(struct pbuf *p, struct netif *inp)
         pcb->local_port == tcphdr->dest &&
         ip_addr_cmp(&pcb->remote_ip, ip_current_src_addr()) &&
         ip_addr_cmp(&pcb->local_ip, ip_current_dest_addr())) {
+#if !TCP_PCB_HASH
       /* Move this PCB to the front of the list so that subsequent
          lookups will be faster (we exploit locality in TCP segment
          arrivals). */
@@ -275,6 +283,7 @@ tcp_input(struct pbuf *p, struct netif *inp)
         TCP_STATS_INC(tcp.cachehit);
       }
       LWIP_ASSERT("tcp_input: pcb->next != pcb (after cache)", pcb->next != pcb);
+#endif /* !TCP_PCB_HASH */
       break;
     }
     prev = pcb;
@@ -283,7 +292,14 @@ tcp_input(struct pbuf *p, struct netif *inp)
   if (pcb == NULL) {
     /* If it did not go to an active connection, we check the connections
        in the TIME-WAIT state. */
+#if TCP_PCB_HASH
+    for (pcb = tcp_conn_hash[TCP_PCB_HASH_CONN(tcphdr->dest, tcphdr->src)]; pcb != NULL; pcb = pcb->hash_next) {
+      if (pcb->state != TIME_WAIT) {
+        continue;
+      }
+#else /* TCP_PCB_HASH */
     for (pcb = tcp_tw_pcbs; pcb != NULL; pcb = pcb->next) {
+#endif /* TCP_PCB_HASH */
       LWIP_ASSERT("tcp_input: TIME-WAIT pcb->state == TIME-WAIT", pcb->state == TIME_WAIT);
 
       /* check if PCB is bound to specific netif */
@@ -315,7 +331,11 @@ tcp_input(struct pbuf *p, struct netif *inp)
     /* Finally, if we still did not get a match, we check all PCBs that
        are LISTENing for incoming connections. */
     prev = NULL;
+#if TCP_PCB_HASH
+    for (lpcb = tcp_listen_hash[TCP_PCB_HASH_LISTEN(tcphdr->dest)]; lpcb != NULL; lpcb = lpcb->hash_next) {
+#else /* TCP_PCB_HASH */
     for (lpcb = tcp_listen_pcbs.listen_pcbs; lpcb != NULL; lpcb = lpcb->next) {
+#endif /* TCP_PCB_HASH */
       /* check if PCB is bound to specific netif */
       if ((lpcb->netif_idx != NETIF_NO_INDEX) &&
           (lpcb->netif_idx != netif_get_index(ip_data.current_input_netif))) {
@@ -358,6 +378,9 @@ tcp_input(struct pbuf *p, struct netif *inp)
     }
 #endif /* SO_REUSE */
     if (lpcb != NULL) {
+#if TCP_PCB_HASH
+      LWIP_UNUSED_ARG(prev);
+#else /* TCP_PCB_HASH */
       /* Move this PCB to the front of the list so that subsequent
          lookups will be faster (we exploit locality in TCP segment
          arrivals). */
@@ -370,6 +393,7 @@ tcp_input(struct pbuf *p, struct netif *inp)
       } else {
         TCP_STATS_INC(tcp.cachehit);
       }
+#endif /* TCP_PCB_HASH */
 
       LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_input: packed for LISTENing connection.\n"));
 #ifdef LWIP_HOOK_TCP_INPACKET_PCB
@@ -295,6 +295,18 @@ tcp_seg_add_chksum(u16_t chksum, u16_t len, u16_t *seg_chksum,
 }
 #endif /* TCP_CHECKSUM_ON_COPY */
 
+/** Get the maximum size (data and options) of the segments sent on a pcb:
+ * the MSS, but not more than half the maximum window we ever received.
+ *
+ * Called by tcp_write and tcp_output.
+ */
+static u16_t
+tcp_mss_local(const struct tcp_pcb *pcb)
+{
+  u16_t mss_local = LWIP_MIN(pcb->mss, TCPWND_MIN16(pcb->snd_wnd_max / 2));
+  return mss_local ? mss_local : pcb->mss;
+}
+
 /** Checks if tcp_write is allowed or not (checks state, snd_buf and snd_queuelen).
  *
  * @param pcb the tcp pcb to check for
@@ -410,12 +422,15 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
 #endif /* TCP_CHECKSUM_ON_COPY */
   err_t err;
   u16_t mss_local;
+  u16_t seg_max;
+#if TCP_LARGE_SEND
+  u16_t chunk_len;
+#endif /* TCP_LARGE_SEND */
 
   LWIP_ERROR("tcp_write: invalid pcb", pcb != NULL, return ERR_ARG);
 
   /* don't allocate segments bigger than half the maximum window we ever received */
-  mss_local = LWIP_MIN(pcb->mss, TCPWND_MIN16(pcb->snd_wnd_max / 2));
-  mss_local = mss_local ? mss_local : pcb->mss;
+  mss_local = tcp_mss_local(pcb);
 
   LWIP_ASSERT_CORE_LOCKED();
 
@@ -449,6 +464,15 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
     optlen = LWIP_TCP_OPT_LENGTH_SEGMENT(0, pcb);
   }
 
+  seg_max = mss_local;
+#if TCP_LARGE_SEND
+  /* Queue segments of several times the data tcp_output() sends per segment
+   * (chunk_len), copied data is kept in pbufs of one chunk each. */
+  chunk_len = mss_local - optlen;
+  if (pcb->flags & TF_LARGE_SEND) {
+    seg_max = (u16_t)(optlen + LWIP_MAX(1, TCP_LARGE_SEND_SIZE / chunk_len) * chunk_len);
+  }
+#endif /* TCP_LARGE_SEND */
 
   /*
    * TCP segmentation is done in three phases with increasing complexity:
@@ -483,8 +507,8 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
 
     /* Usable space at the end of the last unsent segment */
     unsent_optlen = LWIP_TCP_OPT_LENGTH_SEGMENT(last_unsent->flags, pcb);
-    LWIP_ASSERT("mss_local is too small", mss_local >= last_unsent->len + unsent_optlen);
-    space = mss_local - (last_unsent->len + unsent_optlen);
+    LWIP_ASSERT("mss_local is too small", seg_max >= last_unsent->len + unsent_optlen);
+    space = seg_max - (last_unsent->len + unsent_optlen);
 
     /*
      * Phase 1: Copy data directly into an oversized pbuf.
@@ -537,20 +561,51 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
        * a segment. A header will never be prepended. */
       if (apiflags & TCP_WRITE_FLAG_COPY) {
         /* Data is copied */
+#if TCP_LARGE_SEND
+        /* Copy into pbufs ending where tcp_output() will cut the segment */
+        u16_t copied = 0;
+        u16_t chunk_space = chunk_len - (last_unsent->len % chunk_len);
+        while (copied < seglen) {
+          struct pbuf *p;
+          u16_t chunk = LWIP_MIN(seglen - copied, chunk_space);
+          if ((p = tcp_pbuf_prealloc(PBUF_RAW, chunk, LWIP_MIN(chunk_space, space - copied),
+                                     &oversize, pcb, apiflags, 1)) == NULL) {
+            LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS,
+                        ("tcp_write : could not allocate memory for pbuf copy size %"U16_F"\n",
+                         chunk));
+            goto memerr;
+          }
+          TCP_DATA_COPY2(p->payload, (const u8_t *)arg + pos + copied, chunk, &concat_chksum, &concat_chksum_swapped);
+          if (concat_p == NULL) {
+            concat_p = p;
+          } else {
+            pbuf_cat(concat_p, p);
+          }
+          copied += chunk;
+          chunk_space = chunk_len;
+        }
+        queuelen += pbuf_clen(concat_p);
+        if (queuelen > LWIP_MIN(TCP_SND_QUEUELEN, TCP_SNDQUEUELEN_OVERFLOW)) {
+          LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("tcp_write: queue too long %"U16_F" (%d)\n",
+                      queuelen, (int)TCP_SND_QUEUELEN));
+          goto memerr;
+        }
+#else /* TCP_LARGE_SEND */
         if ((concat_p = tcp_pbuf_prealloc(PBUF_RAW, seglen, space, &oversize, pcb, apiflags, 1)) == NULL) {
           LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS,
                       ("tcp_write : could not allocate memory for pbuf copy size %"U16_F"\n",
                        seglen));
           goto memerr;
         }
+        TCP_DATA_COPY2(concat_p->payload, (const u8_t *)arg + pos, seglen, &concat_chksum, &concat_chksum_swapped);
+        queuelen += pbuf_clen(concat_p);
+#endif /* TCP_LARGE_SEND */
 #if TCP_OVERSIZE_DBGCHECK
         oversize_add = oversize;
 #endif /* TCP_OVERSIZE_DBGCHECK */
-        TCP_DATA_COPY2(concat_p->payload, (const u8_t *)arg + pos, seglen, &concat_chksum, &concat_chksum_swapped);
 #if TCP_CHECKSUM_ON_COPY
         concat_chksummed += seglen;
 #endif /* TCP_CHECKSUM_ON_COPY */
-        queuelen += pbuf_clen(concat_p);
       } else {
         /* Data is not copied */
         /* If the last unsent pbuf is of type PBUF_ROM, try to extend it. */
@@ -597,7 +652,7 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
   while (pos < len) {
     struct pbuf *p;
     u16_t left = len - pos;
-    u16_t max_len = mss_local - optlen;
+    u16_t max_len = seg_max - optlen;
     u16_t seglen = LWIP_MIN(left, max_len);
 #if TCP_CHECKSUM_ON_COPY
     u16_t chksum = 0;
@@ -607,13 +662,33 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
     if (apiflags & TCP_WRITE_FLAG_COPY) {
       /* If copy is set, memory should be allocated and data copied
        * into pbuf */
-      if ((p = tcp_pbuf_prealloc(PBUF_TRANSPORT, seglen + optlen, mss_local, &oversize, pcb, apiflags, queue == NULL)) == NULL) {
-        LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("tcp_write : could not allocate memory for pbuf copy size %"U16_F"\n", seglen));
+      u16_t first_len = seglen;
+#if TCP_LARGE_SEND
+      u16_t copied, chunk;
+      /* the first pbuf holds the headers and the first chunk */
+      first_len = LWIP_MIN(seglen, chunk_len);
+#endif /* TCP_LARGE_SEND */
+      if ((p = tcp_pbuf_prealloc(PBUF_TRANSPORT, first_len + optlen, mss_local, &oversize, pcb, apiflags, queue == NULL)) == NULL) {
+        LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("tcp_write : could not allocate memory for pbuf copy size %"U16_F"\n", first_len));
         goto memerr;
       }
       LWIP_ASSERT("tcp_write: check that first pbuf can hold the complete seglen",
-                  (p->len >= seglen));
-      TCP_DATA_COPY2((char *)p->payload + optlen, (const u8_t *)arg + pos, seglen, &chksum, &chksum_swapped);
+                  (p->len >= first_len));
+      TCP_DATA_COPY2((char *)p->payload + optlen, (const u8_t *)arg + pos, first_len, &chksum, &chksum_swapped);
+#if TCP_LARGE_SEND
+      /* and the rest of the data follows in pbufs of one chunk each */
+      for (copied = first_len; copied < seglen; copied += chunk) {
+        struct pbuf *p2;
+        chunk = LWIP_MIN(seglen - copied, chunk_len);
+        if ((p2 = tcp_pbuf_prealloc(PBUF_RAW, chunk, chunk_len, &oversize, pcb, apiflags, queue == NULL)) == NULL) {
+          LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("tcp_write : could not allocate memory for pbuf copy size %"U16_F"\n", chunk));
+          pbuf_free(p);
+          goto memerr;
+        }
+        TCP_DATA_COPY2(p2->payload, (const u8_t *)arg + pos + copied, chunk, &chksum, &chksum_swapped);
+        pbuf_cat(p, p2);
+      }
+#endif /* TCP_LARGE_SEND */
     } else {
       /* Copy is not set: First allocate a pbuf for holding the data.
        * Since the referenced data is available at least until it is
@@ -811,6 +886,206 @@ memerr:
   return ERR_MEM;
 }
 
+#if TCP_LARGE_SEND
+#if TCP_CHECKSUM_ON_COPY
+/* one's complement difference of two checksums */
+#define TCP_CHKSUM_SUB(a, b) ((u16_t)FOLD_U32T((u32_t)(a) + (u16_t)~(b)))
+
+/** Checksum len bytes of a pbuf chain, starting at offset.
+ * The result is the plain checksum as if the data started at an even address
+ * (what tcp_seg->chksum means once chksum_swapped has been applied).
+ */
+static u16_t
+tcp_seg_data_chksum(const struct pbuf *p, u16_t offset, u16_t len)
+{
+  u16_t chksum = 0;
+  u8_t chksum_swapped = 0;
+
+  for (; len > 0; p = p->next) {
+    LWIP_ASSERT("tcp_seg_data_chksum: pbuf chain too short", p != NULL);
+    if (offset < p->len) {
+      u16_t n = LWIP_MIN(p->len - offset, len);
+      tcp_seg_add_chksum(~inet_chksum((const u8_t *)p->payload + offset, n), n,
+                         &chksum, &chksum_swapped);
+      len -= n;
+      offset = 0;
+    } else {
+      offset -= p->len;
+    }
+  }
+  return chksum_swapped ? (u16_t)SWAP_BYTES_IN_WORD(chksum) : chksum;
+}
+#endif /* TCP_CHECKSUM_ON_COPY */
+
+/**
+ * Cut the segment on the head of the unsent queue after 'split' bytes of
+ * data without copying it: the pbufs behind the cut move to a new segment
+ * inserted after the head, with a header pbuf initialized from the TCP
+ * header of the head segment. Only a pbuf spanning the cut is split, by
+ * referencing the rest of its data (PBUF_ROM) or by copying it (other
+ * types). Like tcp_split_unsent_seg, this may exceed TCP_SND_QUEUELEN.
+ * If return is not ERR_OK, the head remains intact.
+ *
+ * Called by tcp_output to cut segments queued with TCP_LARGE_SEND to the
+ * segment size, and by tcp_split_unsent_seg.
+ *
+ * @param pcb the tcp_pcb for which to cut the unsent head
+ * @param split the amount of payload to remain in the head
+ */
+static err_t
+tcp_cut_unsent_seg(struct tcp_pcb *pcb, u16_t split)
+{
+  struct tcp_seg *useg = pcb->unsent;
+  struct tcp_seg *seg = NULL;
+  struct pbuf *hdr = NULL, *rest = NULL, *q, *prev = NULL;
+  u16_t remainder, offset;
+  u8_t remainder_flags;
+#if TCP_CHECKSUM_ON_COPY
+  u16_t chksum = 0;
+#endif /* TCP_CHECKSUM_ON_COPY */
+
+  LWIP_ASSERT("tcp_cut_unsent_seg: no unsent segment", useg != NULL);
+  LWIP_ASSERT("tcp_cut_unsent_seg: invalid split", (split > 0) && (split < useg->len));
+  /* rexmit functions don't move segments still referenced by the netif to unsent */
+  LWIP_ASSERT("tcp_cut_unsent_seg: segment busy", useg->p->ref == 1);
+
+  remainder = useg->len - split;
+
+  /* Find the pbuf holding the first byte behind the cut: the data is
+   * preceded by the headers exposed in the first pbuf */
+  offset = useg->p->tot_len - useg->len + split;
+  for (q = useg->p; offset >= q->len; q = q->next) {
+    offset -= q->len;
+    prev = q;
+  }
+  if (offset > 0) {
+    /* q spans the cut: the head keeps it, a new pbuf takes the rest of its data */
+    u16_t rest_len = q->len - offset;
+    if ((q->type_internal & (PBUF_TYPE_FLAG_STRUCT_DATA_CONTIGUOUS | PBUF_TYPE_FLAG_DATA_VOLATILE)) == 0) {
+      /* reference the non-volatile payload data */
+      if ((rest = pbuf_alloc(PBUF_RAW, rest_len, PBUF_ROM)) != NULL) {
+        ((struct pbuf_rom *)rest)->payload = (const u8_t *)q->payload + offset;
+      }
+    } else if ((rest = pbuf_alloc(PBUF_RAW, rest_len, PBUF_RAM)) != NULL) {
+      MEMCPY(rest->payload, (const u8_t *)q->payload + offset, rest_len);
+    }
+    if (rest == NULL) {
+      LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS,
+                  ("tcp_cut_unsent_seg: could not allocate pbuf for %"U16_F" bytes\n", rest_len));
+      goto memerr;
+    }
+  }
+  LWIP_ASSERT("tcp_cut_unsent_seg: cut in the headers", (offset > 0) || (prev != NULL));
+
+  /* The header pbuf of the remainder: options are created when calling tcp_output() */
+  hdr = pbuf_alloc(PBUF_TRANSPORT, LWIP_TCP_OPT_LENGTH_SEGMENT(useg->flags, pcb), PBUF_RAM);
+  if ((hdr == NULL) || pbuf_add_header(hdr, TCP_HLEN)) {
+    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS,
+                ("tcp_cut_unsent_seg: could not allocate header pbuf\n"));
+    goto memerr;
+  }
+  if ((seg = (struct tcp_seg *)memp_malloc(MEMP_TCP_SEG)) == NULL) {
+    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS,
+                ("tcp_cut_unsent_seg: could not allocate segment\n"));
+    goto memerr;
+  }
+
+#if TCP_CHECKSUM_ON_COPY
+  if (useg->flags & TF_SEG_DATA_CHECKSUMMED) {
+    chksum = useg->chksum_swapped ? (u16_t)SWAP_BYTES_IN_WORD(useg->chksum) : useg->chksum;
+  }
+#endif /* TCP_CHECKSUM_ON_COPY */
+
+  /* Remove this segment from the queue since its pbuf chain changes */
+  pcb->snd_queuelen -= pbuf_clen(useg->p);
+
+  /* Detach the data behind the cut from the head */
+  if (offset > 0) {
+    rest->next = q->next;
+    if (q->next != NULL) {
+      rest->tot_len = (u16_t)(rest->len + q->next->tot_len);
+    }
+    q->next = NULL;
+    q->len = offset;
+  } else {
+    rest = q;
+    prev->next = NULL;
+  }
+  for (q = useg->p; q != NULL; q = q->next) {
+    q->tot_len = (u16_t)(q->tot_len - remainder);
+  }
+  pbuf_cat(hdr, rest);
+
+  /* The TCP header of the head is the template for the remainder; it gets
+   * the PSH and FIN flags. SYN should be left on the head, RST should not be
+   * present with data. */
+  remainder_flags = TCPH_FLAGS(useg->tcphdr) & (TCP_PSH | TCP_FIN);
+  seg->tcphdr = (struct tcp_hdr *)hdr->payload;
+  MEMCPY(seg->tcphdr, useg->tcphdr, TCP_HLEN);
+  seg->tcphdr->seqno = lwip_htonl(lwip_ntohl(useg->tcphdr->seqno) + split);
+  TCPH_FLAGS_SET(seg->tcphdr, remainder_flags);
+  TCPH_UNSET_FLAG(useg->tcphdr, remainder_flags);
+
+  seg->p = hdr;
+  seg->len = remainder;
+  seg->flags = useg->flags;
+  useg->len = split;
+#if TCP_OVERSIZE_DBGCHECK
+  seg->oversize_left = useg->oversize_left;
+  useg->oversize_left = 0;
+#endif /* TCP_OVERSIZE_DBGCHECK */
+#if TCP_OVERSIZE
+  if ((offset > 0) && (rest->next == NULL) && (useg->next == NULL)) {
+    /* the last pbuf of the unsent queue is new now and has no space */
+    pcb->unsent_oversize = 0;
+#if TCP_OVERSIZE_DBGCHECK
+    seg->oversize_left = 0;
+#endif /* TCP_OVERSIZE_DBGCHECK */
+  }
+#endif /* TCP_OVERSIZE */
+
+#if TCP_CHECKSUM_ON_COPY
+  if (useg->flags & TF_SEG_DATA_CHECKSUMMED) {
+    /* Split the data checksum, checksumming the smaller part again */
+    u16_t head_chksum, rest_chksum;
+    if (split <= remainder) {
+      head_chksum = tcp_seg_data_chksum(useg->p, useg->p->tot_len - split, split);
+      rest_chksum = TCP_CHKSUM_SUB(chksum, head_chksum);
+      if (split & 1) {
+        rest_chksum = (u16_t)SWAP_BYTES_IN_WORD(rest_chksum);
+      }
+    } else {
+      rest_chksum = tcp_seg_data_chksum(seg->p, seg->p->tot_len - remainder, remainder);
+      head_chksum = TCP_CHKSUM_SUB(chksum, (split & 1) ? (u16_t)SWAP_BYTES_IN_WORD(rest_chksum) : rest_chksum);
+    }
+    useg->chksum = (split & 1) ? (u16_t)SWAP_BYTES_IN_WORD(head_chksum) : head_chksum;
+    useg->chksum_swapped = (u8_t)(split & 1);
+    seg->chksum = (remainder & 1) ? (u16_t)SWAP_BYTES_IN_WORD(rest_chksum) : rest_chksum;
+    seg->chksum_swapped = (u8_t)(remainder & 1);
+  }
+#endif /* TCP_CHECKSUM_ON_COPY */
+
+  /* Update number of segments on the queues */
+  pcb->snd_queuelen += pbuf_clen(useg->p) + pbuf_clen(seg->p);
+
+  /* Finally insert remainder into queue after the head */
+  seg->next = useg->next;
+  useg->next = seg;
+
+  return ERR_OK;
+memerr:
+  TCP_STATS_INC(tcp.memerr);
+
+  if (hdr != NULL) {
+    pbuf_free(hdr);
+  }
+  if (rest != NULL) {
+    pbuf_free(rest);
+  }
+  return ERR_MEM;
+}
+#endif /* TCP_LARGE_SEND */
+
 /**
  * Split segment on the head of the unsent queue.  If return is not
  * ERR_OK, existing head remains intact
@@ -859,6 +1134,13 @@ tcp_split_unsent_seg(struct tcp_pcb *pcb, u16_t split)
   LWIP_ASSERT("split <= mss", split <= pcb->mss);
   LWIP_ASSERT("useg->len > 0", useg->len > 0);
 
+#if TCP_LARGE_SEND
+  if (useg->p->ref == 1) {
+    /* The remainder may be large: cut the segment instead of copying it */
+    return tcp_cut_unsent_seg(pcb, split);
+  }
+#endif /* TCP_LARGE_SEND */
+
   /* We should check that we don't exceed TCP_SND_QUEUELEN but we need
    * to split this packet so we may actually exceed the max value by
    * one!
@@ -1225,6 +1507,30 @@ tcp_build_wnd_scale_option(u32_t *opts)
 }
 #endif
 
+#if TCP_LARGE_SEND
+/** Cut the head of the unsent queue to the segment size if tcp_write queued
+ * more data in it. The cut is only done when the window allows sending the
+ * head, so that the rest stays queued as one segment.
+ *
+ * @param pcb the tcp_pcb with a non-empty unsent queue
+ * @param wnd the current send window
+ */
+static err_t
+tcp_output_cut_unsent(struct tcp_pcb *pcb, u32_t wnd)
+{
+  struct tcp_seg *seg = pcb->unsent;
+  u8_t optlen = LWIP_TCP_OPT_LENGTH_SEGMENT(seg->flags, pcb);
+  /* the same data per segment as tcp_write without TCP_LARGE_SEND */
+  u16_t max_len = (u16_t)(LWIP_MAX(tcp_mss_local(pcb), optlen + 1) - optlen);
+
+  if ((seg->len > max_len) &&
+      (lwip_ntohl(seg->tcphdr->seqno) - pcb->lastack + max_len <= wnd)) {
+    return tcp_cut_unsent_seg(pcb, max_len);
+  }
+  return ERR_OK;
+}
+#endif /* TCP_LARGE_SEND */
+
 /**
  * @ingroup tcp_raw
  * Find out what we can send and send it
@@ -1301,6 +1607,13 @@ tcp_output(struct tcp_pcb *pcb)
     ip_addr_copy(pcb->local_ip, *local_ip);
   }
 
+#if TCP_LARGE_SEND
+  if (tcp_output_cut_unsent(pcb, wnd) != ERR_OK) {
+    tcp_set_flags(pcb, TF_NAGLEMEMERR);
+    return ERR_MEM;
+  }
+#endif /* TCP_LARGE_SEND */
+
   /* Handle the current segment not fitting within the window */
   if (lwip_ntohl(seg->tcphdr->seqno) - pcb->lastack + seg->len > wnd) {
     /* We need to start the persistent timer when the next unsent segment does not fit
@@ -1406,6 +1719,12 @@ tcp_output(struct tcp_pcb *pcb)
       tcp_seg_free(seg);
     }
     seg = pcb->unsent;
+#if TCP_LARGE_SEND
+    if ((seg != NULL) && (tcp_output_cut_unsent(pcb, wnd) != ERR_OK)) {
+      tcp_set_flags(pcb, TF_NAGLEMEMERR);
+      return ERR_MEM;
+    }
+#endif /* TCP_LARGE_SEND */
   }
 #if TCP_OVERSIZE
   if (pcb->unsent == NULL) {
@@ -118,11 +118,228 @@ const int lwip_num_cyclic_timers = LWIP_ARRAYSIZE(lwip_cyclic_timers);
 
 #if LWIP_TIMERS && !LWIP_TIMERS_CUSTOM
 
+#if LWIP_TIMERS_WHEEL
+
+#if (LWIP_TIMERS_WHEEL_HASH_SIZE & (LWIP_TIMERS_WHEEL_HASH_SIZE - 1)) != 0
+#error "LWIP_TIMERS_WHEEL_HASH_SIZE must be a power of 2"
+#endif
+
+/** The one and only timing wheel */
+static struct sys_timeouts_wheel timeouts_wheel;
+
+/** Hash bucket of the timeouts with argument 'arg' */
+#define SYS_TIMEOUTS_HASH(arg) ((((mem_ptr_t)(arg)) ^ (((mem_ptr_t)(arg)) >> 4) ^ (((mem_ptr_t)(arg)) >> 10)) & \
+                                (LWIP_TIMERS_WHEEL_HASH_SIZE - 1))
+
+#if LWIP_TESTMODE
+struct sys_timeouts_wheel*
+sys_timeouts_get_wheel(void)
+{
+  return &timeouts_wheel;
+}
+#endif
+
+/** Index of the lowest bit set in x (x must not be 0) */
+static u8_t
+sys_timeouts_lowest_bit(u32_t x)
+{
+  u8_t n = 0;
+
+  if ((x & 0xffff) == 0) {
+    n += 16;
+    x >>= 16;
+  }
+  if ((x & 0xff) == 0) {
+    n += 8;
+    x >>= 8;
+  }
+  if ((x & 0xf) == 0) {
+    n += 4;
+    x >>= 4;
+  }
+  if ((x & 0x3) == 0) {
+    n += 2;
+    x >>= 2;
+  }
+  if ((x & 0x1) == 0) {
+    n += 1;
+  }
+  return n;
+}
+
+/** Check if timeout a expires before timeout b: earlier time, or the same
+ * time and created first */
+static int
+sys_timeouts_wheel_before(const struct sys_timeo *a, const struct sys_timeo *b)
+{
+  if (a->time != b->time) {
+    return TIME_LESS_THAN(a->time, b->time);
+  }
+  return ((u32_t)(a->seq - b->seq) > LWIP_MAX_TIMEOUT) ? 1 : 0;
+}
+
+/** Put a timeout in the wheel slot matching its expiry time */
+static void
+sys_timeouts_wheel_add(struct sys_timeo *timeout)
+{
+  struct sys_timeouts_wheel *w = &timeouts_wheel;
+  struct sys_timeo **slot;
+  u32_t time, delta;
+  u8_t level, idx;
+
+  if (TIME_LESS_THAN(timeout->time, w->base)) {
+    /* already overdue: put it in the slot processed next */
+    time = w->base;
+  } else {
+    time = timeout->time;
+  }
+  delta = time - w->base;
+  for (level = 0; level < SYS_TIMEOUTS_WHEEL_LEVELS - 1; level++) {
+    if (delta < (1UL << (SYS_TIMEOUTS_WHEEL_BITS * (level + 1)))) {
+      break;
+    }
+  }
+  idx = (u8_t)((time >> (SYS_TIMEOUTS_WHEEL_BITS * level)) & (SYS_TIMEOUTS_WHEEL_SLOTS - 1));
+
+  slot = &w->slot[level][idx];
+  timeout->next = *slot;
+  if (timeout->next != NULL) {
+    timeout->next->pprev = &timeout->next;
+  }
+  timeout->pprev = slot;
+  *slot = timeout;
+  timeout->slot = (u8_t)(level * SYS_TIMEOUTS_WHEEL_SLOTS + idx);
+  w->used[level] |= 1UL << idx;
+
+  if (w->earliest_valid &&
+      ((w->earliest == NULL) || sys_timeouts_wheel_before(timeout, w->earliest))) {
+    w->earliest = timeout;
+  }
+}
+
+/** Take a timeout out of its wheel slot */
+static void
+sys_timeouts_wheel_del(struct sys_timeo *timeout)
+{
+  struct sys_timeouts_wheel *w = &timeouts_wheel;
+  u8_t level = timeout->slot / SYS_TIMEOUTS_WHEEL_SLOTS;
+  u8_t idx = timeout->slot % SYS_TIMEOUTS_WHEEL_SLOTS;
+
+  *timeout->pprev = timeout->next;
+  if (timeout->next != NULL) {
+    timeout->next->pprev = timeout->pprev;
+  }
+  if (w->slot[level][idx] == NULL) {
+    w->used[level] &= ~(1UL << idx);
+  }
+  if (w->earliest == timeout) {
+    w->earliest_valid = 0;
+  }
+}
+
+/** Remove a timeout from the wheel and the hash table */
+static void
+sys_timeouts_wheel_remove(struct sys_timeo *timeout)
+{
+  sys_timeouts_wheel_del(timeout);
+  *timeout->hpprev = timeout->hnext;
+  if (timeout->hnext != NULL) {
+    timeout->hnext->hpprev = timeout->hpprev;
+  }
+}
+
+/** Check if no timeout is pending */
+static int
+sys_timeouts_wheel_empty(void)
+{
+  u8_t level;
+
+  for (level = 0; level < SYS_TIMEOUTS_WHEEL_LEVELS; level++) {
+    if (timeouts_wheel.used[level] != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/** Move the wheel forward to 'time' (not later than the earliest timeout):
+ * the timeouts of every upper level slot reached are moved down a level.
+ * This reverses their order in the slot, equal times are ordered by 'seq'. */
+static void
+sys_timeouts_wheel_advance(u32_t time)
+{
+  struct sys_timeouts_wheel *w = &timeouts_wheel;
+  struct sys_timeo *list, *t;
+  u32_t old_base = w->base;
+  u8_t level, idx, shift;
+
+  w->base = time;
+  for (level = SYS_TIMEOUTS_WHEEL_LEVELS - 1; level > 0; level--) {
+    shift = (u8_t)(SYS_TIMEOUTS_WHEEL_BITS * level);
+    if ((time >> shift) != (old_base >> shift)) {
+      idx = (u8_t)((time >> shift) & (SYS_TIMEOUTS_WHEEL_SLOTS - 1));
+      list = w->slot[level][idx];
+      w->slot[level][idx] = NULL;
+      w->used[level] &= ~(1UL << idx);
+      while (list != NULL) {
+        t = list;
+        list = list->next;
+        sys_timeouts_wheel_add(t);
+      }
+    }
+  }
+}
+
+/** Get the timeout expiring first (NULL if there is none) */
+static struct sys_timeo *
+sys_timeouts_wheel_earliest(void)
+{
+  struct sys_timeouts_wheel *w = &timeouts_wheel;
+  struct sys_timeo *t, *best;
+  u32_t used, start;
+  u8_t level, shift, first, idx;
+
+  if (w->earliest_valid) {
+    return w->earliest;
+  }
+
+  best = NULL;
+  for (level = 0; level < SYS_TIMEOUTS_WHEEL_LEVELS; level++) {
+    used = w->used[level];
+    if (used == 0) {
+      continue;
+    }
+    shift = (u8_t)(SYS_TIMEOUTS_WHEEL_BITS * level);
+    /* On level 0, the current slot is due now. On the upper levels, it was
+       emptied when the wheel reached it and holds timeouts of the next round. */
+    first = (u8_t)(((w->base >> shift) + (level ? 1 : 0)) & (SYS_TIMEOUTS_WHEEL_SLOTS - 1));
+    if (first != 0) {
+      used = (used >> first) | (used << (SYS_TIMEOUTS_WHEEL_SLOTS - first));
+    }
+    idx = sys_timeouts_lowest_bit(used);
+    start = (u32_t)(((w->base >> shift) + (level ? 1 : 0) + idx) << shift);
+    if ((best != NULL) && TIME_LESS_THAN(best->time, start)) {
+      /* this level cannot have an earlier timeout (it may have one of the
+         same time created before) */
+      continue;
+    }
+    idx = (u8_t)((first + idx) & (SYS_TIMEOUTS_WHEEL_SLOTS - 1));
+    for (t = w->slot[level][idx]; t != NULL; t = t->next) {
+      if ((best == NULL) || sys_timeouts_wheel_before(t, best)) {
+        best = t;
+      }
+    }
+  }
+  w->earliest = best;
+  w->earliest_valid = 1;
+  return best;
+}
+
+#else /* LWIP_TIMERS_WHEEL */
+
 /** The one and only timeout list */
 static struct sys_timeo *next_timeout;
 
-static u32_t current_timeout_due_time;
-
 #if LWIP_TESTMODE
 struct sys_timeo**
 sys_timeouts_get_next_timeout(void)
@@ -131,6 +348,10 @@ sys_timeouts_get_next_timeout(void)
 }
 #endif
 
+#endif /* LWIP_TIMERS_WHEEL */
+
+static u32_t current_timeout_due_time;
+
 #if LWIP_TCP
 /** global variable that shows if the tcp timer is currently scheduled or not */
 static int tcpip_tcp_timer_active;
@@ -183,7 +404,12 @@ sys_timeout_abs(u32_t abs_time, sys_timeout_handler handler, void *arg, const ch
 sys_timeout_abs(u32_t abs_time, sys_timeout_handler handler, void *arg)
 #endif
 {
-  struct sys_timeo *timeout, *t;
+  struct sys_timeo *timeout;
+#if LWIP_TIMERS_WHEEL
+  struct sys_timeo **bucket;
+#else
+  struct sys_timeo *t;
+#endif
 
   timeout = (struct sys_timeo *)memp_malloc(MEMP_SYS_TIMEOUT);
   if (timeout == NULL) {
@@ -202,6 +428,22 @@ sys_timeout_abs(u32_t abs_time, sys_timeout_handler handler, void *arg)
                              (void *)timeout, abs_time, handler_name, (void *)arg));
 #endif /* LWIP_DEBUG_TIMERNAMES */
 
+#if LWIP_TIMERS_WHEEL
+  if (sys_timeouts_wheel_empty()) {
+    /* nothing pending: the wheel can start from now */
+    timeouts_wheel.base = sys_now();
+  }
+  timeout->seq = timeouts_wheel.seq++;
+  sys_timeouts_wheel_add(timeout);
+
+  bucket = &timeouts_wheel.hash[SYS_TIMEOUTS_HASH(arg)];
+  timeout->hnext = *bucket;
+  if (timeout->hnext != NULL) {
+    timeout->hnext->hpprev = &timeout->hnext;
+  }
+  timeout->hpprev = bucket;
+  *bucket = timeout;
+#else /* LWIP_TIMERS_WHEEL */
   if (next_timeout == NULL) {
     next_timeout = timeout;
     return;
@@ -218,6 +460,7 @@ sys_timeout_abs(u32_t abs_time, sys_timeout_handler handler, void *arg)
       }
     }
   }
+#endif /* LWIP_TIMERS_WHEEL */
 }
 
 /**
@@ -316,6 +559,24 @@ sys_timeout(u32_t msecs, sys_timeout_handler handler, void *arg)
 void
 sys_untimeout(sys_timeout_handler handler, void *arg)
 {
+#if LWIP_TIMERS_WHEEL
+  struct sys_timeo *t, *match;
+
+  LWIP_ASSERT_CORE_LOCKED();
+
+  /* remove the match expiring first, like the sorted list does */
+  match = NULL;
+  for (t = timeouts_wheel.hash[SYS_TIMEOUTS_HASH(arg)]; t != NULL; t = t->hnext) {
+    if ((t->h == handler) && (t->arg == arg) &&
+        ((match == NULL) || sys_timeouts_wheel_before(t, match))) {
+      match = t;
+    }
+  }
+  if (match != NULL) {
+    sys_timeouts_wheel_remove(match);
+    memp_free(MEMP_SYS_TIMEOUT, match);
+  }
+#else /* LWIP_TIMERS_WHEEL */
   struct sys_timeo *prev_t, *t;
 
   LWIP_ASSERT_CORE_LOCKED();
@@ -337,7 +598,7 @@ sys_untimeout(sys_timeout_handler handler, void *arg)
       return;
     }
   }
-  return;
+#endif /* LWIP_TIMERS_WHEEL */
 }
 
 /**
@@ -365,6 +626,26 @@ sys_check_timeouts(void)
 
     PBUF_CHECK_FREE_OOSEQ();
 
+#if LWIP_TIMERS_WHEEL
+    tmptimeout = sys_timeouts_wheel_earliest();
+    if (tmptimeout == NULL) {
+      timeouts_wheel.base = now;
+      return;
+    }
+
+    if (TIME_LESS_THAN(now, tmptimeout->time)) {
+      if (!TIME_LESS_THAN(now, timeouts_wheel.base)) {
+        sys_timeouts_wheel_advance(now);
+      }
+      return;
+    }
+
+    /* Timeout has expired */
+    if (TIME_LESS_THAN(timeouts_wheel.base, tmptimeout->time)) {
+      sys_timeouts_wheel_advance(tmptimeout->time);
+    }
+    sys_timeouts_wheel_remove(tmptimeout);
+#else /* LWIP_TIMERS_WHEEL */
     tmptimeout = next_timeout;
     if (tmptimeout == NULL) {
       return;
@@ -376,6 +657,7 @@ sys_check_timeouts(void)
 
     /* Timeout has expired */
     next_timeout = tmptimeout->next;
+#endif /* LWIP_TIMERS_WHEEL */
     handler = tmptimeout->h;
     arg = tmptimeout->arg;
     current_timeout_due_time = tmptimeout->time;
@@ -406,6 +688,43 @@ sys_restart_timeouts(void)
   u32_t now;
   u32_t base;
   struct sys_timeo *t;
+#if LWIP_TIMERS_WHEEL
+  struct sys_timeouts_wheel *w = &timeouts_wheel;
+  struct sys_timeo *list;
+  u8_t level, idx;
+
+  t = sys_timeouts_wheel_earliest();
+  if (t == NULL) {
+    return;
+  }
+
+  now = sys_now();
+  base = t->time;
+
+  /* take all timeouts out of the wheel (they stay in the hash table) */
+  list = NULL;
+  for (level = 0; level < SYS_TIMEOUTS_WHEEL_LEVELS; level++) {
+    for (idx = 0; idx < SYS_TIMEOUTS_WHEEL_SLOTS; idx++) {
+      while (w->slot[level][idx] != NULL) {
+        t = w->slot[level][idx];
+        w->slot[level][idx] = t->next;
+        t->next = list;
+        list = t;
+      }
+    }
+    w->used[level] = 0;
+  }
+  w->base = now;
+  w->earliest = NULL;
+  w->earliest_valid = 1;
+
+  while (list != NULL) {
+    t = list;
+    list = list->next;
+    t->time = (t->time - base) + now;
+    sys_timeouts_wheel_add(t);
+  }
+#else /* LWIP_TIMERS_WHEEL */
 
   if (next_timeout == NULL) {
     return;
@@ -417,6 +736,7 @@ sys_restart_timeouts(void)
   for (t = next_timeout; t != NULL; t = t->next) {
     t->time = (t->time - base) + now;
   }
+#endif /* LWIP_TIMERS_WHEEL */
 }
 
 /** Return the time left before the next timeout is due. If no timeouts are
@@ -426,17 +746,23 @@ u32_t
 sys_timeouts_sleeptime(void)
 {
   u32_t now;
+  struct sys_timeo *first;
 
   LWIP_ASSERT_CORE_LOCKED();
 
-  if (next_timeout == NULL) {
+#if LWIP_TIMERS_WHEEL
+  first = sys_timeouts_wheel_earliest();
+#else
+  first = next_timeout;
+#endif
+  if (first == NULL) {
     return SYS_TIMEOUTS_SLEEPTIME_INFINITE;
   }
   now = sys_now();
-  if (TIME_LESS_THAN(next_timeout->time, now)) {
+  if (TIME_LESS_THAN(first->time, now)) {
     return 0;
   } else {
-    u32_t ret = (u32_t)(next_timeout->time - now);
+    u32_t ret = (u32_t)(first->time - now);
     LWIP_ASSERT("invalid sleeptime", ret <= LWIP_MAX_TIMEOUT);
     return ret;
   }
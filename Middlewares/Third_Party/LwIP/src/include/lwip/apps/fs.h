@@ -34,6 +34,9 @@
 
 #include "httpd_opts.h"
 #include "lwip/err.h"
+#if LWIP_HTTPD_FATFS
+#include "lwip/pbuf.h"
+#endif /* LWIP_HTTPD_FATFS */
 
 #ifdef __cplusplus
 extern "C" {
@@ -77,6 +80,9 @@ struct fs_file {
 #if LWIP_HTTPD_CUSTOM_FILES
   u8_t is_custom_file;
 #endif /* LWIP_HTTPD_CUSTOM_FILES */
+#if LWIP_HTTPD_FATFS
+  u8_t is_fatfs_file;
+#endif /* LWIP_HTTPD_FATFS */
 #if LWIP_HTTPD_FILE_STATE
   void *state;
 #endif /* LWIP_HTTPD_FILE_STATE */
@@ -95,6 +101,9 @@ int fs_read_async(struct fs_file *file, char *buffer, int count, fs_wait_cb call
 int fs_read(struct fs_file *file, char *buffer, int count);
 #endif /* LWIP_HTTPD_FS_ASYNC_READ */
 #endif /* LWIP_HTTPD_DYNAMIC_FILE_READ */
+#if LWIP_HTTPD_FATFS
+int fs_read_ref(struct fs_file *file, int count, struct pbuf **p);
+#endif /* LWIP_HTTPD_FATFS */
 #if LWIP_HTTPD_FS_ASYNC_READ
 int fs_is_file_ready(struct fs_file *file, fs_wait_cb callback_fn, void *callback_arg);
 #endif /* LWIP_HTTPD_FS_ASYNC_READ */
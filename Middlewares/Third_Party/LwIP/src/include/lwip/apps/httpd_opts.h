@@ -379,6 +379,37 @@
 #define LWIP_HTTPD_FS_ASYNC_READ      0
 #endif
 
+/** Set this to 1 to serve the files not found in the fsdata from a FatFs
+ * volume (needs LWIP_HTTPD_DYNAMIC_FILE_READ, LWIP_SUPPORT_CUSTOM_PBUF and
+ * _USE_STREAM in ffconf.h). The file data is not copied: fs_read_ref() passes
+ * the blocks of the FatFs read-ahead pool taken with f_stream() as custom
+ * pbufs that call f_release() when freed, and httpd writes them to TCP
+ * without TCP_WRITE_FLAG_COPY and holds them until they are acknowledged.
+ * SSI files, and blocks needed while the pool is held by other connections,
+ * are read with fs_read() as usual.
+ */
+#if !defined LWIP_HTTPD_FATFS || defined __DOXYGEN__
+#define LWIP_HTTPD_FATFS              0
+#endif
+
+/** Directory of the FatFs volume the URIs are looked up in (prepended to the
+ * URI, e.g. "0:/www") */
+#if !defined LWIP_HTTPD_FATFS_ROOT || defined __DOXYGEN__
+#define LWIP_HTTPD_FATFS_ROOT         ""
+#endif
+
+/** Maximum length of the FatFs path of a file (root and URI) */
+#if !defined LWIP_HTTPD_FATFS_PATH_LEN || defined __DOXYGEN__
+#define LWIP_HTTPD_FATFS_PATH_LEN     128
+#endif
+
+/** Number of FatFs blocks a connection holds until they are acknowledged.
+ * The read-ahead pool is not refilled while any block is held, so this
+ * also bounds the data a connection keeps in flight. */
+#if !defined LWIP_HTTPD_FATFS_REFS || defined __DOXYGEN__
+#define LWIP_HTTPD_FATFS_REFS         4
+#endif
+
 /** Filename (including path) to use as FS data file */
 #if !defined HTTPD_FSDATA_FILE || defined __DOXYGEN__
 /* HTTPD_USE_CUSTOM_FSDATA: Compatibility with deprecated lwIP option */
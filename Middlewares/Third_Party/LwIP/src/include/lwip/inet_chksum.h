@@ -76,6 +76,8 @@ u16_t inet_chksum_pbuf(struct pbuf *p);
 #if LWIP_CHKSUM_COPY_ALGORITHM
 u16_t lwip_chksum_copy(void *dst, const void *src, u16_t len);
 #endif /* LWIP_CHKSUM_COPY_ALGORITHM */
+u16_t inet_chksum_adjust(u16_t chksum, u16_t old_val, u16_t new_val);
+u16_t inet_chksum_adjust32(u16_t chksum, u32_t old_val, u32_t new_val);
 
 #if LWIP_IPV4
 u16_t inet_chksum_pseudo(struct pbuf *p, u8_t proto, u16_t proto_len,
@@ -93,11 +93,13 @@ extern const struct memp_desc* const memp_pools[MEMP_MAX];
  *   extern u8_t \_\_attribute\_\_((section(".onchip_mem"))) memp_memory_my_private_pool_base[];
  */
 #define LWIP_MEMPOOL_DECLARE(name,num,size,desc) \
+  MEMP_CHECK_NUM(name,num) \
+    \
   LWIP_DECLARE_MEMORY_ALIGNED(memp_memory_ ## name ## _base, ((num) * (MEMP_SIZE + MEMP_ALIGN_SIZE(size)))); \
     \
   LWIP_MEMPOOL_DECLARE_STATS_INSTANCE(memp_stats_ ## name) \
     \
-  static struct memp *memp_tab_ ## name; \
+  static MEMP_TAB_T memp_tab_ ## name; \
     \
   const struct memp_desc memp_ ## name = { \
     DECLARE_LWIP_MEMPOOL_DESC(desc) \
@@ -125,6 +127,24 @@ extern const struct memp_desc* const memp_pools[MEMP_MAX];
  * Free element from a private memory pool
  */
 #define LWIP_MEMPOOL_FREE(name, x) memp_free_pool(&memp_ ## name, (x))
+/**
+ * @ingroup mempool
+ * Initialize a cache of a private memory pool (see memp_cache_init())
+ */
+#define LWIP_MEMPOOL_CACHE_INIT(cache, name) memp_cache_init((cache), &memp_ ## name)
+
+/**
+ * @ingroup mempool
+ * A cache of free elements of one pool, owned by one thread: elements are
+ * allocated from and freed to the cache without any lock or atomic operation,
+ * the cache exchanges them with the pool in bulk. Elements in the cache count
+ * as used in the pool statistics.
+ */
+struct memp_cache {
+  const struct memp_desc *desc;
+  u16_t count;
+  void *elem[MEMP_CACHE_SIZE];
+};
 
 #if MEM_USE_POOLS
 /** This structure is used to save the pool one element came from.
@@ -148,6 +168,19 @@ void *memp_malloc(memp_t type);
 #endif
 void  memp_free(memp_t type, void *mem);
 
+#if MEMP_OVERFLOW_CHECK
+u16_t memp_malloc_bulk_fn(memp_t type, void **mem, u16_t n, const char* file, const int line);
+#define memp_malloc_bulk(t, m, n) memp_malloc_bulk_fn((t), (m), (n), __FILE__, __LINE__)
+#else
+u16_t memp_malloc_bulk(memp_t type, void **mem, u16_t n);
+#endif
+void  memp_free_bulk(memp_t type, void **mem, u16_t n);
+
+void  memp_cache_init(struct memp_cache *cache, const struct memp_desc *desc);
+void *memp_cache_malloc(struct memp_cache *cache);
+void  memp_cache_free(struct memp_cache *cache, void *mem);
+void  memp_cache_flush(struct memp_cache *cache);
+
 #ifdef __cplusplus
 }
 #endif
@@ -120,6 +120,27 @@
 #if !defined LWIP_TIMERS_CUSTOM || defined __DOXYGEN__
 #define LWIP_TIMERS_CUSTOM              0
 #endif
+
+/**
+ * LWIP_TIMERS_WHEEL==1: keep the pending timeouts in a hierarchical timing
+ * wheel (6 levels of 32 slots, from 1 ms to 2^25 ms per slot) instead of one
+ * sorted list: sys_timeout() and sys_untimeout() no longer walk all pending
+ * timeouts. Costs 192 + LWIP_TIMERS_WHEEL_HASH_SIZE pointers of RAM and
+ * 3 pointers more per timeout (MEMP_SYS_TIMEOUT), so it pays off with many
+ * timeouts pending at the same time.
+ */
+#if !defined LWIP_TIMERS_WHEEL || defined __DOXYGEN__
+#define LWIP_TIMERS_WHEEL               0
+#endif
+
+/**
+ * LWIP_TIMERS_WHEEL_HASH_SIZE: number of buckets (a power of 2) of the hash
+ * table sys_untimeout() uses to find a timeout by its argument when
+ * LWIP_TIMERS_WHEEL is enabled.
+ */
+#if !defined LWIP_TIMERS_WHEEL_HASH_SIZE || defined __DOXYGEN__
+#define LWIP_TIMERS_WHEEL_HASH_SIZE     32
+#endif
 /**
  * @}
  */
@@ -318,6 +339,29 @@
 #define MEMP_SANITY_CHECK               0
 #endif
 
+/**
+ * MEMP_LOCKFREE==1: the free lists of the pools are lock-free stacks updated
+ * with a compare-and-swap (sys_arch_cas32(), to be provided by the port)
+ * instead of lists protected by SYS_ARCH_PROTECT. Threads and interrupts
+ * allocating from and freeing to the same pool then never wait for each
+ * other. Only MEMP_STATS and MEMP_OVERFLOW_CHECK >= 2 still take
+ * SYS_ARCH_PROTECT. Has no effect with MEMP_MEM_MALLOC, and MEMP_SANITY_CHECK
+ * is not available with it.
+ */
+#if !defined MEMP_LOCKFREE || defined __DOXYGEN__
+#define MEMP_LOCKFREE                   0
+#endif
+
+/**
+ * MEMP_CACHE_SIZE: number of free elements a struct memp_cache can hold.
+ * A thread allocating from (or freeing to) a pool at a high rate can keep
+ * its own cache of elements, refilled (or flushed) by half of its size with
+ * one bulk call. See memp_cache_malloc() and memp_cache_free().
+ */
+#if !defined MEMP_CACHE_SIZE || defined __DOXYGEN__
+#define MEMP_CACHE_SIZE                 8
+#endif
+
 /**
  * MEM_OVERFLOW_CHECK: mem overflow protection reserves a configurable
  * amount of bytes before and after each heap allocation chunk and fills
@@ -1402,6 +1446,32 @@
 #define TCP_DEFAULT_LISTEN_BACKLOG      0xff
 #endif
 
+/**
+ * TCP_PCB_HASH==1: tcp_input() finds the pcb of an incoming segment in hash
+ * tables instead of walking the active, TIME-WAIT and listen lists: one for
+ * the connections (hashed by local and remote port) and one for the
+ * listening pcbs (hashed by local port). Worth it with many connections.
+ */
+#if !defined TCP_PCB_HASH || defined __DOXYGEN__
+#define TCP_PCB_HASH                    0
+#endif
+
+/**
+ * TCP_PCB_HASH_SIZE: number of buckets (a power of 2) of the connection
+ * hash table used with TCP_PCB_HASH.
+ */
+#if !defined TCP_PCB_HASH_SIZE || defined __DOXYGEN__
+#define TCP_PCB_HASH_SIZE               64
+#endif
+
+/**
+ * TCP_PCB_LISTEN_HASH_SIZE: number of buckets (a power of 2) of the
+ * listening pcb hash table used with TCP_PCB_HASH.
+ */
+#if !defined TCP_PCB_LISTEN_HASH_SIZE || defined __DOXYGEN__
+#define TCP_PCB_LISTEN_HASH_SIZE        8
+#endif
+
 /**
  * TCP_OVERSIZE: The maximum number of bytes that tcp_write may
  * allocate ahead of time in an attempt to create shorter pbuf chains
@@ -1420,6 +1490,29 @@
 #define TCP_OVERSIZE                    TCP_MSS
 #endif
 
+/**
+ * TCP_LARGE_SEND==1: support a large send mode for bulk transfers, enabled per
+ * pcb with tcp_large_send_enable(): tcp_write() then queues data in segments
+ * of up to TCP_LARGE_SEND_SIZE bytes (one header, the data kept as a pbuf
+ * chain of references or MSS-aligned copies) and tcp_output() cuts them into
+ * MSS-sized segments only when sending, copying the TCP header of the queued
+ * segment. This saves the tcp_seg and header pbuf per MSS of data that waits
+ * in the send buffer, and work in tcp_write().
+ * Not possible with LWIP_NETIF_TX_SINGLE_PBUF.
+ */
+#if !defined TCP_LARGE_SEND || defined __DOXYGEN__
+#define TCP_LARGE_SEND                  0
+#endif
+
+/**
+ * TCP_LARGE_SEND_SIZE: maximum amount of data in a segment queued with
+ * TCP_LARGE_SEND (rounded down to a multiple of the segment size, at least
+ * one segment). Must leave room for the TCP header in an u16_t.
+ */
+#if !defined TCP_LARGE_SEND_SIZE || defined __DOXYGEN__
+#define TCP_LARGE_SEND_SIZE             TCP_SND_BUF
+#endif
+
 /**
  * LWIP_TCP_TIMESTAMPS==1: support the TCP timestamp option.
  * The timestamp option is currently only used to help remote hosts, it is not
@@ -65,9 +65,30 @@ extern "C" {
 
 #endif /* MEMP_OVERFLOW_CHECK */
 
+#if MEMP_LOCKFREE && !MEMP_MEM_MALLOC
+/* The lock-free free lists link the elements by index, so the head of a list
+ * (struct memp_desc::tab) fits in one 32-bit word with a change counter:
+ * bits 0-15: index + 1 of the first free element (0: list empty)
+ * bits 16-31: incremented on every change, so a compare-and-swap based on an
+ *             outdated head fails even if the same element is first again */
+#define MEMP_TAB_T   volatile u32_t
+/* Fails the build of a pool with more elements than the 16-bit index holds
+ * (u16_t next_idx and the low half of the head, 0 meaning empty) */
+#define MEMP_CHECK_NUM(name,num) \
+  typedef char memp_num_check_ ## name[((num) <= 0xfffe) ? 1 : -1];
+#else
+#define MEMP_TAB_T   struct memp *
+#define MEMP_CHECK_NUM(name,num)
+#endif
+
 #if !MEMP_MEM_MALLOC || MEMP_OVERFLOW_CHECK
 struct memp {
+#if MEMP_LOCKFREE && !MEMP_MEM_MALLOC
+  /** index + 1 of the next free element, 0 at the end of the list */
+  u16_t next_idx;
+#else
   struct memp *next;
+#endif
 #if MEMP_OVERFLOW_CHECK
   const char *file;
   int line;
@@ -126,7 +147,7 @@ struct memp_desc {
   u8_t *base;
 
   /** First free element of each pool. Elements form a linked list. */
-  struct memp **tab;
+  MEMP_TAB_T *tab;
 #endif /* MEMP_MEM_MALLOC */
 };
 
@@ -154,6 +175,14 @@ void *memp_malloc_pool(const struct memp_desc *desc);
 #endif
 void  memp_free_pool(const struct memp_desc* desc, void *mem);
 
+#if MEMP_OVERFLOW_CHECK
+u16_t memp_malloc_pool_bulk_fn(const struct memp_desc *desc, void **mem, u16_t n, const char *file, const int line);
+#define memp_malloc_pool_bulk(d, m, n) memp_malloc_pool_bulk_fn((d), (m), (n), __FILE__, __LINE__)
+#else
+u16_t memp_malloc_pool_bulk(const struct memp_desc *desc, void **mem, u16_t n);
+#endif
+void  memp_free_pool_bulk(const struct memp_desc *desc, void **mem, u16_t n);
+
 #ifdef __cplusplus
 }
 #endif
@@ -343,6 +343,25 @@ extern struct tcp_pcb *tcp_tw_pcbs;      /* List of all TCP PCBs in TIME-WAIT. *
 #define NUM_TCP_PCB_LISTS               4
 extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
 
+#if TCP_PCB_HASH
+/* With TCP_PCB_HASH, the pcbs of tcp_active_pcbs and tcp_tw_pcbs are also in
+   tcp_conn_hash and those of tcp_listen_pcbs in tcp_listen_hash (linked by
+   hash_next), maintained by TCP_REG and TCP_RMV. Connections are hashed by
+   ports only, as the local IP of a connection may still be set on output. */
+extern struct tcp_pcb *tcp_conn_hash[TCP_PCB_HASH_SIZE];
+extern struct tcp_pcb_listen *tcp_listen_hash[TCP_PCB_LISTEN_HASH_SIZE];
+#define TCP_PCB_HASH_CONN(local_port, remote_port) \
+  ((u16_t)((((((u32_t)(local_port)) << 16) ^ (remote_port)) * 2654435761UL) >> 16) & (TCP_PCB_HASH_SIZE - 1))
+#define TCP_PCB_HASH_LISTEN(local_port) ((u16_t)((local_port) & (TCP_PCB_LISTEN_HASH_SIZE - 1)))
+void tcp_pcb_hash_reg(struct tcp_pcb **pcblist, struct tcp_pcb *pcb);
+void tcp_pcb_hash_rmv(struct tcp_pcb **pcblist, struct tcp_pcb *pcb);
+#define TCP_HASH_REG(pcbs, npcb) tcp_pcb_hash_reg(pcbs, npcb)
+#define TCP_HASH_RMV(pcbs, npcb) tcp_pcb_hash_rmv(pcbs, npcb)
+#else /* TCP_PCB_HASH */
+#define TCP_HASH_REG(pcbs, npcb)
+#define TCP_HASH_RMV(pcbs, npcb)
+#endif /* TCP_PCB_HASH */
+
 /* Axioms about the above lists:
    1) Every TCP PCB that is not CLOSED is in one of the lists.
    2) A PCB is only in one of the lists.
@@ -367,6 +386,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
                             (npcb)->next = *(pcbs); \
                             LWIP_ASSERT("TCP_REG: npcb->next != npcb", (npcb)->next != (npcb)); \
                             *(pcbs) = (npcb); \
+                            TCP_HASH_REG(pcbs, npcb); \
                             LWIP_ASSERT("TCP_REG: tcp_pcbs sane", tcp_pcbs_sane()); \
               tcp_timer_needed(); \
                             } while(0)
@@ -383,6 +403,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
                                } \
                             } \
                             (npcb)->next = NULL; \
+                            TCP_HASH_RMV(pcbs, npcb); \
                             LWIP_ASSERT("TCP_RMV: tcp_pcbs sane", tcp_pcbs_sane()); \
                             LWIP_DEBUGF(TCP_DEBUG, ("TCP_RMV: removed %p from %p\n", (void *)(npcb), (void *)(*(pcbs)))); \
                             } while(0)
@@ -393,6 +414,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
   do {                                             \
     (npcb)->next = *pcbs;                          \
     *(pcbs) = (npcb);                              \
+    TCP_HASH_REG(pcbs, npcb);                      \
     tcp_timer_needed();                            \
   } while (0)
 
@@ -413,6 +435,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
       }                                            \
     }                                              \
     (npcb)->next = NULL;                           \
+    TCP_HASH_RMV(pcbs, npcb);                      \
   } while(0)
 
 #endif /* LWIP_DEBUG */
@@ -502,6 +502,22 @@ void sys_arch_unprotect(sys_prot_t pval);
 
 #endif /* SYS_ARCH_PROTECT */
 
+#if MEMP_LOCKFREE
+/**
+ * @ingroup sys_prot
+ * Atomically replace *ptr with desired if it is equal to expected (compare and
+ * swap), with a full memory barrier. Needed by MEMP_LOCKFREE, it has to be safe
+ * against other threads and interrupts (e.g. LDREX/STREX on Cortex-M).
+ *
+ * @param ptr the word to update
+ * @param expected the value *ptr has to be equal to
+ * @param desired the new value of *ptr
+ * @return the value of *ptr before the operation (equal to expected if *ptr
+ *         was replaced)
+ */
+u32_t sys_arch_cas32(volatile u32_t *ptr, u32_t expected, u32_t desired);
+#endif /* MEMP_LOCKFREE */
+
 /*
  * Macros to set/get and increase/decrease variables in a thread-safe way.
  * Use these for accessing variable that are used from more than one thread.
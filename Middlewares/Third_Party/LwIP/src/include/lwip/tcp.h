@@ -209,8 +209,15 @@ typedef u16_t tcpflags_t;
 /**
  * members common to struct tcp_pcb and struct tcp_listen_pcb
  */
+#if TCP_PCB_HASH
+#define TCP_PCB_HASH_NEXT(type) type *hash_next; /* for the hash table bucket */
+#else
+#define TCP_PCB_HASH_NEXT(type)
+#endif
+
 #define TCP_PCB_COMMON(type) \
   type *next; /* for the linked list */ \
+  TCP_PCB_HASH_NEXT(type) \
   void *callback_arg; \
   TCP_PCB_EXTARGS \
   enum tcp_state state; /* TCP state */ \
@@ -269,6 +276,9 @@ struct tcp_pcb {
 #define TF_RTO         0x0800U /* RTO timer has fired, in-flight data moved to unsent and being retransmitted */
 #if LWIP_TCP_SACK_OUT
 #define TF_SACK        0x1000U /* Selective ACKs enabled */
+#endif
+#if TCP_LARGE_SEND
+#define TF_LARGE_SEND  0x2000U /* tcp_write queues large segments, cut by tcp_output */
 #endif
 
   /* the rest of the fields are in host byte order
@@ -440,6 +450,14 @@ void             tcp_poll    (struct tcp_pcb *pcb, tcp_poll_fn poll, u8_t interv
 #define          tcp_nagle_enable(pcb)    tcp_clear_flags(pcb, TF_NODELAY)
 /** @ingroup tcp_raw */
 #define          tcp_nagle_disabled(pcb)  tcp_is_flag_set(pcb, TF_NODELAY)
+#if TCP_LARGE_SEND
+/** @ingroup tcp_raw */
+#define          tcp_large_send_enable(pcb)   tcp_set_flags(pcb, TF_LARGE_SEND)
+/** @ingroup tcp_raw */
+#define          tcp_large_send_disable(pcb)  tcp_clear_flags(pcb, TF_LARGE_SEND)
+/** @ingroup tcp_raw */
+#define          tcp_large_send_enabled(pcb)  tcp_is_flag_set(pcb, TF_LARGE_SEND)
+#endif /* TCP_LARGE_SEND */
 
 #if TCP_LISTEN_BACKLOG
 #define          tcp_backlog_set(pcb, new_backlog) do { \
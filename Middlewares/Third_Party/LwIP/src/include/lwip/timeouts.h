@@ -98,8 +98,48 @@ struct sys_timeo {
 #if LWIP_DEBUG_TIMERNAMES
   const char* handler_name;
 #endif /* LWIP_DEBUG_TIMERNAMES */
+#if LWIP_TIMERS_WHEEL
+  /** points to the 'next' pointer of the previous timeout in the wheel slot
+      (or to the slot itself) */
+  struct sys_timeo **pprev;
+  /** same as next/pprev for the hash bucket of 'arg' */
+  struct sys_timeo *hnext;
+  struct sys_timeo **hpprev;
+  /** order of creation, to expire the timeouts of equal time first in first
+      out whatever their way through the wheel levels */
+  u32_t seq;
+  /** wheel slot the timeout is in: level * SYS_TIMEOUTS_WHEEL_SLOTS + index */
+  u8_t slot;
+#endif /* LWIP_TIMERS_WHEEL */
 };
 
+#if LWIP_TIMERS_WHEEL
+/** Number of levels of the timing wheel */
+#define SYS_TIMEOUTS_WHEEL_LEVELS 6
+/** Each level has 2^SYS_TIMEOUTS_WHEEL_BITS slots */
+#define SYS_TIMEOUTS_WHEEL_BITS   5
+#define SYS_TIMEOUTS_WHEEL_SLOTS  (1 << SYS_TIMEOUTS_WHEEL_BITS)
+
+/** The hierarchical timing wheel used with LWIP_TIMERS_WHEEL.
+ * A slot at level n covers 2^(5*n) ms; a timeout is in the lowest level whose
+ * 32 slots reach its expiry time from 'base', and moves down a level when
+ * 'base' reaches its slot. */
+struct sys_timeouts_wheel {
+  /** time up to which timeouts have been processed */
+  u32_t base;
+  /** one bit per non-empty slot on each level */
+  u32_t used[SYS_TIMEOUTS_WHEEL_LEVELS];
+  struct sys_timeo *slot[SYS_TIMEOUTS_WHEEL_LEVELS][SYS_TIMEOUTS_WHEEL_SLOTS];
+  /** the timeouts again, hashed by their argument for sys_untimeout() */
+  struct sys_timeo *hash[LWIP_TIMERS_WHEEL_HASH_SIZE];
+  /** timeout expiring first, valid if earliest_valid != 0 */
+  struct sys_timeo *earliest;
+  u8_t earliest_valid;
+  /** sequence number of the next timeout created */
+  u32_t seq;
+};
+#endif /* LWIP_TIMERS_WHEEL */
+
 void sys_timeouts_init(void);
 
 #if LWIP_DEBUG_TIMERNAMES
@@ -115,7 +155,11 @@ void sys_check_timeouts(void);
 u32_t sys_timeouts_sleeptime(void);
 
 #if LWIP_TESTMODE
+#if LWIP_TIMERS_WHEEL
+struct sys_timeouts_wheel* sys_timeouts_get_wheel(void);
+#else /* LWIP_TIMERS_WHEEL */
 struct sys_timeo** sys_timeouts_get_next_timeout(void);
+#endif /* LWIP_TIMERS_WHEEL */
 void lwip_cyclic_timer(void *arg);
 #endif
 
@@ -0,0 +1,84 @@
+/**
+ * @file
+ * Batched receive queue for ethernet drivers
+ */
+
+/*
+ * Copyright (c) 2017 STMicroelectronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#ifndef LWIP_HDR_NETIF_ETHRX_H
+#define LWIP_HDR_NETIF_ETHRX_H
+
+#include "lwip/opt.h"
+
+#include "netif/ethrx_opts.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if !NO_SYS
+struct tcpip_callback_msg;
+#endif
+
+/** @ingroup ethrx
+ * The receive queue. Indexes are free running, head is only written by the
+ * driver (the receive thread), tail only by tcpip_thread, so no lock is needed
+ * between them.
+ */
+struct ethrx {
+  struct netif *netif;
+  struct pbuf *pkt[ETHRX_QUEUE_SIZE];
+  /** next entry to be filled */
+  volatile u16_t head;
+  /** next entry to be passed to the stack */
+  volatile u16_t tail;
+#if !NO_SYS
+  /** message draining the queue in tcpip_thread */
+  struct tcpip_callback_msg *msg;
+  volatile u8_t posted;
+#endif
+};
+
+err_t ethrx_init(struct ethrx *rx, struct netif *netif);
+err_t ethrx_put(struct ethrx *rx, struct pbuf *p);
+err_t ethrx_flush(struct ethrx *rx);
+
+/** Number of packets waiting for the stack */
+#define ethrx_pending(rx)   ((u16_t)((rx)->head - (rx)->tail))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LWIP_HDR_NETIF_ETHRX_H */
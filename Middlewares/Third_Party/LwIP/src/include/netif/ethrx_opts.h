@@ -0,0 +1,80 @@
+/**
+ * @file
+ * Batched receive queue for ethernet drivers (options)
+ */
+
+/*
+ * Copyright (c) 2017 STMicroelectronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#ifndef LWIP_HDR_NETIF_ETHRX_OPTS_H
+#define LWIP_HDR_NETIF_ETHRX_OPTS_H
+
+#include "lwip/opt.h"
+
+/**
+ * @defgroup ethrx_opts Options
+ * @ingroup ethrx
+ * @{
+ */
+
+/** ETHRX_QUEUE_SIZE: number of received packets that can wait for
+ * tcpip_thread. Must be a power of 2. A packet put in a full queue is dropped,
+ * so it should be at least the number of receive buffers of the driver.
+ */
+#ifndef ETHRX_QUEUE_SIZE
+#define ETHRX_QUEUE_SIZE                    16
+#endif
+
+/** ETHRX_BARRIER(): memory barrier between filling a queue slot and advancing
+ * the index that passes it to the other side (and between reading the index
+ * and the slots on that side). The default only keeps the compiler from
+ * reordering the accesses, which is enough when both sides run on the same
+ * core. Define it to __DMB() in lwipopts.h otherwise.
+ */
+#ifndef ETHRX_BARRIER
+#if defined(__GNUC__) || defined(__ICCARM__)
+#define ETHRX_BARRIER()                     __asm volatile ("" ::: "memory")
+#elif defined(__CC_ARM)
+#define ETHRX_BARRIER()                     __memory_changed()
+#else
+#error "ETHRX_BARRIER() is not defined for this compiler"
+#endif
+#endif
+
+/** ETHRX_DEBUG: Enable debugging in ethrx.c. */
+#ifndef ETHRX_DEBUG
+#define ETHRX_DEBUG                         LWIP_DBG_OFF
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* LWIP_HDR_NETIF_ETHRX_OPTS_H */
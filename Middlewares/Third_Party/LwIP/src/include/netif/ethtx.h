@@ -0,0 +1,129 @@
+/**
+ * @file
+ * Zero-copy transmit ring for ethernet drivers
+ */
+
+/*
+ * Copyright (c) 2017 STMicroelectronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#ifndef LWIP_HDR_NETIF_ETHTX_H
+#define LWIP_HDR_NETIF_ETHTX_H
+
+#include "lwip/opt.h"
+
+#include "netif/ethtx_opts.h"
+#include "lwip/pbuf.h"
+#include "lwip/err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ethtx;
+#if !NO_SYS
+struct tcpip_callback_msg;
+#endif
+
+/** @ingroup ethtx
+ * A buffer of a packet handed to the MAC. The layout is the one of the buffer
+ * lists taken by the DMA drivers (e.g. ETH_BufferTypeDef of the STM32 HAL), so
+ * the chain can be passed to the driver as is.
+ */
+struct ethtx_buf {
+  u8_t *buffer;
+  u32_t len;
+  struct ethtx_buf *next;
+};
+
+/** @ingroup ethtx
+ * Function prototype for the MAC hook handing a packet to the DMA.
+ * Called in the context that calls ethtx_output() and ethtx_poll().
+ *
+ * @param tx the transmit ring
+ * @param buf the buffers of the packet, valid until the packet is completed
+ * @param len total length of the packet
+ * @param pkt handle of the packet, to be passed to ethtx_complete() when the
+ *        MAC is done with it
+ * @return ERR_OK if the packet was queued on the DMA,
+ *         ERR_MEM if there are not enough free descriptors (retried after the
+ *         next completion), any other error drops the packets not yet queued
+ */
+typedef err_t (*ethtx_xmit_fn)(struct ethtx *tx, struct ethtx_buf *buf, u16_t len, void *pkt);
+
+/** @ingroup ethtx
+ * A packet slot of the ring. The buffer chain is reused from packet to packet.
+ */
+struct ethtx_slot {
+  struct pbuf *p;
+  u16_t len;
+  struct ethtx_buf buf[ETHTX_MAX_BUFS];
+};
+
+/** @ingroup ethtx
+ * The transmit ring. Slots are used in order, indexes are free running:
+ *   tail <= done <= sent <= head
+ * head, sent and tail are only written by the output side (tcpip_thread or
+ * core lock holder), done only by the completion side (TX interrupt), so no
+ * lock is needed between them.
+ */
+struct ethtx {
+  ethtx_xmit_fn xmit;
+  /** free for the driver */
+  void *state;
+  struct ethtx_slot slot[ETHTX_RING_SIZE];
+  /** next slot to be filled */
+  u16_t head;
+  /** next slot to be handed to the MAC */
+  u16_t sent;
+  /** next slot to be completed by the MAC */
+  volatile u16_t done;
+  /** next slot to be freed */
+  u16_t tail;
+#if !NO_SYS
+  /** message running ethtx_poll() in tcpip_thread after a completion */
+  struct tcpip_callback_msg *msg;
+  volatile u8_t posted;
+#endif
+};
+
+err_t ethtx_init(struct ethtx *tx, ethtx_xmit_fn xmit, void *state);
+err_t ethtx_output(struct ethtx *tx, struct pbuf *p);
+void  ethtx_poll(struct ethtx *tx);
+void  ethtx_complete(struct ethtx *tx, void *pkt);
+void  ethtx_complete_batch(struct ethtx *tx);
+
+/** Number of packets queued or in flight */
+#define ethtx_pending(tx)   ((u16_t)((tx)->head - (tx)->tail))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LWIP_HDR_NETIF_ETHTX_H */
@@ -0,0 +1,89 @@
+/**
+ * @file
+ * Zero-copy transmit ring for ethernet drivers (options)
+ */
+
+/*
+ * Copyright (c) 2017 STMicroelectronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#ifndef LWIP_HDR_NETIF_ETHTX_OPTS_H
+#define LWIP_HDR_NETIF_ETHTX_OPTS_H
+
+#include "lwip/opt.h"
+
+/**
+ * @defgroup ethtx_opts Options
+ * @ingroup ethtx
+ * @{
+ */
+
+/** ETHTX_RING_SIZE: number of packets that can be queued or in flight on the
+ * MAC at the same time. Must be a power of 2. Twice the number of DMA transmit
+ * descriptors lets the output thread queue a burst while the previous one is
+ * still being sent.
+ */
+#ifndef ETHTX_RING_SIZE
+#define ETHTX_RING_SIZE                     8
+#endif
+
+/** ETHTX_MAX_BUFS: number of buffers a packet can be handed to the MAC in.
+ * A pbuf chain longer than this (or with volatile payload, see PBUF_NEEDS_COPY)
+ * is copied into a single PBUF_RAM pbuf before it is queued.
+ */
+#ifndef ETHTX_MAX_BUFS
+#define ETHTX_MAX_BUFS                      4
+#endif
+
+/** ETHTX_BARRIER(): memory barrier between filling a ring slot and advancing
+ * the index that passes it to the other side (and between reading the index
+ * and the slots on that side). The default only keeps the compiler from
+ * reordering the accesses, which is enough when both sides run on the same
+ * core. Define it to __DMB() in lwipopts.h otherwise.
+ */
+#ifndef ETHTX_BARRIER
+#if defined(__GNUC__) || defined(__ICCARM__)
+#define ETHTX_BARRIER()                     __asm volatile ("" ::: "memory")
+#elif defined(__CC_ARM)
+#define ETHTX_BARRIER()                     __memory_changed()
+#else
+#error "ETHTX_BARRIER() is not defined for this compiler"
+#endif
+#endif
+
+/** ETHTX_DEBUG: Enable debugging in ethtx.c. */
+#ifndef ETHTX_DEBUG
+#define ETHTX_DEBUG                         LWIP_DBG_OFF
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* LWIP_HDR_NETIF_ETHTX_OPTS_H */
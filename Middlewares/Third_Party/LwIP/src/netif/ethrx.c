@@ -0,0 +1,202 @@
+/**
+ * @file
+ * Batched receive queue for ethernet drivers
+ *
+ * @defgroup ethrx Ethernet RX queue
+ * @ingroup netifs
+ * A queue of received packets between the receive thread of an ethernet
+ * driver and tcpip_thread. Instead of posting one message per packet to
+ * tcpip_thread (netif->input == tcpip_input), the driver puts the packets it
+ * drained from the MAC in the queue, and one message passes them all to the
+ * stack.
+ *
+ * Usage:
+ * @code{.c}
+ *   static struct ethrx EthRx;
+ *
+ *   ethrx_init(&EthRx, netif);
+ *
+ *   static void rx_thread(void *arg)
+ *   {
+ *     for (;;) {
+ *       ...wait for the receive interrupt...
+ *       while ((p = low_level_input(netif)) != NULL) {
+ *         if (ethrx_put(&EthRx, p) != ERR_OK) {
+ *           pbuf_free(p);
+ *         }
+ *       }
+ *       ethrx_flush(&EthRx);
+ *     }
+ *   }
+ * @endcode
+ */
+
+/*
+ * Copyright (c) 2017 STMicroelectronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "netif/ethrx.h"
+#include "netif/ethernet.h"
+#include "lwip/ip.h"
+#include "lwip/stats.h"
+#include "lwip/debug.h"
+#if !NO_SYS
+#include "lwip/tcpip.h"
+#endif
+
+#include <string.h>
+
+#if (ETHRX_QUEUE_SIZE & (ETHRX_QUEUE_SIZE - 1)) || (ETHRX_QUEUE_SIZE > 0x8000)
+#error "ETHRX_QUEUE_SIZE must be a power of 2"
+#endif
+
+/* Pass the queued packets to the stack, in tcpip_thread (or with the core
+   locked) */
+static void
+ethrx_drain(struct ethrx *rx)
+{
+  struct netif *netif = rx->netif;
+  u16_t head = rx->head;
+  struct pbuf *p;
+  err_t err;
+
+  /* read the slots published up to head */
+  ETHRX_BARRIER();
+  while (rx->tail != head) {
+    p = rx->pkt[rx->tail & (ETHRX_QUEUE_SIZE - 1)];
+    /* the slot is read before it is given back to the driver */
+    ETHRX_BARRIER();
+    rx->tail++;
+#if LWIP_ETHERNET
+    if (netif->flags & (NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET)) {
+      err = ethernet_input(p, netif);
+    } else
+#endif /* LWIP_ETHERNET */
+    {
+      err = ip_input(p, netif);
+    }
+    if (err != ERR_OK) {
+      pbuf_free(p);
+    }
+  }
+}
+
+#if !NO_SYS && !LWIP_TCPIP_CORE_LOCKING_INPUT
+static void
+ethrx_drain_cb(void *ctx)
+{
+  struct ethrx *rx = (struct ethrx *)ctx;
+
+  rx->posted = 0;
+  ethrx_drain(rx);
+}
+#endif
+
+/**
+ * @ingroup ethrx
+ * Initialize a receive queue.
+ *
+ * @param rx the receive queue
+ * @param netif the netif the packets are received on
+ * @return ERR_OK, or ERR_MEM if the tcpip_thread message could not be allocated
+ */
+err_t
+ethrx_init(struct ethrx *rx, struct netif *netif)
+{
+  LWIP_ASSERT("rx != NULL", rx != NULL);
+  LWIP_ASSERT("netif != NULL", netif != NULL);
+
+  memset(rx, 0, sizeof(struct ethrx));
+  rx->netif = netif;
+#if !NO_SYS && !LWIP_TCPIP_CORE_LOCKING_INPUT
+  rx->msg = tcpip_callbackmsg_new(ethrx_drain_cb, rx);
+  if (rx->msg == NULL) {
+    return ERR_MEM;
+  }
+#endif
+  return ERR_OK;
+}
+
+/**
+ * @ingroup ethrx
+ * Queue a received packet. It is passed to the stack by the next
+ * ethrx_flush(). Only to be called by one thread (the receive thread).
+ *
+ * @param rx the receive queue
+ * @param p the packet (including the ethernet header)
+ * @return ERR_OK if the packet was queued, or ERR_MEM if the queue is full
+ *         (the caller keeps the packet and has to free it)
+ */
+err_t
+ethrx_put(struct ethrx *rx, struct pbuf *p)
+{
+  LWIP_ASSERT("p != NULL", p != NULL);
+
+  if ((u16_t)(rx->head - rx->tail) >= ETHRX_QUEUE_SIZE) {
+    LWIP_DEBUGF(ETHRX_DEBUG, ("ethrx_put: queue full\n"));
+    LINK_STATS_INC(link.drop);
+    return ERR_MEM;
+  }
+  rx->pkt[rx->head & (ETHRX_QUEUE_SIZE - 1)] = p;
+  /* publish the slot before the index */
+  ETHRX_BARRIER();
+  rx->head++;
+  return ERR_OK;
+}
+
+/**
+ * @ingroup ethrx
+ * Pass the queued packets to the stack: post one message to tcpip_thread,
+ * unless one is already pending (it will take the new packets too). With
+ * LWIP_TCPIP_CORE_LOCKING_INPUT or NO_SYS, the packets are passed directly.
+ *
+ * @param rx the receive queue
+ * @return ERR_OK, or ERR_MEM if the message could not be posted (the packets
+ *         stay queued until the next ethrx_flush())
+ */
+err_t
+ethrx_flush(struct ethrx *rx)
+{
+#if NO_SYS
+  ethrx_drain(rx);
+#elif LWIP_TCPIP_CORE_LOCKING_INPUT
+  LOCK_TCPIP_CORE();
+  ethrx_drain(rx);
+  UNLOCK_TCPIP_CORE();
+#else
+  if ((rx->head != rx->tail) && !rx->posted) {
+    rx->posted = 1;
+    if (tcpip_callbackmsg_trycallback(rx->msg) != ERR_OK) {
+      rx->posted = 0;
+      return ERR_MEM;
+    }
+  }
+#endif
+  return ERR_OK;
+}
@@ -0,0 +1,288 @@
+/**
+ * @file
+ * Zero-copy transmit ring for ethernet drivers
+ *
+ * @defgroup ethtx Ethernet TX ring
+ * @ingroup netifs
+ * A ring of packets between the linkoutput function of an ethernet driver and
+ * its MAC DMA. The pbufs are handed to the MAC without copy and referenced
+ * until the MAC has sent them. linkoutput never waits for the MAC: when the DMA
+ * descriptors are all in use, the packet stays queued in the ring and is handed
+ * to the MAC after the next completion.
+ *
+ * The completion side (usually the TX interrupt) only advances an index, the
+ * pbufs are freed in batches by the output side, on the next output or in
+ * tcpip_thread by a message posted at the end of a completion batch.
+ *
+ * Usage:
+ * @code{.c}
+ *   static struct ethtx EthTx;
+ *
+ *   static err_t mac_xmit(struct ethtx *tx, struct ethtx_buf *buf, u16_t len, void *pkt)
+ *   {
+ *     ...hand buf to the DMA, pkt is passed back when the DMA is done with it...
+ *   }
+ *   static err_t low_level_output(struct netif *netif, struct pbuf *p)
+ *   {
+ *     return ethtx_output(&EthTx, p);
+ *   }
+ *   void mac_tx_irq(void)
+ *   {
+ *     ...for each packet sent by the DMA, in order: ethtx_complete(&EthTx, pkt);
+ *     ethtx_complete_batch(&EthTx);
+ *   }
+ *
+ *   ethtx_init(&EthTx, mac_xmit, NULL);
+ * @endcode
+ */
+
+/*
+ * Copyright (c) 2017 STMicroelectronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "netif/ethtx.h"
+#include "lwip/stats.h"
+#include "lwip/debug.h"
+#if !NO_SYS
+#include "lwip/tcpip.h"
+#endif
+
+#include <string.h>
+
+#if (ETHTX_RING_SIZE & (ETHTX_RING_SIZE - 1)) || (ETHTX_RING_SIZE > 0x8000)
+#error "ETHTX_RING_SIZE must be a power of 2"
+#endif
+#if ETHTX_MAX_BUFS < 1
+#error "ETHTX_MAX_BUFS must be at least 1"
+#endif
+
+#define ETHTX_SLOT(tx, idx)   (&(tx)->slot[(idx) & (ETHTX_RING_SIZE - 1)])
+
+#if !NO_SYS
+static void
+ethtx_poll_cb(void *ctx)
+{
+  ethtx_poll((struct ethtx *)ctx);
+}
+#endif
+
+/* Free the pbufs of the packets completed by the MAC */
+static void
+ethtx_reclaim(struct ethtx *tx)
+{
+  u16_t done = tx->done;
+
+  /* the MAC is done with the slots up to done */
+  ETHTX_BARRIER();
+  while (tx->tail != done) {
+    struct ethtx_slot *s = ETHTX_SLOT(tx, tx->tail);
+    pbuf_free(s->p);
+    s->p = NULL;
+    tx->tail++;
+  }
+}
+
+/* Hand the queued packets to the MAC until it runs out of descriptors */
+static err_t
+ethtx_push(struct ethtx *tx)
+{
+  err_t err;
+
+  while (tx->sent != tx->head) {
+    struct ethtx_slot *s = ETHTX_SLOT(tx, tx->sent);
+    err = tx->xmit(tx, s->buf, s->len, s->p);
+    if (err == ERR_MEM) {
+      /* MAC busy: the next completion will bring us back here */
+      break;
+    }
+    if (err != ERR_OK) {
+      /* MAC stopped: drop what it has not taken yet */
+      LWIP_DEBUGF(ETHTX_DEBUG, ("ethtx_push: xmit error %d, dropping %"U16_F" packets\n",
+                                (int)err, (u16_t)(tx->head - tx->sent)));
+      while (tx->head != tx->sent) {
+        tx->head--;
+        s = ETHTX_SLOT(tx, tx->head);
+        pbuf_free(s->p);
+        s->p = NULL;
+        LINK_STATS_INC(link.drop);
+      }
+      return err;
+    }
+    tx->sent++;
+  }
+  return ERR_OK;
+}
+
+/**
+ * @ingroup ethtx
+ * Initialize a transmit ring.
+ *
+ * @param tx the transmit ring
+ * @param xmit MAC hook handing a packet to the DMA
+ * @param state free for the driver, stored in tx->state
+ * @return ERR_OK, or ERR_MEM if the completion message could not be allocated
+ */
+err_t
+ethtx_init(struct ethtx *tx, ethtx_xmit_fn xmit, void *state)
+{
+  LWIP_ASSERT("tx != NULL", tx != NULL);
+  LWIP_ASSERT("xmit != NULL", xmit != NULL);
+
+  memset(tx, 0, sizeof(struct ethtx));
+  tx->xmit = xmit;
+  tx->state = state;
+#if !NO_SYS
+  tx->msg = tcpip_callbackmsg_new(ethtx_poll_cb, tx);
+  if (tx->msg == NULL) {
+    return ERR_MEM;
+  }
+#endif
+  return ERR_OK;
+}
+
+/**
+ * @ingroup ethtx
+ * Queue a packet for transmission. To be called from the linkoutput function
+ * of the driver, with the same serialization (tcpip_thread or core lock).
+ * The pbuf is referenced, the caller keeps its own reference.
+ *
+ * @param tx the transmit ring
+ * @param p the packet
+ * @return ERR_OK if the packet was queued (it may not be on the MAC yet),
+ *         ERR_MEM if the ring is full or the packet could not be copied,
+ *         the error of the MAC hook if it refused the packet
+ */
+err_t
+ethtx_output(struct ethtx *tx, struct pbuf *p)
+{
+  struct ethtx_slot *s;
+  struct pbuf *q;
+  u16_t n = 0;
+
+  LWIP_ASSERT("p != NULL", p != NULL);
+
+  ethtx_reclaim(tx);
+  if ((u16_t)(tx->head - tx->tail) >= ETHTX_RING_SIZE) {
+    LWIP_DEBUGF(ETHTX_DEBUG, ("ethtx_output: ring full\n"));
+    LINK_STATS_INC(link.memerr);
+    return ERR_MEM;
+  }
+
+  for (q = p; q != NULL && n <= ETHTX_MAX_BUFS; q = q->next) {
+    n++;
+  }
+  if (n > ETHTX_MAX_BUFS || PBUF_NEEDS_COPY(p)) {
+    /* Too many buffers for the slot, or payload that may change before the
+       MAC reads it: send a copy */
+    q = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+    if (q == NULL) {
+      LINK_STATS_INC(link.memerr);
+      return ERR_MEM;
+    }
+  } else {
+    pbuf_ref(p);
+    q = p;
+  }
+
+  s = ETHTX_SLOT(tx, tx->head);
+  s->p = q;
+  s->len = q->tot_len;
+  for (n = 0; q != NULL; q = q->next, n++) {
+    s->buf[n].buffer = (u8_t *)q->payload;
+    s->buf[n].len = q->len;
+    s->buf[n].next = (q->next != NULL) ? &s->buf[n + 1] : NULL;
+  }
+  /* publish the slot before the index */
+  ETHTX_BARRIER();
+  tx->head++;
+
+  return ethtx_push(tx);
+}
+
+/**
+ * @ingroup ethtx
+ * Free the completed packets and hand the queued ones to the MAC.
+ * Called in tcpip_thread after a completion batch, or from the main loop
+ * at NO_SYS == 1.
+ *
+ * @param tx the transmit ring
+ */
+void
+ethtx_poll(struct ethtx *tx)
+{
+#if !NO_SYS
+  tx->posted = 0;
+#endif
+  ethtx_reclaim(tx);
+  ethtx_push(tx);
+}
+
+/**
+ * @ingroup ethtx
+ * Called by the driver (usually from the TX interrupt) for each packet the MAC
+ * is done with, in the order the packets were handed to it.
+ *
+ * @param tx the transmit ring
+ * @param pkt the handle passed to the MAC hook
+ */
+void
+ethtx_complete(struct ethtx *tx, void *pkt)
+{
+  LWIP_ASSERT("ethtx_complete: no packet on the MAC", tx->done != tx->sent);
+  LWIP_ASSERT("ethtx_complete: packets completed out of order",
+              ETHTX_SLOT(tx, tx->done)->p == (struct pbuf *)pkt);
+  LWIP_UNUSED_ARG(pkt);
+  /* the driver is done with the packet before it is given back */
+  ETHTX_BARRIER();
+  tx->done++;
+}
+
+/**
+ * @ingroup ethtx
+ * Called by the driver after a batch of ethtx_complete(). When packets are
+ * waiting for descriptors or the MAC went idle, ethtx_poll() is scheduled in
+ * tcpip_thread (once until it runs), otherwise the completed packets are
+ * freed on the next output.
+ *
+ * @param tx the transmit ring
+ */
+void
+ethtx_complete_batch(struct ethtx *tx)
+{
+#if !NO_SYS
+  if (!tx->posted && (tx->sent != tx->head || tx->done == tx->sent)) {
+    tx->posted = 1;
+    if (tcpip_callbackmsg_trycallback_fromisr(tx->msg) != ERR_OK) {
+      tx->posted = 0;
+    }
+  }
+#else
+  LWIP_UNUSED_ARG(tx);
+#endif
+}
@@ -40,6 +40,9 @@
 #if !NO_SYS
 
 #include "cmsis_os.h"
+#if MEMP_LOCKFREE
+#include "cmsis_compiler.h"
+#endif
 
 #if defined(LWIP_PROVIDE_ERRNO)
 int errno;
@@ -509,4 +512,30 @@ void sys_arch_unprotect(sys_prot_t pval)
   osMutexRelease(lwip_sys_mutex);
 }
 
+#if MEMP_LOCKFREE
+/*
+  Compare and swap for the lock-free memp pools (MEMP_LOCKFREE): *ptr is set to
+  desired if it is equal to expected, the previous value of *ptr is returned.
+  Based on the exclusive access instructions, so it is safe against other tasks
+  and interrupt handlers without masking interrupts: an exception between
+  LDREX and STREX clears the exclusive monitor and the store is retried.
+*/
+u32_t sys_arch_cas32(volatile u32_t *ptr, u32_t expected, u32_t desired)
+{
+  u32_t prev;
+
+  __DMB();
+  do {
+    prev = __LDREXW(ptr);
+    if (prev != expected) {
+      __CLREX();
+      break;
+    }
+  } while (__STREXW(desired, ptr) != 0U);
+  __DMB();
+
+  return prev;
+}
+#endif /* MEMP_LOCKFREE */
+
 #endif /* !NO_SYS */
@@ -0,0 +1,24 @@
+/*
+ * Included before inet_chksum.c when it is built once per algorithm, so the
+ * versions can be linked together in chksum_bench: the public functions get
+ * the algorithm number as suffix (lwip_standard_chksum_v4...).
+ */
+#ifndef LWIP_HDR_BENCH_RENAME_H
+#define LWIP_HDR_BENCH_RENAME_H
+
+#define BENCH_CONCAT2(a, b)   a##b
+#define BENCH_CONCAT(a, b)    BENCH_CONCAT2(a, b)
+#define BENCH_NAME(name)      BENCH_CONCAT(name, BENCH_CONCAT(_v, LWIP_CHKSUM_ALGORITHM))
+
+#define lwip_standard_chksum          BENCH_NAME(lwip_standard_chksum)
+#define lwip_chksum_copy              BENCH_NAME(lwip_chksum_copy)
+#define inet_chksum                   BENCH_NAME(inet_chksum)
+#define inet_chksum_pbuf              BENCH_NAME(inet_chksum_pbuf)
+#define inet_chksum_adjust            BENCH_NAME(inet_chksum_adjust)
+#define inet_chksum_adjust32          BENCH_NAME(inet_chksum_adjust32)
+#define inet_chksum_pseudo            BENCH_NAME(inet_chksum_pseudo)
+#define inet_chksum_pseudo_partial    BENCH_NAME(inet_chksum_pseudo_partial)
+#define ip_chksum_pseudo              BENCH_NAME(ip_chksum_pseudo)
+#define ip_chksum_pseudo_partial      BENCH_NAME(ip_chksum_pseudo_partial)
+
+#endif /* LWIP_HDR_BENCH_RENAME_H */
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2017 STMicroelectronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+/*
+ * Host benchmark of the checksum algorithms of inet_chksum.c
+ * (LWIP_CHKSUM_ALGORITHM 1 to 4, and the copy and checksum of
+ * LWIP_CHKSUM_COPY_ALGORITHM 1 and 2) across packet sizes and alignments.
+ * The results of all the versions are checked against each other first.
+ */
+
+#include "lwip/opt.h"
+#include "lwip/def.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_BUFSIZE     4096
+#define BENCH_BYTES       (64UL * 1024 * 1024)  /* summed per measure */
+
+typedef u16_t (*chksum_fn)(const void *dataptr, int len);
+typedef u16_t (*chksum_copy_fn)(void *dst, const void *src, u16_t len);
+
+u16_t lwip_standard_chksum_v1(const void *dataptr, int len);
+u16_t lwip_standard_chksum_v2(const void *dataptr, int len);
+u16_t lwip_standard_chksum_v3(const void *dataptr, int len);
+u16_t lwip_standard_chksum_v4(const void *dataptr, int len);
+/* v2: MEMCPY then version #2, v4: fused copy and checksum */
+u16_t lwip_chksum_copy_v2(void *dst, const void *src, u16_t len);
+u16_t lwip_chksum_copy_v4(void *dst, const void *src, u16_t len);
+
+static const chksum_fn chksum_fns[] = {
+  lwip_standard_chksum_v1,
+  lwip_standard_chksum_v2,
+  lwip_standard_chksum_v3,
+  lwip_standard_chksum_v4
+};
+static const chksum_copy_fn copy_fns[] = {
+  lwip_chksum_copy_v2,
+  lwip_chksum_copy_v4
+};
+
+static const int sizes[] = { 20, 40, 64, 128, 256, 576, 1460, 1500, 4000 };
+static const int offsets[] = { 0, 1, 2, 3 };
+
+static u8_t src_buf[BENCH_BUFSIZE + 8];
+static u8_t dst_buf[BENCH_BUFSIZE + 8];
+static volatile u16_t sink;
+
+static double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Check all the versions against version #1 */
+static int
+check(void)
+{
+  int len, ofs, dofs;
+  size_t i;
+  u16_t ref, sum;
+
+  for (ofs = 0; ofs < 8; ofs++) {
+    for (len = 0; len <= BENCH_BUFSIZE; len += (len < 300) ? 1 : 97) {
+      ref = lwip_standard_chksum_v1(&src_buf[ofs], len);
+      for (i = 1; i < LWIP_ARRAYSIZE(chksum_fns); i++) {
+        sum = chksum_fns[i](&src_buf[ofs], len);
+        if (sum != ref) {
+          printf("version #%d: ofs %d len %d: 0x%04x != 0x%04x\n", (int)i + 1, ofs, len, sum, ref);
+          return -1;
+        }
+      }
+      for (dofs = 0; dofs < 4; dofs++) {
+        for (i = 0; i < LWIP_ARRAYSIZE(copy_fns); i++) {
+          memset(dst_buf, 0, sizeof(dst_buf));
+          sum = copy_fns[i](&dst_buf[dofs], &src_buf[ofs], (u16_t)len);
+          if ((sum != ref) || memcmp(&dst_buf[dofs], &src_buf[ofs], len)) {
+            printf("copy version #%d: dst %d src %d len %d failed\n", (int)i * 2 + 2, dofs, ofs, len);
+            return -1;
+          }
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+/* Throughput of one checksum version in MB/s */
+static double
+bench_chksum(chksum_fn fn, int ofs, int len)
+{
+  unsigned long n = BENCH_BYTES / (unsigned long)len;
+  unsigned long i;
+  u16_t acc = 0;
+  double t;
+
+  t = now();
+  for (i = 0; i < n; i++) {
+    acc ^= fn(&src_buf[ofs], len);
+  }
+  t = now() - t;
+  sink = acc;
+  return (double)n * (double)len / t / 1e6;
+}
+
+/* Throughput of one copy and checksum version in MB/s */
+static double
+bench_copy(chksum_copy_fn fn, int dofs, int ofs, int len)
+{
+  unsigned long n = BENCH_BYTES / (unsigned long)len;
+  unsigned long i;
+  u16_t acc = 0;
+  double t;
+
+  t = now();
+  for (i = 0; i < n; i++) {
+    acc ^= fn(&dst_buf[dofs], &src_buf[ofs], (u16_t)len);
+  }
+  t = now() - t;
+  sink = acc;
+  return (double)n * (double)len / t / 1e6;
+}
+
+int
+main(void)
+{
+  size_t i, s, o;
+
+  srand(1);
+  for (i = 0; i < sizeof(src_buf); i++) {
+    src_buf[i] = (u8_t)rand();
+  }
+  if (check() != 0) {
+    return 1;
+  }
+
+  printf("checksum (MB/s)\n");
+  printf("  len ofs        v1        v2        v3        v4\n");
+  for (s = 0; s < LWIP_ARRAYSIZE(sizes); s++) {
+    for (o = 0; o < LWIP_ARRAYSIZE(offsets); o++) {
+      printf("%5d %3d", sizes[s], offsets[o]);
+      for (i = 0; i < LWIP_ARRAYSIZE(chksum_fns); i++) {
+        printf(" %9.0f", bench_chksum(chksum_fns[i], offsets[o], sizes[s]));
+      }
+      printf("\n");
+    }
+  }
+
+  printf("\ncopy and checksum (MB/s)\n");
+  printf("  len dst src  memcpy+v2     fused\n");
+  for (s = 0; s < LWIP_ARRAYSIZE(sizes); s++) {
+    for (o = 0; o < LWIP_ARRAYSIZE(offsets); o++) {
+      /* same alignment, then dst and src alignments differing */
+      int dofs;
+      for (dofs = offsets[o]; dofs <= offsets[o] + 1; dofs++) {
+        printf("%5d %3d %3d", sizes[s], dofs & 3, offsets[o]);
+        for (i = 0; i < LWIP_ARRAYSIZE(copy_fns); i++) {
+          printf(" %10.0f", bench_copy(copy_fns[i], dofs & 3, offsets[o], sizes[s]));
+        }
+        printf("\n");
+      }
+    }
+  }
+  return 0;
+}
@@ -13,13 +13,17 @@ set(LWIP_TESTFILES
 	${LWIP_TESTDIR}/lwip_unittests.c
 	${LWIP_TESTDIR}/api/test_sockets.c
 	${LWIP_TESTDIR}/arch/sys_arch.c
+	${LWIP_TESTDIR}/core/test_chksum.c
 	${LWIP_TESTDIR}/core/test_def.c
 	${LWIP_TESTDIR}/core/test_mem.c
+	${LWIP_TESTDIR}/core/test_memp.c
 	${LWIP_TESTDIR}/core/test_netif.c
 	${LWIP_TESTDIR}/core/test_pbuf.c
 	${LWIP_TESTDIR}/core/test_timers.c
 	${LWIP_TESTDIR}/dhcp/test_dhcp.c
 	${LWIP_TESTDIR}/etharp/test_etharp.c
+	${LWIP_TESTDIR}/ethrx/test_ethrx.c
+	${LWIP_TESTDIR}/ethtx/test_ethtx.c
 	${LWIP_TESTDIR}/ip4/test_ip4.c
 	${LWIP_TESTDIR}/ip6/test_ip6.c
 	${LWIP_TESTDIR}/mdns/test_mdns.c
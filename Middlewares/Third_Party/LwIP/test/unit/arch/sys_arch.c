@@ -41,6 +41,9 @@
 #include <lwip/sys.h>
 
 #include <string.h>
+#if !NO_SYS
+#include <pthread.h>
+#endif
 
 u32_t lwip_sys_now;
 
@@ -65,6 +68,43 @@ sys_init(void)
 
 test_sys_arch_waiting_fn the_waiting_fn;
 
+static pthread_mutex_t test_sys_arch_mutex;
+static pthread_once_t test_sys_arch_mutex_once = PTHREAD_ONCE_INIT;
+
+static void
+test_sys_arch_mutex_init(void)
+{
+  pthread_mutexattr_t attr;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&test_sys_arch_mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+void
+test_sys_arch_protect(void)
+{
+  pthread_once(&test_sys_arch_mutex_once, test_sys_arch_mutex_init);
+  pthread_mutex_lock(&test_sys_arch_mutex);
+}
+
+void
+test_sys_arch_unprotect(void)
+{
+  pthread_mutex_unlock(&test_sys_arch_mutex);
+}
+
+#if MEMP_LOCKFREE
+u32_t
+sys_arch_cas32(volatile u32_t *ptr, u32_t expected, u32_t desired)
+{
+  __atomic_compare_exchange_n(ptr, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  /* on failure, expected has been updated to the current value */
+  return expected;
+}
+#endif /* MEMP_LOCKFREE */
+
 void
 test_sys_arch_wait_callback(test_sys_arch_waiting_fn waiting_fn)
 {
@@ -53,9 +53,12 @@ typedef struct lwip_mbox sys_mbox_t;
 /* DWORD (thread id) is used for sys_thread_t but we won't include windows.h */
 typedef u32_t sys_thread_t;
 
+/* a (recursive) mutex, as some tests (e.g. memp) run several threads */
 #define SYS_ARCH_DECL_PROTECT(lev)
-#define SYS_ARCH_PROTECT(lev)
-#define SYS_ARCH_UNPROTECT(lev)
+#define SYS_ARCH_PROTECT(lev)   test_sys_arch_protect()
+#define SYS_ARCH_UNPROTECT(lev) test_sys_arch_unprotect()
+void test_sys_arch_protect(void);
+void test_sys_arch_unprotect(void);
 
 /* to implement doing something while blocking on an mbox or semaphore:
  * pass a function to test_sys_arch_wait_callback() that returns
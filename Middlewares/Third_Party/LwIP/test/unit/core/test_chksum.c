@@ -0,0 +1,186 @@
+#include "test_chksum.h"
+
+#include "lwip/inet_chksum.h"
+#include "lwip/def.h"
+
+#define TEST_BUFSIZE          2048
+#define TEST_MAXOFS           8
+
+static u8_t testdata[TEST_BUFSIZE + TEST_MAXOFS];
+static u8_t copybuf[TEST_BUFSIZE + TEST_MAXOFS];
+
+/* Lengths around the loop boundaries of the algorithms plus frame sizes */
+static const int test_lens[] = { 1460, 1480, 1500, 1514, TEST_BUFSIZE };
+
+/* Setups/teardown functions */
+
+static void
+chksum_setup(void)
+{
+  int i;
+
+  for (i = 0; i < (int)sizeof(testdata); i++) {
+    testdata[i] = (u8_t)rand();
+  }
+}
+
+static void
+chksum_teardown(void)
+{
+}
+
+/* Reference: 16-bit big endian words summed one at a time, as in RFC 1071,
+   returned the way inet_chksum() does (to be saved directly in the header) */
+static u16_t
+ref_chksum(const u8_t *data, int len)
+{
+  u32_t acc = 0;
+  int i;
+
+  for (i = 0; i + 1 < len; i += 2) {
+    acc += ((u32_t)data[i] << 8) | data[i + 1];
+  }
+  if (len & 1) {
+    acc += (u32_t)data[len - 1] << 8;
+  }
+  while (acc >> 16) {
+    acc = (acc & 0xffffUL) + (acc >> 16);
+  }
+  return lwip_htons((u16_t)~acc);
+}
+
+static void
+check_chksum(int ofs, int len)
+{
+  u16_t expected = ref_chksum(&testdata[ofs], len);
+  u16_t chksum = inet_chksum(&testdata[ofs], (u16_t)len);
+
+  fail_unless(chksum == expected, "ofs %d len %d: 0x%04x != 0x%04x", ofs, len, chksum, expected);
+}
+
+#if LWIP_CHKSUM_COPY_ALGORITHM
+static void
+check_chksum_copy(int dst_ofs, int src_ofs, int len)
+{
+  u16_t expected = ref_chksum(&testdata[src_ofs], len);
+  u16_t chksum;
+
+  memset(copybuf, 0, sizeof(copybuf));
+  chksum = lwip_chksum_copy(&copybuf[dst_ofs], &testdata[src_ofs], (u16_t)len);
+  fail_unless((u16_t)~chksum == expected, "dst %d src %d len %d", dst_ofs, src_ofs, len);
+  fail_if(memcmp(&copybuf[dst_ofs], &testdata[src_ofs], len));
+  if (dst_ofs > 0) {
+    fail_unless(copybuf[dst_ofs - 1] == 0);
+  }
+  fail_unless(copybuf[dst_ofs + len] == 0);
+}
+#endif /* LWIP_CHKSUM_COPY_ALGORITHM */
+
+/* Test functions */
+
+/** The checksum is the same for any alignment and length */
+START_TEST(test_chksum_alignment)
+{
+  int ofs, len;
+  size_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (ofs = 0; ofs < TEST_MAXOFS; ofs++) {
+    for (len = 0; len <= 300; len++) {
+      check_chksum(ofs, len);
+    }
+    for (i = 0; i < LWIP_ARRAYSIZE(test_lens); i++) {
+      check_chksum(ofs, test_lens[i]);
+    }
+  }
+}
+END_TEST
+
+/** All-ones data sums to 0xffff without overflowing the accumulator */
+START_TEST(test_chksum_all_ones)
+{
+  int ofs;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(testdata, 0xff, sizeof(testdata));
+  for (ofs = 0; ofs < TEST_MAXOFS; ofs++) {
+    check_chksum(ofs, TEST_BUFSIZE);
+    check_chksum(ofs, TEST_BUFSIZE - 1);
+  }
+}
+END_TEST
+
+/** Copy and checksum gives the same data and checksum as copy then checksum */
+START_TEST(test_chksum_copy)
+{
+#if LWIP_CHKSUM_COPY_ALGORITHM
+  int dst_ofs, src_ofs, len;
+  size_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (dst_ofs = 0; dst_ofs < 4; dst_ofs++) {
+    for (src_ofs = 0; src_ofs < 4; src_ofs++) {
+      for (len = 0; len <= 100; len++) {
+        check_chksum_copy(dst_ofs, src_ofs, len);
+      }
+      for (i = 0; i < LWIP_ARRAYSIZE(test_lens); i++) {
+        check_chksum_copy(dst_ofs, src_ofs, test_lens[i] - 4);
+      }
+    }
+  }
+#else /* LWIP_CHKSUM_COPY_ALGORITHM */
+  LWIP_UNUSED_ARG(_i);
+#endif /* LWIP_CHKSUM_COPY_ALGORITHM */
+}
+END_TEST
+
+/** Incremental updates give the checksum computed over the changed data */
+START_TEST(test_chksum_adjust)
+{
+  u8_t hdr[20];
+  u16_t chksum, old16, new16;
+  u32_t old32, new32;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  /* example of RFC 1624: the result is 0x0000, never 0xffff */
+  fail_unless(inet_chksum_adjust(PP_HTONS(0xdd2f), PP_HTONS(0x5555), PP_HTONS(0x3285)) == 0x0000);
+
+  for (i = 0; i < 1000; i++) {
+    memcpy(hdr, &testdata[(i * 20) % (TEST_BUFSIZE - 20)], sizeof(hdr));
+    hdr[10] = hdr[11] = 0;
+    chksum = inet_chksum(hdr, sizeof(hdr));
+
+    /* 16-bit field */
+    memcpy(&old16, &hdr[8], sizeof(old16));
+    new16 = (u16_t)rand();
+    memcpy(&hdr[8], &new16, sizeof(new16));
+    chksum = inet_chksum_adjust(chksum, old16, new16);
+    fail_unless(inet_chksum(hdr, sizeof(hdr)) == chksum);
+
+    /* 32-bit field */
+    memcpy(&old32, &hdr[12], sizeof(old32));
+    new32 = ((u32_t)rand() << 16) ^ (u32_t)rand();
+    memcpy(&hdr[12], &new32, sizeof(new32));
+    chksum = inet_chksum_adjust32(chksum, old32, new32);
+    fail_unless(inet_chksum(hdr, sizeof(hdr)) == chksum);
+
+    /* the checksum field set: the header sums to zero */
+    memcpy(&hdr[10], &chksum, sizeof(chksum));
+    fail_unless(inet_chksum(hdr, sizeof(hdr)) == 0);
+  }
+}
+END_TEST
+
+/** Create the suite including all tests for this module */
+Suite *
+chksum_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_chksum_alignment),
+    TESTFUNC(test_chksum_all_ones),
+    TESTFUNC(test_chksum_copy),
+    TESTFUNC(test_chksum_adjust)
+  };
+  return create_suite("CHKSUM", tests, sizeof(tests)/sizeof(testfunc), chksum_setup, chksum_teardown);
+}
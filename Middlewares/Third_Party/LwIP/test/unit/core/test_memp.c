@@ -0,0 +1,233 @@
+#include "test_memp.h"
+
+#include "lwip/memp.h"
+#include "lwip/stats.h"
+
+#include <string.h>
+#if !NO_SYS
+#include <pthread.h>
+#endif
+
+#if !LWIP_STATS || !MEMP_STATS
+#error "This tests needs MEMP-statistics enabled"
+#endif
+
+#define TEST_POOL_NUM   32
+#define TEST_POOL_SIZE  16
+
+LWIP_MEMPOOL_DECLARE(TEST, TEST_POOL_NUM, TEST_POOL_SIZE, "TEST")
+
+/* Setups/teardown functions */
+
+static void
+memp_setup(void)
+{
+  LWIP_MEMPOOL_INIT(TEST);
+  memp_TEST.stats->max = 0;
+  memp_TEST.stats->err = 0;
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+static void
+memp_teardown(void)
+{
+  fail_unless(memp_TEST.stats->used == 0);
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/** Allocate all elements of the TEST pool one by one, check they are all
+ * different and free them again */
+static void
+memp_check_all_free(void)
+{
+  void *elem[TEST_POOL_NUM];
+  int i, j;
+
+  for (i = 0; i < TEST_POOL_NUM; i++) {
+    elem[i] = LWIP_MEMPOOL_ALLOC(TEST);
+    fail_unless(elem[i] != NULL);
+    for (j = 0; j < i; j++) {
+      fail_unless(elem[i] != elem[j]);
+    }
+  }
+  fail_unless(LWIP_MEMPOOL_ALLOC(TEST) == NULL);
+  for (i = 0; i < TEST_POOL_NUM; i++) {
+    LWIP_MEMPOOL_FREE(TEST, elem[i]);
+  }
+}
+
+/* Test functions */
+
+/** Allocate and free in bulk, running the pool out */
+START_TEST(test_memp_bulk)
+{
+  void *elem[TEST_POOL_NUM];
+  void *more[4];
+  u16_t n;
+  LWIP_UNUSED_ARG(_i);
+
+  n = memp_malloc_pool_bulk(&memp_TEST, elem, TEST_POOL_NUM - 2);
+  fail_unless(n == TEST_POOL_NUM - 2);
+  fail_unless(memp_TEST.stats->used == TEST_POOL_NUM - 2);
+  fail_unless(memp_TEST.stats->err == 0);
+
+  /* only 2 left */
+  n = memp_malloc_pool_bulk(&memp_TEST, more, 4);
+  fail_unless(n == 2);
+  fail_unless(memp_TEST.stats->used == TEST_POOL_NUM);
+  fail_unless(memp_TEST.stats->max == TEST_POOL_NUM);
+  fail_unless(memp_TEST.stats->err == 1);
+  fail_unless(LWIP_MEMPOOL_ALLOC(TEST) == NULL);
+
+  memp_free_pool_bulk(&memp_TEST, more, 2);
+  memp_free_pool_bulk(&memp_TEST, elem, TEST_POOL_NUM - 2);
+  fail_unless(memp_TEST.stats->used == 0);
+
+  memp_check_all_free();
+}
+END_TEST
+
+/** Bulk functions on lwIP pools */
+START_TEST(test_memp_bulk_type)
+{
+  void *elem[3];
+  u16_t n;
+  LWIP_UNUSED_ARG(_i);
+
+  n = memp_malloc_bulk(MEMP_PBUF, elem, 3);
+  fail_unless(n == 3);
+  fail_unless(lwip_stats.memp[MEMP_PBUF]->used == 3);
+  memp_free_bulk(MEMP_PBUF, elem, 3);
+  fail_unless(lwip_stats.memp[MEMP_PBUF]->used == 0);
+}
+END_TEST
+
+/** Cache refills from and flushes to the pool in bulk */
+START_TEST(test_memp_cache)
+{
+  struct memp_cache cache;
+  void *elem[MEMP_CACHE_SIZE + 1];
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  LWIP_MEMPOOL_CACHE_INIT(&cache, TEST);
+
+  /* refill with half the cache size */
+  elem[0] = memp_cache_malloc(&cache);
+  fail_unless(elem[0] != NULL);
+  fail_unless(memp_TEST.stats->used == (MEMP_CACHE_SIZE + 1) / 2);
+
+  for (i = 1; i <= MEMP_CACHE_SIZE; i++) {
+    elem[i] = memp_cache_malloc(&cache);
+    fail_unless(elem[i] != NULL);
+  }
+  /* freeing into a full cache gives half of it back */
+  for (i = 0; i <= MEMP_CACHE_SIZE; i++) {
+    memp_cache_free(&cache, elem[i]);
+    fail_unless(cache.count <= MEMP_CACHE_SIZE);
+  }
+  fail_unless(memp_TEST.stats->used == cache.count);
+
+  memp_cache_flush(&cache);
+  fail_unless(cache.count == 0);
+  fail_unless(memp_TEST.stats->used == 0);
+
+  memp_check_all_free();
+}
+END_TEST
+
+#if !NO_SYS
+#define TEST_THREADS    4
+#define TEST_LOOPS      20000
+
+/** Allocate and free from several threads, writing a thread specific pattern
+ * to the elements to detect one being given out twice */
+static void *
+memp_test_thread(void *arg)
+{
+  u8_t id = (u8_t)(size_t)arg;
+  struct memp_cache cache;
+  void *elem[3];
+  u16_t n, j;
+  int i, k, bad = 0;
+
+  LWIP_MEMPOOL_CACHE_INIT(&cache, TEST);
+  for (i = 0; i < TEST_LOOPS; i++) {
+    switch (i % 3) {
+      case 0:
+        elem[0] = LWIP_MEMPOOL_ALLOC(TEST);
+        n = (elem[0] != NULL) ? 1 : 0;
+        break;
+      case 1:
+        n = memp_malloc_pool_bulk(&memp_TEST, elem, 3);
+        break;
+      default:
+        elem[0] = memp_cache_malloc(&cache);
+        n = (elem[0] != NULL) ? 1 : 0;
+        break;
+    }
+    for (j = 0; j < n; j++) {
+      memset(elem[j], id, TEST_POOL_SIZE);
+    }
+    for (j = 0; j < n; j++) {
+      for (k = 0; k < TEST_POOL_SIZE; k++) {
+        if (((u8_t *)elem[j])[k] != id) {
+          bad = 1;
+        }
+      }
+    }
+    switch (i % 3) {
+      case 0:
+        if (n) {
+          LWIP_MEMPOOL_FREE(TEST, elem[0]);
+        }
+        break;
+      case 1:
+        memp_free_pool_bulk(&memp_TEST, elem, n);
+        break;
+      default:
+        memp_cache_free(&cache, elem[0]);
+        break;
+    }
+  }
+  memp_cache_flush(&cache);
+  return bad ? arg : NULL;
+}
+
+/** Run several threads on one pool */
+START_TEST(test_memp_threads)
+{
+  pthread_t threads[TEST_THREADS];
+  void *ret;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < TEST_THREADS; i++) {
+    fail_unless(pthread_create(&threads[i], NULL, memp_test_thread, (void *)(size_t)(i + 1)) == 0);
+  }
+  for (i = 0; i < TEST_THREADS; i++) {
+    fail_unless(pthread_join(threads[i], &ret) == 0);
+    fail_unless(ret == NULL);
+  }
+  fail_unless(memp_TEST.stats->used == 0);
+  fail_unless(memp_TEST.stats->max <= TEST_POOL_NUM);
+
+  memp_check_all_free();
+}
+END_TEST
+#endif /* !NO_SYS */
+
+/** Create the suite including all tests for this module */
+Suite *
+memp_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_memp_bulk),
+    TESTFUNC(test_memp_bulk_type),
+    TESTFUNC(test_memp_cache),
+#if !NO_SYS
+    TESTFUNC(test_memp_threads)
+#endif
+  };
+  return create_suite("MEMP", tests, sizeof(tests)/sizeof(testfunc), memp_setup, memp_teardown);
+}
@@ -4,8 +4,39 @@
 #include "lwip/timeouts.h"
 #include "arch/sys_arch.h"
 
+#include <time.h>
+
+/* same as TIME_LESS_THAN in timeouts.c */
+#define TIME_LESS_THAN_TEST(t, compare_to) ((((u32_t)((t)-(compare_to))) > 0x7fffffff) ? 1 : 0)
+
 /* Setups/teardown functions */
 
+#if LWIP_TIMERS_WHEEL
+static struct sys_timeouts_wheel old_wheel;
+
+static void
+timers_setup(void)
+{
+  struct sys_timeouts_wheel* wheel = sys_timeouts_get_wheel();
+  old_wheel = *wheel;
+  memset(wheel, 0, sizeof(*wheel));
+}
+
+static void
+timers_teardown(void)
+{
+  struct sys_timeouts_wheel* wheel = sys_timeouts_get_wheel();
+  *wheel = old_wheel;
+  lwip_sys_now = 0;
+}
+
+/* expiry time of the first timeout (must not be overdue) */
+static u32_t
+first_timeout_time(void)
+{
+  return lwip_sys_now + sys_timeouts_sleeptime();
+}
+#else /* LWIP_TIMERS_WHEEL */
 static struct sys_timeo* old_list_head;
 
 static void
@@ -24,6 +55,14 @@ timers_teardown(void)
   lwip_sys_now = 0;
 }
 
+/* expiry time of the first timeout */
+static u32_t
+first_timeout_time(void)
+{
+  return (*sys_timeouts_get_next_timeout())->time;
+}
+#endif /* LWIP_TIMERS_WHEEL */
+
 static int fired[3];
 static void
 dummy_handler(void* arg)
@@ -46,8 +85,6 @@ struct lwip_cyclic_timer test_cyclic = {10, dummy_cyclic_handler};
 static void
 do_test_cyclic_timers(u32_t offset)
 {
-  struct sys_timeo** list_head = sys_timeouts_get_next_timeout();
-
   /* verify normal timer expiration */
   lwip_sys_now = offset + 0;
   sys_timeout(test_cyclic.interval_ms, lwip_cyclic_timer, &test_cyclic);
@@ -60,7 +97,7 @@ do_test_cyclic_timers(u32_t offset)
   sys_check_timeouts();
   fail_unless(cyclic_fired == 1);
 
-  fail_unless((*list_head)->time == (u32_t)(lwip_sys_now + test_cyclic.interval_ms - HANDLER_EXECUTION_TIME));
+  fail_unless(first_timeout_time() == (u32_t)(lwip_sys_now + test_cyclic.interval_ms - HANDLER_EXECUTION_TIME));
   
   sys_untimeout(lwip_cyclic_timer, &test_cyclic);
 
@@ -77,7 +114,9 @@ do_test_cyclic_timers(u32_t offset)
   sys_check_timeouts();
   fail_unless(cyclic_fired == 1);
 
-  fail_unless((*list_head)->time == (u32_t)(lwip_sys_now + test_cyclic.interval_ms));
+  fail_unless(first_timeout_time() == (u32_t)(lwip_sys_now + test_cyclic.interval_ms));
+
+  sys_untimeout(lwip_cyclic_timer, &test_cyclic);
 }
 
 START_TEST(test_cyclic_timers)
@@ -127,8 +166,6 @@ END_TEST
 static void
 do_test_timers(u32_t offset)
 {
-  struct sys_timeo** list_head = sys_timeouts_get_next_timeout();
-  
   lwip_sys_now = offset + 0;
 
   sys_timeout(10, dummy_handler, LWIP_PTR_NUMERIC_CAST(void*, 0));
@@ -138,10 +175,20 @@ do_test_timers(u32_t offset)
   sys_timeout( 5, dummy_handler, LWIP_PTR_NUMERIC_CAST(void*, 2));
   fail_unless(sys_timeouts_sleeptime() == 5);
 
+#if LWIP_TIMERS_WHEEL
+  /* all in the lowest wheel level, in the slot of their expiry time? */
+  fail_unless(sys_timeouts_get_wheel()->used[0] ==
+              ((1UL << ((lwip_sys_now + 5) & 31)) | (1UL << ((lwip_sys_now + 10) & 31)) | (1UL << ((lwip_sys_now + 20) & 31))));
+  fail_unless(first_timeout_time() == (u32_t)(lwip_sys_now + 5));
+#else /* LWIP_TIMERS_WHEEL */
   /* linked list correctly sorted? */
-  fail_unless((*list_head)->time             == (u32_t)(lwip_sys_now + 5));
-  fail_unless((*list_head)->next->time       == (u32_t)(lwip_sys_now + 10));
-  fail_unless((*list_head)->next->next->time == (u32_t)(lwip_sys_now + 20));
+  {
+    struct sys_timeo** list_head = sys_timeouts_get_next_timeout();
+    fail_unless((*list_head)->time             == (u32_t)(lwip_sys_now + 5));
+    fail_unless((*list_head)->next->time       == (u32_t)(lwip_sys_now + 10));
+    fail_unless((*list_head)->next->next->time == (u32_t)(lwip_sys_now + 20));
+  }
+#endif /* LWIP_TIMERS_WHEEL */
   
   /* check timers expire in correct order */
   memset(&fired, 0, sizeof(fired));
@@ -219,6 +266,166 @@ START_TEST(test_long_timer)
 }
 END_TEST
 
+#define TIMERS_EQUAL      8
+
+static int equal_order[TIMERS_EQUAL];
+static int equal_fired;
+
+static void
+equal_handler(void* arg)
+{
+  if (equal_fired < TIMERS_EQUAL) {
+    equal_order[equal_fired] = LWIP_PTR_NUMERIC_CAST(int, arg);
+  }
+  equal_fired++;
+}
+
+static void
+do_test_equal_timers(u32_t offset)
+{
+  /* due just after a 1024 ms boundary: the first half goes to an upper wheel
+     level and moves down when the wheel reaches it, the second half is
+     created later, right into the lowest level */
+  u32_t due = offset + 1024 + 2;
+  int i;
+
+  equal_fired = 0;
+  lwip_sys_now = offset + 10;
+  for (i = 0; i < TIMERS_EQUAL / 2; i++) {
+    sys_timeout(due - lwip_sys_now, equal_handler, LWIP_PTR_NUMERIC_CAST(void*, i));
+  }
+  lwip_sys_now = due - 10;
+  sys_check_timeouts();
+  for (; i < TIMERS_EQUAL; i++) {
+    sys_timeout(due - lwip_sys_now, equal_handler, LWIP_PTR_NUMERIC_CAST(void*, i));
+  }
+  fail_unless(first_timeout_time() == due);
+
+  lwip_sys_now = due - 1;
+  sys_check_timeouts();
+  fail_unless(equal_fired == 0);
+
+  lwip_sys_now = due;
+  sys_check_timeouts();
+  fail_unless(equal_fired == TIMERS_EQUAL);
+  /* timeouts of equal time expire in the order they were created */
+  for (i = 0; i < TIMERS_EQUAL; i++) {
+    fail_unless(equal_order[i] == i);
+  }
+}
+
+START_TEST(test_equal_timers)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  /* check without u32_t wraparound */
+  do_test_equal_timers(0);
+
+  /* check with u32_t wraparound at the due time */
+  do_test_equal_timers(0xfffffc00);
+}
+END_TEST
+
+#define TIMERS_MANY       10000
+#define TIMERS_MANY_RANGE 600000 /* 10 minutes */
+
+static u32_t many_due[TIMERS_MANY];
+static u8_t many_state[TIMERS_MANY]; /* 0: pending, 1: cancelled, 2: fired */
+static u32_t many_prev_now, many_last_due;
+static int many_errors, many_fired;
+
+static void
+many_handler(void* arg)
+{
+  int index = LWIP_PTR_NUMERIC_CAST(int, arg);
+  /* fired once, at the first check after its expiry time, in order? */
+  if ((many_state[index] != 0) ||
+      TIME_LESS_THAN_TEST(lwip_sys_now, many_due[index]) ||
+      !TIME_LESS_THAN_TEST(many_prev_now, many_due[index]) ||
+      TIME_LESS_THAN_TEST(many_due[index], many_last_due)) {
+    many_errors++;
+  }
+  many_state[index] = 2;
+  many_last_due = many_due[index];
+  many_fired++;
+}
+
+static u32_t many_rand_state;
+static u32_t
+many_rand(void)
+{
+  many_rand_state = many_rand_state * 1103515245UL + 12345UL;
+  return (many_rand_state >> 8) & 0xffffff;
+}
+
+static void
+do_test_many_timers(u32_t offset)
+{
+  int i, j, pending;
+  clock_t start, t_schedule, t_cancel, t_expire;
+
+  memset(many_state, 0, sizeof(many_state));
+  many_rand_state = offset;
+  many_errors = 0;
+  many_fired = 0;
+  lwip_sys_now = offset;
+
+  start = clock();
+  for (i = 0; i < TIMERS_MANY; i++) {
+    u32_t msecs = 1 + (many_rand() % TIMERS_MANY_RANGE);
+    many_due[i] = lwip_sys_now + msecs;
+    sys_timeout(msecs, many_handler, LWIP_PTR_NUMERIC_CAST(void*, i));
+  }
+  t_schedule = clock() - start;
+
+  /* cancel half of them, in random order */
+  start = clock();
+  for (j = 0; j < TIMERS_MANY / 2; j++) {
+    i = (int)(many_rand() % TIMERS_MANY);
+    while (many_state[i] != 0) {
+      i = (i + 1) % TIMERS_MANY;
+    }
+    sys_untimeout(many_handler, LWIP_PTR_NUMERIC_CAST(void*, i));
+    many_state[i] = 1;
+  }
+  t_cancel = clock() - start;
+  pending = TIMERS_MANY - TIMERS_MANY / 2;
+
+  /* run the clock until all have fired */
+  start = clock();
+  many_prev_now = lwip_sys_now - 1;
+  many_last_due = lwip_sys_now;
+  while ((many_fired < pending) && (lwip_sys_now - offset <= TIMERS_MANY_RANGE + 100)) {
+    sys_check_timeouts();
+    many_prev_now = lwip_sys_now;
+    lwip_sys_now += 1 + (many_rand() % 100);
+  }
+  t_expire = clock() - start;
+
+  fail_unless(many_errors == 0);
+  fail_unless(many_fired == pending);
+  fail_unless(sys_timeouts_sleeptime() == SYS_TIMEOUTS_SLEEPTIME_INFINITE);
+
+  LWIP_PLATFORM_DIAG(("timers: %d timeouts scheduled in %lu us, %d cancelled in %lu us, %d expired in %lu us\n",
+                      TIMERS_MANY, (unsigned long)(t_schedule * 1000000 / CLOCKS_PER_SEC),
+                      TIMERS_MANY / 2, (unsigned long)(t_cancel * 1000000 / CLOCKS_PER_SEC),
+                      pending, (unsigned long)(t_expire * 1000000 / CLOCKS_PER_SEC)));
+}
+
+/* schedule, cancel and expire many timeouts, check them and print the time
+   taken (benchmark) */
+START_TEST(test_many_timers)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  /* check without u32_t wraparound */
+  do_test_many_timers(0);
+
+  /* check with u32_t wraparound */
+  do_test_many_timers(0xfffff000);
+}
+END_TEST
+
 /** Create the suite including all tests for this module */
 Suite *
 timers_suite(void)
@@ -228,6 +435,8 @@ timers_suite(void)
     TESTFUNC(test_cyclic_timers),
     TESTFUNC(test_timers),
     TESTFUNC(test_long_timer),
+    TESTFUNC(test_equal_timers),
+    TESTFUNC(test_many_timers),
   };
   return create_suite("TIMERS", tests, LWIP_ARRAYSIZE(tests), timers_setup, timers_teardown);
 }
@@ -0,0 +1,175 @@
+#include "test_ethrx.h"
+
+#include "netif/ethrx.h"
+#include "netif/ethernet.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/tcpip.h"
+
+#if !LWIP_STATS || !MEM_STATS || !MEMP_STATS
+#error "This tests needs MEM- and MEMP-statistics enabled"
+#endif
+#if NO_SYS || !defined(TCPIP_THREAD_TEST) || LWIP_TCPIP_CORE_LOCKING_INPUT
+#error "This test needs the tcpip_thread test mode"
+#endif
+#if !MIB2_STATS
+#error "This test needs MIB2-statistics enabled"
+#endif
+
+static struct netif test_netif;
+static struct ethrx rx;
+
+static err_t
+default_netif_linkoutput(struct netif *netif, struct pbuf *p)
+{
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(p);
+  return ERR_OK;
+}
+
+static err_t
+default_netif_init(struct netif *netif)
+{
+  netif->linkoutput = default_netif_linkoutput;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
+  netif->hwaddr_len = ETH_HWADDR_LEN;
+  return ERR_OK;
+}
+
+/* An ethernet frame of an unknown protocol: counted and freed by
+   ethernet_input() */
+static struct pbuf *
+make_frame(void)
+{
+  struct pbuf *p;
+  struct eth_hdr *ethhdr;
+
+  p = pbuf_alloc(PBUF_RAW, 60, PBUF_RAM);
+  fail_unless(p != NULL);
+  memset(p->payload, 0, p->len);
+  ethhdr = (struct eth_hdr *)p->payload;
+  memset(&ethhdr->dest, 0xff, ETH_HWADDR_LEN);
+  ethhdr->type = PP_HTONS(0x88b5);
+  return p;
+}
+
+/* Run the messages posted to tcpip_thread, return how many there were */
+static int
+run_tcpip(void)
+{
+  int n = 0;
+
+  while (tcpip_thread_poll_one()) {
+    n++;
+  }
+  return n;
+}
+
+/* Setups/teardown functions */
+
+static void
+ethrx_setup(void)
+{
+  ip4_addr_t addr, netmask, gw;
+
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+  IP4_ADDR(&addr, 192, 168, 0, 1);
+  IP4_ADDR(&netmask, 255, 255, 255, 0);
+  IP4_ADDR(&gw, 192, 168, 0, 254);
+  memset(&test_netif, 0, sizeof(test_netif));
+  netif_add(&test_netif, &addr, &netmask, &gw, NULL, default_netif_init, ethernet_input);
+  netif_set_up(&test_netif);
+  fail_unless(ethrx_init(&rx, &test_netif) == ERR_OK);
+}
+
+static void
+ethrx_teardown(void)
+{
+  fail_unless(ethrx_flush(&rx) == ERR_OK);
+  run_tcpip();
+  fail_unless(ethrx_pending(&rx) == 0);
+  tcpip_callbackmsg_delete(rx.msg);
+  netif_remove(&test_netif);
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+
+/* Test functions */
+
+/** A batch of frames is passed to the stack by a single message */
+START_TEST(test_ethrx_batch)
+{
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < 5; i++) {
+    fail_unless(ethrx_put(&rx, make_frame()) == ERR_OK);
+  }
+  fail_unless(ethrx_pending(&rx) == 5);
+  fail_unless(test_netif.mib2_counters.ifinunknownprotos == 0);
+
+  fail_unless(ethrx_flush(&rx) == ERR_OK);
+  fail_unless(run_tcpip() == 1);
+  fail_unless(ethrx_pending(&rx) == 0);
+  fail_unless(test_netif.mib2_counters.ifinunknownprotos == 5);
+
+  /* nothing queued: nothing posted */
+  fail_unless(ethrx_flush(&rx) == ERR_OK);
+  fail_unless(run_tcpip() == 0);
+}
+END_TEST
+
+/** Frames queued while a message is pending are taken by that message */
+START_TEST(test_ethrx_flush_posted)
+{
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < 3; i++) {
+    fail_unless(ethrx_put(&rx, make_frame()) == ERR_OK);
+  }
+  fail_unless(ethrx_flush(&rx) == ERR_OK);
+  for (i = 0; i < 2; i++) {
+    fail_unless(ethrx_put(&rx, make_frame()) == ERR_OK);
+  }
+  fail_unless(ethrx_flush(&rx) == ERR_OK);
+
+  fail_unless(run_tcpip() == 1);
+  fail_unless(ethrx_pending(&rx) == 0);
+  fail_unless(test_netif.mib2_counters.ifinunknownprotos == 5);
+}
+END_TEST
+
+/** A full queue refuses the frame, the caller keeps it */
+START_TEST(test_ethrx_queue_full)
+{
+  struct pbuf *p;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < ETHRX_QUEUE_SIZE; i++) {
+    fail_unless(ethrx_put(&rx, make_frame()) == ERR_OK);
+  }
+  p = make_frame();
+  fail_unless(ethrx_put(&rx, p) == ERR_MEM);
+  fail_unless(p->ref == 1);
+  pbuf_free(p);
+
+  fail_unless(ethrx_flush(&rx) == ERR_OK);
+  fail_unless(run_tcpip() == 1);
+  fail_unless(test_netif.mib2_counters.ifinunknownprotos == ETHRX_QUEUE_SIZE);
+}
+END_TEST
+
+/** Create the suite including all tests for this module */
+Suite *
+ethrx_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_ethrx_batch),
+    TESTFUNC(test_ethrx_flush_posted),
+    TESTFUNC(test_ethrx_queue_full)
+  };
+  return create_suite("ETHRX", tests, sizeof(tests)/sizeof(testfunc), ethrx_setup, ethrx_teardown);
+}
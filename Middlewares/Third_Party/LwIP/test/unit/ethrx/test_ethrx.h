@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_ETHRX_H
+#define LWIP_HDR_TEST_ETHRX_H
+
+#include "../lwip_check.h"
+
+Suite *ethrx_suite(void);
+
+#endif
@@ -0,0 +1,316 @@
+#include "test_ethtx.h"
+
+#include "netif/ethtx.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/tcpip.h"
+
+#if !LWIP_STATS || !MEM_STATS || !MEMP_STATS
+#error "This tests needs MEM- and MEMP-statistics enabled"
+#endif
+#if NO_SYS || !defined(TCPIP_THREAD_TEST)
+#error "This test needs the tcpip_thread test mode"
+#endif
+
+/* A simulated MAC: a DMA with SIM_DESC_CNT descriptors, one per buffer, that
+   reads the buffers of a packet only when it is sent (sim_send()), like a real
+   DMA does */
+#define SIM_DESC_CNT  4
+#define SIM_PKT_MAX   32
+#define SIM_LOG_SIZE  8192
+
+static struct ethtx tx;
+
+static struct {
+  struct ethtx_buf *buf[SIM_PKT_MAX];
+  u16_t len[SIM_PKT_MAX];
+  void *pkt[SIM_PKT_MAX];
+  int nbuf[SIM_PKT_MAX];
+  int first, count;
+  int desc_used;
+  int stopped;
+  int xmit_calls;
+  /* what went on the wire */
+  u8_t log[SIM_LOG_SIZE];
+  int log_len;
+  int sent;
+} sim;
+
+static u8_t testdata[SIM_LOG_SIZE];
+
+static err_t
+sim_xmit(struct ethtx *t, struct ethtx_buf *buf, u16_t len, void *pkt)
+{
+  struct ethtx_buf *b;
+  int n = 0, i;
+
+  fail_unless(t == &tx);
+  sim.xmit_calls++;
+  if (sim.stopped) {
+    return ERR_IF;
+  }
+  for (b = buf; b != NULL; b = b->next) {
+    n++;
+  }
+  if (sim.desc_used + n > SIM_DESC_CNT) {
+    return ERR_MEM;
+  }
+  fail_unless(sim.count < SIM_PKT_MAX);
+  i = (sim.first + sim.count) % SIM_PKT_MAX;
+  sim.buf[i] = buf;
+  sim.len[i] = len;
+  sim.pkt[i] = pkt;
+  sim.nbuf[i] = n;
+  sim.count++;
+  sim.desc_used += n;
+  return ERR_OK;
+}
+
+/* Send up to n packets, then run the completion like the TX interrupt does */
+static void
+sim_send(int n)
+{
+  struct ethtx_buf *b;
+  int i, len;
+
+  while (n-- > 0 && sim.count > 0) {
+    i = sim.first;
+    len = 0;
+    for (b = sim.buf[i]; b != NULL; b = b->next) {
+      fail_unless(sim.log_len + (int)b->len <= SIM_LOG_SIZE);
+      memcpy(&sim.log[sim.log_len], b->buffer, b->len);
+      sim.log_len += (int)b->len;
+      len += (int)b->len;
+    }
+    fail_unless(len == sim.len[i]);
+    sim.desc_used -= sim.nbuf[i];
+    sim.first = (sim.first + 1) % SIM_PKT_MAX;
+    sim.count--;
+    sim.sent++;
+    ethtx_complete(&tx, sim.pkt[i]);
+  }
+  ethtx_complete_batch(&tx);
+}
+
+/* Run the messages posted to tcpip_thread */
+static void
+run_tcpip(void)
+{
+  while (tcpip_thread_poll_one());
+}
+
+/* Allocate a chain of n PBUF_RAM pbufs of len bytes each, filled with
+   testdata from offset ofs */
+static struct pbuf *
+make_chain(int n, u16_t len, int ofs)
+{
+  struct pbuf *p = NULL, *q;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    q = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+    fail_unless(q != NULL);
+    memcpy(q->payload, &testdata[ofs + i * len], len);
+    if (p == NULL) {
+      p = q;
+    } else {
+      pbuf_cat(p, q);
+    }
+  }
+  return p;
+}
+
+/* Setups/teardown functions */
+
+static void
+ethtx_setup(void)
+{
+  int i;
+
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+  for (i = 0; i < SIM_LOG_SIZE; i++) {
+    testdata[i] = (u8_t)rand();
+  }
+  memset(&sim, 0, sizeof(sim));
+  fail_unless(ethtx_init(&tx, sim_xmit, NULL) == ERR_OK);
+}
+
+static void
+ethtx_teardown(void)
+{
+  /* let the MAC send everything and the ring free it */
+  sim.stopped = 0;
+  while (sim.count > 0 || ethtx_pending(&tx) > 0) {
+    sim_send(SIM_PKT_MAX);
+    run_tcpip();
+  }
+  tcpip_callbackmsg_delete(tx.msg);
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+
+/* Test functions */
+
+/** A chain is handed to the MAC as is and referenced until it is sent */
+START_TEST(test_ethtx_zero_copy)
+{
+  struct pbuf *p, *q;
+  struct ethtx_buf *b;
+  LWIP_UNUSED_ARG(_i);
+
+  p = make_chain(3, 100, 0);
+  fail_unless(ethtx_output(&tx, p) == ERR_OK);
+  fail_unless(sim.count == 1);
+  fail_unless(sim.len[0] == 300);
+  for (q = p, b = sim.buf[0]; q != NULL; q = q->next, b = b->next) {
+    fail_unless(b != NULL);
+    fail_unless(b->buffer == q->payload);
+    fail_unless(b->len == q->len);
+  }
+  fail_unless(b == NULL);
+  fail_unless(p->ref == 2);
+
+  /* the caller is done with it, the MAC is not */
+  pbuf_free(p);
+  fail_unless(p->ref == 1);
+
+  /* MAC idle after the completion: the pbuf is freed in tcpip_thread */
+  sim_send(1);
+  fail_unless(ethtx_pending(&tx) == 1);
+  run_tcpip();
+  fail_unless(ethtx_pending(&tx) == 0);
+  fail_unless(sim.log_len == 300);
+  fail_if(memcmp(sim.log, testdata, 300));
+}
+END_TEST
+
+/** With the descriptors all in use, packets are queued without waiting and
+ * handed to the MAC by the completions */
+START_TEST(test_ethtx_mac_busy)
+{
+  struct pbuf *p[6];
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < 6; i++) {
+    p[i] = make_chain(2, 50, i * 100);
+    fail_unless(ethtx_output(&tx, p[i]) == ERR_OK);
+    pbuf_free(p[i]);
+  }
+  /* two packets of two buffers fit in the descriptors */
+  fail_unless(sim.count == 2);
+  fail_unless(ethtx_pending(&tx) == 6);
+
+  /* each completion posts one poll, which moves the next packets to the MAC */
+  for (i = 0; i < 6 && ethtx_pending(&tx) > 0; i++) {
+    sim_send(1);
+    run_tcpip();
+  }
+  sim_send(SIM_PKT_MAX);
+  run_tcpip();
+  fail_unless(sim.sent == 6);
+  fail_unless(ethtx_pending(&tx) == 0);
+  fail_unless(sim.log_len == 600);
+  fail_if(memcmp(sim.log, testdata, 600));
+}
+END_TEST
+
+/** A full ring refuses the packet and keeps no reference on it */
+START_TEST(test_ethtx_ring_full)
+{
+  struct pbuf *p;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < ETHTX_RING_SIZE; i++) {
+    p = make_chain(1, 64, i * 64);
+    fail_unless(ethtx_output(&tx, p) == ERR_OK);
+    pbuf_free(p);
+  }
+  fail_unless(ethtx_pending(&tx) == ETHTX_RING_SIZE);
+
+  p = make_chain(1, 64, 0);
+  fail_unless(ethtx_output(&tx, p) == ERR_MEM);
+  fail_unless(p->ref == 1);
+
+  /* completed packets are reclaimed by the next output */
+  sim_send(1);
+  fail_unless(ethtx_output(&tx, p) == ERR_OK);
+  pbuf_free(p);
+}
+END_TEST
+
+/** Too long chains and volatile payloads are sent from a copy */
+START_TEST(test_ethtx_copy)
+{
+  struct pbuf *p, *r;
+  int n = ETHTX_MAX_BUFS + 1;
+  LWIP_UNUSED_ARG(_i);
+
+  p = make_chain(n, 40, 0);
+  fail_unless(ethtx_output(&tx, p) == ERR_OK);
+  fail_unless(p->ref == 1);
+  fail_unless(sim.count == 1);
+  fail_unless(sim.nbuf[0] == 1);
+  fail_unless(sim.buf[0]->buffer != p->payload);
+  pbuf_free(p);
+
+  r = pbuf_alloc(PBUF_RAW, 80, PBUF_REF);
+  fail_unless(r != NULL);
+  r->payload = &testdata[n * 40];
+  fail_unless(ethtx_output(&tx, r) == ERR_OK);
+  fail_unless(r->ref == 1);
+  fail_unless(sim.buf[1]->buffer != r->payload);
+  pbuf_free(r);
+
+  sim_send(2);
+  run_tcpip();
+  fail_unless(ethtx_pending(&tx) == 0);
+  fail_unless(sim.log_len == n * 40 + 80);
+  fail_if(memcmp(sim.log, testdata, n * 40 + 80));
+}
+END_TEST
+
+/** A stopped MAC drops the queued packets */
+START_TEST(test_ethtx_mac_stopped)
+{
+  struct pbuf *p;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < 3; i++) {
+    p = make_chain(2, 50, i * 100);
+    fail_unless(ethtx_output(&tx, p) == ERR_OK);
+    pbuf_free(p);
+  }
+  fail_unless(sim.count == 2);
+  fail_unless(ethtx_pending(&tx) == 3);
+
+  sim.stopped = 1;
+  p = make_chain(1, 50, 0);
+  fail_unless(ethtx_output(&tx, p) == ERR_IF);
+  fail_unless(p->ref == 1);
+  pbuf_free(p);
+
+  /* the packets on the MAC are still completed */
+  fail_unless(ethtx_pending(&tx) == 2);
+  sim_send(2);
+  run_tcpip();
+  fail_unless(ethtx_pending(&tx) == 0);
+  fail_unless(sim.log_len == 200);
+}
+END_TEST
+
+/** Create the suite including all tests for this module */
+Suite *
+ethtx_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_ethtx_zero_copy),
+    TESTFUNC(test_ethtx_mac_busy),
+    TESTFUNC(test_ethtx_ring_full),
+    TESTFUNC(test_ethtx_copy),
+    TESTFUNC(test_ethtx_mac_stopped)
+  };
+  return create_suite("ETHTX", tests, sizeof(tests)/sizeof(testfunc), ethtx_setup, ethtx_teardown);
+}
@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_ETHTX_H
+#define LWIP_HDR_TEST_ETHTX_H
+
+#include "../lwip_check.h"
+
+Suite *ethtx_suite(void);
+
+#endif
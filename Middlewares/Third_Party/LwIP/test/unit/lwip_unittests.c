@@ -5,12 +5,16 @@
 #include "udp/test_udp.h"
 #include "tcp/test_tcp.h"
 #include "tcp/test_tcp_oos.h"
+#include "core/test_chksum.h"
 #include "core/test_def.h"
 #include "core/test_mem.h"
+#include "core/test_memp.h"
 #include "core/test_netif.h"
 #include "core/test_pbuf.h"
 #include "core/test_timers.h"
 #include "etharp/test_etharp.h"
+#include "ethrx/test_ethrx.h"
+#include "ethtx/test_ethtx.h"
 #include "dhcp/test_dhcp.h"
 #include "mdns/test_mdns.h"
 #include "mqtt/test_mqtt.h"
@@ -67,12 +71,16 @@ int main(void)
     udp_suite,
     tcp_suite,
     tcp_oos_suite,
+    chksum_suite,
     def_suite,
     mem_suite,
+    memp_suite,
     netif_suite,
     pbuf_suite,
     timers_suite,
     etharp_suite,
+    ethrx_suite,
+    ethtx_suite,
     dhcp_suite,
     mdns_suite,
     mqtt_suite,
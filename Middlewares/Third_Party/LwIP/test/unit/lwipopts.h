@@ -71,7 +71,25 @@
 /* Minimal changes to opt.h required for etharp unit tests: */
 #define ETHARP_SUPPORT_STATIC_ENTRIES   1
 
-#define MEMP_NUM_SYS_TIMEOUT            (LWIP_NUM_SYS_TIMEOUT_INTERNAL + 8)
+/* The options below replace a default code path. The Makefile builds the tests
+   twice: as is, and with LWIP_UNITTESTS_ALTOPTS=1 for these implementations. */
+#ifndef LWIP_UNITTESTS_ALTOPTS
+#define LWIP_UNITTESTS_ALTOPTS          0
+#endif
+
+/* timers tests schedule 10000 timeouts, in the timing wheel */
+#define LWIP_TIMERS_WHEEL               LWIP_UNITTESTS_ALTOPTS
+#define MEMP_NUM_SYS_TIMEOUT            (LWIP_NUM_SYS_TIMEOUT_INTERNAL + 8 + 10000)
+
+/* tcp tests demultiplex segments to 1000 connections via the pcb hash */
+#define TCP_PCB_HASH                    LWIP_UNITTESTS_ALTOPTS
+#define MEMP_NUM_TCP_PCB                1000
+
+/* tcp tests cover the large send mode, enabled per pcb */
+#define TCP_LARGE_SEND                  LWIP_UNITTESTS_ALTOPTS
+
+/* memp tests run several threads on the lock-free pools */
+#define MEMP_LOCKFREE                   LWIP_UNITTESTS_ALTOPTS
 
 /* MIB2 stats are required to check IPv4 reassembly results */
 #define MIB2_STATS                      1
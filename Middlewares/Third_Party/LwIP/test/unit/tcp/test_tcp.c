@@ -5,6 +5,8 @@
 #include "tcp_helper.h"
 #include "lwip/inet_chksum.h"
 
+#include <time.h>
+
 #ifdef _MSC_VER
 #pragma warning(disable: 4307) /* we explicitly wrap around TCP seqnos */
 #endif
@@ -1664,6 +1666,224 @@ START_TEST(test_tcp_persist_split)
 }
 END_TEST
 
+#if TCP_LARGE_SEND
+static u8_t tx_data_mirror[6 * TCP_MSS];
+
+/** Check the MSS-sized packets cut from one large-send segment: sequence
+ * numbers, data and PSH on the last packet only */
+static void
+test_tcp_large_send_check_packets(struct pbuf *packets, u32_t seqno, u16_t total)
+{
+  struct pbuf *q;
+  u16_t offset = 0;
+
+  for (q = packets; q != NULL; q = q->next) {
+    struct tcp_hdr tcphdr;
+    u16_t len = (u16_t)(q->len - 40U);
+    EXPECT(pbuf_copy_partial(q, &tcphdr, 20, 20) == 20);
+    EXPECT(lwip_ntohl(tcphdr.seqno) == seqno + offset);
+    EXPECT(len <= TCP_MSS);
+    EXPECT(memcmp((u8_t *)q->payload + 40U, &tx_data[offset], len) == 0);
+    offset = (u16_t)(offset + len);
+    if (offset < total) {
+      EXPECT(len == TCP_MSS);
+      EXPECT((TCPH_FLAGS(&tcphdr) & TCP_PSH) == 0);
+    } else {
+      EXPECT((TCPH_FLAGS(&tcphdr) & TCP_PSH) != 0);
+    }
+  }
+  EXPECT(offset == total);
+}
+
+/** Queue 5.5 MSS with writes not aligned to the MSS into one large-send
+ * segment, then check that tcp_output cuts it into MSS-sized segments as the
+ * window opens. With nocopy, the writes alternate between two buffers so
+ * that the segment is a chain of ROM pbufs straddling the cut points. */
+static void
+test_tcp_large_send(u8_t apiflags)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  err_t err;
+  u16_t total = 5 * TCP_MSS + TCP_MSS / 2;
+  u16_t sent, len;
+  size_t i;
+
+  for (i = 0; i < sizeof(tx_data); i++) {
+    tx_data[i] = (u8_t)i;
+  }
+  memcpy(tx_data_mirror, tx_data, sizeof(tx_data_mirror));
+
+  /* initialize local vars */
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  memset(&counters, 0, sizeof(counters));
+
+  /* create and initialize the pcb */
+  tcp_ticks = SEQNO1 - ISS;
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  pcb->mss = TCP_MSS;
+  /* set window to three segments */
+  pcb->cwnd = 3 * TCP_MSS;
+  pcb->snd_wnd = 3 * TCP_MSS;
+  pcb->snd_wnd_max = TCP_WND;
+  tcp_large_send_enable(pcb);
+  EXPECT(tcp_large_send_enabled(pcb));
+
+  for (sent = 0; sent < total; sent = (u16_t)(sent + len)) {
+    const u8_t *src = ((sent / 1000) & 1) ? tx_data_mirror : tx_data;
+    len = (u16_t)LWIP_MIN(1000, total - sent);
+    err = tcp_write(pcb, &src[sent], len, apiflags);
+    EXPECT_RET(err == ERR_OK);
+  }
+
+  /* everything is queued in one segment */
+  EXPECT_RET(pcb->unsent != NULL);
+  EXPECT(pcb->unsent->next == NULL);
+  EXPECT(pcb->unsent->len == total);
+  EXPECT(pcb->snd_queuelen == pbuf_clen(pcb->unsent->p));
+
+  /* the first three segments fill the window */
+  txcounters.copy_tx_packets = 1;
+  err = tcp_output(pcb);
+  EXPECT(err == ERR_OK);
+  EXPECT(txcounters.num_tx_calls == 3);
+  EXPECT(txcounters.num_tx_bytes == 3 * (TCP_MSS + 40U));
+  check_seqnos(pcb->unacked, 3, seqnos);
+  /* the remainder stays one segment */
+  EXPECT_RET(pcb->unsent != NULL);
+  EXPECT(pcb->unsent->next == NULL);
+  EXPECT(pcb->unsent->len == total - 3 * TCP_MSS);
+  check_seqnos(pcb->unsent, 1, &seqnos[3]);
+
+  /* ACK the first three segments, this sends two more full segments. The
+     last one stays on unsent for nagle, just as without TCP_LARGE_SEND */
+  p = tcp_create_rx_segment_wnd(pcb, NULL, 0, 0, 3 * TCP_MSS, TCP_ACK, 3 * TCP_MSS);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(txcounters.num_tx_calls == 5);
+  EXPECT(txcounters.num_tx_bytes == 5 * (TCP_MSS + 40U));
+  check_seqnos(pcb->unacked, 2, &seqnos[3]);
+  EXPECT_RET(pcb->unsent != NULL);
+  EXPECT(pcb->unsent->next == NULL);
+  EXPECT(pcb->unsent->len == total - 5 * TCP_MSS);
+  check_seqnos(pcb->unsent, 1, &seqnos[5]);
+
+  /* ACK those, this sends the last segment */
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 2 * TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  txcounters.copy_tx_packets = 0;
+  EXPECT(txcounters.num_tx_calls == 6);
+  EXPECT(txcounters.num_tx_bytes == total + 6 * 40U);
+  EXPECT(pcb->unsent == NULL);
+  check_seqnos(pcb->unacked, 1, &seqnos[5]);
+
+  EXPECT(txcounters.tx_packets != NULL);
+  if (txcounters.tx_packets != NULL) {
+    test_tcp_large_send_check_packets(txcounters.tx_packets, seqnos[0], total);
+    pbuf_free(txcounters.tx_packets);
+    txcounters.tx_packets = NULL;
+  }
+
+  /* ACK the rest, all segments are freed */
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, total - 5 * TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->unacked == NULL);
+  EXPECT(pcb->snd_queuelen == 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SEG) == 0);
+
+  /* ensure no errors have been recorded */
+  EXPECT(counters.err_calls == 0);
+  EXPECT(counters.last_err == ERR_OK);
+
+  /* make sure the pcb is freed */
+  EXPECT_RET(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 1);
+  tcp_abort(pcb);
+  EXPECT_RET(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+}
+#endif /* TCP_LARGE_SEND */
+
+START_TEST(test_tcp_large_send_copy)
+{
+  LWIP_UNUSED_ARG(_i);
+#if TCP_LARGE_SEND
+  test_tcp_large_send(TCP_WRITE_FLAG_COPY);
+#endif /* TCP_LARGE_SEND */
+}
+END_TEST
+
+START_TEST(test_tcp_large_send_nocopy)
+{
+  LWIP_UNUSED_ARG(_i);
+#if TCP_LARGE_SEND
+  test_tcp_large_send(0);
+#endif /* TCP_LARGE_SEND */
+}
+END_TEST
+
+#define TCP_MANY_PCBS     1000
+#define TCP_MANY_SEGMENTS 20
+static struct test_tcp_counters many_counters[TCP_MANY_PCBS];
+
+/** Demultiplex data segments to a large number of established connections,
+ * exercising the pcb lookup in tcp_input (hashed or linear) */
+START_TEST(test_tcp_many_pcbs_input)
+{
+  struct tcp_pcb* pcbs[TCP_MANY_PCBS];
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  char data[TCP_MANY_SEGMENTS * 4];
+  int i, j;
+  clock_t start, t_input;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  memset(many_counters, 0, sizeof(many_counters));
+  for (i = 0; i < (int)sizeof(data); i++) {
+    data[i] = (char)i;
+  }
+
+  for (i = 0; i < TCP_MANY_PCBS; i++) {
+    many_counters[i].expected_data_len = sizeof(data);
+    many_counters[i].expected_data = data;
+    pcbs[i] = test_tcp_new_counters_pcb(&many_counters[i]);
+    EXPECT_RET(pcbs[i] != NULL);
+    tcp_set_state(pcbs[i], ESTABLISHED, &test_local_ip, &test_remote_ip,
+                  TEST_LOCAL_PORT, (u16_t)(TEST_REMOTE_PORT + i));
+  }
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == TCP_MANY_PCBS);
+
+  /* send to the connections round-robin, so no lookup is a cache hit */
+  start = clock();
+  for (j = 0; j < TCP_MANY_SEGMENTS; j++) {
+    for (i = 0; i < TCP_MANY_PCBS; i++) {
+      struct pbuf* p = tcp_create_rx_segment(pcbs[i], &data[j * 4], 4, 0, 0, 0);
+      EXPECT_RET(p != NULL);
+      test_tcp_input(p, &netif);
+    }
+  }
+  t_input = clock() - start;
+
+  for (i = 0; i < TCP_MANY_PCBS; i++) {
+    EXPECT(many_counters[i].recv_calls == TCP_MANY_SEGMENTS);
+    EXPECT(many_counters[i].recved_bytes == sizeof(data));
+    EXPECT(many_counters[i].err_calls == 0);
+  }
+  LWIP_PLATFORM_DIAG(("tcp_input, %d segments to %d pcbs: %ld us\n",
+                      TCP_MANY_SEGMENTS * TCP_MANY_PCBS, TCP_MANY_PCBS,
+                      (long)(t_input * 1000000 / CLOCKS_PER_SEC)));
+
+  tcp_remove_all();
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+}
+END_TEST
+
 /** Create the suite including all tests for this module */
 Suite *
 tcp_suite(void)
@@ -1689,7 +1909,10 @@ tcp_suite(void)
     TESTFUNC(test_tcp_rto_timeout_syn_sent_link_down),
     TESTFUNC(test_tcp_zwp_timeout),
     TESTFUNC(test_tcp_zwp_timeout_link_down),
-    TESTFUNC(test_tcp_persist_split)
+    TESTFUNC(test_tcp_persist_split),
+    TESTFUNC(test_tcp_large_send_copy),
+    TESTFUNC(test_tcp_large_send_nocopy),
+    TESTFUNC(test_tcp_many_pcbs_input)
   };
   return create_suite("TCP", tests, sizeof(tests)/sizeof(testfunc), tcp_setup, tcp_teardown);
 }
@@ -21,6 +21,8 @@
 #include "lwip/timeouts.h"
 #include "netif/ethernet.h"
 #include "netif/etharp.h"
+#include "netif/ethrx.h"
+#include "netif/ethtx.h"
 #include "lwip/stats.h"
 #include "lwip/snmp.h"
 #include "lwip/tcpip.h"
@@ -33,8 +35,14 @@
 /* Private define ------------------------------------------------------------*/
 /* The time to block waiting for input. */
 #define TIME_WAITING_FOR_INPUT                 ( osWaitForever )
-/* Time to block waiting for transmissions to finish */
-#define ETHIF_TX_TIMEOUT                       (2000U)
+/* Maximum number of frames passed to tcpip_thread in one message */
+#define ETHIF_RX_BATCH                         (8U)
+/* Time to let frames come in with the Rx interrupt masked before draining
+   them [ms], to be kept under the time to fill the Rx descriptors (0: none) */
+#define ETHIF_RX_COALESCE_TIME                 (0U)
+/* Time to wait before posting the received frames again when the tcpip_thread
+   mailbox is full [ms], the Rx interrupt stays masked meanwhile */
+#define ETHIF_RX_RETRY_TIME                    (1U)
 /* Stack size of the interface thread */
 #define INTERFACE_THREAD_STACK_SIZE            ( 350 )
 
@@ -82,6 +90,13 @@ typedef struct
   uint8_t buff[(ETH_RX_BUF_SIZE + 31) & ~31];
 } RxBuff_t;
 
+/* The buffer lists of the transmit ring are passed to the ETH DMA as is: the
+   build fails here if struct ethtx_buf does not match ETH_BufferTypeDef */
+typedef char ethtx_buf_layout_check[(sizeof(struct ethtx_buf) == sizeof(ETH_BufferTypeDef)
+                                     && offsetof(struct ethtx_buf, buffer) == offsetof(ETH_BufferTypeDef, buffer)
+                                     && offsetof(struct ethtx_buf, len) == offsetof(ETH_BufferTypeDef, len)
+                                     && offsetof(struct ethtx_buf, next) == offsetof(ETH_BufferTypeDef, next)) ? 1 : -1];
+
 #if defined ( __ICCARM__ ) /*!< IAR Compiler */
 
 #pragma location=0x2004C000
@@ -106,9 +121,10 @@ LWIP_MEMPOOL_DECLARE(RX_POOL, ETH_RX_BUFFER_CNT, sizeof(RxBuff_t), "Zero-copy RX
 static uint8_t RxAllocStatus;
 
 osSemaphoreId RxPktSemaphore = NULL; /* Semaphore to signal incoming packets */
+struct ethrx EthRx;                  /* Receive queue between ethernetif_input and tcpip_thread */
 
 TaskHandle_t EthIfThread;       /* Handle of the interface thread */
-osSemaphoreId TxPktSemaphore = NULL;   /* Semaphore to signal transmit packet complete */
+struct ethtx EthTx;             /* Transmit ring between lwIP and the ETH DMA */
 
 /* Global Ethernet handle */
 ETH_HandleTypeDef EthHandle;
@@ -117,6 +133,7 @@ lan8742_Object_t LAN8742;
 
 /* Private function prototypes -----------------------------------------------*/
 static void ethernetif_input( void const * argument );
+static err_t low_level_xmit(struct ethtx *tx, struct ethtx_buf *buf, u16_t len, void *pkt);
 static void RMII_Thread( void const * argument );
 int32_t ETH_PHY_IO_Init(void);
 int32_t ETH_PHY_IO_DeInit (void);
@@ -141,14 +158,30 @@ lan8742_IOCtx_t  LAN8742_IOCtx = {ETH_PHY_IO_Init,
   *
   * @param netif the already initialized lwip network interface structure
   *        for this ethernetif
+  * @return ERR_OK, or ERR_MEM if the receive queue or transmit ring message
+  *         couldn't be allocated
   */
-static void low_level_init(struct netif *netif)
+static err_t low_level_init(struct netif *netif)
 {
   uint32_t duplex, speed = 0;
   int32_t PHYLinkState = 0;
   ETH_MACConfigTypeDef MACConf = {0};
   uint8_t macaddress[6]= {ETH_MAC_ADDR0, ETH_MAC_ADDR1, ETH_MAC_ADDR2, ETH_MAC_ADDR3, ETH_MAC_ADDR4, ETH_MAC_ADDR5};
 
+  /* Initialize the queue passing the received frames to tcpip_thread, first:
+     the interface cannot receive without its tcpip_thread message */
+  if(ethrx_init(&EthRx, netif) != ERR_OK)
+  {
+    return ERR_MEM;
+  }
+
+  /* Initialize the transmit ring before the DMA is started: the Tx IRQ needs its
+     tcpip_thread message. Its buffer lists are passed to the ETH DMA as is */
+  if(ethtx_init(&EthTx, low_level_xmit, NULL) != ERR_OK)
+  {
+    return ERR_MEM;
+  }
+
   EthHandle.Instance = ETH;
   EthHandle.Init.MACAddr = macaddress;
   EthHandle.Init.MediaInterface = HAL_ETH_RMII_MODE;
@@ -190,9 +223,6 @@ static void low_level_init(struct netif *netif)
   /* create a binary semaphore used for informing ethernetif of frame reception */
   RxPktSemaphore = xSemaphoreCreateBinary();
 
-  /* create a binary semaphore used for informing ethernetif of frame transmission */
-  TxPktSemaphore = xSemaphoreCreateBinary();
-
   /* create the task that handles the ETH_MAC */
   osThreadDef(EthIf, ethernetif_input, osPriorityRealtime, 0, INTERFACE_THREAD_STACK_SIZE);
   osThreadCreate (osThread(EthIf), netif);
@@ -205,7 +235,7 @@ static void low_level_init(struct netif *netif)
   {
     netif_set_link_down(netif);
     netif_set_down(netif);
-    return;
+    return ERR_OK;
   }
 
   PHYLinkState = LAN8742_GetLinkState(&LAN8742);
@@ -260,6 +290,41 @@ static void low_level_init(struct netif *netif)
     osThreadDef(RMII_Watchdog, RMII_Thread, osPriorityRealtime, 0, configMINIMAL_STACK_SIZE);
     osThreadCreate (osThread(RMII_Watchdog), NULL);
   }
+
+  return ERR_OK;
+}
+
+/**
+  * @brief Hands a packet of the transmit ring to the ETH DMA.
+  * Called from ethtx_output() and ethtx_poll(), never waits for the DMA.
+  *
+  * @param tx the transmit ring
+  * @param buf the buffers of the packet (zero-copy, they point into the pbufs)
+  * @param len total length of the packet
+  * @param pkt the packet, given back by HAL_ETH_TxFreeCallback()
+  * @return ERR_OK if the packet was queued on the DMA,
+  *         ERR_MEM if the Tx descriptors are all in use,
+  *         ERR_IF if the ETH is stopped
+  */
+static err_t low_level_xmit(struct ethtx *tx, struct ethtx_buf *buf, u16_t len, void *pkt)
+{
+  TxConfig.Length = len;
+  TxConfig.TxBuffer = (ETH_BufferTypeDef *)buf;
+  TxConfig.pData = pkt;
+
+  if(HAL_ETH_Transmit_IT(&EthHandle, &TxConfig) == HAL_OK)
+  {
+    return ERR_OK;
+  }
+
+  if(HAL_ETH_GetState(&EthHandle) != HAL_ETH_STATE_STARTED)
+  {
+    /* Link down */
+    return ERR_IF;
+  }
+
+  /* Descriptors busy: retried by the ring after the next Tx completion */
+  return ERR_MEM;
 }
 
 /**
@@ -267,74 +332,20 @@ static void low_level_init(struct netif *netif)
  * contained in the pbuf that is passed to the function. This pbuf
  * might be chained.
  *
+ * The packet is queued in the transmit ring and handed to the ETH DMA without
+ * copy, the pbuf being referenced until the DMA has sent it. This function
+ * does not wait for free Tx descriptors.
+ *
  * @param netif the lwip network interface structure for this ethernetif
  * @param p the MAC packet to send (e.g. IP packet including MAC addresses and type)
- * @return ERR_OK if the packet was sent, or ERR_IF if the packet was unable to be sent
+ * @return ERR_OK if the packet was queued, ERR_MEM if the transmit ring is full,
+ *         or ERR_IF if the ETH is stopped
  *
- * @note ERR_OK means the packet was sent (but not necessarily transmit complete),
- * and ERR_IF means the packet has more chained buffers than what the interface supports.
+ * @note ERR_OK means the packet was queued (but not necessarily sent).
  */
 static err_t low_level_output(struct netif *netif, struct pbuf *p)
 {
-  uint32_t i = 0U;
-  struct pbuf *q = NULL;
-  err_t errval = ERR_OK;
-  ETH_BufferTypeDef Txbuffer[ETH_TX_DESC_CNT];
-
-  memset(Txbuffer, 0 , ETH_TX_DESC_CNT*sizeof(ETH_BufferTypeDef));
-
-  for(q = p; q != NULL; q = q->next)
-  {
-    if(i >= ETH_TX_DESC_CNT)
-      return ERR_IF;
-
-    Txbuffer[i].buffer = q->payload;
-    Txbuffer[i].len = q->len;
-
-    if(i>0)
-    {
-      Txbuffer[i-1].next = &Txbuffer[i];
-    }
-
-    if(q->next == NULL)
-    {
-      Txbuffer[i].next = NULL;
-    }
-
-    i++;
-  }
-
-  TxConfig.Length = p->tot_len;
-  TxConfig.TxBuffer = Txbuffer;
-  TxConfig.pData = p;
-
-  pbuf_ref(p);
-
-  do
-  {
-    if(HAL_ETH_Transmit_IT(&EthHandle, &TxConfig) == HAL_OK)
-    {
-      errval = ERR_OK;
-    }
-    else
-    {
-      if(HAL_ETH_GetError(&EthHandle) & HAL_ETH_ERROR_BUSY)
-      {
-        /* Wait for descriptors to become available */
-        osSemaphoreWait( TxPktSemaphore, ETHIF_TX_TIMEOUT);
-        HAL_ETH_ReleaseTxPacket(&EthHandle);
-        errval = ERR_BUF;
-      }
-      else
-      {
-        /* Other error */
-        pbuf_free(p);
-        errval =  ERR_IF;
-      }
-    }
-  }while(errval == ERR_BUF);
-
-  return errval;
+  return ethtx_output(&EthTx, p);
 }
 
 /**
@@ -361,29 +372,52 @@ static struct pbuf * low_level_input(struct netif *netif)
  * This task should be signaled when a receive packet is ready to be read
  * from the interface.
  *
+ * The Rx interrupt stays masked while the task drains the frames. They are
+ * passed to tcpip_thread in batches of up to ETHIF_RX_BATCH frames, one
+ * message per batch, and the Rx interrupt is enabled again once no frame is
+ * left. When the tcpip_thread mailbox is full, the batch is posted again every
+ * ETHIF_RX_RETRY_TIME, the frames waiting in the Rx descriptors meanwhile.
+ *
  * @param argument the lwip network interface structure for this ethernetif
  */
 static void ethernetif_input( void const * argument )
 {
   struct pbuf *p = NULL;
   struct netif *netif = (struct netif *) argument;
+  uint32_t count = 0U;
 
   for( ;; )
   {
     if (osSemaphoreWait( RxPktSemaphore, TIME_WAITING_FOR_INPUT)==osOK)
     {
+#if (ETHIF_RX_COALESCE_TIME > 0U)
+      /* Let more frames come in before draining them */
+      osDelay(ETHIF_RX_COALESCE_TIME);
+#endif
       do
       {
-        p = low_level_input( netif );
-        if (p != NULL)
+        for(count = 0U; count < ETHIF_RX_BATCH; count++)
         {
-          if (netif->input( p, netif) != ERR_OK )
+          p = low_level_input( netif );
+          if (p == NULL)
+          {
+            break;
+          }
+          if (ethrx_put(&EthRx, p) != ERR_OK)
           {
             pbuf_free(p);
           }
         }
 
-      }while(p != NULL);
+        /* One tcpip_thread message for the whole batch */
+        while (ethrx_flush(&EthRx) != ERR_OK)
+        {
+          osDelay(ETHIF_RX_RETRY_TIME);
+        }
+      }while(count == ETHIF_RX_BATCH);
+
+      /* No frame left: back to interrupt mode */
+      __HAL_ETH_DMA_ENABLE_IT(&EthHandle, ETH_DMAIER_RIE);
     }
   }
 }
@@ -427,9 +461,7 @@ err_t ethernetif_init(struct netif *netif)
   netif->linkoutput = low_level_output;
 
   /* initialize the hardware */
-  low_level_init(netif);
-
-  return ERR_OK;
+  return low_level_init(netif);
 }
 
 /**
@@ -523,6 +555,8 @@ void HAL_ETH_MspInit(ETH_HandleTypeDef *heth)
   */
 void HAL_ETH_RxCpltCallback(ETH_HandleTypeDef *heth)
 {
+  /* Mask the Rx interrupt until ethernetif_input has drained the frames */
+  __HAL_ETH_DMA_DISABLE_IT(heth, ETH_DMAIER_RIE);
   osSemaphoreRelease(RxPktSemaphore);
 }
 
@@ -533,7 +567,10 @@ void HAL_ETH_RxCpltCallback(ETH_HandleTypeDef *heth)
   */
 void HAL_ETH_TxCpltCallback(ETH_HandleTypeDef *heth)
 {
-  osSemaphoreRelease(TxPktSemaphore);
+  /* Give the sent packets back to the transmit ring, their pbufs are freed
+     later in tcpip_thread */
+  HAL_ETH_ReleaseTxPacket(heth);
+  ethtx_complete_batch(&EthTx);
 }
 
 /**
@@ -745,7 +782,7 @@ void HAL_ETH_RxLinkCallback(void **pStart, void **pEnd, uint8_t *buff, uint16_t
 
 void HAL_ETH_TxFreeCallback(uint32_t * buff)
 {
-  pbuf_free((struct pbuf *)buff);
+  ethtx_complete(&EthTx, buff);
 }
 
 /**
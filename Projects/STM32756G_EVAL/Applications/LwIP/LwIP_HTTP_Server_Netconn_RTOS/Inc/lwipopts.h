@@ -57,6 +57,9 @@ a lot of data that needs to be copied, this should be set high. */
 /* MEMP_NUM_SYS_TIMEOUT: the number of simulateously active
    timeouts. */
 #define MEMP_NUM_SYS_TIMEOUT    10
+/* MEMP_LOCKFREE: take and give back pool elements with a compare-and-swap
+   (LDREX/STREX, see sys_arch_cas32()) instead of the lwIP core mutex. */
+#define MEMP_LOCKFREE           1
 
 
 /* ---------- Pbuf options ---------- */
@@ -153,6 +156,12 @@ The STM32F7xxallows computing and verifying the IP, UDP, TCP and ICMP checksums
   #define CHECKSUM_CHECK_TCP              1
   /* CHECKSUM_CHECK_ICMP==1: Check checksums by hardware for incoming ICMP packets.*/
   #define CHECKSUM_GEN_ICMP               1
+  /* LWIP_CHKSUM_ALGORITHM==4: Sum 32-bit words in a 64-bit accumulator.*/
+  #define LWIP_CHKSUM_ALGORITHM           4
+  /* LWIP_CHECKSUM_ON_COPY==1: Calculate the checksum of the data while copying it to pbufs.*/
+  #define LWIP_CHECKSUM_ON_COPY           1
+  /* LWIP_CHKSUM_COPY_ALGORITHM==2: Copy and checksum the data in one pass.*/
+  #define LWIP_CHKSUM_COPY_ALGORITHM      2
 #endif
 
 
@@ -167,6 +167,12 @@ The STM32F7xxallows computing and verifying the IP, UDP, TCP and ICMP checksums
   #define CHECKSUM_CHECK_TCP              1
   /* CHECKSUM_CHECK_ICMP==1: Check checksums by hardware for incoming ICMP packets.*/
   #define CHECKSUM_GEN_ICMP               1
+  /* LWIP_CHKSUM_ALGORITHM==4: Sum 32-bit words in a 64-bit accumulator.*/
+  #define LWIP_CHKSUM_ALGORITHM           4
+  /* LWIP_CHECKSUM_ON_COPY==1: Calculate the checksum of the data while copying it to pbufs.*/
+  #define LWIP_CHECKSUM_ON_COPY           1
+  /* LWIP_CHKSUM_COPY_ALGORITHM==2: Copy and checksum the data in one pass.*/
+  #define LWIP_CHKSUM_COPY_ALGORITHM      2
 #endif
 
 